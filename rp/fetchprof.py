@@ -0,0 +1,132 @@
+import argparse
+import bisect
+import os
+import re
+import sys
+
+# Map the histogram of the ROM4 fetch profiler to the symbols of the target
+# firmware. The histogram is the output of the "profile" telemetry command,
+# saved from the USB CDC port. The symbols come from the listing of vasm,
+# target/atarist/build/main.lst, written by the target Makefile.
+
+ROM4_ADDR = 0xFA0000
+
+LISTING_FILE = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)),
+    "..",
+    "target",
+    "atarist",
+    "build",
+    "main.lst",
+)
+
+# Source line and code lines of the listing of vasm:
+# F00:0326       start:
+#                S01:00FA0000:  22 00
+SOURCE_LINE = re.compile(r"^F\d+:\d+\s(.*)$")
+CODE_LINE = re.compile(r"^\s+S\d+:([0-9A-Fa-f]{8}):")
+LABEL = re.compile(r"^\s*(\.?[A-Za-z_][\w]*):")
+
+
+def read_histogram(file_path):
+    # Returns the bytes per bucket and a dict of ROM4 offset to samples
+    bucket_bytes = None
+    histogram = {}
+    with open(file_path, "r") as file:
+        for line in file:
+            fields = line.split()
+            if len(fields) == 3 and fields[0] == "profile":
+                bucket_bytes = int(fields[1])
+                histogram = {}
+            elif fields == ["profile", "end"]:
+                break
+            elif bucket_bytes is not None and len(fields) == 2:
+                histogram[int(fields[0], 16)] = int(fields[1], 16)
+    if bucket_bytes is None:
+        raise ValueError(f"No profile export in {file_path}")
+    return bucket_bytes, histogram
+
+
+def read_symbols(file_path):
+    # Returns the sorted addresses and the label of each. The local labels
+    # are named after the last global label
+    symbols = {}
+    pending = []
+    scope = ""
+    with open(file_path, "r", errors="replace") as file:
+        for line in file:
+            source = SOURCE_LINE.match(line)
+            if source is not None:
+                label = LABEL.match(source.group(1))
+                if label is not None and " equ " not in source.group(1):
+                    name = label.group(1)
+                    if name.startswith("."):
+                        name = scope + name
+                    else:
+                        scope = name
+                    pending.append(name)
+                continue
+            code = CODE_LINE.match(line)
+            if code is not None and pending:
+                address = int(code.group(1), 16)
+                symbols.setdefault(address, pending[-1])
+                pending = []
+    addresses = sorted(symbols)
+    return addresses, [symbols[address] for address in addresses]
+
+
+def symbol_of(address, addresses, names):
+    index = bisect.bisect_right(addresses, address) - 1
+    if index < 0:
+        return "?", 0
+    return names[index], address - addresses[index]
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Map the ROM4 fetch profile to the symbols of the target "
+        "firmware."
+    )
+    parser.add_argument(
+        "profile",
+        help="Text saved from the USB telemetry after the profile command.",
+    )
+    parser.add_argument(
+        "--listing",
+        default=LISTING_FILE,
+        help="Listing of vasm. Default: target/atarist/build/main.lst.",
+    )
+    parser.add_argument(
+        "--top",
+        type=int,
+        default=20,
+        help="Symbols to show, the hottest first. Default: 20.",
+    )
+    args = parser.parse_args()
+
+    bucket_bytes, histogram = read_histogram(args.profile)
+    addresses, names = read_symbols(args.listing)
+    if not addresses:
+        sys.exit(f"No symbols in {args.listing}")
+
+    # A bucket can hold the end of a symbol and the start of the next. The
+    # samples go to the symbol at the start of the bucket
+    per_symbol = {}
+    for offset, samples in histogram.items():
+        name, _ = symbol_of(ROM4_ADDR + offset, addresses, names)
+        per_symbol[name] = per_symbol.get(name, 0) + samples
+    total = sum(histogram.values())
+    if total == 0:
+        sys.exit("No samples in the profile")
+
+    print(f"{total} samples, {bucket_bytes} bytes per bucket\n")
+    print(f"{'Samples':>8} {'%':>6}  Symbol")
+    ranking = sorted(per_symbol.items(), key=lambda item: -item[1])
+    for name, samples in ranking[: args.top]:
+        print(f"{samples:>8} {100.0 * samples / total:>6.2f}  {name}")
+
+    print(f"\n{'Address':>8} {'Samples':>8}  Symbol")
+    buckets = sorted(histogram.items(), key=lambda item: -item[1])
+    for offset, samples in buckets[: args.top]:
+        name, delta = symbol_of(ROM4_ADDR + offset, addresses, names)
+        print(f"  ${ROM4_ADDR + offset:06X} {samples:>8}  {name}+{delta}")
@@ -0,0 +1,308 @@
+/**
+ * File: bench_host.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Microbenchmarks of the core code, run in the host. They also
+ * check the results, so a broken build fails the test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz4.h"
+#include "rtcmsg.h"
+#include "settings.h"
+#include "termscreen.h"
+#include "tprotocol.h"
+#include "tzrules.h"
+
+#define BENCH_PARSER_FRAMES 200000  // Frames parsed by benchParser
+#define BENCH_PARSER_PAYLOAD 16     // Bytes of payload of each frame
+#define BENCH_TZ_HOURS (24 * 366 * 4)  // Hours walked by benchTzRules
+#define BENCH_LZ4_ROUNDS 20000         // Blocks decompressed by benchLz4
+#define BENCH_SETTINGS_KEYS 30         // Keys, like the app settings
+#define BENCH_SETTINGS_LOOKUPS 200000  // Lookups done by benchSettings
+#define BENCH_SETTINGS_SAVES 500       // Saves done by benchSettings
+#define BENCH_DATETIME_ROUNDS 200000   // Messages built by benchDatetime
+#define BENCH_SCROLL_LINES 20000       // Lines printed by benchScroll
+
+// Shared memory of the clock, up to its last variable
+#define BENCH_SHARED_SIZE (RTCEMUL_SHARED_VARIABLES + 64)
+
+// Header, command, size, payload and checksum
+#define BENCH_FRAME_WORDS (3 + (BENCH_PARSER_PAYLOAD / 2) + 1)
+
+static unsigned char __attribute__((aligned(4)))
+benchScratch[TPROTO_FRAME_SIZE(TPROTO_SCRATCH_PAYLOAD_SIZE)];
+static TransmissionParser benchParserState;
+static uint32_t benchFrames = 0;
+
+static void benchFrameCB(const TransmissionProtocol *protocol) {
+  (void)protocol;
+  benchFrames++;
+}
+
+static void benchChecksumErrorCB(const TransmissionProtocol *protocol) {
+  (void)protocol;
+}
+
+static int benchParser(void) {
+  uint16_t frame[BENCH_FRAME_WORDS];
+  uint16_t checksum = TPROTO_CHECKSUM_INIT;
+  int words = 0;
+  frame[words++] = PROTOCOL_HEADER;
+  frame[words++] = 0x0001;
+  checksum = tprotocol_checksumAdd(checksum, 0x0001);
+  frame[words++] = BENCH_PARSER_PAYLOAD;
+  checksum = tprotocol_checksumAdd(checksum, BENCH_PARSER_PAYLOAD);
+  for (int i = 0; i < BENCH_PARSER_PAYLOAD / 2; i++) {
+    uint16_t data = (uint16_t)(0x1234 * (i + 1));
+    frame[words++] = data;
+    checksum = tprotocol_checksumAdd(checksum, data);
+  }
+  frame[words++] = checksum;
+
+  benchParserState = (TransmissionParser)TPROTO_PARSER_INIT(benchScratch);
+  benchFrames = 0;
+  uint64_t start = time_us_64();
+  for (int n = 0; n < BENCH_PARSER_FRAMES; n++) {
+    for (int i = 0; i < BENCH_FRAME_WORDS; i++) {
+      tprotocol_parseWith(&benchParserState, frame[i], benchFrameCB,
+                          benchChecksumErrorCB);
+    }
+  }
+  uint64_t elapsed = time_us_64() - start;
+  printf("parser: %.2f ns/word, %u frames\n",
+         (double)elapsed * 1000 /
+             ((double)BENCH_PARSER_FRAMES * BENCH_FRAME_WORDS),
+         benchFrames);
+  return (benchFrames == BENCH_PARSER_FRAMES) ? 0 : -1;
+}
+
+static int benchTzRules(void) {
+  TzRules rules;
+  if (tzrules_parse("CET-1CEST,M3.5.0,M10.5.0/3", &rules) != 0) {
+    printf("tzrules: parse failed\n");
+    return -1;
+  }
+  // 2024-01-15 and 2024-07-15 at noon UTC
+  if ((tzrules_offsetAt(&rules, 1705320000) != 3600) ||
+      (tzrules_offsetAt(&rules, 1721044800) != 7200)) {
+    printf("tzrules: wrong offset\n");
+    return -1;
+  }
+
+  // Walk the clock forward, like the calls with the time of the clock
+  uint32_t utc = 1704067200;  // 2024-01-01 00:00 UTC
+  int64_t sum = 0;
+  uint64_t start = time_us_64();
+  for (int i = 0; i < BENCH_TZ_HOURS; i++) {
+    sum += tzrules_offsetAt(&rules, utc);
+    utc += 3600;
+  }
+  uint64_t elapsed = time_us_64() - start;
+  printf("tzrules: %.2f ns/offset, sum %lld\n",
+         (double)elapsed * 1000 / BENCH_TZ_HOURS, (long long)sum);
+  return 0;
+}
+
+static int benchLz4(void) {
+  // Four literals, then a match of 60 bytes with offset 4 repeating them,
+  // and five more literals to close the block
+  static const uint8_t block[] = {0x4F, 'a', 'b', 'c', 'd', 0x04, 0x00,
+                                  41,   0x50, 'e', 'f', 'g', 'h', 'i'};
+  uint8_t out[128];
+  int size = 0;
+  uint64_t start = time_us_64();
+  for (int i = 0; i < BENCH_LZ4_ROUNDS; i++) {
+    size = lz4_decompress(block, sizeof(block), out, sizeof(out));
+  }
+  uint64_t elapsed = time_us_64() - start;
+  printf("lz4: %.2f ns/block of %d bytes\n",
+         (double)elapsed * 1000 / BENCH_LZ4_ROUNDS, size);
+  if ((size != 69) || (memcmp(out, "abcdabcd", 8) != 0) ||
+      (memcmp(out + 60, "abcdefghi", 9) != 0)) {
+    printf("lz4: wrong output\n");
+    return -1;
+  }
+  // A match before the start of the output must be refused
+  static const uint8_t bad[] = {0x10, 'a', 0x08, 0x00};
+  if (lz4_decompress(bad, sizeof(bad), out, sizeof(out)) != -1) {
+    printf("lz4: bad block accepted\n");
+    return -1;
+  }
+  return 0;
+}
+
+static int benchSettings(void) {
+  static SettingsConfigEntry defaults[BENCH_SETTINGS_KEYS];
+  static SettingsConfigEntry
+      arena[SETTINGS_ARENA_ENTRIES(BENCH_SETTINGS_KEYS)];
+  for (int i = 0; i < BENCH_SETTINGS_KEYS; i++) {
+    snprintf(defaults[i].key, sizeof(defaults[i].key), "BENCH_KEY_%02d", i);
+    defaults[i].dataType = SETTINGS_TYPE_INT;
+    snprintf(defaults[i].value, sizeof(defaults[i].value), "%d", i);
+  }
+  flash_range_erase(0, HOST_FLASH_SIZE);
+
+  SettingsContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  settings_setJournaled(&ctx, true);
+  settings_setArena(&ctx, arena, SETTINGS_ARENA_ENTRIES(BENCH_SETTINGS_KEYS));
+  // The flash is empty, so it loads the defaults and writes them, like the
+  // first boot
+  settings_init(&ctx, defaults, BENCH_SETTINGS_KEYS, 0, FLASH_SECTOR_SIZE,
+                0x1234, 1);
+  settings_save(&ctx, false);
+
+  // The last entry is the worst case of a linear search
+  const char *key = defaults[BENCH_SETTINGS_KEYS - 1].key;
+  uint32_t found = 0;
+  uint64_t start = time_us_64();
+  for (int n = 0; n < BENCH_SETTINGS_LOOKUPS; n++) {
+    if (settings_find_entry(&ctx, key) != NULL) {
+      found++;
+    }
+  }
+  uint64_t elapsed = time_us_64() - start;
+  printf("settings: %.2f ns/lookup, %u found\n",
+         (double)elapsed * 1000 / BENCH_SETTINGS_LOOKUPS, found);
+
+  // Each save appends one record, and compacts the journal when it is full
+  start = time_us_64();
+  for (int n = 0; n < BENCH_SETTINGS_SAVES; n++) {
+    settings_put_integer(&ctx, key, n);
+    settings_save(&ctx, false);
+  }
+  elapsed = time_us_64() - start;
+  printf("settings: %.2f us/save\n",
+         (double)elapsed / BENCH_SETTINGS_SAVES);
+
+  // The journal must give back the last value
+  SettingsContext reload;
+  memset(&reload, 0, sizeof(reload));
+  settings_setJournaled(&reload, true);
+  settings_setArena(&reload, arena,
+                    SETTINGS_ARENA_ENTRIES(BENCH_SETTINGS_KEYS));
+  settings_init(&reload, defaults, BENCH_SETTINGS_KEYS, 0, FLASH_SECTOR_SIZE,
+                0x1234, 1);
+  SettingsConfigEntry *entry = settings_find_entry(&reload, key);
+  if ((found != BENCH_SETTINGS_LOOKUPS) || (entry == NULL) ||
+      (atoi(entry->value) != BENCH_SETTINGS_SAVES - 1)) {
+    printf("settings: wrong value after reload\n");
+    return -1;
+  }
+  return 0;
+}
+
+static int benchDatetime(void) {
+  static uint32_t shared[BENCH_SHARED_SIZE / sizeof(uint32_t)];
+  uintptr_t sharedAddr = (uintptr_t)shared;
+  const uint8_t *bcd = (const uint8_t *)shared + RTCEMUL_DATETIME_BCD;
+
+  // The Y2K offset wraps the century
+  if ((rtcmsg_toBcd(59) != 0x59) || (rtcmsg_addBcd(0x24, 0x70) != 0x94) ||
+      (rtcmsg_addBcd(0x35, 0x70) != 0x05)) {
+    printf("datetime: wrong BCD\n");
+    return -1;
+  }
+
+  // 2024-07-15 13:45:30, a Monday
+  datetime_t now = {.year = 2024,
+                    .month = 7,
+                    .day = 15,
+                    .dotw = 1,
+                    .hour = 13,
+                    .min = 45,
+                    .sec = 30};
+  WRITE_LONGWORD_RAW(sharedAddr, RTCEMUL_Y2K_PATCH, 0xFFFFFFFF);
+  uint32_t seq = READ_AND_SWAP_LONGWORD(sharedAddr, RTCEMUL_DATETIME_SEQ);
+  uint64_t start = time_us_64();
+  for (int i = 0; i < BENCH_DATETIME_ROUNDS; i++) {
+    rtcmsg_setDatetime(sharedAddr, &now, true, -1500, 42);
+  }
+  uint64_t elapsed = time_us_64() - start;
+  printf("datetime: %.2f ns/message\n",
+         (double)elapsed * 1000 / BENCH_DATETIME_ROUNDS);
+
+  // The bytes of each word are swapped for the 68000
+  static const uint8_t expected[8] = {0x94, 0x1b, 0x15, 0x07,
+                                      0x45, 0x13, 0x00, 0x30};
+  uint32_t msdos = READ_LONGWORD(sharedAddr, RTCEMUL_DATETIME_MSDOS);
+  if ((memcmp(bcd, expected, sizeof(expected)) != 0) ||
+      (msdos != ((((2024 - 1980) << 9 | 7 << 5 | 15) << 16) |
+                 (13 << 11 | 45 << 5 | 15))) ||
+      (READ_LONGWORD(sharedAddr, RTCEMUL_Y2K_PATCH) != 0xFFFFFFFF) ||
+      (READ_AND_SWAP_LONGWORD(sharedAddr, RTCEMUL_DRIFT_PPB) !=
+       (uint32_t)-1500) ||
+      (READ_AND_SWAP_LONGWORD(sharedAddr, RTCEMUL_SYNC_AGE) != 42)) {
+    printf("datetime: wrong message\n");
+    return -1;
+  }
+  // Two steps per message, and even when it is complete
+  if (READ_AND_SWAP_LONGWORD(sharedAddr, RTCEMUL_DATETIME_SEQ) !=
+      seq + 2 * BENCH_DATETIME_ROUNDS) {
+    printf("datetime: wrong sequence\n");
+    return -1;
+  }
+
+  // Without the patch the year stays and the patch of the computer is off
+  rtcmsg_setDatetime(sharedAddr, &now, false, 0, RTCEMUL_SYNC_AGE_NEVER);
+  if ((bcd[0] != 0x24) ||
+      (READ_LONGWORD(sharedAddr, RTCEMUL_Y2K_PATCH) != 0)) {
+    printf("datetime: wrong year without the Y2K patch\n");
+    return -1;
+  }
+  return 0;
+}
+
+static int benchScroll(void) {
+  static const char line[] = "0123456789012345678901234567890123456789\n";
+  term_clearScreen();
+  // Start from the last row, so every new line scrolls the screen
+  for (int i = 0; i < TERM_SCREEN_SIZE_Y; i++) {
+    term_printString("\n");
+  }
+  uint64_t start = time_us_64();
+  for (int i = 0; i < BENCH_SCROLL_LINES; i++) {
+    term_printString(line);
+  }
+  uint64_t elapsed = time_us_64() - start;
+  printf("scroll: %.2f ns/line\n",
+         (double)elapsed * 1000 / BENCH_SCROLL_LINES);
+
+  // The full line wraps: the next row is empty and the cursor is there
+  uint8_t posX = 0;
+  uint8_t posY = 0;
+  term_getCursor(&posX, &posY);
+  if ((memcmp(term_getRow(TERM_SCREEN_SIZE_Y - 3), line,
+              TERM_SCREEN_SIZE_X) != 0) ||
+      (term_getRow(TERM_SCREEN_SIZE_Y - 2)[0] != 0) || (posX != 0) ||
+      (posY != TERM_SCREEN_SIZE_Y - 1)) {
+    printf("scroll: wrong screen\n");
+    return -1;
+  }
+
+  // Home, clear to the end of the screen and direct cursor addressing
+  term_printString("\x1B" "H" "\x1B" "J" "\x1B" "Y" "\x25" "\x2A" "VT52");
+  term_getCursor(&posX, &posY);
+  if ((memcmp(term_getRow(5) + 10, "VT52", 4) != 0) ||
+      (term_getRow(0)[0] != 0) || (posX != 14) || (posY != 5)) {
+    printf("scroll: wrong escape sequences\n");
+    return -1;
+  }
+  return 0;
+}
+
+int main(void) {
+  int errors = 0;
+  errors += (benchParser() != 0);
+  errors += (benchTzRules() != 0);
+  errors += (benchLz4() != 0);
+  errors += (benchSettings() != 0);
+  errors += (benchDatetime() != 0);
+  errors += (benchScroll() != 0);
+  return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+/**
+ * File: bench_replay.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Replays a bus capture of "capture export" through the
+ * protocol parser, in the host
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tprotocol.h"
+
+// Same bits as bustrace.h, which needs lwIP
+#define REPLAY_ROM3_BIT 0x00010000
+#define REPLAY_WORD_MASK 0x0001FFFF
+
+// Inverted high bit of the address lines, like in the interrupt handlers
+#define REPLAY_ADDRESS_HIGH_BIT 0x8000
+
+// Longest line of the export
+#define REPLAY_LINE_SIZE 256
+
+static unsigned char __attribute__((aligned(4)))
+replayScratch[TPROTO_FRAME_SIZE(TPROTO_SCRATCH_PAYLOAD_SIZE)];
+static TransmissionParser replayParser;
+static uint32_t replayFrames = 0;
+static uint32_t replayErrors = 0;
+static bool replayVerbose = false;
+
+static void replayFrameCB(const TransmissionProtocol *protocol) {
+  replayFrames++;
+  if (replayVerbose) {
+    printf("frame: command 0x%04X, %u bytes\n", protocol->command_id,
+           protocol->payload_size);
+  }
+}
+
+static void replayChecksumErrorCB(const TransmissionProtocol *protocol) {
+  replayErrors++;
+  if (replayVerbose) {
+    printf("checksum error: command 0x%04X, %u bytes\n", protocol->command_id,
+           protocol->payload_size);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) {
+      replayVerbose = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path == NULL) {
+    fprintf(stderr, "usage: %s [-v] capture.txt\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  FILE *file = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    return EXIT_FAILURE;
+  }
+
+  // Load the whole capture first, so only the parser is timed
+  size_t count = 0;
+  size_t capacity = 0;
+  uint32_t *timestamps = NULL;
+  uint32_t *words = NULL;
+  uint32_t rom4 = 0;
+  char line[REPLAY_LINE_SIZE];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    unsigned long timestamp;
+    unsigned long word;
+    // "capture <count>" and "capture end" frame the records
+    if ((strncmp(line, "capture", 7) == 0) ||
+        (sscanf(line, "%lx %lx", &timestamp, &word) != 2)) {
+      continue;
+    }
+    if ((word & REPLAY_ROM3_BIT) == 0) {
+      rom4++;
+      continue;
+    }
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 1024;
+      timestamps = realloc(timestamps, capacity * sizeof(uint32_t));
+      words = realloc(words, capacity * sizeof(uint32_t));
+      if ((timestamps == NULL) || (words == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+      }
+    }
+    timestamps[count] = (uint32_t)timestamp;
+    words[count] = (uint32_t)(word & REPLAY_WORD_MASK);
+    count++;
+  }
+  if (file != stdin) {
+    fclose(file);
+  }
+
+  // The timer follows the timestamps of the capture, so the parser drops
+  // the frames with gaps like in the device
+  replayParser = (TransmissionParser)TPROTO_PARSER_INIT(replayScratch);
+  uint64_t start = time_us_64();
+  for (size_t i = 0; i < count; i++) {
+    timer_hw->timerawl = timestamps[i];
+    tprotocol_parseWith(&replayParser,
+                        (uint16_t)(words[i] ^ REPLAY_ADDRESS_HIGH_BIT),
+                        replayFrameCB, replayChecksumErrorCB);
+  }
+  uint64_t elapsed = time_us_64() - start;
+
+  const TransmissionProtocolStats *stats = &replayParser.stats;
+  printf("rom3=%zu rom4=%u headers=%u frames=%u errors=%u resyncs=%u\n",
+         count, rom4, stats->headers, replayFrames, replayErrors,
+         stats->resyncs);
+  printf("%.2f ns/word\n",
+         (count > 0) ? (double)elapsed * 1000 / (double)count : 0.0);
+  free(timestamps);
+  free(words);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+/**
+ * File: display.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Display of the terminal in the host. The cells go to a
+ * framebuffer like the u8g2 one, with the same bands and scroll of display.c
+ */
+
+#include "display_term.h"
+
+// Framebuffer of u8g2, in the display memory in the device
+static uint8_t hostFramebuffer[DISPLAY_BUFFER_SIZE];
+static uint32_t hostDirtyBands = 0;
+static uint8_t hostScrollHead = 0;
+
+static uint8_t hostBand(uint8_t band) {
+  if (band >= DISPLAY_SCROLL_BANDS) {
+    return band;
+  }
+  return (uint8_t)((band + hostScrollHead) % DISPLAY_SCROLL_BANDS);
+}
+
+// Same writes as the blitter of display_term.c. The glyph rows are the code
+static void hostBlit(uint8_t col, uint8_t row, uint8_t pattern) {
+  uint8_t band = hostBand(row);
+  uint32_t offset = (uint32_t)band * DISPLAY_DIRTY_BAND_BYTES + col;
+  for (int line = 0; line < DISPLAY_TERM_CHAR_HEIGHT; line++) {
+    hostFramebuffer[DISPLAY_SWAP_BYTE(offset)] = pattern;
+    offset += DISPLAY_ROW_BYTES;
+  }
+  hostDirtyBands |= 1u << band;
+}
+
+void display_termChar(uint8_t col, uint8_t row, char chr) {
+  hostBlit(col, row + DISPLAY_TERM_FIRST_ROW_OFFSET - 1, (uint8_t)chr);
+}
+
+void display_termCursor(uint8_t col, uint8_t row) { hostBlit(col, row, 0xFF); }
+
+void display_termStart(uint8_t numCol, uint8_t numRow) {
+  (void)numCol;
+  (void)numRow;
+  display_termClear();
+}
+
+void display_termRefresh() { hostDirtyBands = 0; }
+
+void display_termClear() {
+  memset(hostFramebuffer, 0, sizeof(hostFramebuffer));
+  hostScrollHead = 0;
+  hostDirtyBands = UINT32_MAX;
+}
+
+void display_scrollBands() {
+  memset(hostFramebuffer + hostScrollHead * DISPLAY_DIRTY_BAND_BYTES, 0,
+         DISPLAY_DIRTY_BAND_BYTES);
+  hostScrollHead = (hostScrollHead + 1) % DISPLAY_SCROLL_BANDS;
+  hostDirtyBands = UINT32_MAX;
+}
@@ -0,0 +1,32 @@
+/**
+ * File: flash.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Flash of the host build, an array in RAM
+ */
+
+#include "hardware/flash.h"
+
+#include <assert.h>
+#include <string.h>
+
+uint8_t hostFlash[HOST_FLASH_SIZE];
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+  assert(flash_offs % FLASH_SECTOR_SIZE == 0);
+  assert(count % FLASH_SECTOR_SIZE == 0);
+  assert(flash_offs + count <= HOST_FLASH_SIZE);
+  memset(hostFlash + flash_offs, 0xFF, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data,
+                         size_t count) {
+  assert(flash_offs % FLASH_PAGE_SIZE == 0);
+  assert(count % FLASH_PAGE_SIZE == 0);
+  assert(flash_offs + count <= HOST_FLASH_SIZE);
+  // Programming only clears bits, like the real flash
+  for (size_t i = 0; i < count; i++) {
+    hostFlash[flash_offs + i] &= data[i];
+  }
+}
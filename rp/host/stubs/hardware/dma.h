@@ -0,0 +1,14 @@
+/**
+ * File: dma.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_HARDWARE_DMA_H
+#define HOST_HARDWARE_DMA_H
+
+// The host build copies with memcpy: there are no DMA channels
+
+#endif  // HOST_HARDWARE_DMA_H
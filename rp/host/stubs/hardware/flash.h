@@ -0,0 +1,30 @@
+/**
+ * File: flash.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build. The flash is an
+ * array in RAM, erased to 0xFF
+ */
+
+#ifndef HOST_HARDWARE_FLASH_H
+#define HOST_HARDWARE_FLASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+
+// Size of the flash of the host. Enough for the settings of the tests
+#define HOST_FLASH_SIZE (16u * FLASH_SECTOR_SIZE)
+
+extern uint8_t hostFlash[HOST_FLASH_SIZE];
+
+#define XIP_BASE ((uintptr_t)hostFlash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data,
+                         size_t count);
+
+#endif  // HOST_HARDWARE_FLASH_H
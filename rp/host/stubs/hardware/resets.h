@@ -0,0 +1,12 @@
+/**
+ * File: resets.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_HARDWARE_RESETS_H
+#define HOST_HARDWARE_RESETS_H
+
+#endif  // HOST_HARDWARE_RESETS_H
@@ -0,0 +1,22 @@
+/**
+ * File: systick.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_HARDWARE_STRUCTS_SYSTICK_H
+#define HOST_HARDWARE_STRUCTS_SYSTICK_H
+
+#include <stdint.h>
+
+typedef struct {
+  volatile uint32_t cvr;
+} systick_hw_t;
+
+// The SysTick never counts in the host, so the interrupts take 0 cycles
+static systick_hw_t hostSystick __attribute__((unused));
+#define systick_hw (&hostSystick)
+
+#endif  // HOST_HARDWARE_STRUCTS_SYSTICK_H
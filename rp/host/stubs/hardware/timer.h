@@ -0,0 +1,23 @@
+/**
+ * File: timer.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_HARDWARE_TIMER_H
+#define HOST_HARDWARE_TIMER_H
+
+#include <stdint.h>
+
+typedef struct {
+  volatile uint32_t timerawl;
+} timer_hw_t;
+
+// The timer only moves when the host code sets it, so a replay can feed the
+// timestamps of a capture to the parser
+extern timer_hw_t hostTimer;
+#define timer_hw (&hostTimer)
+
+#endif  // HOST_HARDWARE_TIMER_H
@@ -0,0 +1,14 @@
+/**
+ * File: vreg.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_HARDWARE_VREG_H
+#define HOST_HARDWARE_VREG_H
+
+#define VREG_VOLTAGE_1_10 0b01011
+
+#endif  // HOST_HARDWARE_VREG_H
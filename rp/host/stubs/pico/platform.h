@@ -0,0 +1,16 @@
+/**
+ * File: platform.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_PICO_PLATFORM_H
+#define HOST_PICO_PLATFORM_H
+
+// There is no flash to keep the code out of in the host
+#define __not_in_flash_func(func_name) func_name
+#define __scratch_x(group) __attribute__((unused))
+
+#endif  // HOST_PICO_PLATFORM_H
@@ -0,0 +1,20 @@
+/**
+ * File: stdlib.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/sync.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+#include "pico/types.h"
+
+#endif  // HOST_PICO_STDLIB_H
@@ -0,0 +1,31 @@
+/**
+ * File: time.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_PICO_TIME_H
+#define HOST_PICO_TIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "hardware/timer.h"
+
+typedef uint64_t absolute_time_t;
+
+// Monotonic clock of the host, like the timer of the device
+static inline uint64_t time_us_64(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+static inline bool best_effort_wfe_or_timeout(absolute_time_t until) {
+  return time_us_64() >= until;
+}
+
+#endif  // HOST_PICO_TIME_H
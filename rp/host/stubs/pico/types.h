@@ -0,0 +1,25 @@
+/**
+ * File: types.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Stub of the pico-sdk for the host build
+ */
+
+#ifndef HOST_PICO_TYPES_H
+#define HOST_PICO_TYPES_H
+
+#include <stdint.h>
+
+// Same fields as the datetime_t of the pico-sdk
+typedef struct {
+  int16_t year;
+  int8_t month;
+  int8_t day;
+  int8_t dotw;
+  int8_t hour;
+  int8_t min;
+  int8_t sec;
+} datetime_t;
+
+#endif  // HOST_PICO_TYPES_H
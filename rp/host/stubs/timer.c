@@ -0,0 +1,11 @@
+/**
+ * File: timer.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Timer of the host build
+ */
+
+#include "hardware/timer.h"
+
+timer_hw_t hostTimer;
@@ -0,0 +1,511 @@
+import argparse
+import os
+import re
+import sys
+
+# Simulate the PIO programs of the ROM emulator against the bus cycles of the
+# 68000 and report the timing margins, before flashing a new clock or a new
+# number of wait cycles.
+
+SRC_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "src")
+PIO_FILE = os.path.join(SRC_PATH, "romemul.pio")
+CONSTANTS_FILE = os.path.join(SRC_PATH, "include", "constants.h")
+
+# Worst case values of the MC68000 datasheet in nanoseconds:
+# clock low to address valid (6), clock high to /AS asserted (9),
+# clock low to /AS negated (12) and data in setup to clock low (27).
+# The data is latched in the falling edge that ends S6, so the hold is
+# measured from that edge
+CPU_TIMINGS = {
+    8: {"tCLAV": 62, "tCHSL": 60, "tCLSH": 70, "tDICL": 15},
+    16: {"tCLAV": 30, "tCHSL": 30, "tCLSH": 30, "tDICL": 7},
+}
+
+INPUT_SYNC_CYCLES = 2  # The GPIO inputs pass through a two flop synchronizer
+BUS_CYCLES = 4  # Back to back ROM reads simulated in each run
+PHASE_STEPS = 16  # Phases of the bus against the PIO clock simulated
+
+# Side-set pins of romemul_read: bit 0 is /READ and bit 1 is /WRITE
+SIDE_READ = 0b01
+SIDE_WRITE = 0b10
+
+# Shift thresholds of romemul_read_program_init()
+AUTOPUSH_BITS = 17
+AUTOPULL_BITS = 16
+
+
+def read_text(file_path):
+    with open(file_path, "r") as file:
+        return file.read()
+
+
+def read_constant(text, name):
+    match = re.search(r"#define\s+" + name + r"\s+\(?([0-9.]+)", text)
+    if match is None:
+        raise ValueError(f"{name} not found in {CONSTANTS_FILE}")
+    return float(match.group(1))
+
+
+def parse_pio(text):
+    # Returns the public defines and, for each program, the list of
+    # instructions and the wrap addresses
+    defines = {}
+    programs = {}
+    program = None
+    in_sdk_block = False
+    for line in text.splitlines():
+        if line.startswith("%"):
+            in_sdk_block = "{" in line
+            continue
+        if in_sdk_block:
+            continue
+        line = line.split(";")[0].split("//")[0].strip()
+        if not line:
+            continue
+        if line.startswith(".define"):
+            fields = line.split()
+            defines[fields[-2]] = fields[-1]
+        elif line.startswith(".program"):
+            program = {"code": [], "wrap_target": 0, "wrap": None}
+            programs[line.split()[1]] = program
+        elif line.startswith(".wrap_target"):
+            program["wrap_target"] = len(program["code"])
+        elif line.startswith(".wrap"):
+            program["wrap"] = len(program["code"]) - 1
+        elif line.startswith("."):
+            continue
+        elif line.endswith(":"):
+            program.setdefault("labels", {})[line.split()[-1][:-1]] = len(
+                program["code"]
+            )
+        else:
+            program["code"].append(parse_instruction(line))
+    for program in programs.values():
+        if program["wrap"] is None:
+            program["wrap"] = len(program["code"]) - 1
+    return defines, programs
+
+
+def parse_instruction(line):
+    match = re.match(
+        r"^(?P<op>\w+)\s*(?P<args>.*?)\s*(side\s+(?P<side>\w+))?\s*"
+        r"(\[(?P<delay>[^\]]+)\])?$",
+        line,
+    )
+    args = [arg for arg in re.split(r"[\s,]+", match.group("args")) if arg]
+    return {
+        "op": match.group("op"),
+        "args": args,
+        "side": match.group("side"),
+        "delay": match.group("delay"),
+    }
+
+
+def resolve(value, defines):
+    # Numbers and defines, 0b binary values included
+    while value in defines:
+        value = defines[value]
+    return int(value, 0)
+
+
+class StateMachine:
+    def __init__(self, name, program, defines):
+        self.name = name
+        self.program = program
+        self.defines = defines
+        self.pc = 0
+        self.x = 0
+        self.y = 0
+        self.isr = 0
+        self.osr = 0
+        self.isr_count = 0
+        self.osr_count = 0
+        self.delay = 0
+        self.issued = False
+        self.jumped = False
+        self.side = None
+
+    def step(self, cycle, bus):
+        # Runs one PIO clock cycle. Returns the IRQ flags to set
+        if self.delay > 0:
+            self.delay -= 1
+            return []
+        instr = self.program["code"][self.pc]
+        if not self.issued:
+            # The side-set is applied when the instruction is issued, even
+            # if it stalls
+            self.issued = True
+            if instr["side"] is not None:
+                self.side = resolve(instr["side"], self.defines)
+                bus.side_changed(self, cycle)
+        pc = self.pc
+        self.jumped = False
+        done, irqs = self.execute(instr, cycle, bus)
+        if done:
+            self.issued = False
+            if instr["delay"] is not None:
+                self.delay = resolve(instr["delay"].strip(), self.defines)
+            if self.jumped:
+                pass
+            elif pc == self.program["wrap"]:
+                self.pc = self.program["wrap_target"]
+            else:
+                self.pc += 1
+        return irqs
+
+    def execute(self, instr, cycle, bus):
+        op = instr["op"]
+        args = instr["args"]
+        if op == "nop":
+            return True, []
+        if op == "wait":
+            polarity = resolve(args[0], self.defines)
+            if args[1] == "irq":
+                index = resolve(args[2], self.defines)
+                if bus.irq(index) != polarity:
+                    return False, []
+                if polarity == 1:
+                    bus.clear_irq(index)
+                return True, []
+            pin = resolve(args[2], self.defines)
+            return bus.gpio(pin, cycle) == polarity, []
+        if op == "irq":
+            return True, [resolve(args[-1], self.defines)]
+        if op == "mov":
+            value = self.source(args[1])
+            if args[0] == "osr":
+                self.osr, self.osr_count = value, 0
+            elif args[0] == "isr":
+                self.isr, self.isr_count = value, 0
+            elif args[0] == "x":
+                self.x = value
+            elif args[0] == "y":
+                self.y = value
+            return True, []
+        if op == "out":
+            if self.osr_count >= AUTOPULL_BITS:
+                if not bus.tx_ready(cycle):
+                    return False, []
+                self.osr, self.osr_count = bus.tx_pop(), 0
+            self.osr_count += resolve(args[1], self.defines)
+            if args[0] == "pins":
+                bus.data_out(cycle)
+            return True, []
+        if op == "in":
+            self.isr_count += resolve(args[1], self.defines)
+            if args[0] == "pins":
+                bus.address_in(cycle)
+            if self.isr_count >= AUTOPUSH_BITS:
+                bus.rx_push(cycle)
+                self.isr_count = 0
+            return True, []
+        if op == "pull":
+            if not bus.tx_ready(cycle):
+                return args[:1] == ["noblock"], []
+            self.osr, self.osr_count = bus.tx_pop(), 0
+            return True, []
+        if op == "push":
+            bus.rx_push(cycle)
+            self.isr_count = 0
+            return True, []
+        if op == "jmp":
+            self.jumped = self.condition(args[0]) if len(args) > 1 else True
+            if self.jumped:
+                self.pc = self.program["labels"][args[-1]]
+            return True, []
+        raise ValueError(f"Instruction not simulated: {op}")
+
+    def source(self, name):
+        if name.startswith("~"):
+            return ~self.source(name[1:]) & 0xFFFFFFFF
+        return {"null": 0, "x": self.x, "y": self.y, "osr": self.osr}.get(
+            name, self.isr
+        )
+
+    def condition(self, name):
+        if name == "x!=y":
+            return self.x != self.y
+        raise ValueError(f"Condition not simulated: {name}")
+
+
+class Bus:
+    # The 68000 doing back to back ROM reads, the glue logic, the
+    # transceivers and the DMA chain that looks up the data
+    def __init__(self, config, rom_pin, phase_ns):
+        self.config = config
+        self.rom_pin = rom_pin
+        self.period = config["pio_ns"]
+        self.phase = phase_ns
+        half = 500.0 / config["cpu_mhz"]
+        timing = CPU_TIMINGS[config["cpu_mhz"]]
+        cycle_ns = (8 + 4 * config["wait_states"]) * half
+        self.accesses = []
+        for n in range(BUS_CYCLES):
+            start = phase_ns + n * cycle_ns
+            s7 = start + (7 + 4 * config["wait_states"]) * half
+            as_low = start + 2 * half + timing["tCHSL"]
+            as_high = s7 + timing["tCLSH"]
+            self.accesses.append(
+                {
+                    "address": start + half + timing["tCLAV"],
+                    "rom_low": as_low + config["decode_ns"],
+                    "rom_high": as_high + config["decode_ns"],
+                    "sample": s7 - timing["tDICL"],
+                    "hold": s7,
+                    "next_drive": start + cycle_ns + 3 * half,
+                    "events": {},
+                }
+            )
+        self.cycle = 0
+        self.irqs = set()
+        self.rx = []
+        self.tx = []
+        self.read_pass = -1
+        self.read_on = None
+        self.write_on = None
+
+    def time(self, cycle):
+        return cycle * self.period
+
+    def access(self):
+        if 0 <= self.read_pass < len(self.accesses):
+            return self.accesses[self.read_pass]
+        return None
+
+    def gpio(self, pin, cycle):
+        if pin != self.rom_pin:
+            return 1
+        sampled = self.time(cycle - INPUT_SYNC_CYCLES)
+        for access in self.accesses:
+            if access["rom_low"] <= sampled < access["rom_high"]:
+                return 0
+        return 1
+
+    def irq(self, index):
+        return 1 if index in self.irqs else 0
+
+    def clear_irq(self, index):
+        self.irqs.discard(index)
+        self.read_pass += 1
+        if self.access() is not None:
+            self.access()["events"]["start"] = self.time(self.cycle)
+
+    def side_changed(self, sm, cycle):
+        # The new pins are driven at the end of the cycle
+        now = self.time(cycle + 1)
+        read_on = not (sm.side & SIDE_READ)
+        write_on = not (sm.side & SIDE_WRITE)
+        access = self.access()
+        if read_on and self.read_on is None:
+            self.read_on = now
+        if not read_on:
+            self.read_on = None
+        if write_on and self.write_on is None:
+            self.write_on = now
+        if not write_on:
+            if self.write_on is not None and access is not None:
+                access["events"].setdefault("release", now)
+            self.write_on = None
+        if write_on and access is not None:
+            access["events"].setdefault("write_on", now)
+
+    def address_in(self, cycle):
+        access = self.access()
+        if access is not None:
+            access["events"]["address_in"] = self.time(
+                cycle - INPUT_SYNC_CYCLES
+            )
+            access["events"]["read_on"] = self.read_on
+
+    def rx_push(self, cycle):
+        ready = self.time(cycle + 1) + self.config["dma_ns"]
+        self.tx.append(ready)
+
+    def tx_ready(self, cycle):
+        return bool(self.tx) and self.tx[0] <= self.time(cycle)
+
+    def tx_pop(self):
+        self.tx.pop(0)
+        return 0
+
+    def data_out(self, cycle):
+        access = self.access()
+        if access is not None:
+            access["events"]["data_out"] = self.time(cycle + 1)
+
+
+def simulate(config, programs, defines, phase_ns):
+    rom_pin = resolve(config["rom"], defines)
+    bus = Bus(config, rom_pin, phase_ns)
+    machines = [
+        StateMachine(name, programs[name], defines)
+        for name in ("monitor_rom3", "monitor_rom4", "romemul_read")
+    ]
+    # The C code sends the most significant word of the ROM address first
+    bus.tx.append(0)
+    end = bus.accesses[-1]["next_drive"] + 1000
+    cycle = 0
+    while bus.time(cycle) < end:
+        bus.cycle = cycle
+        irqs = []
+        for sm in machines:
+            irqs += sm.step(cycle, bus)
+        bus.irqs.update(irqs)
+        cycle += 1
+    return bus.accesses
+
+
+def margins(config, programs, defines):
+    # Worst margins of all the accesses in all the phases
+    buffer_ns = config["buffer_ns"]
+    worst = {
+        "Address setup": None,
+        "Data setup": None,
+        "Data hold": None,
+        "Bus release": None,
+    }
+    missed = 0
+    for step in range(PHASE_STEPS):
+        phase = 100.0 + step * config["pio_ns"] / PHASE_STEPS
+        # The first access lets the state machines settle
+        for access in simulate(config, programs, defines, phase)[1:]:
+            events = access["events"]
+            if "data_out" not in events or "release" not in events:
+                missed += 1
+                continue
+            enabled = max(events["read_on"], access["address"])
+            values = {
+                "Address setup": events["address_in"] - enabled - buffer_ns,
+                "Data setup": access["sample"]
+                - max(events["data_out"], events["write_on"])
+                - buffer_ns,
+                "Data hold": events["release"] - access["hold"],
+                "Bus release": access["next_drive"]
+                - events["release"]
+                - buffer_ns,
+            }
+            for name, value in values.items():
+                if worst[name] is None or value < worst[name]:
+                    worst[name] = value
+    return worst, missed
+
+
+def parse_list(value, kind):
+    return [kind(item) for item in value.split(",")]
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Simulate the ROM emulator PIO programs against the 68000 "
+        "bus and report the timing margins."
+    )
+    parser.add_argument(
+        "--clock_khz",
+        default=None,
+        help="RP2040 clock in KHz. Comma separated list to sweep. "
+        "Default: RP2040_CLOCK_FREQ_KHZ.",
+    )
+    parser.add_argument(
+        "--wait_cycles",
+        default=None,
+        help="READ_ADDRESS_SAFE_WAIT_CYCLES. Comma separated list to sweep. "
+        "Default: the value in romemul.pio.",
+    )
+    parser.add_argument(
+        "--divider",
+        type=float,
+        default=None,
+        help="PIO clock divider. Default: SAMPLE_DIV_FREQ.",
+    )
+    parser.add_argument(
+        "--cpu_mhz",
+        default="8",
+        help="68000 clock in MHz, 8 or 16. Comma separated list to sweep.",
+    )
+    parser.add_argument(
+        "--wait_states",
+        type=int,
+        default=0,
+        help="Wait states of the ROM accesses inserted by the glue logic.",
+    )
+    parser.add_argument(
+        "--decode_ns",
+        type=float,
+        default=20.0,
+        help="Delay of the glue logic from /AS to /ROMx.",
+    )
+    parser.add_argument(
+        "--buffer_ns",
+        type=float,
+        default=10.0,
+        help="Propagation delay of the bus transceivers.",
+    )
+    parser.add_argument(
+        "--dma_cycles",
+        type=int,
+        default=12,
+        help="System clock cycles of the DMA chain from the RX to the TX FIFO.",
+    )
+    parser.add_argument(
+        "--rom",
+        default="ROM4_GPIO",
+        choices=["ROM3_GPIO", "ROM4_GPIO"],
+        help="ROM signal of the accesses.",
+    )
+    args = parser.parse_args()
+
+    constants = read_text(CONSTANTS_FILE)
+    defines, programs = parse_pio(read_text(PIO_FILE))
+    clocks = (
+        parse_list(args.clock_khz, int)
+        if args.clock_khz
+        else [int(read_constant(constants, "RP2040_CLOCK_FREQ_KHZ"))]
+    )
+    waits = (
+        parse_list(args.wait_cycles, int)
+        if args.wait_cycles
+        else [resolve("READ_ADDRESS_SAFE_WAIT_CYCLES", defines)]
+    )
+    divider = (
+        args.divider
+        if args.divider is not None
+        else read_constant(constants, "SAMPLE_DIV_FREQ")
+    )
+
+    names = ["Address setup", "Data setup", "Data hold", "Bus release"]
+    print(
+        f"PIO divider {divider:.2f}, {args.wait_states} wait states, "
+        f"decode {args.decode_ns:.0f} ns, buffers {args.buffer_ns:.0f} ns, "
+        f"DMA {args.dma_cycles} cycles"
+    )
+    print("Worst margins in ns. Negative values break the bus timing\n")
+    print(f"{'CPU':>4} {'KHz':>7} {'Wait':>4} " + " ".join(
+        f"{name:>13}" for name in names) + f" {'Missed':>6}")
+    failed = False
+    for cpu_mhz in parse_list(args.cpu_mhz, int):
+        if cpu_mhz not in CPU_TIMINGS:
+            sys.exit(f"No timings of the 68000 at {cpu_mhz} MHz")
+        for clock_khz in clocks:
+            for wait in waits:
+                defines["READ_ADDRESS_SAFE_WAIT_CYCLES"] = str(wait)
+                config = {
+                    "cpu_mhz": cpu_mhz,
+                    "pio_ns": 1e6 * divider / clock_khz,
+                    "wait_states": args.wait_states,
+                    "decode_ns": args.decode_ns,
+                    "buffer_ns": args.buffer_ns,
+                    "dma_ns": 1e6 * args.dma_cycles / clock_khz,
+                    "rom": args.rom,
+                }
+                worst, missed = margins(config, programs, defines)
+                row = f"{cpu_mhz:>4} {clock_khz:>7} {wait:>4} "
+                for name in names:
+                    value = worst[name]
+                    if value is None:
+                        row += f"{'-':>13} "
+                    else:
+                        row += f"{value:>13.1f} "
+                        failed = failed or value < 0
+                print(row + f"{missed:>6}")
+                failed = failed or missed > 0
+    sys.exit(1 if failed else 0)
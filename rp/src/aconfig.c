@@ -1,20 +1,39 @@
 #include "include/aconfig.h"
 
-// We don't have any variables because this is the placeholder app
+#define ACONFIG_DEFAULT_ENTRY(id, type, value) \
+  {ACONFIG_PARAM_##id, type, value},
+
 static SettingsConfigEntry defaultEntries[] = {
-    {ACONFIG_PARAM_MODE, SETTINGS_TYPE_INT, "255"},  // 255: Menu mode
-    {ACONFIG_PARAM_RTC_NTP_SERVER_HOST, SETTINGS_TYPE_STRING,
-     "pool.ntp.org"},  // NTP server host
-    {ACONFIG_PARAM_RTC_NTP_SERVER_PORT, SETTINGS_TYPE_INT,
-     "123"},  // NTP server port
-    {ACONFIG_PARAM_RTC_TYPE, SETTINGS_TYPE_STRING, "SIDECART"},  // RTC type
-    {ACONFIG_PARAM_RTC_UTC_OFFSET, SETTINGS_TYPE_STRING, "0"},   // UTC offset
-    {ACONFIG_PARAM_RTC_Y2K_PATCH, SETTINGS_TYPE_BOOL, "true"},   // Y2K patch
-};
+    ACONFIG_DEFAULT_ENTRIES(ACONFIG_DEFAULT_ENTRY)};
+
+// Largest journal record of each key, for the compaction of the journal
+#define ACONFIG_RECORD_MAX(id, type, value) \
+  +SETTINGS_JOURNAL_RECORD_MAX(sizeof(ACONFIG_PARAM_##id))
+
+// A compaction writes the header and one record per entry. The longest values
+// must still leave room for a change, or every save would compact the sector
+_Static_assert(sizeof(SettingsJournalHeader) +
+                       SETTINGS_JOURNAL_RECORD_MAX(
+                           sizeof(SETTINGS_MAGICVERSION_KEY))
+                           ACONFIG_DEFAULT_ENTRIES(ACONFIG_RECORD_MAX) +
+                       SETTINGS_JOURNAL_RECORD_MAX(SETTINGS_MAX_KEY_LENGTH) <=
+                   ACONFIG_BUFFER_SIZE,
+               "The app settings and a change do not fit in the sector");
 
 // Create a global context for our settings
 static SettingsContext gSettingsCtx;
 
+// The entries in memory. Static, sized from the defaults
+static SettingsConfigEntry entriesArena[SETTINGS_ARENA_ENTRIES(
+    ACONFIG_KEY_COUNT)] SETTINGS_ARENA;
+
+// The stored entries keep the order of the defaults: index them directly
+static bool keysInOrder = false;
+
+// Changes not written to the flash yet, and when to write them
+static bool savePending = false;
+static absolute_time_t saveDeadline;
+
 // Helper function to check if a UUID_SIZE-character string is a valid UUID4.
 // A valid UUID4 is in the canonical format
 // "xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx" where x is a hexadecimal digit and y
@@ -131,6 +150,10 @@ int aconfig_init(const char *currentAppId) {
   }
 
   DPRINTF("Initializing app settings\n");
+  // The app sector is only written by this firmware. Append the changes
+  settings_setJournaled(&gSettingsCtx, true);
+  settings_setArena(&gSettingsCtx, entriesArena,
+                    sizeof(entriesArena) / sizeof(entriesArena[0]));
   int err = settings_init(&gSettingsCtx, defaultEntries,
                           sizeof(defaultEntries) / sizeof(defaultEntries[0]),
                           flashAddress - XIP_BASE, ACONFIG_BUFFER_SIZE,
@@ -145,9 +168,91 @@ int aconfig_init(const char *currentAppId) {
 
   DPRINTF("Settings app loaded.\n");
 
+  keysInOrder = true;
+  for (size_t i = 0; i < ACONFIG_KEY_COUNT; i++) {
+    SettingsConfigEntry *entry =
+        settings_get_entry(&gSettingsCtx, SETTINGS_FIRST_ENTRY + i);
+    if ((entry == NULL) || (strncmp(entry->key, defaultEntries[i].key,
+                                    SETTINGS_MAX_KEY_LENGTH) != 0)) {
+      DPRINTF("Entry %zu out of order. Using the key lookup.\n", i);
+      keysInOrder = false;
+      break;
+    }
+  }
+
   settings_print(&gSettingsCtx, NULL);
 
   return ACONFIG_SUCCESS;
 }
 
-SettingsContext *aconfig_getContext(void) { return &gSettingsCtx; }
\ No newline at end of file
+SettingsContext *aconfig_getContext(void) { return &gSettingsCtx; }
+
+SettingsConfigEntry *aconfig_getEntry(AconfigKey key) {
+  if ((unsigned)key >= ACONFIG_KEY_COUNT) {
+    return NULL;
+  }
+  if (keysInOrder) {
+    return settings_get_entry(&gSettingsCtx, SETTINGS_FIRST_ENTRY + key);
+  }
+  return settings_find_entry(&gSettingsCtx, defaultEntries[key].key);
+}
+void aconfig_requestSave(void) {
+  savePending = true;
+  saveDeadline = make_timeout_time_ms(ACONFIG_SAVE_QUIET_MS);
+}
+
+// Runs with the interrupts disabled and core 1 parked
+static void flushLocal(void *param) {
+  *(int *)param = settings_save(&gSettingsCtx, false);
+}
+
+int aconfig_flush(void) {
+  if (!savePending) {
+    return ACONFIG_SUCCESS;
+  }
+  int err = 0;
+  int rc = flash_safe_execute(flushLocal, &err, ACONFIG_SAVE_LOCKOUT_MS);
+  if ((rc != PICO_OK) || (err != 0)) {
+    DPRINTF("Cannot save the app settings. rc=%d err=%d\n", rc, err);
+    // Retry later, not in every loop
+    saveDeadline = make_timeout_time_ms(ACONFIG_SAVE_QUIET_MS);
+    return ACONFIG_SAVE_ERROR;
+  }
+  savePending = false;
+  DPRINTF("App settings saved\n");
+  return ACONFIG_SUCCESS;
+}
+
+void aconfig_poll(void) {
+  if (savePending && time_reached(saveDeadline)) {
+    aconfig_flush();
+  }
+}
+
+// Position of the entry in the settings context. SIZE_MAX if not found
+static size_t entryIndex(AconfigKey key) {
+  if ((unsigned)key >= ACONFIG_KEY_COUNT) {
+    return SIZE_MAX;
+  }
+  if (keysInOrder) {
+    return SETTINGS_FIRST_ENTRY + key;
+  }
+  SettingsConfigEntry *entry = aconfig_getEntry(key);
+  return entry ? (size_t)(entry - gSettingsCtx.configData.entries) : SIZE_MAX;
+}
+
+int aconfig_getInt(AconfigKey key, int defaultValue) {
+  return settings_get_int(&gSettingsCtx, entryIndex(key), defaultValue);
+}
+
+bool aconfig_getBool(AconfigKey key, bool defaultValue) {
+  return settings_get_bool(&gSettingsCtx, entryIndex(key), defaultValue);
+}
+
+double aconfig_getDouble(AconfigKey key, double defaultValue) {
+  return settings_get_double(&gSettingsCtx, entryIndex(key), defaultValue);
+}
+
+const char *aconfig_getString(AconfigKey key, const char *defaultValue) {
+  return settings_get_string(&gSettingsCtx, entryIndex(key), defaultValue);
+}
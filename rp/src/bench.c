@@ -0,0 +1,116 @@
+/**
+ * File: bench.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Microbenchmarks of the core code, run in the device
+ */
+
+#include "bench.h"
+
+#include "tprotocol.h"
+
+// Header, command, size, payload and checksum
+#define BENCH_FRAME_WORDS (3 + (BENCH_PARSER_PAYLOAD / 2) + 1)
+
+// Inverted high bit of the address lines, like in the interrupt handlers
+#define BENCH_ADDRESS_HIGH_BIT 0x8000
+
+// Private parser without queue, so the parser of the bus is not disturbed
+static unsigned char __attribute__((aligned(4)))
+benchScratch[TPROTO_FRAME_SIZE(TPROTO_SCRATCH_PAYLOAD_SIZE)];
+static TransmissionParser benchParser;
+
+_Static_assert(BENCH_PARSER_PAYLOAD <= TPROTO_SCRATCH_PAYLOAD_SIZE,
+               "The payload of the bench does not fit in the scratch frame");
+
+static uint32_t benchFrames = 0;
+static uint32_t benchErrors = 0;
+
+static void __not_in_flash_func(bench_frameCB)(
+    const TransmissionProtocol *protocol) {
+  benchFrames++;
+}
+
+static void __not_in_flash_func(bench_checksumErrorCB)(
+    const TransmissionProtocol *protocol) {
+  benchErrors++;
+}
+
+uint32_t bench_parser(uint32_t *frames) {
+  uint16_t frame[BENCH_FRAME_WORDS];
+  uint16_t checksum = TPROTO_CHECKSUM_INIT;
+  int words = 0;
+  frame[words++] = PROTOCOL_HEADER;
+  frame[words++] = 0x0001;
+  checksum = tprotocol_checksumAdd(checksum, 0x0001);
+  frame[words++] = BENCH_PARSER_PAYLOAD;
+  checksum = tprotocol_checksumAdd(checksum, BENCH_PARSER_PAYLOAD);
+  for (int i = 0; i < BENCH_PARSER_PAYLOAD / 2; i++) {
+    uint16_t data = (uint16_t)(0x1234 * (i + 1));
+    frame[words++] = data;
+    checksum = tprotocol_checksumAdd(checksum, data);
+  }
+  frame[words++] = checksum;
+
+  benchParser = (TransmissionParser)TPROTO_PARSER_INIT(benchScratch);
+  benchFrames = 0;
+  uint64_t start = time_us_64();
+  for (int n = 0; n < BENCH_PARSER_FRAMES; n++) {
+    for (int i = 0; i < BENCH_FRAME_WORDS; i++) {
+      tprotocol_parseWith(&benchParser, frame[i], bench_frameCB,
+                          bench_checksumErrorCB);
+    }
+  }
+  uint64_t elapsed = time_us_64() - start;
+  if (frames != NULL) {
+    *frames = benchFrames;
+  }
+  return (uint32_t)(elapsed * 1000 /
+                    ((uint64_t)BENCH_PARSER_FRAMES * BENCH_FRAME_WORDS));
+}
+
+uint32_t bench_replay(uint32_t *frames, uint32_t *errors) {
+  uint32_t count = 0;
+  const BusTraceRecord *records = bustrace_getRecords(&count);
+  uint32_t words = 0;
+  benchParser = (TransmissionParser)TPROTO_PARSER_INIT(benchScratch);
+  benchFrames = 0;
+  benchErrors = 0;
+  uint64_t start = time_us_64();
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t word = records[i].word;
+    if (word & BUSTRACE_ROM3_BIT) {
+      tprotocol_parseWith(&benchParser,
+                          (uint16_t)(word ^ BENCH_ADDRESS_HIGH_BIT),
+                          bench_frameCB, bench_checksumErrorCB);
+      words++;
+    }
+  }
+  uint64_t elapsed = time_us_64() - start;
+  *frames = benchFrames;
+  *errors = benchErrors;
+  return (words > 0) ? (uint32_t)(elapsed * 1000 / words) : 0;
+}
+
+uint32_t bench_settings(void) {
+  SettingsContext *ctx = aconfig_getContext();
+  // The last entry is the worst case of a linear search
+  SettingsConfigEntry *last = NULL;
+  for (size_t i = 0; settings_get_entry(ctx, i) != NULL; i++) {
+    last = settings_get_entry(ctx, i);
+  }
+  if (last == NULL) {
+    return 0;
+  }
+  uint32_t found = 0;
+  uint64_t start = time_us_64();
+  for (int n = 0; n < BENCH_SETTINGS_LOOKUPS; n++) {
+    if (settings_find_entry(ctx, last->key) != NULL) {
+      found++;
+    }
+  }
+  uint64_t elapsed = time_us_64() - start;
+  DPRINTF("Settings lookups: %u found\n", found);
+  return (uint32_t)(elapsed * 1000 / BENCH_SETTINGS_LOOKUPS);
+}
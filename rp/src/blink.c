@@ -16,56 +16,85 @@ static MorseCode morseAlphabet[] = {
 static bool blinkState = false;
 static absolute_time_t blinkTime = {0};
 
-void blink_morse(char chr) {
-  void blink_morse_container() {
-    const char *morseCode = NULL;
-    // Search for character's Morse code
-    for (int i = 0; morseAlphabet[i].character != '\0'; i++) {
-      if (morseAlphabet[i].character == chr) {
-        morseCode = morseAlphabet[i].morse;
-        break;
-      }
+// Pattern player: milliseconds of the LED on and off in turn, even steps on
+static uint16_t patternSteps[BLINK_PATTERN_MAX_STEPS];
+static int patternLength = 0;
+static int patternStep = 0;
+static bool patternRepeat = false;
+static absolute_time_t patternNext = {0};
+
+static const char *findMorse(char chr) {
+  for (int i = 0; morseAlphabet[i].character != '\0'; i++) {
+    if (morseAlphabet[i].character == chr) {
+      return morseAlphabet[i].morse;
     }
+  }
+  return NULL;
+}
 
-    // If character not found in Morse alphabet, return
-    if (!morseCode) return;
+void blink_play(const char *text, bool repeat) {
+  patternLength = 0;
+  for (; *text != '\0'; text++) {
+    const char *morseCode = findMorse(*text);
+    // Characters not in the Morse alphabet are ignored
+    for (int i = 0; (morseCode != NULL) && (morseCode[i] != '\0') &&
+                    (patternLength < BLINK_PATTERN_MAX_STEPS - 1);
+         i++) {
+      patternSteps[patternLength++] =
+          (morseCode[i] == '.') ? DOT_DURATION_MS : DASH_DURATION_MS;
+      patternSteps[patternLength++] = SYMBOL_GAP_MS;
+    }
+    if (patternLength > 0) {
+      patternSteps[patternLength - 1] = CHARACTER_GAP_MS;
+    }
+  }
+  patternStep = 0;
+  patternRepeat = repeat;
+  patternNext = get_absolute_time();
+  blink_poll();
+}
 
-    // Blink pattern
-    for (int i = 0; morseCode[i] != '\0'; i++) {
-#if defined(CYW43_WL_GPIO_LED_PIN)
-      cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
-#else
-      gpio_put(PICO_DEFAULT_LED_PIN, 1);
-#endif
-      if (morseCode[i] == '.') {
-        // Short blink for dot
-        sleep_ms(DOT_DURATION_MS);
-      } else {
-        // Long blink for dash
-        sleep_ms(DASH_DURATION_MS);
-      }
-#if defined(CYW43_WL_GPIO_LED_PIN)
-      cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
-#else
-      gpio_put(PICO_DEFAULT_LED_PIN, 0);
-#endif
-      // Gap between symbols
-      sleep_ms(SYMBOL_GAP_MS);
+void blink_stop() {
+  patternLength = 0;
+  blink_off();
+}
+
+bool blink_isPlaying() { return patternLength > 0; }
+
+void blink_poll() {
+  if ((patternLength == 0) || !time_reached(patternNext)) {
+    return;
+  }
+  if (patternStep == patternLength) {
+    if (!patternRepeat) {
+      patternLength = 0;  // The last step turned the LED off
+      return;
     }
+    patternStep = 0;
+  }
+  if ((patternStep & 1) == 0) {
+    blink_on();
+  } else {
+    blink_off();
+  }
+  patternNext = make_timeout_time_ms(patternSteps[patternStep++]);
+}
+
+void blink_morse(char chr) {
+  char text[2] = {chr, '\0'};
+  blink_play(text, false);
+  while (blink_isPlaying()) {
+    sleep_until(patternNext);
+    blink_poll();
   }
-#if defined(CYW43_WL_GPIO_LED_PIN)
-#ifdef NETWORK_H
-  network_initChipOnly();
-#endif
-#endif
-  blink_morse_container();
 }
 
 void blink_error() {
   // If we are here, something went wrong. Flash 'E' in morse code forever
+  blink_play("E", true);
   while (1) {
-    blink_morse('E');
-    sleep_ms(CHARACTER_GAP_MS);
+    sleep_until(patternNext);
+    blink_poll();
   }
 }
 
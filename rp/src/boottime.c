@@ -0,0 +1,120 @@
+/**
+ * File: boottime.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Timing of the boot phases of the last boots
+ */
+
+#include "boottime.h"
+
+// Circular history of the last boots. Valid only if the magic and the
+// checksum match
+typedef struct {
+  uint32_t magic;
+  uint32_t head;   // Record of the current boot
+  uint32_t boots;  // Records in use
+  BootRecord records[BOOTTIME_HISTORY];
+  uint32_t checksum;
+} BootHistory;
+
+static BootHistory __uninitialized_ram(bootHistory);
+
+// Names of the phases, in the order of BootPhase
+static const char *phaseNames[BOOT_PHASES] = {
+    "config",    "fw copy", "romemul", "display", "wifi init",
+    "wifi conn", "dhcp",    "dns",     "ntp",     "desktop",
+};
+
+static uint32_t history_checksum(void) {
+  const uint32_t *words = (const uint32_t *)&bootHistory;
+  size_t count = offsetof(BootHistory, checksum) / sizeof(uint32_t);
+  uint32_t sum = 0x9E3779B9;
+  for (size_t i = 0; i < count; i++) {
+    sum = (sum << 1 | sum >> 31) ^ words[i];
+  }
+  return sum;
+}
+
+static inline BootRecord *current_record(void) {
+  return &bootHistory.records[bootHistory.head];
+}
+
+// Only the first run of a phase is boot time. The WiFi connection spans all
+// the attempts until the desktop is launched
+static bool phase_locked(const BootRecord *record, BootPhase phase) {
+  if (phase == BOOT_PHASE_WIFI_CONNECT) {
+    return record->closed;
+  }
+  return record->phases[phase].done;
+}
+
+void boottime_init(void) {
+  if ((bootHistory.magic != BOOTTIME_MAGIC) ||
+      (bootHistory.head >= BOOTTIME_HISTORY) ||
+      (bootHistory.boots > BOOTTIME_HISTORY) ||
+      (bootHistory.checksum != history_checksum())) {
+    // Power up: start a new history
+    memset(&bootHistory, 0, sizeof(bootHistory));
+    bootHistory.magic = BOOTTIME_MAGIC;
+    bootHistory.head = BOOTTIME_HISTORY - 1;
+  }
+  bootHistory.head = (bootHistory.head + 1) % BOOTTIME_HISTORY;
+  if (bootHistory.boots < BOOTTIME_HISTORY) {
+    bootHistory.boots++;
+  }
+  memset(current_record(), 0, sizeof(BootRecord));
+  bootHistory.checksum = history_checksum();
+}
+
+void boottime_begin(BootPhase phase) {
+  BootRecord *record = current_record();
+  BootPhaseTime *time = &record->phases[phase];
+  if (phase_locked(record, phase)) {
+    return;
+  }
+  if (time->count == 0) {
+    time->start_us = (uint32_t)time_us_64();
+  }
+  time->count++;
+  bootHistory.checksum = history_checksum();
+}
+
+void boottime_end(BootPhase phase) {
+  BootRecord *record = current_record();
+  BootPhaseTime *time = &record->phases[phase];
+  if (phase_locked(record, phase)) {
+    return;
+  }
+  if (time->count == 0) {
+    // Measured since the power up
+    time->start_us = 0;
+    time->count = 1;
+  }
+  time->end_us = (uint32_t)time_us_64();
+  time->done = true;
+  if (phase == BOOT_PHASE_DESKTOP) {
+    record->closed = true;
+  }
+  bootHistory.checksum = history_checksum();
+}
+
+const BootRecord *boottime_getRecord(int age) {
+  if ((age < 0) || ((uint32_t)age >= bootHistory.boots)) {
+    return NULL;
+  }
+  uint32_t index =
+      (bootHistory.head + BOOTTIME_HISTORY - (uint32_t)age) % BOOTTIME_HISTORY;
+  return &bootHistory.records[index];
+}
+
+const char *boottime_getPhaseName(BootPhase phase) {
+  return (phase < BOOT_PHASES) ? phaseNames[phase] : "?";
+}
+
+int32_t boottime_getPhaseMs(const BootPhaseTime *phase) {
+  if (!phase->done) {
+    return -1;
+  }
+  return (int32_t)((phase->end_us - phase->start_us) / 1000);
+}
@@ -0,0 +1,211 @@
+/**
+ * File: buscal.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Calibration of the timing of the cartridge bus
+ */
+
+#include "buscal.h"
+
+#include "display.h"
+#include "term.h"
+
+typedef enum {
+  BUSCAL_STEP_IDLE = 0,
+  BUSCAL_STEP_SETTLE,  // Waiting for the computer to go back to the RAM
+  BUSCAL_STEP_TEST,    // The computer reads the pattern with a candidate
+  BUSCAL_STEP_REPORT   // Waiting for the errors of the candidate
+} BusCalStep;
+
+static const float dividers[BUSCAL_NUM_DIVIDERS] = BUSCAL_DIVIDERS;
+
+static BusCalCandidate candidates[BUSCAL_CANDIDATES];
+static BusCalStep step = BUSCAL_STEP_IDLE;
+static int32_t current = -1;  // Candidate under test, -1 before the first
+static absolute_time_t deadline;
+
+static inline uint32_t sharedAddress(void) {
+  return (uint32_t)&__rom_in_ram_start__;
+}
+
+static void setState(uint32_t state) {
+  WRITE_AND_SWAP_LONGWORD(sharedAddress(), BUSCAL_STATE_OFFSET, state);
+}
+
+static void setSafeTiming(void) {
+  romemul_setBusTiming(READ_ADDRESS_SAFE_WAIT_CYCLES, SAMPLE_DIV_FREQ);
+}
+
+// Each long has the inverted address and the address of its second word, so
+// the data lines toggle in every access
+static void writePattern(void) {
+  for (uint32_t i = 0; i < BUSCAL_PATTERN_LONGS; i++) {
+    uint32_t offset = BUSCAL_PATTERN_OFFSET + i * sizeof(uint32_t);
+    WRITE_WORD(sharedAddress(), offset, (uint16_t)~offset);
+    WRITE_WORD(sharedAddress(), offset + 2, (uint16_t)(offset + 2));
+  }
+}
+
+static bool candidatePassed(const BusCalCandidate *candidate) {
+  return candidate->tested && (candidate->errors == 0) &&
+         (candidate->passes >= BUSCAL_MIN_PASSES);
+}
+
+// A candidate is stable if the next slower wait also passes
+static bool candidateStable(int index) {
+  if (!candidatePassed(&candidates[index])) {
+    return false;
+  }
+  if (candidates[index].waitCycles == ROMEMUL_MAX_WAIT_CYCLES) {
+    return true;
+  }
+  return candidatePassed(&candidates[index + 1]);
+}
+
+// Time from the access to the data in the bus, in system clock cycles
+static float candidateCycles(const BusCalCandidate *candidate) {
+  return (BUSCAL_FIXED_CYCLES + BUSCAL_DATA_WAITS * candidate->waitCycles) *
+         candidate->divider;
+}
+
+static void finish(bool completed) {
+  setSafeTiming();
+  int best = -1;
+  for (int i = 0; completed && (i < BUSCAL_CANDIDATES); i++) {
+    if (candidateStable(i) &&
+        ((best < 0) || (candidateCycles(&candidates[i]) <
+                        candidateCycles(&candidates[best])))) {
+      best = i;
+    }
+  }
+  term_beginOutput();
+  if (best >= 0) {
+    const BusCalCandidate *candidate = &candidates[best];
+    romemul_setBusTiming(candidate->waitCycles, candidate->divider);
+    char divider[8];
+    snprintf(divider, sizeof(divider), "%.2f", (double)candidate->divider);
+    settings_put_integer(aconfig_getContext(),
+                         ACONFIG_PARAM_BUS_WAIT_CYCLES, candidate->waitCycles);
+    settings_put_string(aconfig_getContext(), ACONFIG_PARAM_BUS_CLOCK_DIV,
+                        divider);
+    aconfig_requestSave();
+    TPRINTF("Bus timing saved: divider %s, %u wait cycles\n", divider,
+            candidate->waitCycles);
+  } else {
+    TPRINTF("No stable timing found. Using the default timing\n");
+  }
+  term_endOutput();
+  SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_TERM);
+  setState(BUSCAL_STATE_DONE);
+  step = BUSCAL_STEP_IDLE;
+}
+
+static void nextCandidate(void) {
+  current++;
+  if (current >= BUSCAL_CANDIDATES) {
+    finish(true);
+    return;
+  }
+  const BusCalCandidate *candidate = &candidates[current];
+  romemul_setBusTiming(candidate->waitCycles, candidate->divider);
+  WRITE_AND_SWAP_LONGWORD(sharedAddress(), BUSCAL_ROUND_OFFSET, current);
+  setState(BUSCAL_STATE_TEST);
+  step = BUSCAL_STEP_TEST;
+  deadline = make_timeout_time_ms(BUSCAL_TEST_MS);
+}
+
+void buscal_init(void) {
+  int waitCycles = aconfig_getInt(ACONFIG_KEY_BUS_WAIT_CYCLES, -1);
+  if (waitCycles < 0) {
+    DPRINTF("Bus not calibrated. Default timing\n");
+    return;
+  }
+  double divider =
+      aconfig_getDouble(ACONFIG_KEY_BUS_CLOCK_DIV, SAMPLE_DIV_FREQ);
+  if (romemul_setBusTiming((uint8_t)waitCycles, (float)divider) != 0) {
+    DPRINTF("Invalid bus timing in the settings. Default timing\n");
+    return;
+  }
+  DPRINTF("Bus timing: divider %.2f, %d wait cycles\n", divider, waitCycles);
+}
+
+int buscal_start(void) {
+  if (step != BUSCAL_STEP_IDLE) {
+    return -1;
+  }
+  // Grouped by divider, so the next slower wait is the next candidate
+  for (int d = 0; d < BUSCAL_NUM_DIVIDERS; d++) {
+    for (int w = 0; w < BUSCAL_NUM_WAITS; w++) {
+      BusCalCandidate *candidate = &candidates[d * BUSCAL_NUM_WAITS + w];
+      candidate->waitCycles = (uint8_t)w;
+      candidate->divider = dividers[d];
+      candidate->errors = 0;
+      candidate->passes = 0;
+      candidate->tested = false;
+    }
+  }
+  setSafeTiming();
+  writePattern();
+  setState(BUSCAL_STATE_IDLE);
+  WRITE_AND_SWAP_LONGWORD(sharedAddress(), BUSCAL_ROUND_OFFSET,
+                          BUSCAL_ROUND_READY);
+  // Wait for the computer to enter the test loop
+  current = -1;
+  step = BUSCAL_STEP_REPORT;
+  deadline = make_timeout_time_ms(BUSCAL_REPORT_TIMEOUT_MS);
+  SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_CALIBRATE);
+  return 0;
+}
+
+void buscal_reset(void) {
+  setSafeTiming();
+  settings_put_integer(aconfig_getContext(), ACONFIG_PARAM_BUS_WAIT_CYCLES,
+                       -1);
+  aconfig_requestSave();
+}
+
+void buscal_result(uint32_t round, uint32_t errors, uint32_t passes) {
+  if ((step != BUSCAL_STEP_REPORT) || (round != (uint32_t)current)) {
+    DPRINTF("Unexpected calibration result for round %u\n", round);
+    return;
+  }
+  if (current < 0) {
+    // Do not start the calibration again when the computer is back
+    SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_TERM);
+  } else {
+    BusCalCandidate *candidate = &candidates[current];
+    candidate->errors = errors;
+    candidate->passes = passes;
+    candidate->tested = true;
+    TPRINTF("Divider %.2f, %u waits: %lu errors, %lu passes\n",
+            (double)candidate->divider, candidate->waitCycles,
+            (unsigned long)errors, (unsigned long)passes);
+  }
+  step = BUSCAL_STEP_SETTLE;
+  deadline = make_timeout_time_ms(BUSCAL_SETTLE_MS);
+}
+
+void buscal_poll(void) {
+  if ((step == BUSCAL_STEP_IDLE) || !time_reached(deadline)) {
+    return;
+  }
+  switch (step) {
+    case BUSCAL_STEP_SETTLE:
+      nextCandidate();
+      break;
+    case BUSCAL_STEP_TEST:
+      // Back to the default timing, so the computer can run from the ROM
+      setSafeTiming();
+      setState(BUSCAL_STATE_REPORT);
+      step = BUSCAL_STEP_REPORT;
+      deadline = make_timeout_time_ms(BUSCAL_REPORT_TIMEOUT_MS);
+      break;
+    case BUSCAL_STEP_REPORT:
+      TPRINTF("No answer from the computer. Calibration aborted\n");
+      finish(false);
+      break;
+    default:
+      break;
+  }
+}
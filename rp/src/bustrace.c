@@ -0,0 +1,117 @@
+/**
+ * File: bustrace.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Capture of the raw cartridge bus accesses
+ */
+
+#include "bustrace.h"
+
+#include "romemul.h"
+#include "telemetry.h"
+
+#if ROMEMUL_BUS_TRACE == 1
+static BusTraceRecord staticRecords[BUSTRACE_RECORDS];
+BusTrace busTrace = {false, 0, BUSTRACE_RECORDS, staticRecords};
+static int32_t exportNext = -1;  // Next record to export, -1 if none
+
+// lwIP takes the arena back. Keep what fits in the static buffer
+static void releaseArena(void) {
+  busTrace.armed = false;
+  __dmb();
+  // A handler that saw the capture armed can still write the arena
+  romemul_waitBusIrqs();
+  uint32_t count = busTrace.count;
+  if (count > BUSTRACE_RECORDS) {
+    count = BUSTRACE_RECORDS;
+  }
+  memcpy(staticRecords, busTrace.records, count * sizeof(BusTraceRecord));
+  // The count first, so it never goes past the capacity of the buffer
+  busTrace.count = count;
+  busTrace.capacity = BUSTRACE_RECORDS;
+  busTrace.records = staticRecords;
+  if ((exportNext >= 0) && ((uint32_t)exportNext > count)) {
+    exportNext = (int32_t)count;
+  }
+  DPRINTF("Bus capture back to %u accesses\n", count);
+}
+
+void bustrace_start(void) {
+  busTrace.armed = false;
+  busTrace.count = 0;
+  exportNext = -1;
+  if (busTrace.records == staticRecords) {
+    size_t size = 0;
+    BusTraceRecord *arena =
+        (BusTraceRecord *)netpool_acquire(&size, releaseArena);
+    if ((arena != NULL) && (size / sizeof(BusTraceRecord) > BUSTRACE_RECORDS)) {
+      busTrace.records = arena;
+      busTrace.capacity = size / sizeof(BusTraceRecord);
+    }
+  }
+  __dmb();
+  busTrace.armed = true;
+  DPRINTF("Bus capture started\n");
+}
+
+void bustrace_stop(void) {
+  busTrace.armed = false;
+  DPRINTF("Bus capture stopped. %u accesses\n", busTrace.count);
+}
+
+bool bustrace_isArmed(void) { return busTrace.armed; }
+
+uint32_t bustrace_getCapacity(void) { return busTrace.capacity; }
+
+const BusTraceRecord *bustrace_getRecords(uint32_t *count) {
+  *count = busTrace.count;
+  return busTrace.records;
+}
+
+int bustrace_export(void) {
+#if USB_TELEMETRY == 1
+  if (busTrace.armed) {
+    bustrace_stop();
+  }
+  exportNext = 0;
+  TELEMETRY_PRINTF("capture %u\n", busTrace.count);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+void bustrace_poll(void) {
+#if USB_TELEMETRY == 1
+  if (exportNext < 0) {
+    return;
+  }
+  // One line per access: timestamp and word in hexadecimal
+  uint32_t count = busTrace.count;
+  for (int i = 0; (i < BUSTRACE_EXPORT_BATCH) &&
+                  (telemetry_getFree() >= TELEMETRY_PRINTF_SIZE) &&
+                  ((uint32_t)exportNext < count);
+       i++) {
+    const BusTraceRecord *record = &busTrace.records[exportNext++];
+    TELEMETRY_PRINTF("%08lX %05lX\n", (unsigned long)record->timestamp,
+                     (unsigned long)record->word);
+  }
+  if ((uint32_t)exportNext >= count) {
+    TELEMETRY_PRINTF("capture end\n");
+    exportNext = -1;
+  }
+#endif
+}
+#else
+void bustrace_start(void) {}
+void bustrace_stop(void) {}
+bool bustrace_isArmed(void) { return false; }
+uint32_t bustrace_getCapacity(void) { return 0; }
+const BusTraceRecord *bustrace_getRecords(uint32_t *count) {
+  *count = 0;
+  return NULL;
+}
+int bustrace_export(void) { return -1; }
+void bustrace_poll(void) {}
+#endif
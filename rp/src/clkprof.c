@@ -0,0 +1,217 @@
+/**
+ * File: clkprof.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Clock and voltage profiles selected in the app settings
+ */
+
+#include "clkprof.h"
+
+#include "hardware/uart.h"
+
+// The first profile is the one main() boots with. No profile is slower than
+// RP2040_CLOCK_FREQ_KHZ: the commands of the computer need it
+static const ClkProfProfile profiles[] = {
+    {CLKPROF_SAFE_NAME, RP2040_CLOCK_FREQ_KHZ, RP2040_VOLTAGE},
+    // Same clock with more margin, for the units unstable at the default
+    {"STABLE", RP2040_CLOCK_FREQ_KHZ, VREG_VOLTAGE_1_20},
+    {"FAST", 250000, VREG_VOLTAGE_1_20},
+};
+#define CLKPROF_NUM_PROFILES (sizeof(profiles) / sizeof(profiles[0]))
+
+static const ClkProfProfile *current = &profiles[0];
+
+// Frames handled by the loopback test
+static uint16_t loopbackTag = 0;
+static uint32_t loopbackFrames = 0;
+
+static int findProfile(const char *name) {
+  for (size_t i = 0; i < CLKPROF_NUM_PROFILES; i++) {
+    if (strcmp(profiles[i].name, name) == 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+// Raise the voltage before the clock and lower it after
+static bool applyProfile(const ClkProfProfile *profile) {
+  if (profile->voltage > current->voltage) {
+    vreg_set_voltage(profile->voltage);
+    sleep_ms(CLKPROF_VREG_SETTLE_MS);
+  }
+  if (!set_sys_clock_khz(profile->clockKhz, false)) {
+    DPRINTF("Clock of %u KHz not possible\n", profile->clockKhz);
+    vreg_set_voltage(current->voltage);
+    return false;
+  }
+  if (profile->voltage < current->voltage) {
+    vreg_set_voltage(profile->voltage);
+  }
+  current = profile;
+#if defined(_DEBUG) && (_DEBUG != 0) && defined(uart_default)
+  // The peripherals run from the system clock
+  uart_set_baudrate(uart_default, PICO_DEFAULT_UART_BAUD_RATE);
+#endif
+  return true;
+}
+
+// Copy a pattern between the banks of the ROM with the DMA, while the CPU
+// reads it, and compare the sum of the sniffer, the sum of the CPU and the
+// copy
+static bool testDmaChecksum(uint32_t round) {
+  uint32_t *src = (uint32_t *)&__rom_in_ram_start__;
+  uint32_t *dst =
+      (uint32_t *)((uint8_t *)src + CLKPROF_PATTERN_DEST_OFFSET);
+  uint32_t value = 0x9E3779B9 * (round + 1);
+  for (uint32_t i = 0; i < CLKPROF_PATTERN_WORDS; i++) {
+    // Xorshift32. Every data line toggles
+    value ^= value << 13;
+    value ^= value >> 17;
+    value ^= value << 5;
+    src[i] = value;
+    dst[i] = ~value;
+  }
+
+  int channel = dma_claim_unused_channel(false);
+  if (channel < 0) {
+    DPRINTF("No free DMA channel for the self-test\n");
+    return false;
+  }
+  dma_channel_config config = dma_channel_get_default_config(channel);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+  channel_config_set_read_increment(&config, true);
+  channel_config_set_write_increment(&config, true);
+  channel_config_set_sniff_enable(&config, true);
+  dma_sniffer_enable(channel, DMA_SNIFF_CTRL_CALC_VALUE_SUM, true);
+  dma_hw->sniff_data = 0;
+  dma_channel_configure(channel, &config, dst, src, CLKPROF_PATTERN_WORDS,
+                        true);
+
+  // The load: the CPU reads the same banks while the DMA copies them
+  uint32_t expected = 0;
+  for (uint32_t i = 0; i < CLKPROF_PATTERN_WORDS; i++) {
+    expected += src[i];
+  }
+  dma_channel_wait_for_finish_blocking(channel);
+  uint32_t sniffed = dma_hw->sniff_data;
+  dma_sniffer_disable();
+  dma_channel_unclaim(channel);
+
+  bool ok = (sniffed == expected) &&
+            (memcmp(src, dst, CLKPROF_PATTERN_BYTES) == 0);
+  if (!ok) {
+    DPRINTF("DMA self-test failed. Sum 0x%08X, expected 0x%08X\n", sniffed,
+            expected);
+  }
+  return ok;
+}
+
+static void loopbackCallback(const TransmissionProtocol *protocol) {
+  const uint16_t *payload = (const uint16_t *)protocol->payload;
+  if ((protocol->command_id == CLKPROF_LOOPBACK_COMMAND) &&
+      (payload[0] == loopbackTag)) {
+    loopbackFrames++;
+  }
+}
+
+static void loopbackChecksumError(const TransmissionProtocol *protocol) {
+  (void)protocol;
+  DPRINTF("Loopback frame with a wrong checksum\n");
+}
+
+// Send a frame through a parser of the protocol, like the bus does
+static bool testLoopback(uint32_t round) {
+  static unsigned char __attribute__((aligned(4)))
+  scratch[TPROTO_FRAME_SIZE(TPROTO_SCRATCH_PAYLOAD_SIZE)];
+  TransmissionParser parser = TPROTO_PARSER_INIT(scratch);
+
+  uint16_t frame[3 + CLKPROF_LOOPBACK_WORDS + 1];
+  uint16_t checksum = TPROTO_CHECKSUM_INIT;
+  frame[0] = PROTOCOL_HEADER;
+  frame[1] = CLKPROF_LOOPBACK_COMMAND;
+  frame[2] = CLKPROF_LOOPBACK_WORDS * sizeof(uint16_t);
+  for (int i = 0; i < CLKPROF_LOOPBACK_WORDS; i++) {
+    frame[3 + i] = (uint16_t)(0x5AA5 ^ (round << 8) ^ i);
+  }
+  for (int i = 1; i < 3 + CLKPROF_LOOPBACK_WORDS; i++) {
+    checksum = tprotocol_checksumAdd(checksum, frame[i]);
+  }
+  frame[3 + CLKPROF_LOOPBACK_WORDS] = checksum;
+
+  loopbackTag = frame[3];
+  loopbackFrames = 0;
+  for (size_t i = 0; i < sizeof(frame) / sizeof(frame[0]); i++) {
+    tprotocol_parseWith(&parser, frame[i], loopbackCallback,
+                        loopbackChecksumError);
+  }
+  if (loopbackFrames != 1) {
+    DPRINTF("Protocol loopback failed\n");
+    return false;
+  }
+  return true;
+}
+
+static bool selfTest(void) {
+  for (uint32_t round = 0; round < CLKPROF_SELFTEST_ROUNDS; round++) {
+    if (!testDmaChecksum(round) || !testLoopback(round)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void saveSafeProfile(void) {
+  settings_put_string(aconfig_getContext(), ACONFIG_PARAM_CLOCK_PROFILE,
+                      CLKPROF_SAFE_NAME);
+  aconfig_requestSave();
+  if (aconfig_flush() != ACONFIG_SUCCESS) {
+    DPRINTF("Error saving the SAFE clock profile\n");
+  }
+}
+
+int clkprof_init(void) {
+  uint32_t trial = watchdog_hw->scratch[CLKPROF_SCRATCH];
+  watchdog_hw->scratch[CLKPROF_SCRATCH] = 0;
+  if ((trial & CLKPROF_TRIAL_MASK) == CLKPROF_TRIAL_MAGIC) {
+    // The watchdog rebooted the unit while testing the profile
+    DPRINTF("Clock profile %u hung. SAFE profile restored\n",
+            (unsigned int)(trial & ~CLKPROF_TRIAL_MASK));
+    saveSafeProfile();
+    return -1;
+  }
+
+  const char *name =
+      aconfig_getString(ACONFIG_KEY_CLOCK_PROFILE, CLKPROF_SAFE_NAME);
+  int index = findProfile(name);
+  if (index < 0) {
+    DPRINTF("Unknown clock profile %s. SAFE profile\n", name);
+    return -1;
+  }
+  if (index == 0) {
+    DPRINTF("Clock profile: %s\n", current->name);
+    return 0;
+  }
+
+  // Under trial until the self-test passes
+  watchdog_hw->scratch[CLKPROF_SCRATCH] =
+      CLKPROF_TRIAL_MAGIC | (uint32_t)index;
+  watchdog_enable(CLKPROF_TRIAL_TIMEOUT_MS, true);
+  bool accepted = applyProfile(&profiles[index]) && selfTest();
+  watchdog_disable();
+  watchdog_hw->scratch[CLKPROF_SCRATCH] = 0;
+  if (!accepted) {
+    applyProfile(&profiles[0]);
+    DPRINTF("Clock profile %s failed its self-test. SAFE profile restored\n",
+            profiles[index].name);
+    saveSafeProfile();
+    return -1;
+  }
+  romemul_setSystemClock(current->clockKhz);
+  DPRINTF("Clock profile: %s. %u KHz, %s\n", current->name,
+          current->clockKhz, VOLTAGE_VALUES[current->voltage]);
+  return 0;
+}
+
+const ClkProfProfile *clkprof_getCurrent(void) { return current; }
@@ -0,0 +1,230 @@
+/**
+ * File: dispatch.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Dispatcher of the commands of all the apps
+ */
+
+#include "dispatch.h"
+
+// Commands of all the apps, parsed in place by the interrupt
+TPROTO_QUEUE_DEFINE(protocolQueue, DISPATCH_PARAMETERS_MAX_SIZE);
+
+// Jump table indexed by the app and the command of the app
+static DispatchHandler handlers[DISPATCH_MAX_APPS][DISPATCH_MAX_COMMANDS];
+
+static volatile DispatchAccessHandler accessHandler = NULL;
+
+static uint32_t memoryRandomTokenAddress = 0;
+static uint32_t memoryRandomTokenSeedAddress = 0;
+static uint32_t memoryStatsAddress = 0;
+
+// Tokens ready for the next commands. Only the consumer of the queue uses
+// them, so the indices run free without locks
+static uint32_t tokenPool[DISPATCH_TOKEN_POOL_SIZE];
+static uint32_t tokenHead = 0;
+static uint32_t tokenTail = 0;
+static uint32_t tokenState = 0;
+
+// Collect 32 bits from the random bit of the ring oscillator. Slow, only
+// used to seed the generator
+static uint32_t roscRandom32(void) {
+  uint32_t value = 0;
+  for (int i = 0; i < 32; i++) {
+    value = (value << 1) | (rosc_hw->randombit & 1U);
+  }
+  return value;
+}
+
+// Xorshift32. Fast enough to fill the pool between two commands
+static inline uint32_t __not_in_flash_func(nextRandom)(void) {
+  uint32_t x = tokenState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  tokenState = x;
+  return x;
+}
+
+// Seed the tokens from the ring oscillator. Xorshift never leaves zero
+static void seedTokens(void) {
+  tokenState = roscRandom32();
+  if (tokenState == 0) {
+    tokenState = 0x2545F491;
+  }
+}
+
+// Fill the pool up in the idle time of the consumer
+static void __not_in_flash_func(fillTokens)(void) {
+  while ((tokenHead - tokenTail) < DISPATCH_TOKEN_POOL_SIZE) {
+    tokenPool[tokenHead & DISPATCH_TOKEN_POOL_MASK] = nextRandom();
+    tokenHead++;
+  }
+}
+
+static inline void __not_in_flash_func(handleChecksumError)(
+    const TransmissionProtocol *protocol) {
+  DTRACE(TRACE_CHECKSUM_ERROR, protocol->command_id, protocol->payload_size);
+}
+
+void dispatch_init(void) {
+  uint32_t memorySharedAddress =
+      (unsigned int)&__rom_in_ram_start__ + FLASH_ROM4_LOAD_OFFSET;
+  memoryRandomTokenAddress =
+      memorySharedAddress + DISPATCH_RANDOM_TOKEN_OFFSET;
+  memoryRandomTokenSeedAddress =
+      memorySharedAddress + DISPATCH_RANDOM_TOKEN_SEED_OFFSET;
+  memoryStatsAddress = memorySharedAddress + TPROTO_STATS_OFFSET;
+  seedTokens();
+  fillTokens();
+  // Commands from the computer are parsed directly into the protocol queue
+  tprotocol_setQueue(&protocolQueue);
+  // Tell the computer how to check the frames
+  TPROTO_SET_CAPABILITIES(memorySharedAddress + TPROTO_CAPABILITIES_OFFSET);
+}
+
+int dispatch_register(const DispatchCommand *commands, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    uint16_t app = commands[i].commandId >> DISPATCH_APP_SHIFT;
+    uint16_t cmd = commands[i].commandId & DISPATCH_COMMAND_MASK;
+    if ((app >= DISPATCH_MAX_APPS) || (cmd >= DISPATCH_MAX_COMMANDS)) {
+      DPRINTF("Command 0x%04X out of the dispatch table\n",
+              commands[i].commandId);
+      return -1;
+    }
+    handlers[app][cmd] = commands[i].handler;
+  }
+  return 0;
+}
+
+void dispatch_setAccessHandler(DispatchAccessHandler handler) {
+  accessHandler = handler;
+}
+
+uint32_t __not_in_flash_func(dispatch_nextToken)(void) {
+  if (tokenHead == tokenTail) {
+    // Pool drained by a burst of commands, or not seeded yet
+    if (tokenState == 0) {
+      seedTokens();
+    }
+    return nextRandom();
+  }
+  uint32_t token = tokenPool[tokenTail & DISPATCH_TOKEN_POOL_MASK];
+  tokenTail++;
+  return token;
+}
+
+bool dispatch_waitCommand(absolute_time_t until) {
+  return tprotocol_queueWait(&protocolQueue, until);
+}
+
+uint32_t dispatch_getOverflows(void) { return protocolQueue.overflows; }
+
+// Interrupt handler for DMA completion
+void TPROTO_IRQ_FUNC(dispatch_dmaIrqHandlerLookup)(void) {
+  uint32_t irqStart = tprotocol_irqStart();
+  // Read the rom3 signal and if so then process the command
+  dma_hw->ints1 = 1U << 2;
+
+  // Read once to avoid redundant hardware access
+  uint32_t addr = dma_hw->ch[2].al3_read_addr_trig;
+  bustrace_record(addr);
+
+  // We expect that the ROM3 signal is not set very often, so this should help
+  // the compiler to run faster
+  if (__builtin_expect(addr & 0x00010000, 0)) {
+    // Invert highest bit of low word to get 16-bit address
+    uint16_t addr_lsb = (uint16_t)(addr ^ DISPATCH_ADDRESS_HIGH_BIT);
+
+    // The parser writes the frame in place into the protocol queue
+    tprotocol_parse(addr_lsb, NULL, handleChecksumError);
+  } else {
+    DispatchAccessHandler handler = accessHandler;
+    if (__builtin_expect(handler != NULL, 0)) {
+      handler(addr & 0xFFFF);
+    }
+  }
+  tprotocol_irqEnd(irqStart);
+}
+
+// Handler for the ROM3 addresses drained from the capture ring
+void __not_in_flash_func(dispatch_captureAddressHandler)(uint32_t addr) {
+  bustrace_record(addr);
+  // Invert highest bit of low word to get 16-bit address
+  uint16_t addr_lsb = (uint16_t)(addr ^ DISPATCH_ADDRESS_HIGH_BIT);
+
+  // The parser writes the frame in place into the protocol queue
+  tprotocol_parse(addr_lsb, NULL, handleChecksumError);
+}
+
+// Handler for the addresses of a frame forwarded by the PIO header filter
+bool __not_in_flash_func(dispatch_frameAddressHandler)(uint32_t addr) {
+  bustrace_record(addr);
+  if (addr & 0x00010000) {
+    // Invert highest bit of low word to get 16-bit address
+    uint16_t addr_lsb = (uint16_t)(addr ^ DISPATCH_ADDRESS_HIGH_BIT);
+
+    // The parser writes the frame in place into the protocol queue
+    tprotocol_parse(addr_lsb, NULL, handleChecksumError);
+  }
+  // Keep forwarding while the frame is in flight
+  return !tprotocol_isIdle();
+}
+
+// Trace the parameters D3 to D6 that follow the random token
+static inline void traceParameters(const TransmissionProtocol *protocol) {
+  if (protocol->payload_size > DISPATCH_PARAMETERS_MAX_SIZE) {
+    return;
+  }
+  uint16_t *payloadPtr = ((uint16_t *)protocol->payload);
+  // Jump the random token
+  TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
+  uint16_t payloadSizeTmp = 4;
+  for (uint32_t reg = 3; protocol->payload_size > payloadSizeTmp; reg++) {
+    DTRACE(TRACE_COMMAND_PARAM, reg, TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
+    TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
+    payloadSizeTmp += 4;
+  }
+}
+
+// Invoke this function to process the commands from the active loop
+void __not_in_flash_func(dispatch_loop)(void) {
+  // Drain all the pending commands
+  TransmissionProtocol *protocol = NULL;
+  while ((protocol = tprotocol_queuePeek(&protocolQueue)) != NULL) {
+    // Shared by all commands
+    uint32_t randomToken = TPROTO_GET_RANDOM_TOKEN(protocol->payload);
+    uint16_t commandId = protocol->command_id;
+    DTRACE(TRACE_COMMAND, commandId, protocol->payload_size);
+    traceParameters(protocol);
+
+    uint16_t app = commandId >> DISPATCH_APP_SHIFT;
+    uint16_t cmd = commandId & DISPATCH_COMMAND_MASK;
+    DispatchHandler handler = NULL;
+    if ((app < DISPATCH_MAX_APPS) && (cmd < DISPATCH_MAX_COMMANDS)) {
+      handler = handlers[app][cmd];
+    }
+    if (handler != NULL) {
+      handler(protocol);
+    } else {
+      DTRACE(TRACE_UNKNOWN_COMMAND, commandId, 0);
+    }
+
+    if (memoryRandomTokenAddress != 0) {
+      // Set the random token in the shared memory
+      TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenAddress, randomToken);
+
+      // Init the random token seed in the shared memory for the next command
+      TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenSeedAddress,
+                              dispatch_nextToken());
+    }
+    tprotocol_queuePop(&protocolQueue);
+  }
+  // The queue is empty. Prepare the tokens of the next commands
+  fillTokens();
+  if (memoryStatsAddress != 0) {
+    // Mirror the counters of the protocol for the computer
+    tprotocol_publishStats(&protocolQueue, memoryStatsAddress);
+  }
+}
@@ -16,12 +16,44 @@ static uint32_t displaysHighresTranstableAddress = 0;
 _Static_assert(DISPLAY_BUFFER_SIZE <= UINT32_MAX,
                "Buffer size exceeds allowed limits");
 
-// Allocate the framebuffer
-static unsigned char u8g2Buffer[DISPLAY_BUFFER_SIZE] = {0};
+// The framebuffer is the display memory read by the computer. Set up in
+// display_setupU8g2()
+static unsigned char *u8g2Buffer = NULL;
 
 // Global u8g2 structure
 static u8g2_t u8g2 = {0};
 
+// Bands of the framebuffer changed since the last refresh. One bit per band
+_Static_assert(DISPLAY_DIRTY_BANDS <= 32, "Too many bands for the bitmap");
+static uint32_t dirtyBands = 0;
+
+// Published with the bands of each refresh. Odd while updating
+static uint32_t frameSeq = 0;
+
+// Band of the framebuffer shown at the top of the scroll region
+static uint8_t scrollHead = 0;
+
+#if DISPLAY_HIGHRES_EXPANDED == 1
+_Static_assert(DISPLAY_HIGHRES_BUFFER_OFFSET +
+                       DISPLAY_HIGHRES_ROW_BYTES * DISPLAY_HEIGHT <=
+                   DISPLAY_BUFFER_OFFSET,
+               "The high resolution buffer overlaps the framebuffer");
+
+// Copy of the mask table, to expand the rows without reading the ROM memory
+static uint16_t highresMask[DISPLAY_MASK_TABLE_SIZE] = {0};
+
+// Expand the bytes of the framebuffer to the doubled high resolution words
+static void displayExpandHighres(uint32_t offset, uint32_t length) {
+  volatile uint16_t *highres =
+      (volatile uint16_t *)((unsigned int)&__rom_in_ram_start__ +
+                            DISPLAY_HIGHRES_BUFFER_OFFSET) +
+      offset;
+  for (uint32_t i = 0; i < length; i++) {
+    highres[i] = highresMask[u8g2Buffer[DISPLAY_SWAP_BYTE(offset + i)]];
+  }
+}
+#endif
+
 // Dummy byte communication function
 static unsigned char u8x8DummyByte(void *u8x8, unsigned char msg,
                                    unsigned char argInt, void *argPtr) {
@@ -101,6 +133,76 @@ unsigned char u8x8DCustom(u8x8_t *u8x8, unsigned char msg, unsigned char argInt,
 }
 #endif
 
+void display_markDirty(uint16_t y, uint16_t height) {
+  if ((height == 0) || (y >= DISPLAY_HEIGHT)) {
+    return;
+  }
+  uint32_t last = (uint32_t)y + height - 1;
+  if (last >= DISPLAY_HEIGHT) {
+    last = DISPLAY_HEIGHT - 1;
+  }
+  for (uint32_t band = y / DISPLAY_TILE_HEIGHT;
+       band <= last / DISPLAY_TILE_HEIGHT; band++) {
+    dirtyBands |= 1u << band;
+  }
+}
+
+void display_markAllDirty() {
+  dirtyBands = (DISPLAY_DIRTY_BANDS == 32) ? UINT32_MAX
+                                           : (1u << DISPLAY_DIRTY_BANDS) - 1;
+}
+
+uint8_t display_getBand(uint8_t band) {
+  if (band >= DISPLAY_SCROLL_BANDS) {
+    return band;
+  }
+  return (uint8_t)((band + scrollHead) % DISPLAY_SCROLL_BANDS);
+}
+
+void display_scrollBands() {
+  // The top band becomes the bottom one, blank
+  memset(u8g2Buffer + scrollHead * DISPLAY_DIRTY_BAND_BYTES, 0,
+         DISPLAY_DIRTY_BAND_BYTES);
+  scrollHead = (scrollHead + 1) % DISPLAY_SCROLL_BANDS;
+  // All the bands move on the screen
+  display_markAllDirty();
+}
+
+void display_resetScroll() {
+  scrollHead = 0;
+  display_markAllDirty();
+}
+
+// All the drawing functions of u8g2 end here: mark the bands they touch.
+// Same as u8g2_ll_hvline_horizontal_right_lsb(), in the 68000 byte order
+static void displayHvline(u8g2_t *u8g2Ref, u8g2_uint_t x, u8g2_uint_t y,
+                          u8g2_uint_t len, uint8_t dir) {
+  display_markDirty(y, (dir == 0) ? 1 : len);
+
+  uint8_t *buffer = u8g2Ref->tile_buf_ptr;
+  uint32_t offset = (uint32_t)y * DISPLAY_ROW_BYTES + (x >> 3);
+  uint8_t mask = 0x80 >> (x & 7);
+  uint8_t color = u8g2Ref->draw_color;
+  do {
+    uint8_t *ptr = buffer + DISPLAY_SWAP_BYTE(offset);
+    if (color <= 1) {
+      *ptr |= mask;
+    }
+    if (color != 1) {
+      *ptr ^= mask;
+    }
+    if (dir == 0) {
+      mask >>= 1;
+      if (mask == 0) {
+        mask = 0x80;
+        offset++;
+      }
+    } else {
+      offset += DISPLAY_ROW_BYTES;
+    }
+  } while (--len != 0);
+}
+
 // Initialize u8g2 with the custom buffer
 void display_setupU8g2() {
   DPRINTF("Initializing u8g2 with a buffer size of %d bytes\n",
@@ -124,6 +226,11 @@ void display_setupU8g2() {
 
   // We clear the command address just in case
   SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_NOP);
+
+  // Tell the computer if the high resolution rows are expanded here
+  WRITE_AND_SWAP_LONGWORD(display_getCommandAddress(),
+                          DISPLAY_HIGHRES_READY_OFFSET,
+                          DISPLAY_HIGHRES_EXPANDED == 1);
 #endif
 
   u8g2_SetupDisplay(&u8g2, u8x8DCustom, (u8x8_msg_cb)u8x8CadDummy,
@@ -132,23 +239,69 @@ void display_setupU8g2() {
   // Calculate tile buffer height
   uint8_t tileBufHeight = DISPLAY_HEIGHT / DISPLAY_TILE_HEIGHT;
 
-  u8g2_SetupBuffer(&u8g2, u8g2Buffer, tileBufHeight,
-                   u8g2_ll_hvline_horizontal_right_lsb, U8G2_R0);
+  // Draw straight into the display memory
+  u8g2Buffer = (unsigned char *)display_getAddress();
+
+  u8g2_SetupBuffer(&u8g2, u8g2Buffer, tileBufHeight, displayHvline, U8G2_R0);
 
   // Fake initialization sequence
   u8g2_InitDisplay(&u8g2);  // Initialize display (will use dummy callbacks)
+
+  // The display memory has not been written yet
+  display_markAllDirty();
 }
 
 void display_refresh() {
-  uint32_t *displayBuffer = (void *)display_getAddress();
-  COPY_AND_SWAP_16BIT_DMA(displayBuffer, (uint16_t *)u8g2Buffer,
-                          DISPLAY_BUFFER_SIZE);
+  if (dirtyBands == 0) {
+    return;
+  }
+
+#if DISPLAY_HIGHRES_EXPANDED == 1
+  // Expand each span of consecutive dirty bands
+  uint32_t band = 0;
+  while (band < DISPLAY_DIRTY_BANDS) {
+    if ((dirtyBands & (1u << band)) == 0) {
+      band++;
+      continue;
+    }
+    uint32_t first = band;
+    while ((band < DISPLAY_DIRTY_BANDS) && (dirtyBands & (1u << band))) {
+      band++;
+    }
+    displayExpandHighres(first * DISPLAY_DIRTY_BAND_BYTES,
+                         (band - first) * DISPLAY_DIRTY_BAND_BYTES);
+  }
+#endif
+
+  // Tell the computer which bands to copy, in the order of the screen, and
+  // where they are. u8g2 already drew them in place
+  uint32_t screenBands = 0;
+  uint32_t commandAddress = display_getCommandAddress();
+  WRITE_AND_SWAP_LONGWORD(commandAddress, DISPLAY_FRAME_SEQ_OFFSET,
+                          ++frameSeq);
+  __dmb();
+  for (uint8_t screenBand = 0; screenBand < DISPLAY_DIRTY_BANDS;
+       screenBand++) {
+    uint8_t band = display_getBand(screenBand);
+    if (dirtyBands & (1u << band)) {
+      screenBands |= 1u << screenBand;
+    }
+    WRITE_AND_SWAP_LONGWORD(commandAddress,
+                            DISPLAY_BAND_TABLE_OFFSET + screenBand * 4,
+                            band * DISPLAY_DIRTY_BAND_BYTES);
+  }
+  WRITE_AND_SWAP_LONGWORD(commandAddress, DISPLAY_DIRTY_BANDS_OFFSET,
+                          screenBands);
+  __dmb();
+  WRITE_AND_SWAP_LONGWORD(commandAddress, DISPLAY_FRAME_SEQ_OFFSET,
+                          ++frameSeq);
+  dirtyBands = 0;
 }
 
 void display_drawProductInfo() {
   // Product info
   char productStr[DISPLAY_MAX_CHARACTERS] = {0};
-  u8g2_SetFont(&u8g2, u8g2_font_squeezed_b7_tr);
+  fontcache_setFont(&u8g2, u8g2_font_squeezed_b7_tr);
   snprintf(productStr, sizeof(productStr), "%s %s - %s", DISPLAY_PRODUCT_MSG,
            RELEASE_VERSION, DISPLAY_COPYRIGHT_MESSAGE);
   u8g2_DrawStr(
@@ -173,6 +326,9 @@ void display_generateMaskTable(uint32_t memoryAddress) {
     WRITE_WORD(memory_address, i * 2, ~mask);
 #else
     WRITE_WORD(memoryAddress, i * 2, mask);
+#endif
+#if DISPLAY_HIGHRES_EXPANDED == 1
+    highresMask[i] = (DISPLAY_HIGHRES_INVERT == 1) ? ~mask : mask;
 #endif
   }
 }
@@ -185,4 +341,5 @@ void display_scrollup(uint16_t blankBytes) {
   memmove(u8g2Buffer, u8g2Buffer + blankBytes,
           DISPLAY_BUFFER_SIZE - blankBytes);
   memset(u8g2Buffer + DISPLAY_BUFFER_SIZE - blankBytes, 0, blankBytes);
+  display_markAllDirty();
 }
\ No newline at end of file
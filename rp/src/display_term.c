@@ -15,16 +15,60 @@ static uint8_t maxRow = 0;
 _Static_assert(DISPLAY_BUFFER_SIZE <= UINT32_MAX,
                "Buffer size exceeds allowed limits");
 
+// The blitter writes one byte per row of a cell
+_Static_assert(DISPLAY_TERM_CHAR_WIDTH == 8, "The cells must be 8 pixels wide");
+
+// The rows of each glyph of the terminal font, rasterized once
+static uint8_t glyphs[DISPLAY_TERM_GLYPHS][DISPLAY_TERM_CHAR_HEIGHT] = {0};
+static bool glyphsReady = false;
+
+// Draw each glyph in the first cell once and keep its rows
+static void displayTermRasterize(void) {
+  u8g2_t *u8g2 = display_getU8g2Ref();
+  uint8_t *buffer = u8g2_GetBufferPtr(u8g2);
+  for (int chr = 0; chr < DISPLAY_TERM_GLYPHS; chr++) {
+    for (int row = 0; row < DISPLAY_TERM_CHAR_HEIGHT; row++) {
+      buffer[DISPLAY_SWAP_BYTE(row * DISPLAY_ROW_BYTES)] = 0;
+    }
+    u8g2_DrawGlyph(u8g2, 0, DISPLAY_TERM_CHAR_HEIGHT, chr);
+    for (int row = 0; row < DISPLAY_TERM_CHAR_HEIGHT; row++) {
+      glyphs[chr][row] = buffer[DISPLAY_SWAP_BYTE(row * DISPLAY_ROW_BYTES)];
+      buffer[DISPLAY_SWAP_BYTE(row * DISPLAY_ROW_BYTES)] = 0;
+    }
+  }
+  glyphsReady = true;
+}
+
+// Write the rows of a cell straight into the framebuffer
+static void displayTermBlit(const uint8_t col, const uint8_t row,
+                            const uint8_t *rows) {
+  uint8_t *buffer = u8g2_GetBufferPtr(display_getU8g2Ref());
+  uint32_t top = (uint32_t)display_getBand(row) * DISPLAY_TERM_CHAR_HEIGHT;
+  uint32_t offset = top * DISPLAY_ROW_BYTES + col;
+  for (int line = 0; line < DISPLAY_TERM_CHAR_HEIGHT; line++) {
+    buffer[DISPLAY_SWAP_BYTE(offset)] = rows[line];
+    offset += DISPLAY_ROW_BYTES;
+  }
+  display_markDirty(top, DISPLAY_TERM_CHAR_HEIGHT);
+}
+
 void display_termChar(const uint8_t col, const uint8_t row, const char chr) {
-  u8g2_DrawGlyph(
-      display_getU8g2Ref(), col * DISPLAY_TERM_CHAR_WIDTH,
-      (DISPLAY_TERM_FIRST_ROW_OFFSET + row) * DISPLAY_TERM_CHAR_HEIGHT, chr);
+  if (!glyphsReady) {
+    u8g2_DrawGlyph(display_getU8g2Ref(), col * DISPLAY_TERM_CHAR_WIDTH,
+                   (display_getBand(row + DISPLAY_TERM_FIRST_ROW_OFFSET - 1) +
+                    1) * DISPLAY_TERM_CHAR_HEIGHT,
+                   chr);
+    return;
+  }
+  // The glyph is drawn above the baseline of the next row
+  displayTermBlit(col, row + DISPLAY_TERM_FIRST_ROW_OFFSET - 1,
+                  glyphs[(uint8_t)chr]);
 }
 
 void display_termCursor(const uint8_t col, const uint8_t row) {
-  u8g2_DrawBox(display_getU8g2Ref(), col * DISPLAY_TERM_CHAR_WIDTH,
-               row * DISPLAY_TERM_CHAR_HEIGHT, DISPLAY_TERM_CHAR_WIDTH,
-               DISPLAY_TERM_CHAR_HEIGHT);
+  static const uint8_t block[DISPLAY_TERM_CHAR_HEIGHT] = {
+      0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  displayTermBlit(col, row, block);
 }
 
 void display_termStart(const uint8_t numCol, const uint8_t numRow) {
@@ -36,6 +80,7 @@ void display_termStart(const uint8_t numCol, const uint8_t numRow) {
 
   // // Clear the buffer first
   u8g2_ClearBuffer(display_getU8g2Ref());
+  display_resetScroll();
 
   // Set the flag to NOT-RESET the computer
   SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_NOP);
@@ -57,5 +102,11 @@ void display_termRefresh() {
 void display_termClear() {
   // Clear the buffer
   u8g2_ClearBuffer(display_getU8g2Ref());
-  u8g2_SetFont(display_getU8g2Ref(), u8g2_font_amstrad_cpc_extended_8f);
+  display_resetScroll();
+  fontcache_setFont(display_getU8g2Ref(), u8g2_font_amstrad_cpc_extended_8f);
+
+  // The terminal font doesn't change: rasterize it once
+  if (!glyphsReady) {
+    displayTermRasterize();
+  }
 }
@@ -0,0 +1,89 @@
+/**
+ * File: dmacopy.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Memory copies with a DMA channel claimed once
+ */
+
+#include "dmacopy.h"
+
+static int copyChannel = -1;
+
+// Claim the channel the first time, and wait for the copy running
+static int acquireChannel(void) {
+  if (copyChannel < 0) {
+    copyChannel = dma_claim_unused_channel(false);
+    if (copyChannel < 0) {
+      DPRINTF("No free DMA channel for the copies\n");
+      return -1;
+    }
+  }
+  dmacopy_wait();
+  return 0;
+}
+
+int dmacopy_startFromFlash(void *dest, const void *src, uint32_t words) {
+  if (acquireChannel() < 0) {
+    return -1;
+  }
+  // Drain what a previous stream left in the FIFO
+  while (!(xip_ctrl_hw->stat & XIP_STAT_FIFO_EMPTY)) {
+    (void)xip_ctrl_hw->stream_fifo;
+  }
+  xip_ctrl_hw->stream_addr = (uint32_t)src;
+  xip_ctrl_hw->stream_ctr = words;
+  dma_channel_config config = dma_channel_get_default_config(copyChannel);
+  channel_config_set_read_increment(&config, false);
+  channel_config_set_write_increment(&config, true);
+  channel_config_set_dreq(&config, DREQ_XIP_STREAM);
+  dma_channel_configure(copyChannel, &config, dest,
+                        (const void *)XIP_AUX_BASE, words, true);
+  return 0;
+}
+
+int dmacopy_startSwap16(void *dest, const void *src, size_t bytes) {
+  if (acquireChannel() < 0) {
+    return -1;
+  }
+  dma_channel_config config = dma_channel_get_default_config(copyChannel);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+  channel_config_set_read_increment(&config, true);
+  channel_config_set_write_increment(&config, true);
+  channel_config_set_bswap(&config, true);
+  dma_channel_configure(copyChannel, &config, dest, src, (bytes + 1) / 2,
+                        true);
+  return 0;
+}
+
+void dmacopy_swap16(void *dest, const void *src, size_t bytes) {
+  if ((bytes >= DMACOPY_SWAP_MIN_BYTES) &&
+      (dmacopy_startSwap16(dest, src, bytes) == 0)) {
+    dmacopy_wait();
+    return;
+  }
+  volatile uint16_t *destWords = (volatile uint16_t *)dest;
+  const volatile uint16_t *srcWords = (const volatile uint16_t *)src;
+  size_t words = (bytes + 1) / 2;
+  size_t i = 0;
+  // Four words per turn. REV16 swaps each one
+  for (; i + 4 <= words; i += 4) {
+    destWords[i] = __builtin_bswap16(srcWords[i]);
+    destWords[i + 1] = __builtin_bswap16(srcWords[i + 1]);
+    destWords[i + 2] = __builtin_bswap16(srcWords[i + 2]);
+    destWords[i + 3] = __builtin_bswap16(srcWords[i + 3]);
+  }
+  for (; i < words; i++) {
+    destWords[i] = __builtin_bswap16(srcWords[i]);
+  }
+}
+
+bool dmacopy_isBusy(void) {
+  return (copyChannel >= 0) && dma_channel_is_busy(copyChannel);
+}
+
+void dmacopy_wait(void) {
+  while (dmacopy_isBusy()) {
+    tight_loop_contents();
+  }
+}
@@ -22,6 +22,8 @@ static void cmdType(const char *arg);
 static void cmdHost(const char *arg);
 static void cmdPort(const char *arg);
 static void cmdUTCOffset(const char *arg);
+static void cmdRadio(const char *arg);
+static void cmdFastBoot(const char *arg);
 
 // Command table
 static const Command commands[] = {
@@ -34,6 +36,8 @@ static const Command commands[] = {
     {"h", cmdHost},
     {"p", cmdPort},
     {"u", cmdUTCOffset},
+    {"r", cmdRadio},
+    {"f", cmdFastBoot},
     {"s", term_cmdSettings},
     {"settings", term_cmdSettings},
     {"print", term_cmdPrint},
@@ -43,32 +47,89 @@ static const Command commands[] = {
     {"put_int", term_cmdPutInt},
     {"put_bool", term_cmdPutBool},
     {"put_str", term_cmdPutString},
+    {"stats", term_cmdStats},
+    {"boot", term_cmdBootTimes},
+    {"bench", term_cmdBench},
+    {"capture", term_cmdCapture},
+    {"stbench", term_cmdStBench},
+    {"calibrate", term_cmdCalibrate},
+    {"profile", term_cmdProfile},
+    {"ota", term_cmdOta},
 };
 
 // Number of commands in the table
 static const size_t numCommands = sizeof(commands) / sizeof(commands[0]);
 
+#if USB_TELEMETRY == 1
+// Commands of the USB telemetry channel
+static void telemetryHelp(const char *arg);
+static void telemetryStats(const char *arg);
+static void telemetrySettings(const char *arg);
+static void telemetryNTP(const char *arg);
+static void telemetryCapture(const char *arg);
+static void telemetryProfile(const char *arg);
+static void telemetryLoadGen(const char *arg);
+
+static const TelemetryCommand telemetryCommands[] = {
+    {"help", telemetryHelp},
+    {"stats", telemetryStats},
+    {"settings", telemetrySettings},
+    {"ntp", telemetryNTP},
+    {"capture", telemetryCapture},
+    {"profile", telemetryProfile},
+    {"loadgen", telemetryLoadGen},
+};
+
+static const size_t numTelemetryCommands =
+    sizeof(telemetryCommands) / sizeof(telemetryCommands[0]);
+#endif
+
 // Boot countdown
 static int countdown = 0;
 
 // Halt the contdown
 static bool haltCountdown = false;
 
+// Skip the setup menu countdown
+static bool fastBoot = false;
+
 // Keep active loop or exit
 static bool keepActive = true;
 
 // Jump to the booster app
 static bool jumpBooster = false;
+static volatile bool resetRequested = false;
+static volatile bool eraseRequested = false;
 
 // GEM launched
 static bool gemLaunched = false;
 
 // Do we have network or not?
 static bool hasNetwork = false;
+static bool timeMaster = false;  // Answers the NTP queries of the network
 
 // app status
 static int appStatus = APP_MODE_SETUP;
 
+// Radio state between the NTP resyncs
+static const char *radioPowerNames[RADIO_POWER_OPTIONS] = {"Always on",
+                                                           "Power save", "Off"};
+static int radioPower = RADIO_POWER_ON;
+static int radioState = RADIO_POWER_ON;
+
+// Last WiFi connection, to connect faster in the next boot
+static network_fast_connect_t wifiCache = {0};
+static bool wifiCacheLoaded = false;
+static int wifiCacheLeaseExpiry = 0;
+static network_fast_connect_t wifiCurrent = {0};
+static bool wifiCurrentValid = false;
+static uint64_t wifiConnectedUs = 0;
+
+// Connection of the boot, stepped by the main loop
+static bool wifiConnecting = false;
+static bool wifiConnectFast = false;
+static int wifiConnectAttempts = 0;
+
 #define MAX_DOMAIN_LENGTH 255
 #define MAX_LABEL_LENGTH 63
 
@@ -123,12 +184,13 @@ static void showTitle() {
 }
 
 static void menu(void) {
+  term_beginOutput();
   showTitle();
   term_printString("\n\n");
   term_printString("[H]ost NTP: ");
   // Print the NTP server host
-  SettingsConfigEntry *ntpHost = settings_find_entry(
-      aconfig_getContext(), ACONFIG_PARAM_RTC_NTP_SERVER_HOST);
+  SettingsConfigEntry *ntpHost =
+      aconfig_getEntry(ACONFIG_KEY_RTC_NTP_SERVER_HOST);
   if (ntpHost != NULL) {
     term_printString(ntpHost->value);
   } else {
@@ -136,8 +198,8 @@ static void menu(void) {
   }
   term_printString("\n[P]ort NTP: ");
   // Print the NTP server port
-  SettingsConfigEntry *ntpPort = settings_find_entry(
-      aconfig_getContext(), ACONFIG_PARAM_RTC_NTP_SERVER_PORT);
+  SettingsConfigEntry *ntpPort =
+      aconfig_getEntry(ACONFIG_KEY_RTC_NTP_SERVER_PORT);
   if (ntpPort != NULL) {
     term_printString(ntpPort->value);
   } else {
@@ -145,8 +207,7 @@ static void menu(void) {
   }
   term_printString("\n[U]TC Offset: ");
   // Print the UTC offset
-  SettingsConfigEntry *utcOffset =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_RTC_UTC_OFFSET);
+  SettingsConfigEntry *utcOffset = aconfig_getEntry(ACONFIG_KEY_RTC_UTC_OFFSET);
   if (utcOffset != NULL) {
     term_printString(utcOffset->value);
   } else {
@@ -154,12 +215,31 @@ static void menu(void) {
   }
   term_printString("\n[Y]2K Patch: ");
   // Print the Y2K patch
-  SettingsConfigEntry *y2kPatch =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_RTC_Y2K_PATCH);
+  SettingsConfigEntry *y2kPatch = aconfig_getEntry(ACONFIG_KEY_RTC_Y2K_PATCH);
   if (y2kPatch != NULL) {
-    term_printString(y2kPatch->value[0] == 't' || y2kPatch->value[0] == 'T' ||
-                             y2kPatch->value[0] == 'Y' ||
-                             y2kPatch->value[0] == 'y'
+    term_printString(aconfig_getBool(ACONFIG_KEY_RTC_Y2K_PATCH, false)
+                         ? "Enabled"
+                         : "Disabled");
+  } else {
+    term_printString("Not set");
+  }
+  term_printString("\n[R]adio after sync: ");
+  // Print the radio policy between the resyncs
+  SettingsConfigEntry *radio = aconfig_getEntry(ACONFIG_KEY_RTC_RADIO_POWER);
+  if (radio != NULL) {
+    int radioValue = aconfig_getInt(ACONFIG_KEY_RTC_RADIO_POWER, 0);
+    term_printString((radioValue >= 0 && radioValue < RADIO_POWER_OPTIONS)
+                         ? radioPowerNames[radioValue]
+                         : radioPowerNames[RADIO_POWER_ON]);
+  } else {
+    term_printString("Not set");
+  }
+  term_printString("\n[F]ast boot: ");
+  // Print the boot mode
+  SettingsConfigEntry *appMode = aconfig_getEntry(ACONFIG_KEY_MODE);
+  if (appMode != NULL) {
+    term_printString(aconfig_getInt(ACONFIG_KEY_MODE, APP_MODE_SETUP) ==
+                             APP_MODE_FAST_BOOT
                          ? "Enabled"
                          : "Disabled");
   } else {
@@ -167,8 +247,7 @@ static void menu(void) {
   }
   term_printString("\n[T]ype:");
   // Print the RTC type
-  SettingsConfigEntry *rtcType =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_RTC_TYPE);
+  SettingsConfigEntry *rtcType = aconfig_getEntry(ACONFIG_KEY_RTC_TYPE);
   if (rtcType != NULL) {
     term_printString(rtcType->value);
   } else {
@@ -196,6 +275,7 @@ static void menu(void) {
 
   term_printString("\n");
   term_printString("Select an option: ");
+  term_endOutput();
 }
 
 static void showCounter(int cdown) {
@@ -211,11 +291,11 @@ static void showCounter(int cdown) {
   u8g2_DrawBox(display_getU8g2Ref(), 0,
                DISPLAY_HEIGHT - DISPLAY_TERM_CHAR_HEIGHT, DISPLAY_WIDTH,
                DISPLAY_TERM_CHAR_HEIGHT);
-  u8g2_SetFont(display_getU8g2Ref(), u8g2_font_squeezed_b7_tr);
+  fontcache_setFont(display_getU8g2Ref(), u8g2_font_squeezed_b7_tr);
   u8g2_SetDrawColor(display_getU8g2Ref(), 0);
   u8g2_DrawStr(display_getU8g2Ref(), 0, DISPLAY_HEIGHT - 1, msg);
   u8g2_SetDrawColor(display_getU8g2Ref(), 1);
-  u8g2_SetFont(display_getU8g2Ref(), u8g2_font_amstrad_cpc_extended_8f);
+  fontcache_setFont(display_getU8g2Ref(), u8g2_font_amstrad_cpc_extended_8f);
 }
 
 // Command handlers
@@ -261,32 +341,58 @@ void cmdBooster(const char *arg) {
 
 void cmdY2KPatch(const char *arg) {
   // Y2K patch command
-  SettingsConfigEntry *y2kPatch =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_RTC_Y2K_PATCH);
+  SettingsConfigEntry *y2kPatch = aconfig_getEntry(ACONFIG_KEY_RTC_Y2K_PATCH);
   if (y2kPatch != NULL) {
     DPRINTF("Y2K patch value: %s\n", y2kPatch->value);
-    if (y2kPatch->value[0] == 't' || y2kPatch->value[0] == 'T' ||
-        y2kPatch->value[0] == 'Y' || y2kPatch->value[0] == 'y') {
-      // Change the Y2K patch value to true
-      settings_put_bool(aconfig_getContext(), ACONFIG_PARAM_RTC_Y2K_PATCH,
-                        false);
-    } else {
-      settings_put_bool(aconfig_getContext(), ACONFIG_PARAM_RTC_Y2K_PATCH,
-                        true);
-    }
-    settings_save(aconfig_getContext(), true);
+    // Toggle the Y2K patch value
+    settings_put_bool(aconfig_getContext(), ACONFIG_PARAM_RTC_Y2K_PATCH,
+                      !aconfig_getBool(ACONFIG_KEY_RTC_Y2K_PATCH, false));
+    aconfig_requestSave();
     haltCountdown = true;
     menu();
-    display_refresh();
   } else {
     DPRINTF("Y2K patch not found in the settings.\n");
   }
 }
 
+void cmdRadio(const char *arg) {
+  // Radio policy command. Cycle through the options
+  SettingsConfigEntry *radio = aconfig_getEntry(ACONFIG_KEY_RTC_RADIO_POWER);
+  if (radio != NULL) {
+    DPRINTF("Radio power value: %s\n", radio->value);
+    int radioValue = (aconfig_getInt(ACONFIG_KEY_RTC_RADIO_POWER, 0) + 1) %
+                     RADIO_POWER_OPTIONS;
+    settings_put_integer(aconfig_getContext(), ACONFIG_PARAM_RTC_RADIO_POWER,
+                         radioValue);
+    aconfig_requestSave();
+    haltCountdown = true;
+    menu();
+  } else {
+    DPRINTF("Radio power not found in the settings.\n");
+  }
+}
+
+void cmdFastBoot(const char *arg) {
+  // Fast boot command. Toggle between the fast boot and the setup menu
+  SettingsConfigEntry *appMode = aconfig_getEntry(ACONFIG_KEY_MODE);
+  if (appMode != NULL) {
+    DPRINTF("App mode value: %s\n", appMode->value);
+    settings_put_integer(aconfig_getContext(), ACONFIG_PARAM_MODE,
+                         aconfig_getInt(ACONFIG_KEY_MODE, APP_MODE_SETUP) ==
+                                 APP_MODE_FAST_BOOT
+                             ? APP_MODE_SETUP
+                             : APP_MODE_FAST_BOOT);
+    aconfig_requestSave();
+    haltCountdown = true;
+    menu();
+  } else {
+    DPRINTF("App mode not found in the settings.\n");
+  }
+}
+
 void cmdType(const char *arg) {
   // RTC type command
-  SettingsConfigEntry *rtcType =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_RTC_TYPE);
+  SettingsConfigEntry *rtcType = aconfig_getEntry(ACONFIG_KEY_RTC_TYPE);
   if (rtcType != NULL) {
     DPRINTF("RTC type value: %s\n", rtcType->value);
     if (strcmp(rtcType->value, "SIDECART") == 0) {
@@ -297,10 +403,9 @@ void cmdType(const char *arg) {
       settings_put_string(aconfig_getContext(), ACONFIG_PARAM_RTC_TYPE,
                           "SIDECART");
     }
-    settings_save(aconfig_getContext(), true);
+    aconfig_requestSave();
     haltCountdown = true;
     menu();
-    display_refresh();
   } else {
     DPRINTF("RTC type not found in the settings.\n");
   }
@@ -332,7 +437,10 @@ void cmdHost(const char *arg) {
       settings_put_string(aconfig_getContext(),
                           ACONFIG_PARAM_RTC_NTP_SERVER_HOST,
                           term_getInputBuffer());
-      settings_save(aconfig_getContext(), true);
+      // The cached address belongs to the previous host
+      settings_put_string(aconfig_getContext(), ACONFIG_PARAM_RTC_NTP_CACHE_IP,
+                          "");
+      aconfig_requestSave();
       menu();
     }
   }
@@ -369,7 +477,7 @@ void cmdPort(const char *arg) {
       settings_put_string(aconfig_getContext(),
                           ACONFIG_PARAM_RTC_NTP_SERVER_PORT,
                           term_getInputBuffer());
-      settings_save(aconfig_getContext(), true);
+      aconfig_requestSave();
       menu();
     }
   }
@@ -379,7 +487,8 @@ void cmdUTCOffset(const char *arg) {
   if (term_getCommandLevel() == TERM_COMMAND_LEVEL_SINGLE_KEY) {
     showTitle();
     term_printString("\n\n");
-    term_printString("Enter the UTC offset:\n");
+    term_printString("Enter the UTC offset in hours, or a TZ string\n");
+    term_printString("like CET-1CEST,M3.5.0,M10.5.0/3:\n");
     term_setCommandLevel(TERM_COMMAND_LEVEL_DATA_INPUT);
     haltCountdown = true;
   } else {
@@ -391,14 +500,17 @@ void cmdUTCOffset(const char *arg) {
       term_printString("Invalid UTC offset.\n");
       term_printString("Press SPACE to continue...\n");
     }
-    // Convert the input buffer to an integer
+    // Convert the input buffer to a number of hours, like 5.5
     const char *input = term_getInputBuffer();
     char *endptr;
-    long utcOffset = strtol(input, &endptr, 10);
+    double utcOffset = strtod(input, &endptr);
+    bool isOffset = (input != endptr) && (*endptr == '\0') &&
+                    (utcOffset >= -12.0) && (utcOffset <= 14.0);
+    // Or a POSIX TZ string with the daylight saving time rules
+    TzRules rules;
 
     // Check if the conversion was successful and within valid range
-    if (input == endptr || *endptr != '\0' || utcOffset < -12 ||
-        utcOffset > 14) {
+    if (!isOffset && (tzrules_parse(input, &rules) != 0)) {
       term_printString("Invalid UTC offset.\n");
       term_printString("Press SPACE to continue...\n");
     }
@@ -406,18 +518,264 @@ void cmdUTCOffset(const char *arg) {
     else {
       settings_put_string(aconfig_getContext(), ACONFIG_PARAM_RTC_UTC_OFFSET,
                           term_getInputBuffer());
-      settings_save(aconfig_getContext(), true);
+      aconfig_requestSave();
       menu();
     }
   }
 }
 
+static bool read_cache_ip(AconfigKey key, ip_addr_t *addr) {
+  const char *value = aconfig_getString(key, NULL);
+  return (value != NULL) && ipaddr_aton(value, addr);
+}
+
+// Load the last WiFi connection. The DHCP lease is only reused if the time is
+// trusted and the lease has not expired yet
+static bool load_wifi_cache() {
+  memset(&wifiCache, 0, sizeof(wifiCache));
+  SettingsConfigEntry *bssid = aconfig_getEntry(ACONFIG_KEY_WIFI_CACHE_BSSID);
+  if ((bssid == NULL) || (bssid->value == NULL)) {
+    return false;
+  }
+  unsigned int mac[NETWORK_MAC_SIZE];
+  if (sscanf(bssid->value, "%02x:%02x:%02x:%02x:%02x:%02x", &mac[0], &mac[1],
+             &mac[2], &mac[3], &mac[4], &mac[5]) != NETWORK_MAC_SIZE) {
+    return false;
+  }
+  for (int i = 0; i < NETWORK_MAC_SIZE; i++) {
+    wifiCache.bssid[i] = (uint8_t)mac[i];
+  }
+  wifiCache.channel =
+      (uint8_t)aconfig_getInt(ACONFIG_KEY_WIFI_CACHE_CHANNEL, 0);
+  if (wifiCache.channel == 0) {
+    return false;
+  }
+
+  wifiCacheLeaseExpiry = aconfig_getInt(ACONFIG_KEY_WIFI_CACHE_LEASE_EXPIRY, 0);
+  bool hasLease =
+      read_cache_ip(ACONFIG_KEY_WIFI_CACHE_IP, &wifiCache.ip) &&
+      read_cache_ip(ACONFIG_KEY_WIFI_CACHE_NETMASK, &wifiCache.netmask) &&
+      read_cache_ip(ACONFIG_KEY_WIFI_CACHE_GATEWAY, &wifiCache.gateway) &&
+      read_cache_ip(ACONFIG_KEY_WIFI_CACHE_DNS, &wifiCache.dns);
+  uint32_t now = 0;
+  if (hasLease && rtc_getTrustedTime(&now) &&
+      ((int64_t)now + WIFI_LEASE_MARGIN_S < (int64_t)wifiCacheLeaseExpiry)) {
+    wifiCache.use_lease = true;
+  }
+  DPRINTF("Cached WiFi channel %d. Lease %s\n", wifiCache.channel,
+          wifiCache.use_lease ? "reused" : "not reused");
+  return true;
+}
+
+// Store the current WiFi connection in the settings. Only when it changed or
+// the lease is half used, to save flash writes
+static bool store_wifi_cache() {
+  if (!wifiCurrentValid) {
+    return false;
+  }
+  int leaseExpiry = wifiCacheLeaseExpiry;
+  uint32_t now = 0;
+  bool renewLease = false;
+  if ((wifiCurrent.lease_secs > 0) && rtc_getTrustedTime(&now)) {
+    // The lease started when the connection was made
+    uint32_t elapsed = (uint32_t)((time_us_64() - wifiConnectedUs) / 1000000);
+    leaseExpiry = (int)(now - elapsed + wifiCurrent.lease_secs);
+    renewLease = (int64_t)now + wifiCurrent.lease_secs / 2 >
+                 (int64_t)wifiCacheLeaseExpiry;
+  }
+  bool changed =
+      !wifiCacheLoaded ||
+      (memcmp(wifiCache.bssid, wifiCurrent.bssid, NETWORK_MAC_SIZE) != 0) ||
+      (wifiCache.channel != wifiCurrent.channel) ||
+      !ip_addr_cmp(&wifiCache.ip, &wifiCurrent.ip);
+  if (!changed && !renewLease) {
+    return false;
+  }
+
+  char value[IPADDR_STRLEN_MAX];
+  char bssid[MAX_BSSID_LENGTH];
+  network_formatBssid(wifiCurrent.bssid, bssid, sizeof(bssid));
+  settings_put_string(aconfig_getContext(), ACONFIG_PARAM_WIFI_CACHE_BSSID,
+                      bssid);
+  settings_put_integer(aconfig_getContext(), ACONFIG_PARAM_WIFI_CACHE_CHANNEL,
+                       wifiCurrent.channel);
+  ipaddr_ntoa_r(&wifiCurrent.ip, value, sizeof(value));
+  settings_put_string(aconfig_getContext(), ACONFIG_PARAM_WIFI_CACHE_IP, value);
+  ipaddr_ntoa_r(&wifiCurrent.netmask, value, sizeof(value));
+  settings_put_string(aconfig_getContext(), ACONFIG_PARAM_WIFI_CACHE_NETMASK,
+                      value);
+  ipaddr_ntoa_r(&wifiCurrent.gateway, value, sizeof(value));
+  settings_put_string(aconfig_getContext(), ACONFIG_PARAM_WIFI_CACHE_GATEWAY,
+                      value);
+  ipaddr_ntoa_r(&wifiCurrent.dns, value, sizeof(value));
+  settings_put_string(aconfig_getContext(), ACONFIG_PARAM_WIFI_CACHE_DNS,
+                      value);
+  settings_put_integer(aconfig_getContext(),
+                       ACONFIG_PARAM_WIFI_CACHE_LEASE_EXPIRY, leaseExpiry);
+  DPRINTF("WiFi connection cached: %s, channel %d\n", bssid,
+          wifiCurrent.channel);
+  return true;
+}
+
+// The network is up: start its services
+static void wifi_connected() {
+  hasNetwork = true;
+  wifiConnectedUs = time_us_64();
+  wifiCurrentValid = (network_getFastConnect(&wifiCurrent) == 0);
+  // Query the NTP server while the countdown runs
+  rtc_startNTPQuery();
+  timeMaster = aconfig_getBool(ACONFIG_KEY_RTC_TIME_MASTER, false) &&
+               (sntpd_start() == 0);
+  int fleetPort = aconfig_getInt(ACONFIG_KEY_FLEET_PORT, 0);
+  if ((fleetPort > 0) && (fleetPort <= 65535)) {
+    fleet_start((uint16_t)fleetPort);
+  }
+  int mirrorPort = aconfig_getInt(ACONFIG_KEY_TERM_MIRROR_PORT, 0);
+  if ((mirrorPort > 0) && (mirrorPort <= 65535)) {
+    termnet_start((uint16_t)mirrorPort,
+                  aconfig_getString(ACONFIG_KEY_TERM_MIRROR_PASSWORD, ""));
+  }
+}
+
+// Send the join of the boot. The last access point without scanning first
+static void wifi_connectStart(bool fast) {
+  wifiConnectFast = fast;
+  network_setFastConnect(fast ? &wifiCache : NULL);
+  boottime_begin(BOOT_PHASE_WIFI_CONNECT);
+  int err = network_wifiStaConnectStart();
+  network_setFastConnect(NULL);
+  wifiConnecting = (err == NETWORK_WIFI_STA_CONN_OK);
+  if (!wifiConnecting) {
+    boottime_end(BOOT_PHASE_WIFI_CONNECT);
+    DPRINTF("Error connecting to the WiFi network: %i\n", err);
+    if (fast) {
+      wifi_connectStart(false);
+    }
+  }
+}
+
+// Step the connection of the boot. Never blocks
+static void wifi_connectPoll() {
+  if (!wifiConnecting) {
+    return;
+  }
+  int err = network_wifiStaConnectPoll();
+  if (err == NETWORK_WIFI_STA_CONN_PENDING) {
+    return;
+  }
+  boottime_end(BOOT_PHASE_WIFI_CONNECT);
+  wifiConnecting = false;
+  if (err == NETWORK_WIFI_STA_CONN_OK) {
+    wifi_connected();
+  } else if (wifiConnectFast) {
+    DPRINTF("Fast connect failed: %i. Full connection\n", err);
+    wifi_connectStart(false);
+  } else if (++wifiConnectAttempts < WIFI_CONNECT_ATTEMPTS) {
+    wifi_connectStart(false);
+  } else {
+    DPRINTF("Timeout connecting to the WiFi network after %d attempts\n",
+            WIFI_CONNECT_ATTEMPTS);
+  }
+}
+
+// Bring the radio back with the last connection before a resync
+static void radio_wakeUp() {
+  if (radioState == RADIO_POWER_SAVE) {
+    network_setPowerSave(false);
+  } else if (radioState == RADIO_POWER_OFF) {
+    // Blocks this core while connecting. The bus is served by core 1
+    if (network_wifiInit(WIFI_MODE_STA) != 0) {
+      DPRINTF("Cannot power the radio up. Retry later\n");
+      return;
+    }
+    rtc_suspendNTP(false);
+    if (wifiCurrentValid) {
+      uint32_t elapsed = (uint32_t)((time_us_64() - wifiConnectedUs) / 1000000);
+      wifiCurrent.use_lease =
+          wifiCurrent.lease_secs > elapsed + WIFI_LEASE_MARGIN_S;
+      network_setFastConnect(&wifiCurrent);
+    }
+    int err = network_wifiStaConnect();
+    network_setFastConnect(NULL);
+    if (err != NETWORK_WIFI_STA_CONN_OK) {
+      err = network_wifiStaConnect();
+    }
+    DPRINTF("Radio on for the resync: %i\n", err);
+  }
+  radioState = RADIO_POWER_ON;
+}
+
+// Quiet the radio once the time is synced, so it does not disturb the bus
+// service, and wake it up a bit before the next resync
+static void radio_policy(RTC_NTP_STATE ntpState) {
+  // The time master must be there for the queries of the other devices
+  if (!hasNetwork || (radioPower == RADIO_POWER_ON) || timeMaster) {
+    return;
+  }
+  int64_t nextSyncUs = rtc_getNextSyncUs();
+  if (radioState == RADIO_POWER_ON) {
+    if ((ntpState == RTC_NTP_SYNCED) && rtc_isNTPIdle() &&
+        (nextSyncUs > RADIO_WAKE_LEAD_US)) {
+      DPRINTF("Radio down until the next resync\n");
+      if (radioPower == RADIO_POWER_SAVE) {
+        network_setPowerSave(true);
+      } else {
+        rtc_suspendNTP(true);
+        network_deInit();
+      }
+      radioState = radioPower;
+    }
+  } else if (nextSyncUs <= RADIO_WAKE_LEAD_US) {
+    radio_wakeUp();
+  }
+}
+
+// The fast boot needs a configuration that can run without the user
+static bool is_config_valid() {
+  SettingsConfigEntry *ntpHost =
+      aconfig_getEntry(ACONFIG_KEY_RTC_NTP_SERVER_HOST);
+  SettingsConfigEntry *rtcType = aconfig_getEntry(ACONFIG_KEY_RTC_TYPE);
+  if ((ntpHost == NULL) || !is_valid_domain(ntpHost->value)) {
+    DPRINTF("Invalid NTP server host\n");
+    return false;
+  }
+  int port = aconfig_getInt(ACONFIG_KEY_RTC_NTP_SERVER_PORT, 0);
+  if ((port <= 0) || (port > 65535)) {
+    DPRINTF("Invalid NTP server port\n");
+    return false;
+  }
+  if ((rtcType == NULL) || (strcmp(rtcType->value, "SIDECART") != 0 &&
+                            strcmp(rtcType->value, "DALLAS") != 0)) {
+    DPRINTF("Invalid RTC type\n");
+    return false;
+  }
+  return true;
+}
+
 // This section contains the functions that are called from the main loop
 
 static bool getKeepActive() { return keepActive; }
 
 static bool getJumpBooster() { return jumpBooster; }
 
+// Called from the SELECT button interrupt. The reset runs in the main loop,
+// after writing the pending settings
+static void requestReset(void) { resetRequested = true; }
+
+// Called from the long press alarm. The flash can't be erased from an
+// interrupt handler, so the erase and the reset run in the main loop
+static void requestEraseAndReset(void) { eraseRequested = true; }
+
+static void checkReset(void) {
+  if (eraseRequested) {
+    reset_deviceAndEraseFlash();
+  }
+  if (resetRequested) {
+    aconfig_flush();
+    reset_device();
+  }
+}
+
 static void preinit() {
   // Initialize the terminal
   term_init();
@@ -449,15 +807,122 @@ void failure(const char *message) {
   display_refresh();
 }
 
+#if USB_TELEMETRY == 1
+static void telemetryHelp(const char *arg) {
+  TELEMETRY_PRINTF("Available commands:\n");
+  TELEMETRY_PRINTF("  stats    - Show the protocol counters\n");
+  TELEMETRY_PRINTF("  settings - Show the settings\n");
+  TELEMETRY_PRINTF("  ntp      - Sync the clock with NTP now\n");
+  TELEMETRY_PRINTF("  capture  - Export the bus capture. start, stop\n");
+  TELEMETRY_PRINTF("  loadgen  - Load the bus. frames|noise|mix [rate] [ms]\n");
+}
+
+static void telemetryPrintStats(const char *name,
+                                const TransmissionProtocolStats *stats,
+                                uint32_t dropped) {
+  uint32_t irqCount = stats->irqCount;
+  uint32_t irqAverage =
+      irqCount ? (uint32_t)(stats->irqTotalCycles / irqCount) : 0;
+  TELEMETRY_PRINTF(
+      "%s: accesses=%lu headers=%lu frames=%lu checksum_errors=%lu "
+      "resyncs=%lu dropped=%lu irq_max=%lu irq_avg=%lu\n",
+      name, (unsigned long)stats->accesses, (unsigned long)stats->headers,
+      (unsigned long)stats->frames, (unsigned long)stats->checksumErrors,
+      (unsigned long)stats->resyncs, (unsigned long)dropped,
+      (unsigned long)stats->irqMaxCycles, (unsigned long)irqAverage);
+}
+
+static void telemetryStats(const char *arg) {
+  telemetryPrintStats("bus", tprotocol_getStats(), dispatch_getOverflows());
+  TELEMETRY_PRINTF("capture: overruns=%lu\n",
+                   (unsigned long)romemul_getCaptureOverruns());
+  TELEMETRY_PRINTF("telemetry: dropped=%lu\n",
+                   (unsigned long)telemetry_getDropped());
+}
+
+static void telemetrySettings(const char *arg) {
+  char *buffer = (char *)malloc(TERM_PRINT_SETTINGS_BUFFER_SIZE);
+  if (buffer == NULL) {
+    TELEMETRY_PRINTF("Error: Out of memory.\n");
+    return;
+  }
+  settings_print(aconfig_getContext(), buffer);
+  telemetry_write(buffer, strlen(buffer));
+  free(buffer);
+}
+
+static void telemetryCapture(const char *arg) {
+  // The capture can be armed from here while the computer boots
+  if (strcmp(arg, "start") == 0) {
+    bustrace_start();
+    TELEMETRY_PRINTF("Capture started\n");
+  } else if (strcmp(arg, "stop") == 0) {
+    bustrace_stop();
+    TELEMETRY_PRINTF("Capture stopped\n");
+  } else {
+    bustrace_export();
+  }
+}
+
+static void telemetryProfile(const char *arg) {
+  if (strcmp(arg, "start") == 0) {
+    if (fetchprof_start() == 0) {
+      TELEMETRY_PRINTF("Profile started\n");
+    } else {
+      TELEMETRY_PRINTF("No fetch profiler in this build\n");
+    }
+  } else if (strcmp(arg, "stop") == 0) {
+    fetchprof_stop();
+    TELEMETRY_PRINTF("Profile stopped\n");
+  } else {
+    fetchprof_export();
+  }
+}
+
+static void telemetryLoadGen(const char *arg) {
+  char name[8];
+  unsigned long rate = LOADGEN_DEFAULT_RATE;
+  unsigned long ms = LOADGEN_DEFAULT_MS;
+  if (strcmp(arg, "stop") == 0) {
+    loadgen_stop();
+    loadgen_report();
+  } else if (sscanf(arg, "%7s %lu %lu", name, &rate, &ms) >= 1) {
+    LoadGenPattern pattern = loadgen_getPattern(name);
+    if ((pattern == LOADGEN_PATTERNS) ||
+        (loadgen_start(pattern, (uint32_t)rate, (uint32_t)ms) != 0)) {
+      TELEMETRY_PRINTF("Load generator not started\n");
+    } else {
+      TELEMETRY_PRINTF("Load generator started\n");
+    }
+  } else if (loadgen_isRunning()) {
+    TELEMETRY_PRINTF("Load generator running\n");
+  } else {
+    loadgen_report();
+  }
+}
+
+static void telemetryNTP(const char *arg) {
+  if (rtc_requestNTPSync() == 0) {
+    TELEMETRY_PRINTF("NTP sync requested\n");
+  } else {
+    TELEMETRY_PRINTF("NTP sync not available now\n");
+  }
+}
+#endif
+
 static void init(const char *folder) {
   // Set the command table
   term_setCommands(commands, numCommands);
+#if USB_TELEMETRY == 1
+  telemetry_setCommands(telemetryCommands, numTelemetryCommands);
+#endif
 
   // Clear the screen
   term_clearScreen();
 
-  // Init contdown
-  countdown = 20;
+  // Init contdown. The fast boot only waits for the computer to see the ESC
+  // key held down
+  countdown = fastBoot ? FAST_BOOT_COUNTDOWN : SETUP_COUNTDOWN;
 
   // Set command level
   term_setCommandLevel(TERM_COMMAND_LEVEL_SINGLE_KEY);  // Single key command
@@ -516,16 +981,16 @@ void emul_start() {
 
   // 1. Check if the host device must be initialized to perform the emulation
   //    of the device, or start in setup/configuration mode
-  SettingsConfigEntry *appMode =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_MODE);
+  SettingsConfigEntry *appMode = aconfig_getEntry(ACONFIG_KEY_MODE);
   int appModeValue = APP_MODE_SETUP;  // Setup menu
   if (appMode == NULL) {
     DPRINTF(
         "APP_MODE_SETUP not found in the configuration. Using default value\n");
   } else {
-    appModeValue = atoi(appMode->value);
+    appModeValue = aconfig_getInt(ACONFIG_KEY_MODE, APP_MODE_SETUP);
     DPRINTF("Start emulation in mode: %i\n", appModeValue);
   }
+  fastBoot = (appModeValue == APP_MODE_FAST_BOOT) && is_config_valid();
 
   // 2. Initialiaze the normal operation of the app, unless the configuration
   // option says to start the config app Or a SELECT button is (or was) pressed
@@ -533,7 +998,8 @@ void emul_start() {
 
   // In this example, the flow will always start the configuration app first
   // The ROM Emulator app for example will check here if the start directly
-  // in emulation mode is needed or not
+  // in emulation mode is needed or not. Here the fast boot mode only shortens
+  // the countdown, so the ESC key can still reach the terminal
 
   // 3. If we are here, it means the app is not in emulation mode, but in
   // setup/configuration mode
@@ -544,16 +1010,46 @@ void emul_start() {
   // The code is stored as an array in the target_firmware.h file
   //
   // Copy the terminal firmware to RAM
+  boottime_begin(BOOT_PHASE_FIRMWARE_COPY);
+#ifdef TARGET_FIRMWARE_LZ4
+  // Less flash to read: decompress the image straight into the ROM in RAM
+  if (lz4_decompress(target_firmware_lz4, target_firmware_lz4_length,
+                     (uint8_t *)&__rom_in_ram_start__, ROM_SIZE_BYTES) !=
+      (int)target_firmware_size) {
+    // The computer would run a partial image: stop here and blink the error
+    DPRINTF("Cannot decompress the target firmware\n");
+    blink_error();
+  }
+#else
   COPY_FIRMWARE_TO_RAM((uint16_t *)target_firmware, target_firmware_length);
+#endif
+  boottime_end(BOOT_PHASE_FIRMWARE_COPY);
 
   // Initialize the terminal emulator PIO programs
   // The communication between the remote (target) computer and the RP2040 is
   // done using a command protocol over the cartridge bus
-  // term_dma_irq_handler_lookup is the implementation of the terminal emulator
-  // using the command protocol.
+  // dispatch_dmaIrqHandlerLookup parses the commands of all the apps, and
+  // each app registers the handlers of its commands in the dispatcher.
   // Hence, if you want to implement your own app or microfirmware, you should
-  // implement your own command handler using this protocol.
-  init_romemul(NULL, term_dma_irq_handler_lookup, false);
+  // register your own command handlers using this protocol.
+  boottime_begin(BOOT_PHASE_ROMEMUL);
+  dispatch_init();
+  status_init();
+  init_romemul(NULL, dispatch_dmaIrqHandlerLookup, false);
+  buscal_init();
+  boottime_end(BOOT_PHASE_ROMEMUL);
+
+#if ROMEMUL_CORE1_BUS == 1
+  // Core 1 services the bus. Core 0 keeps the network, terminal and settings
+  romemul_launchCore1Bus();
+#endif
+#if ROMEMUL_ROM3_CAPTURE == 1
+  // Parse the ROM3 addresses in batches from the capture ring
+  dma_setCaptureCB(dispatch_captureAddressHandler);
+#elif ROMEMUL_ROM3_PIO_FILTER == 1
+  // Only frames found by the PIO header filter reach the parser
+  dma_setFrameCB(dispatch_frameAddressHandler);
+#endif
 
   // After this point, the remote computer can execute the code
 
@@ -569,7 +1065,9 @@ void emul_start() {
 
   // 5. Init the sd card
   // Initialize the display again (in case the terminal emulator changed it)
+  boottime_begin(BOOT_PHASE_DISPLAY);
   display_setupU8g2();
+  boottime_end(BOOT_PHASE_DISPLAY);
 
   // Pre-init the stuff
   // In this example it only prints the please wait message, but can be used as
@@ -585,43 +1083,26 @@ void emul_start() {
   // It's important to note that the network parameters are taken from the
   // global configuration of the Booster app. The network parameters are
   // ready only for the microfirmware apps.
-  SettingsConfigEntry *wifiMode =
-      settings_find_entry(gconfig_getContext(), PARAM_WIFI_MODE);
+  SettingsConfigEntry *wifiMode = gconfig_getEntry(GCONFIG_KEY_WIFI_MODE);
   wifi_mode_t wifiModeValue = WIFI_MODE_STA;
   if (wifiMode == NULL) {
     DPRINTF("No WiFi mode found in the settings. No initializing.\n");
   } else {
-    wifiModeValue = (wifi_mode_t)atoi(wifiMode->value);
+    wifiModeValue =
+        (wifi_mode_t)gconfig_getInt(GCONFIG_KEY_WIFI_MODE, WIFI_MODE_STA);
     if (wifiModeValue != WIFI_MODE_AP) {
       DPRINTF("WiFi mode is STA\n");
       wifiModeValue = WIFI_MODE_STA;
+      boottime_begin(BOOT_PHASE_WIFI_INIT);
       int err = network_wifiInit(wifiModeValue);
+      boottime_end(BOOT_PHASE_WIFI_INIT);
       if (err != 0) {
         DPRINTF("Error initializing the network: %i. No initializing.\n", err);
       } else {
-        // Set the term_loop as a callback during the polling period
-        network_setPollingCallback(term_loop);
-        // Connect to the WiFi network
-        int maxAttempts = 3;  // or any other number defined elsewhere
-        int attempt = 0;
-        err = NETWORK_WIFI_STA_CONN_ERR_TIMEOUT;
-
-        while ((attempt < maxAttempts) &&
-               (err == NETWORK_WIFI_STA_CONN_ERR_TIMEOUT)) {
-          err = network_wifiStaConnect();
-          attempt++;
-
-          if ((err > 0) && (err < NETWORK_WIFI_STA_CONN_ERR_TIMEOUT)) {
-            DPRINTF("Error connecting to the WiFi network: %i\n", err);
-          }
-        }
-
-        if (err == NETWORK_WIFI_STA_CONN_ERR_TIMEOUT) {
-          DPRINTF("Timeout connecting to the WiFi network after %d attempts\n",
-                  maxAttempts);
-          // Optionally, return an error code here.
-        }
-        network_setPollingCallback(NULL);
+        // Join the WiFi network and go on. The main loop steps the
+        // connection while the terminal runs
+        wifiCacheLoaded = load_wifi_cache();
+        wifi_connectStart(wifiCacheLoaded);
       }
     } else {
       DPRINTF("WiFi mode is AP. No initializing.\n");
@@ -633,9 +1114,11 @@ void emul_start() {
   // device.
   init(NULL);
 
-  // Blink on
+  // Blink on, unless the connection is still blinking
 #ifdef BLINK_H
-  blink_on();
+  if (!blink_isPlaying()) {
+    blink_on();
+  }
 #endif
 
   // Configure the SELECT button
@@ -643,8 +1126,8 @@ void emul_start() {
   // 2. Long press: reset the device and erase the flash.
   select_configure();
   select_coreWaitPush(
-      reset_device,
-      reset_deviceAndEraseFlash);  // Wait for the SELECT button to be pushed
+      requestReset,
+      requestEraseAndReset);  // Wait for the SELECT button to be pushed
 
   // 8. Start the main loop
   // The main loop is the core of the app. It is responsible for running the
@@ -663,21 +1146,74 @@ void emul_start() {
   absolute_time_t lastDecrement = get_absolute_time();
 
   while (getKeepActive()) {
+    if (appStatus == APP_EMULATION_RUNTIME) {
 #if PICO_CYW43_ARCH_POLL
-    network_safePoll();
-    cyw43_arch_wait_for_work_until(wifiScanTime);
+      if (radioState != RADIO_POWER_OFF) {
+        network_safePoll();
+      }
+#endif
+      // Idle between the commands. The parser raises the event flag with
+      // __sev() when it publishes a frame, and any interrupt (bus, cyw43,
+      // timers) also ends the wait, so the latency is a few cycles
+      absolute_time_t wakeUp = make_timeout_time_ms(SLEEP_LOOP_MS);
+#if ROMEMUL_CORE1_BUS == 0
+      dispatch_waitCommand(wakeUp);
 #else
-    sleep_ms(SLEEP_LOOP_MS);
-    DPRINTF("Polling...\n");
+      // Core 1 wakes up by itself to process the commands
+      best_effort_wfe_or_timeout(wakeUp);
+#endif
+    } else {
+#if PICO_CYW43_ARCH_POLL
+      network_safePoll();
+      cyw43_arch_wait_for_work_until(wifiScanTime);
+#else
+      // The network runs from its own interrupt. Sleep until the bus
+      // publishes a command or it is time to check the countdown
+      dispatch_waitCommand(make_timeout_time_ms(SLEEP_LOOP_MS));
 #endif
+    }
+    checkReset();
+    // Write the settings changed in the menu once the user stops typing
+    aconfig_poll();
+    // Print the events traced by the interrupts and the bus loop
+    trace_dump();
+    // Send the telemetry and run the commands of the USB port
+    telemetry_poll();
+    // Export the bus capture, if requested
+    bustrace_poll();
+    // Count the samples of the fetch profiler and send its export
+    fetchprof_poll();
+    // End the run of the bus load generator and send its counters
+    loadgen_poll();
+    // Next step of the bus calibration, if running
+    buscal_poll();
+    // The connection of the boot and the NTP query run in the background in
+    // all the states
+    wifi_connectPoll();
+    RTC_NTP_STATE ntpLoopState = rtc_pollNTPQuery();
+    // Publish the status of the device for the computer
+    status_poll(radioState != RADIO_POWER_OFF);
+    // Answer the fleet collector, one request at most
+    fleet_poll(radioState != RADIO_POWER_OFF);
+    // Mirror the terminal for the Telnet client. Its keys only drive the
+    // setup terminal, the one of this core
+    termnet_poll(radioState != RADIO_POWER_OFF, appStatus == APP_MODE_SETUP);
+    // Next step of the LED pattern, if one is playing
+    blink_poll();
     switch (appStatus) {
       case APP_EMULATION_RUNTIME: {
+        if (gemLaunched) {
+          radio_policy(ntpLoopState);
+        }
         // The app is running in emulation mode
-        // Call the RTC loop to handle the RTC commands
-        rtc_loop();
+#if ROMEMUL_CORE1_BUS == 0
+        // Run the commands of the RTC and the terminal
+        dispatch_loop();
+#endif
         if (!gemLaunched) {
           DPRINTF("Jumping to desktop...\n");
           SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_START);
+          boottime_end(BOOT_PHASE_DESKTOP);
           // sleep_ms(SLEEP_LOOP_MS * 10);
           // SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_NOP);
           gemLaunched = true;
@@ -685,42 +1221,66 @@ void emul_start() {
         break;
       }
       case APP_EMULATION_INIT: {
+        if (wifiConnecting) {
+          // The connection ends within its timeout. The settings are written
+          // with it before the computer boots
+          break;
+        }
         // The app is running in initialization mode
         DPRINTF("Start runtime commands...\n");
-        term_printString("\n\nQuerying NTP...");
-        int res = rtc_queryNTPTime();
-        if (res == 0) {
-          term_printString("Time set successfully!\n");
-          datetime_t rtcTime = {0};
-          rtc_get_datetime(&rtcTime);
-          char msg[40];
-          snprintf(msg, sizeof(msg),
-                   "Clock set to: %02d/%02d/%04d %02d:%02d:%02d UTC+0\n",
-                   rtcTime.day, rtcTime.month, rtcTime.year, rtcTime.hour,
-                   rtcTime.min, rtcTime.sec);
-          term_printString(msg);
-
-          // We can continue with the post-init process
-          rtc_postinit();
-
-          // Now we need to change the function that handles the RTC commands
-          DPRINTF("Changing the RTC command handler\n");
-          dma_setResponseCB(rtc_dma_irq_handler_lookup);  // Set the rtc handler
-          DPRINTF("RTC command handler changed\n");
-
-          appStatus = APP_EMULATION_RUNTIME;
-        } else {
-          term_printString("Error setting time :-(\n");
-          appStatus = APP_MODE_SETUP;
+        // Do not wait for the NTP server. The emulation starts with the last
+        // known time and the RTC is updated when the NTP server answers
+        RTC_NTP_STATE ntpState = rtc_pollNTPQuery();
+        radioPower =
+            aconfig_getInt(ACONFIG_KEY_RTC_RADIO_POWER, RADIO_POWER_ON);
+        if (radioPower < 0 || radioPower >= RADIO_POWER_OPTIONS) {
+          radioPower = RADIO_POWER_ON;
         }
-        // Check remote commands
-        term_loop();
+        // Last chance to write the flash before the computer boots. All the
+        // pending changes go in a single write
+        if (store_wifi_cache()) {
+          aconfig_requestSave();
+        }
+        rtc_saveState();
+        if (aconfig_flush() != ACONFIG_SUCCESS) {
+          DPRINTF("Cannot save the settings before the emulation\n");
+        }
+        datetime_t rtcTime = {0};
+        rtc_postinit();
+        rtc_get_datetime(&rtcTime);
+        char msg[48];
+        snprintf(msg, sizeof(msg), "\n\n%s: %02d/%02d/%04d %02d:%02d:%02d\n",
+                 (ntpState == RTC_NTP_SYNCED) ? "Clock set to" : "Clock",
+                 rtcTime.day, rtcTime.month, rtcTime.year, rtcTime.hour,
+                 rtcTime.min, rtcTime.sec);
+        term_printString(msg);
+        if (ntpState != RTC_NTP_SYNCED) {
+          term_printString("NTP sync in background\n");
+        }
+
+        // The bus interrupt stays as it is: the commands of the terminal and
+        // the RTC are live in the same table. Drain the pending commands
+        // before another core becomes the consumer of the queue
+        dispatch_loop();
+#if ROMEMUL_CORE1_BUS == 1
+        // The commands are processed in core 1 from now on, and nowhere else
+        network_setPollingCallback(NULL);
+        romemul_setCore1Loop(dispatch_loop);
+#endif
+        DPRINTF("Emulation commands live\n");
+
+        appStatus = APP_EMULATION_RUNTIME;
         break;
       }
       case APP_MODE_SETUP:
       default: {
         // Check remote commands
-        term_loop();
+        dispatch_loop();
+        // The flash is only written for the update before the emulation
+        ota_poll();
+        if (ota_getState(NULL) != OTA_IDLE) {
+          haltCountdown = true;
+        }
         if (!haltCountdown) {
           // Check if at least one second (1,000,000 µs) has passed since the
           // last decrement
@@ -745,6 +1305,9 @@ void emul_start() {
 
   if (jumpBooster) {
     select_coreWaitPushDisable();  // Disable the SELECT button
+    aconfig_flush();
+    // The time away from the app is unknown
+    rtc_invalidateWarmStart();
     sleep_ms(SLEEP_LOOP_MS);
     // We must reset the computer
     SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_RESET);
@@ -760,5 +1323,6 @@ void emul_start() {
   while (1) {
     // Wait for the computer to start
     sleep_ms(SLEEP_LOOP_MS);
+    checkReset();
   }
 }
\ No newline at end of file
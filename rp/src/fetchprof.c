@@ -0,0 +1,167 @@
+/**
+ * File: fetchprof.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Sampling profiler of the ROM4 addresses fetched by the computer
+ */
+
+#include "fetchprof.h"
+
+#include "telemetry.h"
+
+static FetchProfStats stats = {0};
+
+#if ROMEMUL_ROM4_PROFILE == 1
+static uint32_t histogram[FETCHPROF_BUCKETS];
+static uint32_t sampleRing[FETCHPROF_RING_WORDS]
+    __attribute__((aligned(FETCHPROF_RING_BYTES)));
+static int sampleChannel = -1;
+static int sampleTimer = -1;
+static bool running = false;
+static uint32_t readIndex = 0;
+static uint32_t lastSample = 0;
+static int32_t exportNext = -1;  // Next bucket to export, -1 if none
+
+// Claimed once, kept for the next starts
+static int claimResources(void) {
+  if (sampleChannel >= 0) {
+    return 0;
+  }
+  sampleTimer = dma_claim_unused_timer(false);
+  if (sampleTimer < 0) {
+    DPRINTF("No free DMA timer for the fetch profiler.\n");
+    return -1;
+  }
+  sampleChannel = dma_claim_unused_channel(false);
+  if (sampleChannel < 0) {
+    dma_timer_unclaim(sampleTimer);
+    sampleTimer = -1;
+    DPRINTF("No free DMA channel for the fetch profiler.\n");
+    return -1;
+  }
+  return 0;
+}
+
+int fetchprof_start(void) {
+  const volatile uint32_t *lookupAddr = romemul_getLookupAddress();
+  if ((lookupAddr == NULL) || (claimResources() != 0)) {
+    return -1;
+  }
+  fetchprof_stop();
+  memset(histogram, 0, sizeof(histogram));
+  memset(&stats, 0, sizeof(stats));
+  readIndex = 0;
+  lastSample = 0;
+
+  // The timer runs at sys_clk * X / Y. Y has 16 bits
+  uint32_t divider = clock_get_hz(clk_sys) / FETCHPROF_SAMPLE_HZ;
+  if (divider > 0xFFFF) {
+    divider = 0xFFFF;
+  }
+  dma_timer_set_fraction(sampleTimer, 1, (uint16_t)divider);
+
+  // Low priority, so the chain of the bus wins any clash in the bus fabric
+  dma_channel_config cfg = dma_channel_get_default_config(sampleChannel);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+  channel_config_set_read_increment(&cfg, false);
+  channel_config_set_write_increment(&cfg, true);
+  channel_config_set_ring(&cfg, true, FETCHPROF_RING_BITS);
+  channel_config_set_dreq(&cfg, dma_get_timer_dreq(sampleTimer));
+  channel_config_set_high_priority(&cfg, false);
+  dma_channel_configure(sampleChannel, &cfg, sampleRing, lookupAddr,
+                        FETCHPROF_TRANSFERS, true);
+  running = true;
+  DPRINTF("Fetch profiler started at %u Hz\n", FETCHPROF_SAMPLE_HZ);
+  return 0;
+}
+
+void fetchprof_stop(void) {
+  if (!running) {
+    return;
+  }
+  dma_channel_abort(sampleChannel);
+  running = false;
+  fetchprof_poll();
+  DPRINTF("Fetch profiler stopped. %lu ROM4 samples\n",
+          (unsigned long)stats.rom4);
+}
+
+bool fetchprof_isRunning(void) { return running; }
+
+static void drain(void) {
+  uint32_t writeIndex =
+      ((dma_hw->ch[sampleChannel].write_addr - (uint32_t)sampleRing) >> 2) &
+      FETCHPROF_RING_MASK;
+  while (readIndex != writeIndex) {
+    uint32_t addr = sampleRing[readIndex];
+    readIndex = (readIndex + 1) & FETCHPROF_RING_MASK;
+    stats.samples++;
+    if ((addr == lastSample) || (addr & ROMEMUL_ROM3_ADDRESS_BIT)) {
+      stats.other++;
+    } else {
+      uint32_t bucket = (addr & (FETCHPROF_ROM4_BYTES - 1)) >>
+                        FETCHPROF_BUCKET_SHIFT;
+      histogram[bucket]++;
+      stats.rom4++;
+    }
+    lastSample = addr;
+  }
+}
+
+static void exportBatch(void) {
+#if USB_TELEMETRY == 1
+  for (int i = 0; (i < FETCHPROF_EXPORT_BATCH) &&
+                  (telemetry_getFree() >= TELEMETRY_PRINTF_SIZE) &&
+                  (exportNext < FETCHPROF_BUCKETS);
+       exportNext++) {
+    if (histogram[exportNext] != 0) {
+      TELEMETRY_PRINTF("%04lX %lX\n",
+                       (unsigned long)exportNext << FETCHPROF_BUCKET_SHIFT,
+                       (unsigned long)histogram[exportNext]);
+      i++;
+    }
+  }
+  if (exportNext >= FETCHPROF_BUCKETS) {
+    TELEMETRY_PRINTF("profile end\n");
+    exportNext = -1;
+  }
+#endif
+}
+
+void fetchprof_poll(void) {
+  if (sampleChannel < 0) {
+    return;
+  }
+  drain();
+  if (running && !dma_channel_is_busy(sampleChannel)) {
+    // Hours of samples, but the count ends
+    dma_channel_set_trans_count(sampleChannel, FETCHPROF_TRANSFERS, true);
+  }
+  if (exportNext >= 0) {
+    exportBatch();
+  }
+}
+
+const uint32_t *fetchprof_getHistogram(void) { return histogram; }
+
+int fetchprof_export(void) {
+#if USB_TELEMETRY == 1
+  exportNext = 0;
+  TELEMETRY_PRINTF("profile %u %lu\n", FETCHPROF_BUCKET_BYTES,
+                   (unsigned long)stats.rom4);
+  return 0;
+#else
+  return -1;
+#endif
+}
+#else
+int fetchprof_start(void) { return -1; }
+void fetchprof_stop(void) {}
+bool fetchprof_isRunning(void) { return false; }
+void fetchprof_poll(void) {}
+const uint32_t *fetchprof_getHistogram(void) { return NULL; }
+int fetchprof_export(void) { return -1; }
+#endif
+
+const FetchProfStats *fetchprof_getStats(void) { return &stats; }
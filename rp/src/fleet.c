@@ -0,0 +1,167 @@
+/**
+ * File: fleet.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Snapshot of the device for a fleet collector over UDP
+ */
+
+#include "fleet.h"
+
+static struct udp_pcb *fleetPcb = NULL;
+
+// Sender of the pending request, written by the callback of lwIP
+static ip_addr_t requestAddr;
+static u16_t requestPort = 0;
+static volatile bool requestPending = false;
+static absolute_time_t nextAnswer;
+
+static char snapshot[FLEET_SNAPSHOT_SIZE];
+static size_t snapshotLen = 0;
+
+// Append to the snapshot. The text that does not fit is cut
+static void append(const char *fmt, ...) {
+  if (snapshotLen >= sizeof(snapshot) - 1) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(&snapshot[snapshotLen], sizeof(snapshot) - snapshotLen,
+                      fmt, args);
+  va_end(args);
+  if (len > 0) {
+    snapshotLen += (size_t)len;
+    if (snapshotLen > sizeof(snapshot) - 1) {
+      snapshotLen = sizeof(snapshot) - 1;
+    }
+  }
+}
+
+static void appendBus(void) {
+  const TransmissionProtocolStats *stats = tprotocol_getStats();
+  uint32_t irqCount = stats->irqCount;
+  uint32_t irqAverage =
+      irqCount ? (uint32_t)(stats->irqTotalCycles / irqCount) : 0;
+  append(
+      "\"bus\":{\"accesses\":%lu,\"headers\":%lu,\"frames\":%lu,"
+      "\"checksum_errors\":%lu,\"resyncs\":%lu,\"overflows\":%lu,"
+      "\"irq_max\":%lu,\"irq_avg\":%lu},",
+      (unsigned long)stats->accesses, (unsigned long)stats->headers,
+      (unsigned long)stats->frames, (unsigned long)stats->checksumErrors,
+      (unsigned long)stats->resyncs,
+      (unsigned long)dispatch_getOverflows(),
+      (unsigned long)stats->irqMaxCycles, (unsigned long)irqAverage);
+}
+
+// Milliseconds of each phase of this boot. -1 if it did not finish
+static void appendBoot(void) {
+  const BootRecord *record = boottime_getRecord(0);
+  append("\"boot\":{");
+  for (int i = 0; (record != NULL) && (i < BOOT_PHASES); i++) {
+    append("%s\"%s\":%ld", (i > 0) ? "," : "",
+           boottime_getPhaseName((BootPhase)i),
+           (long)boottime_getPhaseMs(&record->phases[i]));
+  }
+  append("},");
+}
+
+static void appendSync(void) {
+  const char *host;
+  uint32_t rttUs;
+  uint32_t age = rtc_getLastSync(&host, &rttUs);
+  append("\"ntp\":{\"host\":\"%s\",\"rtt_us\":%lu,\"age\":%ld,\"history\":[",
+         host, (unsigned long)rttUs,
+         (age == RTCEMUL_SYNC_AGE_NEVER) ? -1L : (long)age);
+  NTP_SYNC_RECORD history[RTCEMUL_SYNC_HISTORY];
+  int count = rtc_getSyncHistory(history, RTCEMUL_SYNC_HISTORY);
+  for (int i = 0; i < count; i++) {
+    // Boot seconds, round trip, offset corrected and drift
+    append("%s[%lu,%lu,%ld,%ld]", (i > 0) ? "," : "",
+           (unsigned long)history[i].bootSecs,
+           (unsigned long)history[i].rttUs, (long)history[i].offsetUs,
+           (long)history[i].driftPpb);
+  }
+  append("]},");
+}
+
+static void buildSnapshot(bool radioOn) {
+  snapshotLen = 0;
+  append("{\"fw\":\"%s\",\"settings\":%d,\"uptime\":%lu,", RELEASE_VERSION,
+         ACONFIG_VERSION_NUMBER, (unsigned long)(time_us_64() / 1000000ULL));
+  appendBus();
+  appendBoot();
+  appendSync();
+  int32_t rssi = 0;
+  if (!radioOn || (network_getRssi(&rssi) != 0)) {
+    rssi = 0;
+  }
+  append("\"rssi\":%ld}", (long)rssi);
+}
+
+static void fleetRecvCB(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                        const ip_addr_t *addr, u16_t port) {
+  // The content of the request does not matter
+  if (p != NULL) {
+    pbuf_free(p);
+  }
+  if (requestPending) {
+    return;  // One request at a time
+  }
+  ip_addr_copy(requestAddr, *addr);
+  requestPort = port;
+  requestPending = true;
+}
+
+int fleet_start(uint16_t port) {
+  if (fleetPcb != NULL) {
+    return 0;
+  }
+  cyw43_arch_lwip_begin();
+  fleetPcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+  if (fleetPcb == NULL) {
+    cyw43_arch_lwip_end();
+    DPRINTF("Failed to allocate the fleet control block.\n");
+    return -1;
+  }
+  err_t err = udp_bind(fleetPcb, IP_ANY_TYPE, port);
+  if (err != ERR_OK) {
+    udp_remove(fleetPcb);
+    fleetPcb = NULL;
+    cyw43_arch_lwip_end();
+    DPRINTF("Cannot listen on the fleet port: %s\n", lwip_strerr(err));
+    return -1;
+  }
+  udp_recv(fleetPcb, fleetRecvCB, NULL);
+  cyw43_arch_lwip_end();
+  nextAnswer = get_absolute_time();
+  DPRINTF("Fleet telemetry listening on port %u\n", port);
+  return 0;
+}
+
+void fleet_poll(bool radioOn) {
+  if (!requestPending) {
+    return;
+  }
+  if (!radioOn || !time_reached(nextAnswer)) {
+    requestPending = false;  // Dropped, the collector asks again
+    return;
+  }
+  nextAnswer = make_timeout_time_ms(FLEET_MIN_INTERVAL_MS);
+  buildSnapshot(radioOn);
+
+  cyw43_arch_lwip_begin();
+  struct pbuf *answer =
+      pbuf_alloc(PBUF_TRANSPORT, (u16_t)snapshotLen, PBUF_RAM);
+  if (answer == NULL) {
+    DPRINTF("Failed to allocate pbuf for the fleet snapshot.\n");
+  } else {
+    memcpy(answer->payload, snapshot, snapshotLen);
+    err_t err = udp_sendto(fleetPcb, answer, &requestAddr, requestPort);
+    if (err != ERR_OK) {
+      DPRINTF("Failed to send the fleet snapshot: %s\n", lwip_strerr(err));
+    }
+    pbuf_free(answer);
+  }
+  cyw43_arch_lwip_end();
+  requestPending = false;
+}
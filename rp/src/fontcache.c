@@ -0,0 +1,111 @@
+/**
+ * File: fontcache.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: RAM copies of the u8g2 fonts in use
+ */
+
+#include "fontcache.h"
+
+// Layout of the u8g2 fonts, see u8g2_font.c
+#define FONTCACHE_HEADER_SIZE 23
+#define FONTCACHE_UNICODE_POS 21
+#define FONTCACHE_LAST_ENCODING 0xFFFF
+
+typedef struct {
+  const uint8_t *font;  // The font in the flash
+  uint8_t *data;        // Its copy in the arena
+  size_t size;
+  uint32_t lastUse;
+} FontCacheSlot;
+
+// The slots keep the order of their data in the arena, packed from the start
+static uint8_t __attribute__((aligned(4))) arena[FONTCACHE_ARENA_SIZE];
+static FontCacheSlot slots[FONTCACHE_SLOTS];
+static int numSlots = 0;
+static size_t arenaUsed = 0;
+static uint32_t useCount = 0;
+
+static inline uint16_t readWord(const uint8_t *data) {
+  return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+// After the glyphs up to 255 come the lookup table of the unicode glyphs,
+// ended by the last encoding, and the unicode glyphs, ended by a zero
+// encoding
+static size_t fontSize(const uint8_t *font) {
+  const uint8_t *table = font + FONTCACHE_HEADER_SIZE +
+                         readWord(font + FONTCACHE_UNICODE_POS);
+  const uint8_t *glyph = table;
+  uint16_t encoding;
+  do {
+    glyph += readWord(table);
+    encoding = readWord(table + 2);
+    table += 4;
+  } while (encoding != FONTCACHE_LAST_ENCODING);
+  while (readWord(glyph) != 0) {
+    glyph += glyph[2];
+  }
+  return (size_t)(glyph + 2 - font);
+}
+
+// Remove a font and move the next ones down to keep the arena packed
+static void evict(int index) {
+  size_t size = slots[index].size;
+  uint8_t *end = slots[index].data + size;
+  memmove(slots[index].data, end, (size_t)((arena + arenaUsed) - end));
+  for (int i = index; i < numSlots - 1; i++) {
+    slots[i] = slots[i + 1];
+    slots[i].data -= size;
+  }
+  numSlots--;
+  arenaUsed -= size;
+}
+
+static int leastRecentlyUsed(void) {
+  int oldest = 0;
+  for (int i = 1; i < numSlots; i++) {
+    if (slots[i].lastUse < slots[oldest].lastUse) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+void fontcache_setFont(u8g2_t *u8g2, const uint8_t *font) {
+  useCount++;
+  for (int i = 0; i < numSlots; i++) {
+    if (slots[i].font == font) {
+      slots[i].lastUse = useCount;
+      u8g2_SetFont(u8g2, slots[i].data);
+      return;
+    }
+  }
+
+  size_t size = fontSize(font);
+  if (size > FONTCACHE_ARENA_SIZE) {
+    DPRINTF("Font of %u bytes does not fit in the cache\n",
+            (unsigned int)size);
+    u8g2_SetFont(u8g2, font);
+    return;
+  }
+  // The font in use is replaced, so any copy can move or go
+  while ((numSlots == FONTCACHE_SLOTS) ||
+         (arenaUsed + size > FONTCACHE_ARENA_SIZE)) {
+    evict(leastRecentlyUsed());
+  }
+  FontCacheSlot *slot = &slots[numSlots++];
+  slot->font = font;
+  slot->data = arena + arenaUsed;
+  slot->size = size;
+  slot->lastUse = useCount;
+  memcpy(slot->data, font, size);
+  arenaUsed += size;
+  DPRINTF("Font of %u bytes copied to RAM. %u bytes of the cache used\n",
+          (unsigned int)size, (unsigned int)arenaUsed);
+
+  // The copy can be where a moved font was: make u8g2 read the font again
+  u8g2->font = NULL;
+  u8g2_SetFont(u8g2, slot->data);
+}
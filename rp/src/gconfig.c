@@ -1,27 +1,9 @@
 #include "include/gconfig.h"
 
+#define GCONFIG_DEFAULT_ENTRY(id, type, value) {PARAM_##id, type, value},
+
 static SettingsConfigEntry defaultEntries[] = {
-    {PARAM_APPS_FOLDER, SETTINGS_TYPE_STRING, "/apps"},
-    {PARAM_APPS_CATALOG_URL, SETTINGS_TYPE_STRING,
-     "http://atarist.sidecartridge.com/apps.json"},
-    {PARAM_BOOT_FEATURE, SETTINGS_TYPE_STRING, "CONFIGURATOR"},
-    {PARAM_HOSTNAME, SETTINGS_TYPE_STRING, "sidecart"},
-    {PARAM_SAFE_CONFIG_REBOOT, SETTINGS_TYPE_BOOL, "true"},
-    {PARAM_SD_BAUD_RATE_KB, SETTINGS_TYPE_INT, "12500"},
-    {PARAM_WIFI_AUTH, SETTINGS_TYPE_INT, "0"},
-    {PARAM_WIFI_CONNECT_TIMEOUT, SETTINGS_TYPE_INT, "30"},
-    {PARAM_WIFI_COUNTRY, SETTINGS_TYPE_STRING, "XX"},
-    {PARAM_WIFI_DHCP, SETTINGS_TYPE_BOOL, "true"},
-    {PARAM_WIFI_DNS, SETTINGS_TYPE_STRING, "8.8.8.8"},
-    {PARAM_WIFI_GATEWAY, SETTINGS_TYPE_STRING, ""},
-    {PARAM_WIFI_IP, SETTINGS_TYPE_STRING, ""},
-    {PARAM_WIFI_MODE, SETTINGS_TYPE_INT, "0"},
-    {PARAM_WIFI_NETMASK, SETTINGS_TYPE_STRING, ""},
-    {PARAM_WIFI_PASSWORD, SETTINGS_TYPE_STRING, ""},
-    {PARAM_WIFI_POWER, SETTINGS_TYPE_INT, "0"},
-    {PARAM_WIFI_RSSI, SETTINGS_TYPE_BOOL, "true"},
-    {PARAM_WIFI_SCAN_SECONDS, SETTINGS_TYPE_INT, "10"},
-    {PARAM_WIFI_SSID, SETTINGS_TYPE_STRING, ""}};
+    GCONFIG_DEFAULT_ENTRIES(GCONFIG_DEFAULT_ENTRY)};
 
 enum {
   CONFIG_BUFFER_SIZE = 4096,
@@ -32,6 +14,13 @@ enum {
 // Create a global context for our settings
 static SettingsContext gSettingsCtx;
 
+// The entries in memory. Static, sized from the defaults
+static SettingsConfigEntry entriesArena[SETTINGS_ARENA_ENTRIES(
+    GCONFIG_KEY_COUNT)] SETTINGS_ARENA;
+
+// The stored entries keep the order of the defaults: index them directly
+static bool keysInOrder = false;
+
 /**
  * @brief Initializes the global configuration settings.
  *
@@ -49,13 +38,12 @@ static SettingsContext gSettingsCtx;
 int gconfig_init(const char *currentAppName) {
   DPRINTF("Initializing settings\n");
 
-  // If we know the number of default entries in advance, we can use it
-  // uint16_t entriesCount = sizeof(defaultEntries) / sizeof(defaultEntries[0]);
-
-  // If we don't know the number of default entries in advance, we can use the
-  // max value of entries in the flash.
-  uint16_t entriesCount = CONFIG_BUFFER_SIZE / sizeof(SettingsConfigEntry);
+  // The stored entries are read up to the size of the flash region, even if
+  // there are more than the defaults
+  uint16_t entriesCount = GCONFIG_KEY_COUNT;
 
+  settings_setArena(&gSettingsCtx, entriesArena,
+                    sizeof(entriesArena) / sizeof(entriesArena[0]));
   int err = settings_init(&gSettingsCtx, defaultEntries, entriesCount,
                           (unsigned int)&_global_config_flash_start - XIP_BASE,
                           CONFIG_BUFFER_SIZE, CONFIG_MAGIC_NUMBER,
@@ -68,14 +56,25 @@ int gconfig_init(const char *currentAppName) {
     return GCONFIG_INIT_ERROR;
   }
 
+  keysInOrder = true;
+  for (size_t i = 0; i < GCONFIG_KEY_COUNT; i++) {
+    SettingsConfigEntry *entry =
+        settings_get_entry(&gSettingsCtx, SETTINGS_FIRST_ENTRY + i);
+    if ((entry == NULL) || (strncmp(entry->key, defaultEntries[i].key,
+                                    SETTINGS_MAX_KEY_LENGTH) != 0)) {
+      DPRINTF("Entry %zu out of order. Using the key lookup.\n", i);
+      keysInOrder = false;
+      break;
+    }
+  }
+
   // If the current app as argument is not null, check if the current app is the
   // same as the one in the settings Otherwise, ignore and continue
   if (currentAppName != NULL) {
     // If we are here, it means that the settings were initialized correctly
     // We now must read the flash address of the configuration settings of the
     // current application
-    SettingsConfigEntry *entry =
-        settings_find_entry(&gSettingsCtx, PARAM_BOOT_FEATURE);
+    SettingsConfigEntry *entry = gconfig_getEntry(GCONFIG_KEY_BOOT_FEATURE);
     if ((entry == NULL) || (entry->value == NULL) ||
         (strcmp(currentAppName, entry->value) != 0)) {
       // If the entry is found but the content is empty, or not equal to the
@@ -105,4 +104,47 @@ int gconfig_init(const char *currentAppName) {
  *
  * @return SettingsContext* Pointer to the global settings context.
  */
-SettingsContext *gconfig_getContext(void) { return &gSettingsCtx; }
\ No newline at end of file
+SettingsContext *gconfig_getContext(void) { return &gSettingsCtx; }
+
+/**
+ * @brief Returns an entry of the global settings in constant time.
+ *
+ * The entries keep the order of GCONFIG_DEFAULT_ENTRIES, so the key is a
+ * direct index. Falls back to the hash lookup if the stored order differs.
+ *
+ * @param key Index of the entry.
+ * @return SettingsConfigEntry* The entry, or NULL if not found.
+ */
+SettingsConfigEntry *gconfig_getEntry(GconfigKey key) {
+  if ((unsigned)key >= GCONFIG_KEY_COUNT) {
+    return NULL;
+  }
+  if (keysInOrder) {
+    return settings_get_entry(&gSettingsCtx, SETTINGS_FIRST_ENTRY + key);
+  }
+  return settings_find_entry(&gSettingsCtx, defaultEntries[key].key);
+}
+
+// Position of the entry in the settings context. SIZE_MAX if not found
+static size_t entryIndex(GconfigKey key) {
+  if ((unsigned)key >= GCONFIG_KEY_COUNT) {
+    return SIZE_MAX;
+  }
+  if (keysInOrder) {
+    return SETTINGS_FIRST_ENTRY + key;
+  }
+  SettingsConfigEntry *entry = gconfig_getEntry(key);
+  return entry ? (size_t)(entry - gSettingsCtx.configData.entries) : SIZE_MAX;
+}
+
+int gconfig_getInt(GconfigKey key, int defaultValue) {
+  return settings_get_int(&gSettingsCtx, entryIndex(key), defaultValue);
+}
+
+bool gconfig_getBool(GconfigKey key, bool defaultValue) {
+  return settings_get_bool(&gSettingsCtx, entryIndex(key), defaultValue);
+}
+
+const char *gconfig_getString(GconfigKey key, const char *defaultValue) {
+  return settings_get_string(&gSettingsCtx, entryIndex(key), defaultValue);
+}
@@ -11,19 +11,127 @@
 
 #include "constants.h"
 #include "debug.h"
+#include "pico/flash.h"
 #include "settings.h"
 
 #define ACONFIG_PARAM_MODE "MODE"
 #define ACONFIG_PARAM_RTC_NTP_SERVER_HOST "NTP_SERVER_HOST"
 #define ACONFIG_PARAM_RTC_NTP_SERVER_PORT "NTP_SERVER_PORT"
+#define ACONFIG_PARAM_RTC_NTP_FALLBACK_HOSTS "NTP_FALLBACK_HOSTS"
+#define ACONFIG_PARAM_RTC_NTP_CACHE_IP "NTP_CACHE_IP"
+#define ACONFIG_PARAM_RTC_NTP_CACHE_TTL "NTP_CACHE_TTL"
+#define ACONFIG_PARAM_RTC_NTP_CACHE_TIME "NTP_CACHE_TIME"
+#define ACONFIG_PARAM_RTC_CHECKPOINT "CLOCK_CHECKPOINT"
+#define ACONFIG_PARAM_RTC_HTTP_TIME_HOST "HTTP_TIME_HOST"
+#define ACONFIG_PARAM_WIFI_CACHE_BSSID "WIFI_CACHE_BSSID"
+#define ACONFIG_PARAM_WIFI_CACHE_CHANNEL "WIFI_CACHE_CHANNEL"
+#define ACONFIG_PARAM_WIFI_CACHE_IP "WIFI_CACHE_IP"
+#define ACONFIG_PARAM_WIFI_CACHE_NETMASK "WIFI_CACHE_NETMASK"
+#define ACONFIG_PARAM_WIFI_CACHE_GATEWAY "WIFI_CACHE_GATEWAY"
+#define ACONFIG_PARAM_WIFI_CACHE_DNS "WIFI_CACHE_DNS"
+#define ACONFIG_PARAM_WIFI_CACHE_LEASE_EXPIRY "WIFI_CACHE_LEASE_EXPIRY"
+#define ACONFIG_PARAM_RTC_RADIO_POWER "RADIO_POWER"
 #define ACONFIG_PARAM_RTC_TYPE "TYPE"
 #define ACONFIG_PARAM_RTC_UTC_OFFSET "UTC_OFFSET"
 #define ACONFIG_PARAM_RTC_Y2K_PATCH "Y2K_PATCH"
+#define ACONFIG_PARAM_RTC_DISCIPLINE "DISCIPLINE"
+#define ACONFIG_PARAM_RTC_GEMDOS_HOOK "GEMDOS_HOOK"
+#define ACONFIG_PARAM_RTC_TIME_MASTER "TIME_MASTER"
+#define ACONFIG_PARAM_FLEET_PORT "FLEET_PORT"
+#define ACONFIG_PARAM_BUS_WAIT_CYCLES "BUS_WAIT_CYCLES"
+#define ACONFIG_PARAM_BUS_CLOCK_DIV "BUS_CLOCK_DIV"
+#define ACONFIG_PARAM_CLOCK_PROFILE "CLOCK_PROFILE"
+#define ACONFIG_PARAM_OTA_URL "OTA_URL"
+#define ACONFIG_PARAM_OTA_SHA256 "OTA_SHA256"
+#define ACONFIG_PARAM_TERM_MIRROR_PORT "TERM_MIRROR_PORT"
+#define ACONFIG_PARAM_TERM_MIRROR_PASSWORD "TERM_MIRROR_PASSWORD"
+
+// Default entries of the app settings, in flash order. ENTRY(id, type, value)
+// uses the key ACONFIG_PARAM_<id> and gives it the index ACONFIG_KEY_<id>
+#define ACONFIG_DEFAULT_ENTRIES(ENTRY)                                         \
+  /* 255: Menu mode */                                                         \
+  ENTRY(MODE, SETTINGS_TYPE_INT, "255")                                        \
+  /* NTP server host */                                                        \
+  ENTRY(RTC_NTP_SERVER_HOST, SETTINGS_TYPE_STRING, "pool.ntp.org")             \
+  /* NTP server port */                                                        \
+  ENTRY(RTC_NTP_SERVER_PORT, SETTINGS_TYPE_INT, "123")                         \
+  /* Comma separated */                                                        \
+  ENTRY(RTC_NTP_FALLBACK_HOSTS, SETTINGS_TYPE_STRING,                          \
+        "0.pool.ntp.org,1.pool.ntp.org,2.pool.ntp.org")                        \
+  /* Last resolved NTP server address */                                       \
+  ENTRY(RTC_NTP_CACHE_IP, SETTINGS_TYPE_STRING, "")                            \
+  /* Seconds the cached address is valid */                                    \
+  ENTRY(RTC_NTP_CACHE_TTL, SETTINGS_TYPE_INT, "86400")                         \
+  /* When the cached address was resolved. Seconds since 1970 */               \
+  ENTRY(RTC_NTP_CACHE_TIME, SETTINGS_TYPE_INT, "0")                            \
+  /* Last known time for cold boots. Seconds since 1970 */                     \
+  ENTRY(RTC_CHECKPOINT, SETTINGS_TYPE_INT, "0")                                \
+  /* HTTP server for the Date header. Empty to disable */                      \
+  ENTRY(RTC_HTTP_TIME_HOST, SETTINGS_TYPE_STRING, "www.google.com")            \
+  /* Last access point joined. Empty to scan */                                \
+  ENTRY(WIFI_CACHE_BSSID, SETTINGS_TYPE_STRING, "")                            \
+  /* Channel of the last access point */                                       \
+  ENTRY(WIFI_CACHE_CHANNEL, SETTINGS_TYPE_INT, "0")                            \
+  /* Last DHCP address */                                                      \
+  ENTRY(WIFI_CACHE_IP, SETTINGS_TYPE_STRING, "")                               \
+  /* Last DHCP netmask */                                                      \
+  ENTRY(WIFI_CACHE_NETMASK, SETTINGS_TYPE_STRING, "")                          \
+  /* Last DHCP gateway */                                                      \
+  ENTRY(WIFI_CACHE_GATEWAY, SETTINGS_TYPE_STRING, "")                          \
+  /* Last DHCP DNS server */                                                   \
+  ENTRY(WIFI_CACHE_DNS, SETTINGS_TYPE_STRING, "")                              \
+  /* When the last DHCP lease expires. Seconds since 1970 */                   \
+  ENTRY(WIFI_CACHE_LEASE_EXPIRY, SETTINGS_TYPE_INT, "0")                       \
+  /* Between resyncs. 0: always on, 1: power save, 2: off */                   \
+  ENTRY(RTC_RADIO_POWER, SETTINGS_TYPE_INT, "0")                               \
+  /* RTC type */                                                               \
+  ENTRY(RTC_TYPE, SETTINGS_TYPE_STRING, "SIDECART")                            \
+  /* UTC offset */                                                             \
+  ENTRY(RTC_UTC_OFFSET, SETTINGS_TYPE_STRING, "0")                             \
+  /* Y2K patch */                                                              \
+  ENTRY(RTC_Y2K_PATCH, SETTINGS_TYPE_BOOL, "true")                             \
+  /* Calibrated waits of the bus. -1: not calibrated */                        \
+  ENTRY(BUS_WAIT_CYCLES, SETTINGS_TYPE_INT, "-1")                              \
+  /* Calibrated clock divider of the bus */                                    \
+  ENTRY(BUS_CLOCK_DIV, SETTINGS_TYPE_STRING, "1.0")                            \
+  /* Clock and voltage profile: SAFE, STABLE or FAST */                        \
+  ENTRY(CLOCK_PROFILE, SETTINGS_TYPE_STRING, "SAFE")                           \
+  /* Correct the clock of the computer without the Y2K patch */                \
+  ENTRY(RTC_DISCIPLINE, SETTINGS_TYPE_BOOL, "false")                           \
+  /* Answer Tgettime and Tgetdate from the cartridge */                        \
+  ENTRY(RTC_GEMDOS_HOOK, SETTINGS_TYPE_BOOL, "false")                          \
+  /* Answer the NTP queries of the other devices in the network */             \
+  ENTRY(RTC_TIME_MASTER, SETTINGS_TYPE_BOOL, "false")                          \
+  /* UDP port of the fleet telemetry. 0 to disable */                          \
+  ENTRY(FLEET_PORT, SETTINGS_TYPE_INT, "0")                                    \
+  /* http:// URL of the .bin image of the app for the ota command */           \
+  ENTRY(OTA_URL, SETTINGS_TYPE_STRING, "")                                     \
+  /* SHA-256 of the image, 64 hexadecimal digits */                            \
+  ENTRY(OTA_SHA256, SETTINGS_TYPE_STRING, "")                                  \
+  /* TCP port of the Telnet mirror of the terminal. 0 to disable. Without */   \
+  /* TERM_MIRROR_PASSWORD anybody in the network can watch it, but cannot */   \
+  /* type. With it, the client must type it to watch and type */               \
+  ENTRY(TERM_MIRROR_PORT, SETTINGS_TYPE_INT, "0")                              \
+  /* Password to type in the terminal from the mirror. Empty: view only */     \
+  ENTRY(TERM_MIRROR_PASSWORD, SETTINGS_TYPE_STRING, "")
+
+#define ACONFIG_KEY_ID(id, type, value) ACONFIG_KEY_##id,
+
+// Index of each default entry, for aconfig_getEntry()
+typedef enum {
+  ACONFIG_DEFAULT_ENTRIES(ACONFIG_KEY_ID) ACONFIG_KEY_COUNT
+} AconfigKey;
 
 #define ACONFIG_SUCCESS 0
 #define ACONFIG_INIT_ERROR -1
 #define ACONFIG_MISMATCHED_APP -2
 #define ACONFIG_APPKEYLOOKUP_ERROR -3
+#define ACONFIG_SAVE_ERROR -4
+
+// Changes are written after this time without new changes
+#define ACONFIG_SAVE_QUIET_MS 2000
+// Maximum time to wait for core 1 to leave the flash
+#define ACONFIG_SAVE_LOCKOUT_MS 100
 
 #define LEFT_SHIFT_EIGHT_BITS 8
 
@@ -74,4 +182,86 @@ int aconfig_init(const char *currentAppId);
  */
 SettingsContext *aconfig_getContext(void);
 
+/**
+ * @brief Returns an entry of the app settings in constant time.
+ *
+ * The entries keep the order of ACONFIG_DEFAULT_ENTRIES, so the key is a
+ * direct index. Falls back to the hash lookup if the stored order differs.
+ *
+ * @param key Index of the entry.
+ * @return SettingsConfigEntry* The entry, or NULL if not found.
+ */
+SettingsConfigEntry *aconfig_getEntry(AconfigKey key);
+
+/**
+ * @brief Returns the value of an entry of the app settings as an integer.
+ *
+ * The value is parsed when loaded or updated, not on each call.
+ *
+ * @param key Index of the entry.
+ * @param defaultValue Value returned if the entry is not found.
+ * @return int The value parsed like atoi().
+ */
+int aconfig_getInt(AconfigKey key, int defaultValue);
+
+/**
+ * @brief Returns the value of an entry of the app settings as a boolean.
+ *
+ * The value is parsed when loaded or updated, not on each call.
+ *
+ * @param key Index of the entry.
+ * @param defaultValue Value returned if the entry is not found.
+ * @return bool True if it starts with 't', 'T', 'y', 'Y' or '1'.
+ */
+bool aconfig_getBool(AconfigKey key, bool defaultValue);
+
+/**
+ * @brief Returns the value of an entry of the app settings as a double.
+ *
+ * The value is parsed when loaded or updated, not on each call.
+ *
+ * @param key Index of the entry.
+ * @param defaultValue Value returned if the entry is not found.
+ * @return double The value, or defaultValue if it is not a number.
+ */
+double aconfig_getDouble(AconfigKey key, double defaultValue);
+
+/**
+ * @brief Returns the value of an entry of the app settings as a string.
+ *
+ * The value is parsed when loaded or updated, not on each call.
+ *
+ * @param key Index of the entry.
+ * @param defaultValue Value returned if the entry is not found.
+ * @return const char* The value. Valid until the settings are reloaded.
+ */
+const char *aconfig_getString(AconfigKey key, const char *defaultValue);
+
+/**
+ * @brief Schedules a write of the settings to the flash.
+ *
+ * Marks the settings as changed. The changes of several calls are written
+ * together by aconfig_poll() after ACONFIG_SAVE_QUIET_MS without new changes,
+ * or at once by aconfig_flush().
+ */
+void aconfig_requestSave(void);
+
+/**
+ * @brief Writes the pending changes of the settings to the flash.
+ *
+ * The write runs in flash_safe_execute(), with core 1 parked in RAM. Call it
+ * before leaving the app: reset, Booster jump or emulation start.
+ *
+ * @return int ACONFIG_SUCCESS if there is nothing pending or the write
+ * succeeds, ACONFIG_SAVE_ERROR otherwise. The changes stay pending on error.
+ */
+int aconfig_flush(void);
+
+/**
+ * @brief Writes the pending changes once the quiet period has elapsed.
+ *
+ * Call it from the main loop.
+ */
+void aconfig_poll(void);
+
 #endif  // ACONFIG_H
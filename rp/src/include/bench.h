@@ -0,0 +1,58 @@
+/**
+ * File: bench.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Microbenchmarks of the core code, run in the device
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#include "aconfig.h"
+#include "bustrace.h"
+#include "constants.h"
+#include "debug.h"
+#include "pico/stdlib.h"
+
+#define BENCH_PARSER_FRAMES 2000     // Frames parsed by bench_parser
+#define BENCH_PARSER_PAYLOAD 16      // Bytes of payload of each frame
+#define BENCH_SETTINGS_LOOKUPS 2000  // Lookups done by bench_settings
+#define BENCH_SCROLL_LINES 200       // Lines scrolled by the terminal bench
+
+/**
+ * @brief Measures the protocol parser.
+ *
+ * Feeds synthetic frames to a private copy of the parser, without queue, so
+ * the commands of the computer are not disturbed.
+ *
+ * @param frames Where to store the frames parsed with a good checksum.
+ * @return Nanoseconds per word parsed.
+ */
+uint32_t bench_parser(uint32_t *frames);
+
+/**
+ * @brief Replays the bus capture through the protocol parser at full speed.
+ *
+ * Only the ROM3 accesses reach the parser, like in the interrupt handlers.
+ * The pauses of the capture are not replayed, so the parser never restarts
+ * by timeout.
+ *
+ * @param frames Where to store the frames parsed with a good checksum.
+ * @param errors Where to store the frames with a wrong checksum.
+ * @return Nanoseconds per ROM3 word parsed, or 0 if there are none.
+ */
+uint32_t bench_replay(uint32_t *frames, uint32_t *errors);
+
+/**
+ * @brief Measures the lookup of a setting by its key.
+ *
+ * Looks up the last entry of the application settings.
+ *
+ * @return Nanoseconds per lookup, or 0 if there are no settings.
+ */
+uint32_t bench_settings(void);
+
+#endif  // BENCH_H
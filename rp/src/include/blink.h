@@ -25,26 +25,58 @@
 #define SYMBOL_GAP_MS 150
 #define CHARACTER_GAP_MS 700
 
+// Steps of the pattern player: two per Morse symbol, the on and the gap
+#ifndef BLINK_PATTERN_MAX_STEPS
+#define BLINK_PATTERN_MAX_STEPS 32
+#endif
+
 typedef struct {
   char character;
   const char *morse;
 } MorseCode;
 
 /**
- * @brief   Blinks an LED to represent a given character in Morse code.
+ * @brief Starts to blink a text in Morse code without blocking.
+ *
+ * The pattern is built from the Morse alphabet and played by blink_poll().
+ * The characters not in the alphabet are ignored, and the text is cut when
+ * it does not fit in BLINK_PATTERN_MAX_STEPS. A new call replaces the
+ * pattern being played.
  *
- * @param   chr  The character to blink in Morse code.
+ * @param text The characters to blink.
+ * @param repeat true to play the pattern until blink_stop().
+ */
+void blink_play(const char *text, bool repeat);
+
+/**
+ * @brief Stops the pattern being played and turns off the LED.
+ */
+void blink_stop();
+
+/**
+ * @brief Tells if a pattern is being played.
+ *
+ * @return true until the pattern ends. Always true for a repeated pattern
+ * until blink_stop().
+ */
+bool blink_isPlaying();
+
+/**
+ * @brief Advances the pattern being played. Never blocks.
+ *
+ * Call it from the loops. The LED of the CYW43 is driven over the bus of the
+ * chip, so it cannot be driven from an interrupt.
+ */
+void blink_poll();
+
+/**
+ * @brief Blinks an LED to represent a given character in Morse code.
  *
- * @details This function searches for the provided character in the
- *          `morseAlphabet` structure array to get its Morse code
- * representation. If found, it then blinks an LED in the pattern of dots and
- * dashes corresponding to the Morse code of the character. The LED blinks are
- *          separated by time intervals defined by constants such as
- * DOT_DURATION_MS, DASH_DURATION_MS, SYMBOL_GAP_MS, and CHARACTER_GAP_MS.
+ * Blocks until the character is played. Use blink_play() from the loops.
  *
- * @return  void
+ * @param chr The character to blink in Morse code.
  */
-void blink_morse(char ch);
+void blink_morse(char chr);
 
 /**
  * @brief Flashes the letter 'E' in Morse code to indicate an error.
@@ -0,0 +1,106 @@
+/**
+ * File: boottime.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Timing of the boot phases of the last boots
+ */
+
+#ifndef BOOTTIME_H
+#define BOOTTIME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "constants.h"
+#include "debug.h"
+#include "pico/stdlib.h"
+
+// Boots kept in the history, the current one included
+#ifndef BOOTTIME_HISTORY
+#define BOOTTIME_HISTORY 4
+#endif
+
+#define BOOTTIME_MAGIC 0x424F4F54  // "BOOT"
+
+typedef enum {
+  BOOT_PHASE_CONFIG = 0,     // gconfig_init and aconfig_init
+  BOOT_PHASE_FIRMWARE_COPY,  // Copy or decompress the terminal firmware
+  BOOT_PHASE_ROMEMUL,        // init_romemul
+  BOOT_PHASE_DISPLAY,        // display_setupU8g2
+  BOOT_PHASE_WIFI_INIT,      // network_wifiInit
+  BOOT_PHASE_WIFI_CONNECT,   // All the network_wifiStaConnect attempts
+  BOOT_PHASE_DHCP,           // From the link up to the address
+  BOOT_PHASE_DNS,            // First NTP server resolved
+  BOOT_PHASE_NTP,            // First NTP request to the first answer
+  BOOT_PHASE_DESKTOP,        // DISPLAY_COMMAND_START, since the power up
+  BOOT_PHASES
+} BootPhase;
+
+// Microseconds since the power up
+typedef struct {
+  uint32_t start_us;
+  uint32_t end_us;
+  uint16_t count;  // Times the phase started
+  bool done;
+} BootPhaseTime;
+
+typedef struct {
+  BootPhaseTime phases[BOOT_PHASES];
+  bool closed;  // The desktop was launched. No more WiFi attempts count
+} BootRecord;
+
+/**
+ * @brief Starts the record of this boot in the history.
+ *
+ * Call it first in main(). The history lives in RAM not initialized by the
+ * runtime, so it survives the resets but not the power cycles.
+ */
+void boottime_init(void);
+
+/**
+ * @brief Marks the start of a boot phase.
+ *
+ * Only the first run of a phase is recorded, except the WiFi connection
+ * that spans all the attempts until the desktop is launched.
+ *
+ * @param phase The boot phase.
+ */
+void boottime_begin(BootPhase phase);
+
+/**
+ * @brief Marks the end of a boot phase.
+ *
+ * A phase that never started is measured since the power up.
+ *
+ * @param phase The boot phase.
+ */
+void boottime_end(BootPhase phase);
+
+/**
+ * @brief Returns a boot of the history.
+ *
+ * @param age 0 for the current boot, 1 for the previous one and so on.
+ * @return The record of the boot, or NULL if it is not in the history.
+ */
+const BootRecord *boottime_getRecord(int age);
+
+/**
+ * @brief Returns the short name of a boot phase.
+ *
+ * @param phase The boot phase.
+ * @return The name, at most 10 characters.
+ */
+const char *boottime_getPhaseName(BootPhase phase);
+
+/**
+ * @brief Returns the duration of a boot phase in milliseconds.
+ *
+ * @param phase The time of the phase.
+ * @return The milliseconds, or -1 if the phase did not finish.
+ */
+int32_t boottime_getPhaseMs(const BootPhaseTime *phase);
+
+#endif  // BOOTTIME_H
@@ -0,0 +1,102 @@
+/**
+ * File: buscal.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Calibration of the timing of the cartridge bus
+ */
+
+#ifndef BUSCAL_H
+#define BUSCAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "aconfig.h"
+#include "constants.h"
+#include "debug.h"
+#include "memfunc.h"
+#include "pico/stdlib.h"
+#include "romemul.h"
+
+// Area of the shared memory used by the calibration. Must match main.s
+#define BUSCAL_OFFSET 0xE000
+#define BUSCAL_STATE_OFFSET (BUSCAL_OFFSET)       // What the computer must do
+#define BUSCAL_ROUND_OFFSET (BUSCAL_OFFSET + 4)   // Candidate under test
+#define BUSCAL_PATTERN_OFFSET (BUSCAL_OFFSET + 0x10)
+#define BUSCAL_PATTERN_LONGS 256  // Longs read by the computer in each pass
+
+// States for the computer. A corrupted read is unlikely to match any of them
+#define BUSCAL_STATE_IDLE 0
+#define BUSCAL_STATE_TEST 0x54455354    // 'TEST'. Read the pattern
+#define BUSCAL_STATE_REPORT 0x52455054  // 'REPT'. Send the errors
+#define BUSCAL_STATE_DONE 0x444F4E45    // 'DONE'. Back to the terminal
+
+#define BUSCAL_TEST_MS 50    // Time the computer reads each candidate
+#define BUSCAL_SETTLE_MS 50  // Time to go back to the test loop in RAM
+#define BUSCAL_REPORT_TIMEOUT_MS 2000  // Time to wait for the errors
+#define BUSCAL_MIN_PASSES 8  // Passes without errors to accept a candidate
+
+// Clock dividers tested, each one with all the wait cycles
+#define BUSCAL_DIVIDERS {1.0f, 1.25f, 1.5f, 2.0f}
+#define BUSCAL_NUM_DIVIDERS 4
+#define BUSCAL_NUM_WAITS (ROMEMUL_MAX_WAIT_CYCLES + 1)
+#define BUSCAL_CANDIDATES (BUSCAL_NUM_DIVIDERS * BUSCAL_NUM_WAITS)
+
+// PIO cycles of romemul_read from the access to the data in the bus: the
+// fixed instructions and the waits before the data
+#define BUSCAL_FIXED_CYCLES 10
+#define BUSCAL_DATA_WAITS 4
+
+// Round reported by the computer when it enters the test loop
+#define BUSCAL_ROUND_READY 0xFFFFFFFF
+
+typedef struct {
+  uint8_t waitCycles;
+  float divider;
+  uint32_t errors;
+  uint32_t passes;
+  bool tested;
+} BusCalCandidate;
+
+/**
+ * @brief Applies the bus timing saved by the last calibration.
+ *
+ * Call it after init_romemul(). Keeps the default timing if the unit was
+ * never calibrated.
+ */
+void buscal_init(void);
+
+/**
+ * @brief Starts the calibration of the bus timing.
+ *
+ * Asks the computer to run the test loop from its RAM. Each candidate timing
+ * is applied while the computer reads a known pattern from the ROM4, and the
+ * default timing is restored before the computer reports the errors.
+ *
+ * @return 0 if started, -1 if a calibration is already running.
+ */
+int buscal_start(void);
+
+/**
+ * @brief Forgets the calibration and goes back to the default timing.
+ */
+void buscal_reset(void);
+
+/**
+ * @brief Stores the errors reported by the computer for a candidate.
+ *
+ * @param round Candidate tested, or BUSCAL_ROUND_READY.
+ * @param errors Longs read with a wrong value.
+ * @param passes Passes over the whole pattern.
+ */
+void buscal_result(uint32_t round, uint32_t errors, uint32_t passes);
+
+/**
+ * @brief Moves the calibration to the next step when its time is over.
+ *
+ * Call it from the main loop.
+ */
+void buscal_poll(void);
+
+#endif  // BUSCAL_H
@@ -0,0 +1,130 @@
+/**
+ * File: bustrace.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Capture of the raw cartridge bus accesses
+ */
+
+#ifndef BUSTRACE_H
+#define BUSTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "constants.h"
+#include "debug.h"
+#include "hardware/timer.h"
+#include "netpool.h"
+#include "pico/platform.h"
+
+// Capture the bus accesses seen by the DMA interrupt handlers (1) or not (0)
+#ifndef ROMEMUL_BUS_TRACE
+#define ROMEMUL_BUS_TRACE 0
+#endif
+
+// Accesses kept in each capture. More if the pbuf pool of lwIP is lent
+#ifndef BUSTRACE_RECORDS
+#define BUSTRACE_RECORDS 2048
+#endif
+
+#define BUSTRACE_ROM3_BIT 0x00010000   // Set for ROM3, clear for ROM4
+#define BUSTRACE_WORD_MASK 0x0001FFFF  // ROM3/ROM4 bit and the address lines
+
+// Records exported to the USB telemetry in each pass of the main loop
+#define BUSTRACE_EXPORT_BATCH 32
+
+typedef struct {
+  uint32_t timestamp;  // Microseconds since boot, lower 32 bits
+  uint32_t word;       // The raw 17 bit word of the lookup DMA
+} BusTraceRecord;
+
+// The capture stops when the buffer is full, so it keeps the accesses after
+// it was armed: the boot of the computer, a scan of the cartridge...
+typedef struct {
+  volatile bool armed;
+  volatile uint32_t count;
+  uint32_t capacity;        // Records that fit in the buffer
+  BusTraceRecord *records;  // Static buffer, or the arena of netpool
+} BusTrace;
+
+#if ROMEMUL_BUS_TRACE == 1
+extern BusTrace busTrace;
+
+/**
+ * @brief Stores a bus access if the capture is armed.
+ *
+ * Call it from the DMA interrupt handler with the address read by the lookup
+ * DMA. Only one core must call it.
+ *
+ * @param addr The address read by the lookup DMA.
+ */
+static inline __attribute__((always_inline)) void __not_in_flash_func(
+    bustrace_record)(uint32_t addr) {
+  if (__builtin_expect(busTrace.armed, 0)) {
+    uint32_t count = busTrace.count;
+    if (count < busTrace.capacity) {
+      busTrace.records[count].timestamp = timer_hw->timerawl;
+      busTrace.records[count].word = addr & BUSTRACE_WORD_MASK;
+      busTrace.count = count + 1;
+    } else {
+      busTrace.armed = false;
+    }
+  }
+}
+#else
+#define bustrace_record(addr)
+#endif
+
+/**
+ * @brief Clears the capture buffer and starts a new capture.
+ *
+ * The capture uses the pbuf pool of lwIP if the radio is off and the pool
+ * is lent. When the network comes back, the first BUSTRACE_RECORDS
+ * accesses are kept and the capture stops.
+ */
+void bustrace_start(void);
+
+/**
+ * @brief Returns the accesses that fit in the capture buffer.
+ *
+ * @return The records of the buffer in use.
+ */
+uint32_t bustrace_getCapacity(void);
+
+/**
+ * @brief Stops the capture and keeps the accesses captured.
+ */
+void bustrace_stop(void);
+
+/**
+ * @brief Tells if the capture is running.
+ *
+ * @return true until the buffer is full or the capture is stopped.
+ */
+bool bustrace_isArmed(void);
+
+/**
+ * @brief Returns the accesses captured.
+ *
+ * @param count Where to store the number of records.
+ * @return The records, oldest first.
+ */
+const BusTraceRecord *bustrace_getRecords(uint32_t *count);
+
+/**
+ * @brief Starts sending the capture to the USB telemetry channel.
+ *
+ * @return 0 if the export started, -1 if there is no telemetry channel.
+ */
+int bustrace_export(void);
+
+/**
+ * @brief Sends the next records of the export in progress.
+ *
+ * Call it from the main loop. Only sends what fits in the telemetry ring.
+ */
+void bustrace_poll(void);
+
+#endif  // BUSTRACE_H
@@ -0,0 +1,77 @@
+/**
+ * File: clkprof.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Clock and voltage profiles selected in the app settings
+ */
+
+#ifndef CLKPROF_H
+#define CLKPROF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "aconfig.h"
+#include "constants.h"
+#include "debug.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/vreg.h"
+#include "hardware/watchdog.h"
+#include "pico/stdlib.h"
+#include "romemul.h"
+#include "tprotocol.h"
+
+// Profile applied at boot, and whenever a profile fails its self-test
+#define CLKPROF_SAFE_NAME "SAFE"
+
+// Watchdog scratch register that survives the reboot of a failed trial. The
+// SDK only uses the registers 4 to 7
+#define CLKPROF_SCRATCH 3
+#define CLKPROF_TRIAL_MAGIC 0xC10C5E00  // Low byte: profile under trial
+#define CLKPROF_TRIAL_MASK 0xFFFFFF00
+
+// The watchdog reboots the unit if the trial of a profile hangs
+#define CLKPROF_TRIAL_TIMEOUT_MS 2000
+#define CLKPROF_VREG_SETTLE_MS 10  // Time for the regulator to reach the rail
+
+// The self-test copies a pattern from the ROM4 bank to the ROM3 bank with
+// the DMA while the CPU reads it. Both are free before the firmware is loaded
+#define CLKPROF_PATTERN_BYTES 0x8000
+#define CLKPROF_PATTERN_WORDS (CLKPROF_PATTERN_BYTES / sizeof(uint32_t))
+#define CLKPROF_PATTERN_DEST_OFFSET 0x10000
+#define CLKPROF_SELFTEST_ROUNDS 4
+
+// Frames parsed by the loopback test of the protocol
+#define CLKPROF_LOOPBACK_COMMAND 0xFFFE
+#define CLKPROF_LOOPBACK_WORDS 8
+
+typedef struct {
+  const char *name;
+  uint32_t clockKhz;
+  enum vreg_voltage voltage;
+} ClkProfProfile;
+
+/**
+ * @brief Applies the clock profile of the app settings.
+ *
+ * Call it after aconfig_init() and before init_romemul(). main() boots with
+ * the SAFE profile. Any other profile runs a self-test under the watchdog
+ * before it is accepted. If the self-test fails, or the previous boot hung
+ * testing the profile, the SAFE profile is restored and saved.
+ *
+ * @return 0 if the profile of the settings is running, -1 if the SAFE
+ * profile was restored.
+ */
+int clkprof_init(void);
+
+/**
+ * @brief Returns the profile running.
+ *
+ * @return The profile, never NULL.
+ */
+const ClkProfProfile *clkprof_getCurrent(void);
+
+#endif  // CLKPROF_H
@@ -80,12 +80,18 @@
 
 // NOLINTBEGIN(readability-identifier-naming)
 extern unsigned int __flash_binary_start;
+extern unsigned int __flash_binary_end;
 extern unsigned int _rom_temp_start;
 extern unsigned int _booster_app_flash_start;
 extern unsigned int _config_flash_start;
 extern unsigned int _global_lookup_flash_start;
 extern unsigned int _global_config_flash_start;
 extern unsigned int __rom_in_ram_start__;
+extern unsigned int __rom_in_ram_alt_start__;  // Only in the RP2350
+extern unsigned int __settings_arena_start__;
+extern unsigned int __settings_arena_end__;
+extern unsigned int __scratch_x_start__;
+extern unsigned int __scratch_x_end__;
 // NOLINTEND(readability-identifier-naming)
 
 #endif  // CONSTANTS_H
\ No newline at end of file
@@ -0,0 +1,127 @@
+/**
+ * File: dispatch.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Dispatcher of the commands of all the apps
+ */
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bustrace.h"
+#include "constants.h"
+#include "debug.h"
+#include "hardware/dma.h"
+#include "hardware/structs/rosc.h"
+#include "memfunc.h"
+#include "pico/stdlib.h"
+#include "tprotocol.h"
+#include "trace.h"
+
+// The command id of the frames is the app in the high byte and the command
+// of the app in the low byte: APP_xxx << 8 | cmd
+#define DISPATCH_APP_SHIFT 8
+#define DISPATCH_COMMAND_MASK 0xFF
+#define DISPATCH_MAX_APPS 4      // APP_TERMINAL is 0 and APP_RTCEMUL is 3
+#define DISPATCH_MAX_COMMANDS 8  // Commands of each app
+
+// The commands of all the apps carry the random token and up to four longs
+#define DISPATCH_PARAMETERS_MAX_SIZE 20
+
+// Random token of the last command and the seed of the next one. Same place
+// in the shared memory for all the apps. There is a single seed and it only
+// changes when a command completes, so the computer can have one command in
+// flight: the ticket of send_async must be waited for before the next one
+#define DISPATCH_RANDOM_TOKEN_OFFSET 0xF000
+#define DISPATCH_RANDOM_TOKEN_SEED_OFFSET (DISPATCH_RANDOM_TOKEN_OFFSET + 4)
+
+#define DISPATCH_ADDRESS_HIGH_BIT 0x8000  // Inverted high bit of the address
+
+// Tokens generated ahead of the commands. Must be a power of 2
+#define DISPATCH_TOKEN_POOL_SIZE 16
+#define DISPATCH_TOKEN_POOL_MASK (DISPATCH_TOKEN_POOL_SIZE - 1)
+
+// Function to handle a command. The frame is released when it returns
+typedef void (*DispatchHandler)(const TransmissionProtocol *protocol);
+
+// Function called by the bus interrupt for each ROM4 access
+typedef void (*DispatchAccessHandler)(uint32_t addr);
+
+typedef struct {
+  uint16_t commandId;  // APP_xxx << 8 | cmd
+  DispatchHandler handler;
+} DispatchCommand;
+
+/**
+ * @brief Attaches the queue of the commands to the parser of the bus.
+ *
+ * Call it before init_romemul(), with dispatch_dmaIrqHandlerLookup as the
+ * response callback.
+ */
+void dispatch_init(void);
+
+/**
+ * @brief Adds the commands of an app to the jump table.
+ *
+ * The commands of all the registered apps are live at the same time.
+ *
+ * @param commands The commands and their handlers.
+ * @param count Number of commands.
+ * @return 0 on success, -1 if a command is out of the table.
+ */
+int dispatch_register(const DispatchCommand *commands, size_t count);
+
+/**
+ * @brief Sets the function called for each ROM4 access.
+ *
+ * Only the per access interrupt calls it. The change is a single store, so
+ * the interrupt keeps running.
+ *
+ * @param handler The function, or NULL to ignore the ROM4 accesses.
+ */
+void dispatch_setAccessHandler(DispatchAccessHandler handler);
+
+/**
+ * @brief Runs the handlers of the pending commands.
+ *
+ * Only one core can run it at a time, it is the consumer of the queue.
+ */
+void dispatch_loop(void);
+
+/**
+ * @brief Returns a random token from the pool.
+ *
+ * The pool is refilled when the queue is empty, so the answer to a command
+ * only pops a value. Only the consumer of the queue can call it. The tokens
+ * are published one at a time as the seed of the next command, not handed
+ * out per ticket.
+ *
+ * @return A random 32-bit value.
+ */
+uint32_t dispatch_nextToken(void);
+
+/**
+ * @brief Sleeps until a command arrives or the time is reached.
+ *
+ * @param until The time to stop waiting.
+ * @return true if a command is pending, false on timeout.
+ */
+bool dispatch_waitCommand(absolute_time_t until);
+
+/**
+ * @brief Returns the number of commands dropped because the queue was full.
+ *
+ * @return The number of commands dropped since boot.
+ */
+uint32_t dispatch_getOverflows(void);
+
+void TPROTO_IRQ_FUNC(dispatch_dmaIrqHandlerLookup)(void);
+void __not_in_flash_func(dispatch_captureAddressHandler)(uint32_t addr);
+bool __not_in_flash_func(dispatch_frameAddressHandler)(uint32_t addr);
+
+#endif  // DISPATCH_H
@@ -16,7 +16,9 @@
 
 #include "constants.h"
 #include "debug.h"
+#include "fontcache.h"
 #include "hardware/dma.h"
+#include "hardware/sync.h"
 #include "memfunc.h"
 #include "u8g2.h"
 
@@ -49,6 +51,16 @@
 // Buffer size calculation: width * (height / 8)
 #define DISPLAY_BUFFER_SIZE \
   (uint32_t)((DISPLAY_WIDTH / DISPLAY_TILE_HEIGHT) * DISPLAY_HEIGHT)
+// Bytes in a row of pixels of the framebuffer
+#define DISPLAY_ROW_BYTES (DISPLAY_WIDTH / DISPLAY_TILE_WIDHT)
+// The 68000 reads the high byte of each 16 bit word first
+#define DISPLAY_SWAP_BYTE(offset) ((offset) ^ 1)
+// The computer copies only the bands of DISPLAY_TILE_HEIGHT pixel rows changed
+#define DISPLAY_DIRTY_BANDS (DISPLAY_HEIGHT / DISPLAY_TILE_HEIGHT)
+#define DISPLAY_DIRTY_BAND_BYTES \
+  (DISPLAY_ROW_BYTES * DISPLAY_TILE_HEIGHT)
+// Bands rotated to scroll. The last band is the status bar and doesn't scroll
+#define DISPLAY_SCROLL_BANDS (DISPLAY_DIRTY_BANDS - 1)
 #define DISPLAY_COPYRIGHT_MESSAGE "(C)GOODDATA LABS SL 2023-25"
 #define DISPLAY_PRODUCT_MSG "SidecarTridge Multi-Device"
 #define DISPLAY_RESET_WAIT_MESSAGE "Resetting the computer"
@@ -60,6 +72,25 @@
 // Commands offset. BUFFER_OFFSET + ADDRESS_OFFSET
 #define DISPLAY_COMMAND_ADDRESS_OFFSET 8000
 
+// After each refresh, the bands copied and a sequence number, odd while they
+// are updated. COMMAND_ADDRESS_OFFSET + offset
+#define DISPLAY_FRAME_SEQ_OFFSET 4
+#define DISPLAY_DIRTY_BANDS_OFFSET 8
+// Not zero if the RP2040 keeps the expanded high resolution rows
+#define DISPLAY_HIGHRES_READY_OFFSET 12
+// Offset in the framebuffer of each band of the screen, 4 bytes each
+#define DISPLAY_BAND_TABLE_OFFSET 16
+
+#ifndef DISPLAY_HIGHRES_EXPANDED
+#define DISPLAY_HIGHRES_EXPANDED \
+  0  // Set to 1 to expand the high resolution rows in the RP2040
+#endif
+
+// Expanded high resolution rows: one 16 bit word per byte of the framebuffer.
+// The computer writes each row twice. Offset from the ROM in RAM start
+#define DISPLAY_HIGHRES_BUFFER_OFFSET 0x2000
+#define DISPLAY_HIGHRES_ROW_BYTES (DISPLAY_ROW_BYTES * 2)
+
 // Highres translate table offset: BUFFER_OFFSET + TRANSTABLE_OFFSET
 #define DISPLAY_HIGHRES_TRANSTABLE_OFFSET 0x1000
 
@@ -70,6 +101,8 @@
 #define DISPLAY_COMMAND_TERMINAL \
   0x3                              //  Terminal. Not used from RP to Computer.
 #define DISPLAY_COMMAND_START 0x4  // Continue boot process and emulation
+#define DISPLAY_COMMAND_BENCH 0x5  // Run the benchmark in the computer
+#define DISPLAY_COMMAND_CALIBRATE 0x6  // Run the bus calibration loop
 
 /**
  * @brief Sends a command to the display.
@@ -102,18 +135,64 @@
  * - Configuring u8g2 with custom callbacks for dummy byte, GPIO, and
  * command/data routines.
  * - Establishing buffer parameters and running a fake initialization sequence.
+ *   The u8g2 buffer is the display memory read by the computer.
  */
 void display_setupU8g2();
 
 /**
  * @brief Refreshes the display.
  *
- * Copies the contents of the u8g2 buffer into the display's memory-mapped
- * buffer using a DMA transfer with 16-bit swapping, ensuring the on-screen
- * content is updated.
+ * u8g2 draws straight into the display's memory-mapped buffer, in the byte
+ * order of the computer. The refresh publishes the bands changed since the
+ * last refresh next to the command, so the computer copies only them to the
+ * screen.
  */
 void display_refresh();
 
+/**
+ * @brief Marks the pixel rows of the u8g2 buffer as changed.
+ *
+ * The u8g2 drawing functions mark their rows. Call it after writing the buffer
+ * directly.
+ *
+ * @param y The first pixel row changed.
+ * @param height The number of pixel rows changed.
+ */
+void display_markDirty(uint16_t y, uint16_t height);
+
+/**
+ * @brief Marks the whole u8g2 buffer as changed.
+ *
+ * The next display_refresh() copies the full buffer.
+ */
+void display_markAllDirty();
+
+/**
+ * @brief Returns the band of the framebuffer shown at a band of the screen.
+ *
+ * The bands of the scroll region rotate when scrolling, so the rows of the
+ * screen must be drawn at the band returned.
+ *
+ * @param band The band of the screen, in rows of DISPLAY_TILE_HEIGHT pixels.
+ * @return The band of the framebuffer.
+ */
+uint8_t display_getBand(uint8_t band);
+
+/**
+ * @brief Scrolls up the scroll region by one band.
+ *
+ * Rotates the bands instead of moving the buffer, and blanks the new bottom
+ * band. The computer copies the bands in the order of the screen.
+ */
+void display_scrollBands();
+
+/**
+ * @brief Shows the bands of the framebuffer in order again.
+ *
+ * Call it after clearing the whole buffer.
+ */
+void display_resetScroll();
+
 /**
  * @brief Draws product information on the display.
  *
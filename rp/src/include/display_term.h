@@ -30,14 +30,18 @@
 #define DISPLAY_TERM_CHAR_HEIGHT 8
 #endif
 
+// Glyphs of the terminal font rasterized in RAM, one per character code
+#define DISPLAY_TERM_GLYPHS 256
+
 /**
  * @brief Draws a character glyph on the display buffer at the specified grid
  * position.
  *
  * This function calculates the pixel coordinates based on the provided column
  * and row indices, taking into account the character width, height, and a
- * predefined offset for the first row. It then uses the u8g2 graphics library
- * to render the specified character glyph on the display.
+ * predefined offset for the first row. It then copies the rows of the glyph,
+ * rasterized once by display_termClear(), to the display buffer. Until then it
+ * uses the u8g2 graphics library to render the glyph.
  *
  * @param col The column index where the character should be drawn. The actual
  * x-coordinate is computed as col multiplied by the character width.
@@ -51,7 +55,7 @@ void display_termChar(uint8_t col, uint8_t row, char chr);
 /**
  * @brief Draws a solid block at the cursor position.
  *
- * This function renders a filled rectangular block on the display.
+ * This function writes a filled rectangular block to the display buffer.
  * It calculates the position based on the provided column and row indices,
  * multiplied by the predefined character dimensions.
  *
@@ -87,7 +91,8 @@ void display_termRefresh();
  * @brief Clears the terminal display buffer and sets the font.
  *
  * This function clears the current display buffer and sets the font to
- * 'u8g2_font_amstrad_cpc_extended_8f' for the terminal display.
+ * 'u8g2_font_amstrad_cpc_extended_8f' for the terminal display. The first call
+ * rasterizes the glyphs of the font.
  */
 void display_termClear();
 #endif  // DISPLAY_TERM_H
@@ -0,0 +1,77 @@
+/**
+ * File: dmacopy.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Memory copies with a DMA channel claimed once
+ */
+
+#ifndef DMACOPY_H
+#define DMACOPY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "debug.h"
+#include "hardware/dma.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "pico/stdlib.h"
+
+// Shorter blocks are swapped faster by the CPU than by setting up the DMA
+#ifndef DMACOPY_SWAP_MIN_BYTES
+#define DMACOPY_SWAP_MIN_BYTES 64
+#endif
+
+/**
+ * @brief Starts to copy words from the flash with the XIP streaming FIFO.
+ *
+ * Does not wait for the copy. A copy still running is waited for first, so
+ * the copies run one after the other. The channel is claimed by the first
+ * copy and kept.
+ *
+ * @param dest The destination in RAM, aligned to 32 bits.
+ * @param src The source in the flash, aligned to 32 bits.
+ * @param words The number of 32-bit words to copy.
+ * @return 0 if the copy started, -1 if there is no DMA channel free.
+ */
+int dmacopy_startFromFlash(void *dest, const void *src, uint32_t words);
+
+/**
+ * @brief Starts to copy 16-bit words swapping the bytes of each word.
+ *
+ * Does not wait for the copy, like dmacopy_startFromFlash().
+ *
+ * @param dest The destination, aligned to 16 bits.
+ * @param src The source, aligned to 16 bits.
+ * @param bytes The number of bytes to copy, rounded up to a word.
+ * @return 0 if the copy started, -1 if there is no DMA channel free.
+ */
+int dmacopy_startSwap16(void *dest, const void *src, size_t bytes);
+
+/**
+ * @brief Copies 16-bit words swapping the bytes of each word, and waits.
+ *
+ * The byte order of the 68000 and the RP2040 differ. The blocks from
+ * DMACOPY_SWAP_MIN_BYTES are swapped on the fly by the DMA, the shorter ones
+ * by the CPU. dest can be src to swap a block in place.
+ *
+ * @param dest The destination, aligned to 16 bits.
+ * @param src The source, aligned to 16 bits.
+ * @param bytes The number of bytes to copy, rounded up to a word.
+ */
+void dmacopy_swap16(void *dest, const void *src, size_t bytes);
+
+/**
+ * @brief Tells if a copy is running.
+ *
+ * @return true until the last copy started ends.
+ */
+bool dmacopy_isBusy(void);
+
+/**
+ * @brief Waits for the last copy started to end.
+ */
+void dmacopy_wait(void);
+
+#endif  // DMACOPY_H
@@ -14,21 +14,48 @@
 #include <string.h>
 
 #include "aconfig.h"
+#include "boottime.h"
+#include "buscal.h"
 #include "constants.h"
 #include "debug.h"
+#include "dispatch.h"
+#include "fetchprof.h"
+#include "fleet.h"
 #include "httpc/httpc.h"
+#include "loadgen.h"
+#include "lz4.h"
 #include "memfunc.h"
 #include "network.h"
+#include "ota.h"
 #include "pico/stdlib.h"
 #include "romemul.h"
 #include "rtc.h"
 #include "select.h"
+#include "sntpd.h"
+#include "status.h"
+#include "telemetry.h"
 #include "term.h"
+#include "termnet.h"
 
 #define WIFI_SCAN_TIME_MS (5 * 1000)
 #define DOWNLOAD_START_MS (3 * 1000)
 #define DOWNLOAD_DAY_MS (86400 * 1000)
 #define SLEEP_LOOP_MS 100
+#define SETUP_COUNTDOWN 20  // Seconds to wait in the setup menu
+#define FAST_BOOT_COUNTDOWN \
+  2  // Seconds for the computer to see the ESC key in fast boot mode
+#define WIFI_LEASE_MARGIN_S 60  // Do not reuse a DHCP lease about to expire
+#define WIFI_CONNECT_ATTEMPTS 3  // Full connections tried after a timeout
+
+// Radio policy between the NTP resyncs once the computer runs
+enum {
+  RADIO_POWER_ON = 0,       // Always on
+  RADIO_POWER_SAVE = 1,     // Deepest power save mode of the radio
+  RADIO_POWER_OFF = 2,      // Radio and network stack off
+  RADIO_POWER_OPTIONS = 3   // Number of options
+};
+#define RADIO_WAKE_LEAD_US \
+  (20 * 1000 * 1000)  // Wake up the radio before the next resync
 
 enum {
   APP_EMULATION_RUNTIME = 0,  // Emulation during runtime
@@ -37,6 +64,8 @@ enum {
 };
 
 #define APP_MODE_SETUP_STR "255"  // App mode setup string
+#define APP_MODE_FAST_BOOT \
+  APP_EMULATION_INIT  // Skip the setup menu unless ESC is pressed
 
 /**
  * @brief
@@ -0,0 +1,118 @@
+/**
+ * File: fetchprof.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Sampling profiler of the ROM4 addresses fetched by the computer
+ */
+
+#ifndef FETCHPROF_H
+#define FETCHPROF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "constants.h"
+#include "debug.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "romemul.h"
+
+// Sample the ROM4 addresses served to the bus (1) or not (0)
+#ifndef ROMEMUL_ROM4_PROFILE
+#define ROMEMUL_ROM4_PROFILE 0
+#endif
+
+// Samples per second, paced by a DMA timer
+#ifndef FETCHPROF_SAMPLE_HZ
+#define FETCHPROF_SAMPLE_HZ 10000
+#endif
+
+// Bytes of the ROM4 counted in each bucket of the histogram
+#define FETCHPROF_BUCKET_SHIFT 4
+#define FETCHPROF_BUCKET_BYTES (1u << FETCHPROF_BUCKET_SHIFT)
+#define FETCHPROF_ROM4_BYTES 0x10000
+#define FETCHPROF_BUCKETS (FETCHPROF_ROM4_BYTES >> FETCHPROF_BUCKET_SHIFT)
+
+// The ring must be aligned to its size for the DMA address wrapping. 100 ms
+// of samples, longer than a flash write stalls the main loop
+#define FETCHPROF_RING_BITS 12  // 4KB ring
+#define FETCHPROF_RING_BYTES (1u << FETCHPROF_RING_BITS)
+#define FETCHPROF_RING_WORDS (FETCHPROF_RING_BYTES / 4)
+#define FETCHPROF_RING_MASK (FETCHPROF_RING_WORDS - 1)
+
+// Samples per trigger of the DMA. Fits the counter of both chips. It is
+// triggered again once done
+#define FETCHPROF_TRANSFERS 0x0FFFFFFF
+
+// Buckets exported to the USB telemetry in each pass of the main loop
+#define FETCHPROF_EXPORT_BATCH 32
+
+// Counters of the samples since the last start
+typedef struct {
+  uint32_t samples;  // Samples drained from the ring
+  uint32_t rom4;     // New ROM4 addresses, counted in the histogram
+  uint32_t other;    // ROM3 accesses, or the same address again
+} FetchProfStats;
+
+/**
+ * @brief Clears the histogram and starts to sample the bus.
+ *
+ * A DMA channel paced by a DMA timer copies the read address of the lookup
+ * DMA into a ring. The chain that serves the bus is not touched. Call it
+ * after init_romemul().
+ *
+ * @return 0 if sampling, -1 if not available in this build or no DMA
+ * channel or timer is free.
+ */
+int fetchprof_start(void);
+
+/**
+ * @brief Stops the sampling and keeps the histogram.
+ */
+void fetchprof_stop(void);
+
+/**
+ * @brief Tells if the bus is being sampled.
+ *
+ * @return true between fetchprof_start() and fetchprof_stop().
+ */
+bool fetchprof_isRunning(void);
+
+/**
+ * @brief Counts the samples of the ring and sends the export in progress.
+ *
+ * An address equal to the previous sample is not counted: the computer is
+ * not fetching from the cartridge. Call it from the main loop.
+ */
+void fetchprof_poll(void);
+
+/**
+ * @brief Returns the counters of the samples.
+ *
+ * @return The counters, never NULL.
+ */
+const FetchProfStats *fetchprof_getStats(void);
+
+/**
+ * @brief Returns the histogram.
+ *
+ * Bucket i counts the samples between the ROM4 offsets
+ * i * FETCHPROF_BUCKET_BYTES and the next bucket.
+ *
+ * @return FETCHPROF_BUCKETS counters, NULL if not available in this build.
+ */
+const uint32_t *fetchprof_getHistogram(void);
+
+/**
+ * @brief Starts sending the histogram to the USB telemetry channel.
+ *
+ * One line per bucket with samples: the ROM4 offset and the count, both in
+ * hexadecimal. rp/fetchprof.py maps them to the symbols of the firmware.
+ *
+ * @return 0 if the export started, -1 if there is no telemetry channel.
+ */
+int fetchprof_export(void);
+
+#endif  // FETCHPROF_H
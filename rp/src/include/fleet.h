@@ -0,0 +1,57 @@
+/**
+ * File: fleet.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Snapshot of the device for a fleet collector over UDP
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aconfig.h"
+#include "boottime.h"
+#include "constants.h"
+#include "debug.h"
+#include "dispatch.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "network.h"
+#include "pico/cyw43_arch.h"
+#include "rtc.h"
+#include "tprotocol.h"
+
+// Any datagram to the port gets the snapshot as a JSON object
+#define FLEET_SNAPSHOT_SIZE 1024  // Fits in one datagram without fragments
+#define FLEET_MIN_INTERVAL_MS \
+  100  // Requests closer than this to the last answer are dropped
+
+/**
+ * @brief Listens for the requests of the collector.
+ *
+ * The callback of lwIP only takes note of the sender. The answer is built
+ * and sent by fleet_poll(). Call it once the network is up.
+ *
+ * @param port The UDP port to listen on.
+ * @return 0 if listening, -1 otherwise.
+ */
+int fleet_start(uint16_t port);
+
+/**
+ * @brief Answers the pending request, if any.
+ *
+ * At most one request per call and per FLEET_MIN_INTERVAL_MS, so the work
+ * per loop is bounded. Call it from the main loop.
+ *
+ * @param radioOn false if the radio is powered down, so the Wi-Fi chip is
+ * not accessed.
+ */
+void fleet_poll(bool radioOn);
+
+#endif  // FLEET_H
@@ -0,0 +1,40 @@
+/**
+ * File: fontcache.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: RAM copies of the u8g2 fonts in use
+ */
+
+#ifndef FONTCACHE_H
+#define FONTCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "u8g2.h"
+
+// Bytes of RAM for the fonts. Room for the terminal and the status bar fonts
+#ifndef FONTCACHE_ARENA_SIZE
+#define FONTCACHE_ARENA_SIZE 4096
+#endif
+
+// Fonts kept at the same time. The least recently used one is evicted
+#define FONTCACHE_SLOTS 3
+
+/**
+ * @brief Sets the font of the display from its copy in RAM.
+ *
+ * Use it instead of u8g2_SetFont(). The first time a font is used, its data
+ * is copied from the flash into the arena, so the glyphs are decoded without
+ * going through the XIP cache. A font larger than the arena is used from the
+ * flash.
+ *
+ * @param u8g2 The display.
+ * @param font The font in the flash.
+ */
+void fontcache_setFont(u8g2_t *u8g2, const uint8_t *font);
+
+#endif  // FONTCACHE_H
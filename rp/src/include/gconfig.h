@@ -34,6 +34,39 @@
 #define PARAM_WIFI_SCAN_SECONDS "WIFI_SCAN_SECONDS"
 #define PARAM_WIFI_SSID "WIFI_SSID"
 
+// Default entries of the global settings, in the order of the Booster app.
+// ENTRY(id, type, value) uses the key PARAM_<id> and gives it the index
+// GCONFIG_KEY_<id>
+#define GCONFIG_DEFAULT_ENTRIES(ENTRY)                                         \
+  ENTRY(APPS_FOLDER, SETTINGS_TYPE_STRING, "/apps")                            \
+  ENTRY(APPS_CATALOG_URL, SETTINGS_TYPE_STRING,                                \
+        "http://atarist.sidecartridge.com/apps.json")                          \
+  ENTRY(BOOT_FEATURE, SETTINGS_TYPE_STRING, "CONFIGURATOR")                    \
+  ENTRY(HOSTNAME, SETTINGS_TYPE_STRING, "sidecart")                            \
+  ENTRY(SAFE_CONFIG_REBOOT, SETTINGS_TYPE_BOOL, "true")                        \
+  ENTRY(SD_BAUD_RATE_KB, SETTINGS_TYPE_INT, "12500")                           \
+  ENTRY(WIFI_AUTH, SETTINGS_TYPE_INT, "0")                                     \
+  ENTRY(WIFI_CONNECT_TIMEOUT, SETTINGS_TYPE_INT, "30")                         \
+  ENTRY(WIFI_COUNTRY, SETTINGS_TYPE_STRING, "XX")                              \
+  ENTRY(WIFI_DHCP, SETTINGS_TYPE_BOOL, "true")                                 \
+  ENTRY(WIFI_DNS, SETTINGS_TYPE_STRING, "8.8.8.8")                             \
+  ENTRY(WIFI_GATEWAY, SETTINGS_TYPE_STRING, "")                                \
+  ENTRY(WIFI_IP, SETTINGS_TYPE_STRING, "")                                     \
+  ENTRY(WIFI_MODE, SETTINGS_TYPE_INT, "0")                                     \
+  ENTRY(WIFI_NETMASK, SETTINGS_TYPE_STRING, "")                                \
+  ENTRY(WIFI_PASSWORD, SETTINGS_TYPE_STRING, "")                               \
+  ENTRY(WIFI_POWER, SETTINGS_TYPE_INT, "0")                                    \
+  ENTRY(WIFI_RSSI, SETTINGS_TYPE_BOOL, "true")                                 \
+  ENTRY(WIFI_SCAN_SECONDS, SETTINGS_TYPE_INT, "10")                            \
+  ENTRY(WIFI_SSID, SETTINGS_TYPE_STRING, "")
+
+#define GCONFIG_KEY_ID(id, type, value) GCONFIG_KEY_##id,
+
+// Index of each default entry, for gconfig_getEntry()
+typedef enum {
+  GCONFIG_DEFAULT_ENTRIES(GCONFIG_KEY_ID) GCONFIG_KEY_COUNT
+} GconfigKey;
+
 #define GCONFIG_SUCCESS 0
 #define GCONFIG_INIT_ERROR -1
 #define GCONFIG_MISMATCHED_APP -2
@@ -41,4 +74,45 @@
 int gconfig_init(const char *current_app_name);
 SettingsContext *gconfig_getContext(void);
 
+/**
+ * @brief Returns an entry of the global settings in constant time.
+ *
+ * @param key Index of the entry.
+ * @return SettingsConfigEntry* The entry, or NULL if not found.
+ */
+SettingsConfigEntry *gconfig_getEntry(GconfigKey key);
+
+/**
+ * @brief Returns the value of an entry of the global settings as an integer.
+ *
+ * The value is parsed when loaded or updated, not on each call.
+ *
+ * @param key Index of the entry.
+ * @param defaultValue Value returned if the entry is not found.
+ * @return int The value parsed like atoi().
+ */
+int gconfig_getInt(GconfigKey key, int defaultValue);
+
+/**
+ * @brief Returns the value of an entry of the global settings as a boolean.
+ *
+ * The value is parsed when loaded or updated, not on each call.
+ *
+ * @param key Index of the entry.
+ * @param defaultValue Value returned if the entry is not found.
+ * @return bool True if it starts with 't', 'T', 'y', 'Y' or '1'.
+ */
+bool gconfig_getBool(GconfigKey key, bool defaultValue);
+
+/**
+ * @brief Returns the value of an entry of the global settings as a string.
+ *
+ * The value is parsed when loaded or updated, not on each call.
+ *
+ * @param key Index of the entry.
+ * @param defaultValue Value returned if the entry is not found.
+ * @return const char* The value. Valid until the settings are reloaded.
+ */
+const char *gconfig_getString(GconfigKey key, const char *defaultValue);
+
 #endif  // GCONFIG_H
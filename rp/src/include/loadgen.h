@@ -0,0 +1,143 @@
+/**
+ * File: loadgen.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Synthetic load of the cartridge bus for the self-test build
+ */
+
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "debug.h"
+#include "dispatch.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "pico/stdlib.h"
+#include "romemul.h"
+#include "tprotocol.h"
+
+// Accesses per second of back to back word reads of a 68000 at 8 MHz
+#define LOADGEN_DEFAULT_RATE 2000000
+#define LOADGEN_DEFAULT_MS 1000
+#define LOADGEN_MAX_MS 60000
+
+// The pattern is played in a loop from a ring. It must be aligned to its size
+// for the DMA address wrapping
+#define LOADGEN_RING_BITS 12  // 4KB ring
+#define LOADGEN_RING_BYTES (1u << LOADGEN_RING_BITS)
+#define LOADGEN_RING_WORDS (LOADGEN_RING_BYTES / 4)
+
+// Accesses of a run. Fits the counter of the DMA of both chips
+#define LOADGEN_MAX_TRANSFERS 0x0FFFFFFF
+
+// Payload of the frames, like send_sync: the random token and D3 to D5
+#define LOADGEN_FRAME_PAYLOAD 16
+#define LOADGEN_FRAME_WORDS (3 + (LOADGEN_FRAME_PAYLOAD / 2) + 1)
+
+// Most ROM4 accesses between two frames of the mix pattern
+#define LOADGEN_MIX_GAP 32
+
+// One in this number of accesses of the noise pattern is a ROM3 access
+#define LOADGEN_NOISE_ROM3_RATIO 8
+
+// Accesses in the TX FIFO and the OSR of bus_loadgen after the last transfer
+#define LOADGEN_FIFO_WORDS 5
+
+// Time for the last accesses to go through the interrupt and the queue
+#define LOADGEN_SETTLE_MS 10
+
+// Accesses of the pattern sent to the bus
+typedef enum {
+  LOADGEN_FRAMES,  // Back to back frames of the bench ping command
+  LOADGEN_NOISE,   // Random ROM4 and ROM3 accesses, never a header
+  LOADGEN_MIX,     // Frames between random ROM4 and ROM3 accesses
+  LOADGEN_PATTERNS
+} LoadGenPattern;
+
+// Counters of the last run, deltas of the counters of the parser
+typedef struct {
+  LoadGenPattern pattern;
+  uint32_t rate;            // Accesses per second requested
+  uint32_t elapsedUs;       // From the start to the end of the last access
+  uint32_t sent;            // Accesses pushed to the DMA chain
+  uint32_t served;          // Interrupts of the lookup DMA
+  uint32_t rom3Sent;        // ROM3 accesses of the pattern
+  uint32_t rom3Served;      // ROM3 words received by the parser
+  uint32_t framesSent;      // Frames of the pattern
+  uint32_t frames;          // Frames completed with a good checksum
+  uint32_t checksumErrors;  // Frames with a wrong checksum
+  uint32_t resyncs;         // Frames dropped after a gap in the bus
+  uint32_t overflows;       // Frames dropped because the queue was full
+  uint32_t irqMaxCycles;    // Longest interrupt of the run
+  uint32_t irqAvgCycles;    // Average interrupt of the run
+#if TPROTO_IRQ_HISTOGRAM == 1
+  uint32_t irqHistogram[TPROTO_IRQ_BUCKETS];  // Interrupts of the run
+#endif
+  bool aborted;  // Stopped before the end of the pattern
+} LoadGenResult;
+
+/**
+ * @brief Starts to play a pattern on the bus.
+ *
+ * Only available when ROMEMUL_SELF_TEST is enabled, without a computer. A DMA
+ * channel feeds the raw addresses of the pattern to bus_loadgen, which pushes
+ * them to the DMA chain of the bus at the rate given. Call it after
+ * init_romemul().
+ *
+ * @param pattern The accesses to send.
+ * @param rate Accesses per second. Up to the system clock divided by
+ * ROMEMUL_LOADGEN_LOOP_CYCLES.
+ * @param durationMs Time to play the pattern, up to LOADGEN_MAX_MS. Rounded
+ * up to whole passes of the ring.
+ * @return 0 if started, -1 if not available, running or out of range.
+ */
+int loadgen_start(LoadGenPattern pattern, uint32_t rate, uint32_t durationMs);
+
+/**
+ * @brief Stops the pattern and keeps the counters of the run so far.
+ */
+void loadgen_stop(void);
+
+/**
+ * @brief Tells if a pattern is playing.
+ *
+ * @return true until the last access of the pattern is served.
+ */
+bool loadgen_isRunning(void);
+
+/**
+ * @brief Ends the run once the last access is served, and sends the counters
+ * to the USB telemetry channel.
+ *
+ * Call it from the main loop.
+ */
+void loadgen_poll(void);
+
+/**
+ * @brief Returns the counters of the last run.
+ *
+ * @return The counters, NULL if there was no run.
+ */
+const LoadGenResult *loadgen_getResult(void);
+
+/**
+ * @brief Sends the counters of the last run to the USB telemetry channel.
+ */
+void loadgen_report(void);
+
+/**
+ * @brief Returns the pattern with the name given.
+ *
+ * @param name frames, noise or mix.
+ * @return The pattern, LOADGEN_PATTERNS if unknown.
+ */
+LoadGenPattern loadgen_getPattern(const char *name);
+
+#endif  // LOADGEN_H
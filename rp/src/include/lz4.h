@@ -0,0 +1,37 @@
+/**
+ * File: lz4.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Decompression of the LZ4 blocks of the firmware images
+ */
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "debug.h"
+
+#define LZ4_MIN_MATCH 4         // Shortest match of a sequence
+#define LZ4_LENGTH_EXTENDED 15  // The length continues in the next bytes
+
+/**
+ * @brief Decompresses a LZ4 block, without frame header.
+ *
+ * The block is the format written by target/atarist/firmware.py with
+ * --compress=lz4. The input is checked, so a corrupted block never writes
+ * past the end of the destination.
+ *
+ * @param src The compressed block.
+ * @param srcSize Bytes of the compressed block.
+ * @param dst Where to write the decompressed data.
+ * @param dstCapacity Bytes available in the destination.
+ * @return The bytes decompressed, or -1 if the block is not valid.
+ */
+int lz4_decompress(const uint8_t *src, size_t srcSize, uint8_t *dst,
+                   size_t dstCapacity);
+
+#endif  // LZ4_H
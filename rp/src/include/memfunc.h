@@ -13,6 +13,7 @@
 
 #include "constants.h"
 #include "debug.h"
+#include "dmacopy.h"
 #include "hardware/dma.h"
 #include "hardware/structs/xip_ctrl.h"
 
@@ -34,56 +35,38 @@
     DPRINTF("Emulation firmware copied to RAM.\n");          \
   } while (0)
 
-#define COPY_FIRMWARE_TO_RAM_DMA(emulROM, emulROM_length)                     \
-  do {                                                                        \
-    while (!(xip_ctrl_hw->stat & XIP_STAT_FIFO_EMPTY))                        \
-      (void)xip_ctrl_hw->stream_fifo;                                         \
-    xip_ctrl_hw->stream_addr = (uint32_t)&(emulROM)[0];                       \
-    xip_ctrl_hw->stream_ctr = (emulROM_length) / 2;                           \
-    const uint dma_chan = dma_claim_unused_channel(true);                     \
-    dma_channel_config cfg = dma_channel_get_default_config(dma_chan);        \
-    channel_config_set_read_increment(&cfg, false);                           \
-    channel_config_set_write_increment(&cfg, true);                           \
-    channel_config_set_dreq(&cfg, DREQ_XIP_STREAM);                           \
-    dma_channel_configure(dma_chan, &cfg,                                     \
-                          (void *)&__rom_in_ram_start__, /* Write addr */     \
-                          (const void *)XIP_AUX_BASE,    /* Read addr */      \
-                          (emulROM_length) / 2,          /* Transfer count */ \
-                          true /* Start immediately! */                       \
-    );                                                                        \
-    while (dma_channel_is_busy(dma_chan)) {                                   \
-      tight_loop_contents();                                                  \
-    }                                                                         \
+// The length is in 16-bit words. The DMA copies pairs of them
+#define COPY_FIRMWARE_TO_RAM_DMA(emulROM, emulROM_length)                \
+  do {                                                                   \
+    if (dmacopy_startFromFlash((void *)&__rom_in_ram_start__,            \
+                               (const void *)&(emulROM)[0],              \
+                               (emulROM_length) / 2) == 0) {             \
+      dmacopy_wait();                                                    \
+    } else {                                                             \
+      COPY_FIRMWARE_TO_RAM_MEMCPY(emulROM, (emulROM_length) * 2);        \
+    }                                                                    \
   } while (0)
 
 #define CHANGE_ENDIANESS_BLOCK16(dest_ptr_word, size_in_bytes) \
-  do {                                                         \
-    uint16_t *word_ptr = (uint16_t *)(dest_ptr_word);          \
-    for (uint16_t j = 0; j < (size_in_bytes) / 2; ++j) {       \
-      word_ptr[j] = (word_ptr[j] << 8) | (word_ptr[j] >> 8);   \
-    }                                                          \
-  } while (0)
+  dmacopy_swap16((dest_ptr_word), (dest_ptr_word), (size_in_bytes))
 
-#define COPY_AND_CHANGE_ENDIANESS_BLOCK16(src_ptr_word, dest_ptr_word,    \
-                                          size_in_bytes)                  \
-  do {                                                                    \
-    uint16_t *src_word_ptr = (uint16_t *)(src_ptr_word);                  \
-    uint16_t *dest_word_ptr = (uint16_t *)(dest_ptr_word);                \
-    for (uint16_t j = 0; j < (size_in_bytes) / 2; ++j) {                  \
-      dest_word_ptr[j] = (src_word_ptr[j] << 8) | (src_word_ptr[j] >> 8); \
-    }                                                                     \
-  } while (0)
+#define COPY_AND_CHANGE_ENDIANESS_BLOCK16(src_ptr_word, dest_ptr_word, \
+                                          size_in_bytes)               \
+  dmacopy_swap16((dest_ptr_word), (src_ptr_word), (size_in_bytes))
 
-#define SWAP_WORD(data) \
-  ((((uint16_t)data << 8) & 0xFF00) | (((uint16_t)data >> 8) & 0xFF))
+#define SWAP_WORD(data) __builtin_bswap16((uint16_t)(data))
 
+// Swaps the two words of a longword, not its bytes
 #define SWAP_LONGWORD(data) \
   ((((uint32_t)data << 16) & 0xFFFF0000) | (((uint32_t)data >> 16) & 0xFFFF))
 
-#define WRITE_AND_SWAP_LONGWORD(address, offset, data) \
-  *((volatile uint32_t *)((address) + (offset))) =     \
-      ((((uint32_t)(data) << 16) & 0xFFFF0000) |       \
-       (((uint32_t)(data) >> 16) & 0xFFFF))
+// The data is evaluated once, so it can be a ++counter or a function call
+#define WRITE_AND_SWAP_LONGWORD(address, offset, data)                 \
+  do {                                                                 \
+    uint32_t swapData = (uint32_t)(data);                              \
+    *((volatile uint32_t *)((address) + (offset))) =                   \
+        ((swapData << 16) & 0xFFFF0000) | ((swapData >> 16) & 0xFFFF); \
+  } while (0)
 
 #define WRITE_LONGWORD_RAW(address, offset, data) \
   *((volatile uint32_t *)((address) + (offset))) = data
@@ -111,29 +94,8 @@
     (((uint32_t)(*((volatile uint32_t *)((address) + (offset))) >> 16) & \
       0xFFFF))))
 
-#define COPY_AND_SWAP_16BIT_DMA(dest, source, num_bytes)           \
-  do {                                                             \
-    size_t _rounded_bytes = ((num_bytes) + 1) & ~1;                \
-    size_t _num_words = _rounded_bytes / 2;                        \
-    int _dma_channel = dma_claim_unused_channel(true);             \
-    dma_channel_config _dma_cfg =                                  \
-        dma_channel_get_default_config(_dma_channel);              \
-    channel_config_set_transfer_data_size(&_dma_cfg, DMA_SIZE_16); \
-    channel_config_set_read_increment(&_dma_cfg, true);            \
-    channel_config_set_write_increment(&_dma_cfg, true);           \
-    channel_config_set_bswap(&_dma_cfg, true);                     \
-    dma_channel_configure(                                         \
-        _dma_channel, /* Channel */                                \
-        &_dma_cfg,    /* Channel config */                         \
-        (dest),       /* Destination address */                    \
-        (source),     /* Source address */                         \
-        (_num_words), /* Number of 16-bit words to transfer */     \
-        false         /* Don't start yet */                        \
-    );                                                             \
-    dma_channel_start(_dma_channel);                               \
-    dma_channel_wait_for_finish_blocking(_dma_channel);            \
-    dma_channel_unclaim(_dma_channel);                             \
-  } while (0)
+#define COPY_AND_SWAP_16BIT_DMA(dest, source, num_bytes) \
+  dmacopy_swap16((dest), (source), (num_bytes))
 
 /**
  * @brief Macro to set a shared variable.
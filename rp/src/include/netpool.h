@@ -0,0 +1,58 @@
+/**
+ * File: netpool.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Pbuf pool of lwIP lent to the runtime while the radio is off
+ */
+
+#ifndef NETPOOL_H
+#define NETPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "debug.h"
+#include "lwip/memp.h"
+#include "lwip/priv/memp_priv.h"
+
+// Called when lwIP takes the arena back. The user must stop using it
+typedef void (*NetpoolReleaseFn)(void);
+
+/**
+ * @brief Takes the pbuf pool of lwIP, if all its buffers are free.
+ *
+ * The pool is sized for the boot burst of the network and idle while the
+ * radio is off. Call it only after cyw43_arch_deinit(): lwIP must not run
+ * until netpool_reclaim().
+ *
+ * @return 0 if the arena is available, -1 otherwise.
+ */
+int netpool_lend(void);
+
+/**
+ * @brief Gives the arena to its user. One user at a time.
+ *
+ * @param size Where to store the size of the arena in bytes.
+ * @param release Called by netpool_reclaim() before lwIP takes the arena.
+ * @return The arena, word aligned. NULL if it is not lent or already used.
+ */
+void *netpool_acquire(size_t *size, NetpoolReleaseFn release);
+
+/**
+ * @brief Returns the arena to lwIP and rebuilds the pbuf pool.
+ *
+ * Calls the release function of the user first. Call it before the network
+ * is initialized again. Nothing to do if the pool was not lent.
+ */
+void netpool_reclaim(void);
+
+/**
+ * @brief Tells if the arena is lent.
+ *
+ * @return true between netpool_lend() and netpool_reclaim().
+ */
+bool netpool_isLent(void);
+
+#endif  // NETPOOL_H
@@ -9,6 +9,7 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
+#include "boottime.h"
 #include "constants.h"
 #include "debug.h"
 #include "gconfig.h"
@@ -19,9 +20,11 @@
 #endif
 
 #ifdef CYW43_WL_GPIO_LED_PIN
+#include "lwip/dhcp.h"
 #include "lwip/dns.h"
 #include "lwip/ip4_addr.h"
 #include "lwip/netif.h"
+#include "netpool.h"
 #include "pico/cyw43_arch.h"
 #include "pico/unique_id.h"
 #endif
@@ -44,15 +47,26 @@
 
 #define NETWORK_POLLING_INTERVAL 100  // 100 ms
 #define NETWORK_CONNECT_TIMEOUT 30    // 30 seconds
+#define NETWORK_FAST_CONNECT_TIMEOUT \
+  5  // 5 seconds. Then fall back to the full connection
 
 #define NETWORK_POWER_MGMT_DISABLED 0xa11140
 #define NETWORK_POWER_MGMT_MAX_OPTIONS 5
+// Legacy power save, waking up every 10 beacons. The lowest power while
+// connected
+#define NETWORK_POWER_MGMT_DEEPEST \
+  cyw43_pm_value(CYW43_PM1_POWERSAVE_MODE, 200, 10, 10, 10)
 
 #define NETWORK_MAX_STRING_LENGTH 32
 
 #define NETWORK_MAC_SIZE 6
 
-#define MAX_NETWORKS 100
+#define MAX_NETWORKS 100  // The weakest network is dropped for a stronger one
+#define NETWORK_SSID_SIZE 32  // An SSID is not ended by a zero
+// Slots of the BSSID table of the scan. A power of two over twice
+// MAX_NETWORKS, so the probes are short
+#define NETWORK_SCAN_HASH_SIZE 256
+#define NETWORK_SCAN_HASH_EMPTY 0xFF
 #define MAX_SSID_LENGTH \
   36  // SSID can have up to 32 characters + null terminator + padding
 #define MAX_BSSID_LENGTH 20
@@ -68,7 +82,8 @@
 
 // Connection errors as an enumeration
 typedef enum {
-  NETWORK_WIFI_STA_CONN_OK = 0,  // WiFi connected successfully
+  NETWORK_WIFI_STA_CONN_PENDING = 1,  // Still connecting
+  NETWORK_WIFI_STA_CONN_OK = 0,       // WiFi connected successfully
   NETWORK_WIFI_STA_CONN_ERR_NOT_INITIALIZED = -1,  // WiFi not initialized
   NETWORK_WIFI_STA_CONN_ERR_INVALID_MODE = -2,     // Invalid WiFi mode
   NETWORK_WIFI_STA_CONN_ERR_MAC_FAILED = -3,       // Failed to get MAC address
@@ -103,17 +118,20 @@ typedef enum {
   WIFI_MODE_STA = 1  // Station mode
 } wifi_mode_t;
 
+// Network found by the scan. Format it with network_formatSsid() and
+// network_formatBssid() to display it
 typedef struct {
-  char ssid[MAX_SSID_LENGTH];    // SSID can have up to 32 characters + null
-                                 // terminator
-  char bssid[MAX_BSSID_LENGTH];  // BSSID in the format xx:xx:xx:xx:xx:xx + null
-                                 // terminator
-  uint16_t auth_mode;            // MSB is not used, the data is in the LSB
-  int16_t rssi;                  // Received Signal Strength Indicator
+  uint8_t bssid[NETWORK_MAC_SIZE];  // Address of the access point
+  uint8_t ssid_len;                 // Bytes of the SSID
+  uint8_t ssid[NETWORK_SSID_SIZE];  // Not ended by a zero
+  uint16_t auth_mode;  // MSB is not used, the data is in the LSB
+  int16_t rssi;        // Received Signal Strength Indicator
 } wifi_network_info_t;
 
 typedef struct {
   uint32_t magic;  // Some magic value for identification/validation
+  // While scanning, a heap with the weakest network first. After the scan,
+  // sorted with the strongest network first
   wifi_network_info_t networks[MAX_NETWORKS];
   uint16_t count;  // The number of networks found/stored
 } wifi_scan_data_t;
@@ -122,6 +140,19 @@ typedef struct {
 typedef void (*NetworkPollingCallback)(void);
 
 #ifdef CYW43_WL_GPIO_LED_PIN
+// Last connection, to join the same access point again without scanning and
+// reuse the DHCP lease
+typedef struct {
+  uint8_t bssid[NETWORK_MAC_SIZE];
+  uint8_t channel;
+  ip_addr_t ip;
+  ip_addr_t netmask;
+  ip_addr_t gateway;
+  ip_addr_t dns;
+  uint32_t lease_secs;  // Lease time granted by the DHCP server. 0 if unknown
+  bool use_lease;       // The lease is still valid: configure it statically
+} network_fast_connect_t;
+
 /**
  * @brief Registers a callback for periodic network polling.
  *
@@ -151,6 +182,14 @@ int network_initChipOnly();
  */
 int network_wifiInit(wifi_mode_t mode);
 
+/**
+ * @brief Selects the deepest power save mode or the configured one.
+ *
+ * @param deep true for the deepest power save mode, false for the power
+ * management mode of the global configuration.
+ */
+void network_setPowerSave(bool deep);
+
 /**
  * @brief Deinitializes the network stack.
  *
@@ -196,6 +235,25 @@ int network_scanIsActive();
  */
 wifi_scan_data_t* network_getFoundNetworks();
 
+/**
+ * @brief Formats the SSID of a network found by the scan.
+ *
+ * @param network The network found.
+ * @param str Where to write the SSID ended by a zero.
+ * @param size Size of str. MAX_SSID_LENGTH fits any SSID.
+ */
+void network_formatSsid(const wifi_network_info_t* network, char* str,
+                        size_t size);
+
+/**
+ * @brief Formats a BSSID as xx:xx:xx:xx:xx:xx.
+ *
+ * @param bssid The NETWORK_MAC_SIZE bytes of the address.
+ * @param str Where to write the address ended by a zero.
+ * @param size Size of str. MAX_BSSID_LENGTH fits the address.
+ */
+void network_formatBssid(const uint8_t* bssid, char* str, size_t size);
+
 /**
  * @brief Attempts connecting to a WiFi network in station mode.
  *
@@ -205,6 +263,45 @@ wifi_scan_data_t* network_getFoundNetworks();
  */
 wifi_sta_conn_process_status_t network_wifiStaConnect();
 
+/**
+ * @brief Starts to connect to the WiFi network in station mode.
+ *
+ * Configures the interface and sends the join, then returns. Step the
+ * connection with network_wifiStaConnectPoll() while polling the network.
+ *
+ * @return NETWORK_WIFI_STA_CONN_OK if the join was sent, an error otherwise.
+ */
+wifi_sta_conn_process_status_t network_wifiStaConnectStart();
+
+/**
+ * @brief Steps the connection started by network_wifiStaConnectStart().
+ *
+ * Never blocks.
+ *
+ * @return NETWORK_WIFI_STA_CONN_PENDING until the device has an address,
+ * then NETWORK_WIFI_STA_CONN_OK, or NETWORK_WIFI_STA_CONN_ERR_TIMEOUT.
+ */
+wifi_sta_conn_process_status_t network_wifiStaConnectPoll();
+
+/**
+ * @brief Sets the last connection to use in the next network_wifiStaConnect().
+ *
+ * Joins the cached BSSID on the cached channel, and if use_lease is set and
+ * DHCP is enabled, configures the cached address at once while DHCP runs in
+ * the background. The fast connection times out sooner than the full one.
+ *
+ * @param fastConnect Last connection. NULL to use the full connection path.
+ */
+void network_setFastConnect(const network_fast_connect_t* fastConnect);
+
+/**
+ * @brief Reads the current connection to cache it for the next boot.
+ *
+ * @param fastConnect Where to store the current connection.
+ * @return 0 on success, -1 if not connected.
+ */
+int network_getFastConnect(network_fast_connect_t* fastConnect);
+
 /**
  * @brief Obtains the current WiFi connection status.
  *
@@ -257,6 +354,14 @@ const char* network_getAuthTypeStringShort(u_int16_t connect_code);
  */
 ip_addr_t network_getCurrentIp();
 
+/**
+ * @brief Reads the signal strength of the access point in use.
+ *
+ * @param rssi Where to store the signal strength in dBm.
+ * @return 0 if associated with an access point, -1 otherwise.
+ */
+int network_getRssi(int32_t* rssi);
+
 #endif
 
 #endif  // NETWORK_H
@@ -0,0 +1,98 @@
+/**
+ * File: ota.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Update of the app image over HTTP
+ */
+
+#ifndef OTA_H
+#define OTA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aconfig.h"
+#include "constants.h"
+#include "debug.h"
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/watchdog.h"
+#include "httpc/httpc.h"
+#include "lwip/altcp.h"
+#include "lwip/altcp_tls.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/version.h"
+#include "network.h"
+#include "pico/cyw43_arch.h"
+#include "pico/flash.h"
+
+// Sectors of the download kept in RAM. The data is acknowledged to the
+// server once it is in the flash, so the TCP window must fit
+#define OTA_RING_SECTORS 5
+#define OTA_RING_SIZE (OTA_RING_SECTORS * FLASH_SECTOR_SIZE)
+
+_Static_assert(OTA_RING_SIZE >= TCP_WND,
+               "The OTA ring must hold the TCP window");
+
+#define OTA_HASH_SIZE 32    // SHA-256
+#define OTA_LOCKOUT_MS 100  // Maximum wait for core 1 to leave the flash
+
+// Offset of the vector table in the image: after the boot2 in the RP2040
+#if PICO_RP2350
+#define OTA_VECTOR_OFFSET 0
+#else
+#define OTA_VECTOR_OFFSET 256
+#endif
+
+typedef enum {
+  OTA_IDLE,         // No update started
+  OTA_DOWNLOADING,  // Writing the image in the staging slot
+  OTA_VERIFYING,    // Checking the hash of the image in the slot
+  OTA_FAILED        // Stopped. See ota_getError()
+} OtaState;
+
+/**
+ * @brief Starts to download an image of the app.
+ *
+ * The image is the .bin of the app, streamed into the free flash after the
+ * running binary. ota_poll() writes it, checks its SHA-256 and installs it.
+ * Only in the setup mode: the flash writes stop the interrupts. The linker
+ * scripts keep the binary in the first half of the FLASH region, so an image
+ * of the same size always fits in the slot.
+ *
+ * @param url http:// or https:// URL of the image.
+ * @param sha256 SHA-256 of the image, 64 hexadecimal digits.
+ * @return 0 if the download started, -1 otherwise. See ota_getError().
+ */
+int ota_start(const char *url, const char *sha256);
+
+/**
+ * @brief Writes the sectors received and ends the update.
+ *
+ * When the image is complete and its hash matches, copies it over the
+ * running app from RAM and reboots: it does not return. A power loss in the
+ * copy leaves the unit to be flashed through BOOTSEL. Call it from the main
+ * loop.
+ */
+void ota_poll(void);
+
+/**
+ * @brief Returns the state of the update.
+ *
+ * @param written If not NULL, the bytes written in the staging slot.
+ * @return The state.
+ */
+OtaState ota_getState(uint32_t *written);
+
+/**
+ * @brief Returns why the update failed.
+ *
+ * @return A short message. Empty if the update did not fail.
+ */
+const char *ota_getError(void);
+
+#endif  // OTA_H
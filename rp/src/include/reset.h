@@ -14,12 +14,16 @@
 #include "gconfig.h"
 #include "hardware/sync.h"
 #include "hardware/watchdog.h"
+#include "pico/flash.h"
 #include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "settings.h"
 
 #define RESET_WATCHDOG_TIMEOUT 20  // 20 ms
 
+// Time to wait for core 1 to park before erasing the settings
+#define RESET_ERASE_LOCKOUT_MS 1000
+
 /**
  * @brief Reset the current app and jump to the Booster app in flash
  *
@@ -67,7 +71,8 @@ void reset_device();
  *
  *
  * Use to reboot the device to a fabric configuration, it jumps to the start of
- * the Flash
+ * the Flash. The flash is erased through flash_safe_execute(), so call it from
+ * the main loop, never from an interrupt handler.
  *
  * @note This function should not return. If it does, an error message is
  * printed.
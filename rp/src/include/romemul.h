@@ -19,14 +19,100 @@
 #include "hardware/dma.h"
 #include "hardware/pio.h"
 #include "hardware/structs/bus_ctrl.h"
+#include "hardware/structs/systick.h"
 #include "hardware/vreg.h"
 #include "memfunc.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
+#include "trace.h"
 
 #define ROMEMUL_BUS_BITS 17
 
+// Bit of the captured address set when the access is in the ROM3 range
+#define ROMEMUL_ROM3_ADDRESS_BIT 0x00010000
+
+#ifndef ROMEMUL_ROM3_CAPTURE
+#define ROMEMUL_ROM3_CAPTURE 0  // Set to 1 to capture the addresses in a ring
+#endif
+
+#ifndef ROMEMUL_ROM3_PIO_FILTER
+#define ROMEMUL_ROM3_PIO_FILTER 0  // Set to 1 to detect the header in the PIO
+#endif
+
+#if (ROMEMUL_ROM3_CAPTURE == 1) && (ROMEMUL_ROM3_PIO_FILTER == 1)
+#error "ROMEMUL_ROM3_CAPTURE and ROMEMUL_ROM3_PIO_FILTER are exclusive"
+#endif
+
+#ifndef ROMEMUL_CORE1_BUS
+#define ROMEMUL_CORE1_BUS 0  // Set to 1 to service the bus from core 1
+#endif
+
+#ifndef ROMEMUL_SELF_TEST
+#define ROMEMUL_SELF_TEST 0  // Set to 1 to generate the bus load in the PIO
+#endif
+
+// Cycles of the loop of bus_loadgen. The shortest period between accesses
+#define ROMEMUL_LOADGEN_LOOP_CYCLES 5
+
+// Timers in the alarm pool of core 1
+#define ROMEMUL_CORE1_MAX_TIMERS 4
+
+// Instruction memory of a PIO block
+#define ROMEMUL_PIO_INSTRUCTIONS 32
+
+// Room kept in a PIO block for the SPI program the CYW43 driver loads there
+#define ROMEMUL_CYW43_SPI_INSTRUCTIONS 11
+
+// Instructions of a program assembled by pioasm, as a constant expression
+#define ROMEMUL_PROGRAM_LENGTH(name) \
+  (sizeof(name##_program_instructions) / sizeof(uint16_t))
+
+// Protocol header to look for in the PIO filter. Same as PROTOCOL_HEADER
+#define ROMEMUL_FILTER_HEADER 0xABCD
+
+// The ring must be aligned to its size in bytes for the DMA address wrapping
+#define ROMEMUL_CAPTURE_RING_BITS 13  // 8KB ring
+#define ROMEMUL_CAPTURE_RING_BYTES (1u << ROMEMUL_CAPTURE_RING_BITS)
+#define ROMEMUL_CAPTURE_RING_WORDS (ROMEMUL_CAPTURE_RING_BYTES / 4)
+#define ROMEMUL_CAPTURE_RING_MASK (ROMEMUL_CAPTURE_RING_WORDS - 1)
+
+// Words ahead of the DMA write position left out of the overrun check
+#define ROMEMUL_CAPTURE_GUARD_WORDS 16
+
+// Interval to drain the ring. The bus can't fill half of the ring in this time
+#define ROMEMUL_CAPTURE_POLL_US 250
+
+// Delay field of the instructions of romemul_read. The side-set takes three
+// of the five bits, so the waits can be between 0 and 3 cycles
+#define ROMEMUL_DELAY_SHIFT 8
+#define ROMEMUL_MAX_WAIT_CYCLES 3
+
+// Source field of the mov at select_base of romemul_read. X holds the base of
+// the first image and Y the base of the second one
+#define ROMEMUL_MOV_SOURCE_MASK 0x7
+#define ROMEMUL_MOV_SOURCE_X 0x1
+#define ROMEMUL_MOV_SOURCE_Y 0x2
+
+// ROM images the DMA can read. Only the RP2350 has room for a second one
+#if PICO_RP2350
+#define ROMEMUL_IMAGES 2
+#else
+#define ROMEMUL_IMAGES 1
+#endif
+
+// Slowest clock divider of the bus state machines
+#define ROMEMUL_MAX_DIVIDER 4.0f
+
 typedef void (*IRQInterceptionCallback)();
 
+// Function to handle each ROM3 address drained from the capture ring
+typedef void (*CaptureAddressCallback)(uint32_t addr);
+
+// Function to handle each address forwarded by the PIO filter. Returns true
+// while the frame is still in flight, false to look for the next header
+typedef bool (*FrameAddressCallback)(uint32_t addr);
+
 // extern int read_addr_rom_dma_channel;
 // extern int lookup_data_rom_dma_channel;
 
@@ -38,4 +124,167 @@ void dma_irqHandlerLookup(void);
 void dma_irqHandlerAddress(void);
 void dma_setResponseCB(IRQInterceptionCallback responseCallback);
 
+/**
+ * @brief Sets the callback to process the captured ROM3 addresses.
+ *
+ * Only available when ROMEMUL_ROM3_CAPTURE is enabled. Disables the per access
+ * DMA interrupt and starts a repeating timer that drains the capture ring in
+ * batches, calling the callback once for each ROM3 address found.
+ *
+ * @param captureCallback The callback to invoke for each ROM3 address.
+ * @return 0 on success, negative value on error.
+ */
+int dma_setCaptureCB(CaptureAddressCallback captureCallback);
+
+/**
+ * @brief Returns the times the capture ring overran before it was drained.
+ *
+ * Each overrun drops the unread addresses of the ring. Always 0 when
+ * ROMEMUL_ROM3_CAPTURE is disabled.
+ *
+ * @return Number of overruns since boot.
+ */
+uint32_t romemul_getCaptureOverruns(void);
+
+/**
+ * @brief Sets the callback to process the frames found by the PIO filter.
+ *
+ * Only available when ROMEMUL_ROM3_PIO_FILTER is enabled. Disables the per
+ * access DMA interrupt and enables the PIO interrupt of the filter, so the
+ * CPU is only interrupted after a protocol header is found on the bus.
+ *
+ * @param frameCallback The callback to invoke for each forwarded address.
+ * @return 0 on success, negative value on error.
+ */
+int dma_setFrameCB(FrameAddressCallback frameCallback);
+
+/**
+ * @brief Moves the bus servicing to core 1.
+ *
+ * Only available when ROMEMUL_CORE1_BUS is enabled. Launches core 1 and moves
+ * the DMA interrupt to it. From now on, the dma_set*CB functions install the
+ * handlers in core 1, so the network polling and the flash operations in core
+ * 0 can't delay the commands from the computer.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int romemul_launchCore1Bus(void);
+
+/**
+ * @brief Sets the function core 1 calls each time it wakes up.
+ *
+ * Use it to process the commands queued by the interrupt handler in core 1.
+ * Pass NULL to stop calling it.
+ *
+ * @param loopCallback The function to call, or NULL.
+ * @return 0 on success, negative value on error.
+ */
+int romemul_setCore1Loop(IRQInterceptionCallback loopCallback);
+
+/**
+ * @brief Waits until the bus interrupt handlers running now have returned.
+ *
+ * Core 1 only reads its FIFO from its main loop, so its answer means that no
+ * handler is in progress. Without core 1, the handlers run in this core and
+ * cannot be in progress while it calls this function. Call it from the main
+ * loop, after disarming something the handlers use and before freeing it.
+ */
+void romemul_waitBusIrqs(void);
+
+/**
+ * @brief Changes the timing of the bus state machines on the fly.
+ *
+ * Patches the delay of the waits of romemul_read in the instruction memory
+ * and sets the clock divider of the monitors and the emulator. Call it after
+ * init_romemul().
+ *
+ * @param waitCycles Cycles of each wait, READ_ADDRESS_SAFE_WAIT_CYCLES by
+ * default.
+ * @param divider Clock divider, SAMPLE_DIV_FREQ by default. Relative to
+ * RP2040_CLOCK_FREQ_KHZ, so it is scaled to the system clock.
+ * @return 0 on success, -1 if the emulator is not running or the timing is
+ * out of range.
+ */
+int romemul_setBusTiming(uint8_t waitCycles, float divider);
+
+/**
+ * @brief Returns the address in RAM of a ROM image.
+ *
+ * Image 0 is the one loaded at boot. The other ones are free to be loaded
+ * while the Atari ST reads the active one.
+ *
+ * @param image Image between 0 and ROMEMUL_IMAGES - 1.
+ * @return Address of the 128KB of the image, or 0 if there is no such image.
+ */
+uint32_t romemul_getImageAddress(uint8_t image);
+
+/**
+ * @brief Switches the ROM image the Atari ST reads.
+ *
+ * Rewrites the mov at select_base of romemul_read to take the base from X or
+ * Y. It is a single write to the instruction memory, so every bus cycle reads
+ * the whole word from one image or the other. The shared memory of the apps
+ * is only updated in image 0. Call it after init_romemul().
+ *
+ * @param image Image between 0 and ROMEMUL_IMAGES - 1.
+ * @return 0 on success, -1 if the emulator is not running, there is no such
+ * image or the PIO filter, which compares the addresses with the base of
+ * image 0, is enabled.
+ */
+int romemul_selectImage(uint8_t image);
+
+/**
+ * @brief Returns the ROM image the Atari ST reads.
+ *
+ * @return Image between 0 and ROMEMUL_IMAGES - 1.
+ */
+uint8_t romemul_getActiveImage(void);
+
+/**
+ * @brief Sets the system clock the dividers of the bus are scaled to.
+ *
+ * Call it before init_romemul() when the system clock is not
+ * RP2040_CLOCK_FREQ_KHZ.
+ *
+ * @param clockKhz System clock in KHz.
+ * @return 0 on success, -1 if the emulator is running or the clock is slower
+ * than RP2040_CLOCK_FREQ_KHZ.
+ */
+int romemul_setSystemClock(uint32_t clockKhz);
+
+/**
+ * @brief Returns the current timing of the bus state machines.
+ *
+ * @param waitCycles Where to store the cycles of each wait.
+ * @param divider Where to store the clock divider.
+ */
+void romemul_getBusTiming(uint8_t *waitCycles, float *divider);
+
+/**
+ * @brief Returns the read address register of the lookup DMA.
+ *
+ * It holds the address of the last word served to the bus, so another DMA
+ * channel can sample it without adding work to the chain.
+ *
+ * @return The register, or NULL before init_romemul().
+ */
+const volatile uint32_t *romemul_getLookupAddress(void);
+
+/**
+ * @brief Starts the bus load generator with a new period.
+ *
+ * Only available when ROMEMUL_SELF_TEST is enabled. Restarts the state
+ * machine of bus_loadgen, which takes the place of romemul_read, and waits for
+ * the raw addresses of the pattern in the TX FIFO. Each one is pushed to the
+ * DMA chain of the bus after the period. Call it after init_romemul().
+ *
+ * @param periodCycles System clock cycles between two accesses, at least
+ * ROMEMUL_LOADGEN_LOOP_CYCLES.
+ * @param txFifo Where to store the TX FIFO to write the pattern to.
+ * @param dreq Where to store the DREQ of the TX FIFO.
+ * @return 0 on success, -1 if not available or the period is too short.
+ */
+int romemul_startLoadGen(uint32_t periodCycles, volatile uint32_t **txFifo,
+                         uint *dreq);
+
 #endif  // ROMEMUL_H
\ No newline at end of file
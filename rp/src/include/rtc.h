@@ -9,10 +9,17 @@
 #ifndef RTC_H
 #define RTC_H
 
+#include <math.h>
+
 #include "aconfig.h"
+#include "bustrace.h"
 #include "constants.h"
 #include "debug.h"
-#include "hardware/rtc.h"
+#include "dispatch.h"
+#include "rtcclock.h"
+#include "rtcmsg.h"
+#include "httpc/httpc.h"
+#include "lwip/dhcp.h"
 #include "lwip/dns.h"
 #include "lwip/udp.h"
 #include "memfunc.h"
@@ -20,6 +27,8 @@
 #include "pico/cyw43_arch.h"
 #include "time.h"
 #include "tprotocol.h"
+#include "trace.h"
+#include "tzrules.h"
 
 // Size of the shared variables of the shared functions
 #define SHARED_VARIABLE_SHARED_FUNCTIONS_SIZE \
@@ -29,29 +38,62 @@
 #define SHARED_VARIABLE_HARDWARE_TYPE 0
 #define SHARED_VARIABLE_SVERSION 1
 #define SHARED_VARIABLE_BUFFER_TYPE 2
+#define SHARED_VARIABLE_SYNC_TIMEOUT \
+  3  // Iterations of the sync wait loop, calibrated by the computer. 0 if not
+#define SHARED_VARIABLE_RESIDENT_ADDR \
+  4  // Resident code copied to RAM by the computer. 0 if it runs from ROM
 
-#define RTCEMUL_RANDOM_TOKEN_OFFSET \
-  0xF000  // Random token offset in the shared memory
-#define RTCEMUL_RANDOM_TOKEN_SEED_OFFSET \
-  (RTCEMUL_RANDOM_TOKEN_OFFSET + 4)  // random_token + 4 bytes
-#define RTCEMUL_NTP_SUCCESS \
-  (RTCEMUL_RANDOM_TOKEN_SEED_OFFSET + 4)  // random_token_seed + 4 bytes
-#define RTCEMUL_DATETIME_BCD (RTCEMUL_NTP_SUCCESS + 4)  // ntp_success + 4 bytes
-#define RTCEMUL_DATETIME_MSDOS \
-  (RTCEMUL_DATETIME_BCD + 8)  // datetime_bcd + 8 bytes
-#define RTCEMUL_OLD_XBIOS_TRAP \
-  (RTCEMUL_DATETIME_MSDOS + 8)  // datetime_msdos + 8 bytes
-#define RTCEMUL_REENTRY_TRAP \
-  (RTCEMUL_OLD_XBIOS_TRAP + 4)                        // old_bios trap + 4 bytes
-#define RTCEMUL_Y2K_PATCH (RTCEMUL_REENTRY_TRAP + 4)  // reentry_trap + 4 byte
-#define RTCEMUL_SHARED_VARIABLES (RTCEMUL_Y2K_PATCH + 8)  // y2k_patch + 4 bytes
+// Index for the shared variables of the app, after the shared functions
+#define SHARED_VARIABLE_RTC_DISCIPLINE \
+  (SHARED_VARIABLE_SHARED_FUNCTIONS_SIZE + 0)  // Non zero: VBL clock check
+#define SHARED_VARIABLE_RTC_GEMDOS_HOOK \
+  (SHARED_VARIABLE_SHARED_FUNCTIONS_SIZE + 1)  // Non zero: Tgettime/Tgetdate
 
 #define NTP_DEFAULT_HOST "pool.ntp.org"
 #define NTP_DEFAULT_PORT 123
 #define NTP_DELTA 2208988800  // seconds between 1 Jan 1900 and 1 Jan 1970
 #define NTP_MSG_LEN 48        // ignore Authenticator (optional)
 
-#define ADDRESS_HIGH_BIT 0x8000  // High bit of the address
+#define RTCEMUL_NTP_TIMEOUT_MS \
+  5000  // Time to wait for the DNS and the NTP answer before retrying
+#define RTCEMUL_NTP_MAX_ATTEMPTS 3  // Give up after this number of attempts
+#define RTCEMUL_NTP_MAX_SERVERS \
+  4  // NTP servers queried in parallel: the configured one and the fallbacks
+#define RTCEMUL_NTP_COLLECT_MS \
+  250  // Wait for other answers after the first one to pick the lowest RTT
+#define RTCEMUL_NTP_CACHE_TTL_S \
+  86400  // Default validity of the cached NTP server address
+
+// Periodic resync. The interval doubles while the clock is stable
+#define RTCEMUL_NTP_RESYNC_MIN_S 64        // First resync after the sync
+#define RTCEMUL_NTP_RESYNC_MAX_S 16384     // About four and a half hours
+#define RTCEMUL_NTP_STABLE_US 50000        // Offset to double the interval
+#define RTCEMUL_NTP_STEP_US 1000000        // Step instead of slew over this
+#define RTCEMUL_NTP_SLEW_MAX_PPM 500       // Maximum rate of the slew
+#define RTCEMUL_NTP_MAX_DRIFT_PPB 500000   // Ignore drifts over this
+#ifndef RTCEMUL_SYNC_HISTORY
+#define RTCEMUL_SYNC_HISTORY 8  // Last syncs kept for the telemetry
+#endif
+
+// HTTP Date header time source, raced against NTP where UDP is blocked
+#define RTCEMUL_HTTP_TIME_URL "/"  // Only the headers are read
+#define RTCEMUL_HTTP_DATE_MAX_LENGTH \
+  40  // Enough for "Date: Tue, 14 Oct 2025 10:00:00 GMT"
+
+// Date and time used until the NTP server answers when there is no last known
+// time: no warm state, no checkpoint and no valid RELEASE_DATE.
+// 2025-01-01 00:00:00
+#define RTCEMUL_FALLBACK_YEAR 2025
+#define RTCEMUL_FALLBACK_MONTH 1
+#define RTCEMUL_FALLBACK_DAY 1
+#define RTCEMUL_FALLBACK_DOTW 3  // Wednesday
+
+// Warm start: the clock survives the watchdog reboots in uninitialized RAM
+#define RTCEMUL_WARM_MAGIC 0x57524D43  // "WRMC"
+#define RTCEMUL_WARM_RESET_LATENCY_S \
+  1  // The checkpoint is up to one second old when the reset happens
+#define RTCEMUL_CHECKPOINT_INTERVAL_S \
+  86400  // Minimum time between two checkpoints of the clock in the flash
 
 #ifndef ROM3_GPIO
 #define ROM3_GPIO 26
@@ -69,15 +111,28 @@
   (APP_RTCEMUL << 8 | 1)  // Read the time from the internal RTC
 #define RTCEMUL_SAVE_VECTORS \
   (APP_RTCEMUL << 8 | 2)  // Save the vectors of the RTC emulator
-#define RTCEMUL_REENTRY_LOCK \
-  (APP_RTCEMUL << 8 |        \
-   3)  // Command code to lock the reentry to XBIOS in the Sidecart
-#define RTCEMUL_REENTRY_UNLOCK \
-  (APP_RTCEMUL << 8 |          \
-   4)  // Command code to unlock the reentry to XBIOS in the Sidecart
+// Commands 3 and 4 were used to lock and unlock the XBIOS reentry. Not used
+// anymore since the XBIOS handler never calls the XBIOS again
 #define RTCEMUL_SET_SHARED_VAR (APP_RTCEMUL << 8 | 5)  // Set a shared variable
+#define RTCEMUL_SET_SHARED_VARS \
+  (APP_RTCEMUL << 8 | 6)  // Set several (index, value) shared variable pairs
 
 #define RTCEMUL_PARAMETERS_MAX_SIZE 20  // Maximum size of the parameters
+// Pairs that fit in the payload of RTCEMUL_SET_SHARED_VARS after the token
+#define RTCEMUL_SHARED_VARS_MAX_PAIRS \
+  ((RTCEMUL_PARAMETERS_MAX_SIZE - 4) / 8)
+
+#define RTCEMUL_DATETIME_REFRESH_MS \
+  1000  // Refresh the date and time in the shared memory every second
+
+// Dallas DS1216 SmartWatch emulation
+#define RTCEMUL_DALLAS_MAGIC_START \
+  2  // First entry of the magic sequence. The first two are not used
+#define RTCEMUL_DALLAS_ADDRESS_SHIFT \
+  1  // The address lines A1-A4 encode the access type
+#define RTCEMUL_DALLAS_ADDRESS_MASK 0x0F   // Access type bits after the shift
+#define RTCEMUL_DALLAS_BLOCK_MASK 0xFFE0   // Block of the access type lines
+#define RTCEMUL_DALLAS_DATA_BIT 0x0001     // The clock answers in D0
 
 typedef enum {
   RTC_SIDECART,
@@ -87,20 +142,82 @@ typedef enum {
   RTC_UNKNOWN
 } RTC_TYPE;
 
+// Each NTP server queried in parallel. The answers are matched by the
+// originate timestamp, which echoes the transmit timestamp of the request
+typedef struct NTP_SERVER_T {
+  char host[SETTINGS_MAX_VALUE_LENGTH];
+  ip_addr_t ipaddr;
+  bool resolved;
+  bool sent;
+  bool answered;
+  bool error;
+  bool cached;           // Address from the settings, no DNS query
+  bool local;            // Server of the network, queried alone first
+  uint8_t stratum;       // Stratum of the answer
+  uint64_t originate;    // Transmit timestamp sent in the request
+  uint64_t sent_us;      // Local time when the request was sent
+  uint64_t recv_us;      // Local time when the answer was received
+  uint64_t transmit_us;  // Server transmit time, us since the NTP epoch
+  int64_t rtt_us;        // Round trip delay without the server processing
+} NTP_SERVER;
+
+// Sync of the software clock, for the answers of the local NTP server
+typedef struct {
+  uint8_t stratum;   // Stratum of the upstream server
+  uint32_t refId;    // IPv4 address of the upstream server, network order
+  uint32_t rttUs;    // Round trip of the last sync
+  int64_t refUtcUs;  // UTC time of the last sync, us since 1970
+} NTP_REFERENCE;
+
+// A sync of the software clock with a time server
+typedef struct {
+  uint32_t bootSecs;  // Seconds since boot
+  uint32_t rttUs;     // Round trip of the answer. 0 from the HTTP Date header
+  int32_t offsetUs;   // Error of the clock corrected. 0 in the first sync
+  int32_t driftPpb;   // Drift of the crystal after the sync
+} NTP_SYNC_RECORD;
+
 typedef struct NTP_TIME_T {
-  ip_addr_t ntp_ipaddr;
+  ip_addr_t ntp_ipaddr;  // Server of the selected answer
   struct udp_pcb *ntp_pcb;
-  bool ntp_server_found;
-  bool ntp_error;
+  NTP_SERVER servers[RTCEMUL_NTP_MAX_SERVERS + 1];  // Plus the cached one
+  int server_count;
+  volatile bool ntp_synced;
 } NTP_TIME;
 
+// Last known clock, kept in RAM not initialized by the runtime. It is valid
+// only if the magic and the checksum match
+typedef struct {
+  uint32_t magic;
+  uint32_t utc_secs;     // Last known time, seconds since 1970
+  uint32_t sync_secs;    // Time of the last NTP sync, seconds since 1970
+  uint32_t uptime_secs;  // Monotonic time since boot at the checkpoint
+  int32_t drift_ppb;     // Measured drift of the crystal
+  uint32_t checksum;
+} RTC_WARM_STATE;
+
+// States of the NTP query. It runs in the background while the emulation
+// starts with the last known time
+typedef enum {
+  RTC_NTP_IDLE,        // Not started
+  RTC_NTP_RESOLVING,   // Waiting for the DNS answer
+  RTC_NTP_REQUESTING,  // Waiting for the NTP answers
+  RTC_NTP_ALIGNING,    // Waiting for the next second boundary to set the RTC
+  RTC_NTP_SYNCED,      // The RTC is set by the NTP server
+  RTC_NTP_FAILED       // No answer after all the attempts
+} RTC_NTP_STATE;
+
 // DAllas RTC. Info here:
 // https://pdf1.alldatasheet.es/datasheet-pdf/view/58439/DALLAS/DS1216.html
+// The clock sequence is double buffered: the refresh timer writes the idle
+// buffer and flips clock_sequence_active, while the bus handler latches the
+// active buffer when the magic sequence is recognized.
 typedef struct {
   uint64_t last_magic_found;
   uint16_t retries;
   uint64_t magic_sequence_hex;
-  uint8_t clock_sequence[64];
+  uint8_t clock_sequence[2][64];
+  volatile uint8_t clock_sequence_active;
   uint8_t read_address_bit;
   uint8_t write_address_bit_zero;
   uint8_t write_address_bit_one;
@@ -108,12 +225,131 @@ typedef struct {
   uint16_t size_magic_sequence;
   uint16_t size_clock_sequence;
   uint32_t rom_address;
+  // Bus state machine
+  uint16_t magic_index;         // Next entry of magic_sequence to match
+  uint16_t clock_index;         // Next bit of the clock sequence to answer
+  const uint8_t *clock_latch;   // Clock sequence latched on unlock
+  uint16_t *answer_word;        // ROM word the clock bits are answered from
+  uint16_t answer_word_saved;   // Original content of the answer word
 } DallasClock;
 
-int rtc_queryNTPTime();
+/**
+ * @brief Starts the NTP query in the background.
+ *
+ * Reads the NTP settings, starts the internal RTC with the last known time and
+ * sends the DNS query. Call rtc_pollNTPQuery() periodically to advance it.
+ *
+ * @return 0 if the query was started, -1 otherwise.
+ */
+int rtc_startNTPQuery();
+
+/**
+ * @brief Advances the NTP query state machine. Never blocks.
+ *
+ * @return The state of the NTP query.
+ */
+RTC_NTP_STATE rtc_pollNTPQuery();
+
+/**
+ * @brief Tells if no time query is in flight.
+ *
+ * @return true between the resyncs, false while querying the time servers.
+ */
+bool rtc_isNTPIdle();
+
+/**
+ * @brief Returns the time left to the next NTP resync.
+ *
+ * @return Microseconds to the next resync, negative if it is due, or INT64_MAX
+ * if there is none scheduled.
+ */
+int64_t rtc_getNextSyncUs();
+
+/**
+ * @brief Holds the resyncs while the network is down.
+ *
+ * @param suspend true to hold the resyncs, false to run them again.
+ */
+void rtc_suspendNTP(bool suspend);
+
+/**
+ * @brief Brings the next NTP resync forward to now.
+ *
+ * @return 0 if the resync starts in the next rtc_pollNTPQuery(), -1 if there
+ * is no network or a query is already in flight.
+ */
+int rtc_requestNTPSync();
+
+/**
+ * @brief Persists the NTP server address cache and the clock checkpoint.
+ *
+ * Only stores them when the cache changed or the checkpoint is old. The
+ * next aconfig_flush() writes them to the flash, so call both before the
+ * emulation runtime starts.
+ *
+ * @return 0 always.
+ */
+int rtc_saveState();
+
+/**
+ * @brief Forgets the clock kept across resets.
+ *
+ * Call it before leaving the app for an unknown time, like jumping to the
+ * Booster app.
+ */
+void rtc_invalidateWarmStart();
+
+/**
+ * @brief Reads the current time if it can be trusted.
+ *
+ * The time is trusted after a warm start or after a sync with a time server,
+ * but not when it comes from the flash checkpoint of a cold boot.
+ *
+ * @param secs Where to store the seconds since 1970.
+ * @return true if the time is trusted, false otherwise.
+ */
+bool rtc_getTrustedTime(uint32_t *secs);
+
+/**
+ * @brief Reads the details of the last sync with a time server.
+ *
+ * @param host Where to store the host of the server. Empty before the first
+ * sync.
+ * @param rttUs Where to store the round trip of the answer in microseconds.
+ * 0 if the time came from the HTTP Date header.
+ * @return The seconds since the last sync, or RTCEMUL_SYNC_AGE_NEVER.
+ */
+uint32_t rtc_getLastSync(const char **host, uint32_t *rttUs);
+
+/**
+ * @brief Reads the UTC time of the software clock to answer a NTP query.
+ *
+ * @param monoUs Instant to read, from time_us_64().
+ * @param utcUs Where to store the UTC time in microseconds since 1970.
+ * @param ref Where to store the details of the last sync.
+ * @return true if the clock is synced with a NTP server, false before the
+ * first sync or when the time came from the HTTP Date header.
+ */
+bool rtc_getNtpTime(uint64_t monoUs, int64_t *utcUs, NTP_REFERENCE *ref);
+
+/**
+ * @brief Reads the last syncs of the software clock.
+ *
+ * @param records Where to store the syncs, the newest first.
+ * @param max Room in records. Up to RTCEMUL_SYNC_HISTORY are kept.
+ * @return The number of syncs stored.
+ */
+int rtc_getSyncHistory(NTP_SYNC_RECORD *records, int max);
 int rtc_preinit();
 int rtc_postinit();
-void rtc_loop();
-void __not_in_flash_func(rtc_dma_irq_handler_lookup)(void);
+
+/**
+ * @brief Runs the DS1216 state machine for an access to ROM4.
+ *
+ * Called by the bus interrupt once the Dallas RTC is emulated.
+ *
+ * @param addr The address of the access.
+ */
+void TPROTO_IRQ_FUNC(rtc_dallasAccessHandler)(uint32_t addr);
 
 #endif  // RTC_H
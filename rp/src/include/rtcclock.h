@@ -0,0 +1,83 @@
+/**
+ * File: rtcclock.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Calendar clock of the RP2040 and the RP2350
+ */
+
+#ifndef RTCCLOCK_H
+#define RTCCLOCK_H
+
+#include <stdbool.h>
+
+#include "pico/stdlib.h"
+
+#if PICO_RP2040
+#include "hardware/rtc.h"
+#else
+// The RP2350 has no RTC block. The always on timer of the power manager keeps
+// the time instead, and these functions give it the API of the RP2040 RTC.
+// The build defines PICO_INCLUDE_RTC_DATETIME to keep datetime_t
+#include <time.h>
+
+#include "pico/aon_timer.h"
+
+static inline void rtcclock_toTm(const datetime_t *dt, struct tm *tm) {
+  tm->tm_year = dt->year - 1900;
+  tm->tm_mon = dt->month - 1;
+  tm->tm_mday = dt->day;
+  tm->tm_wday = dt->dotw;
+  tm->tm_hour = dt->hour;
+  tm->tm_min = dt->min;
+  tm->tm_sec = dt->sec;
+  tm->tm_isdst = 0;
+}
+
+/**
+ * @brief Does nothing. The timer is started when the time is first set.
+ */
+static inline void rtc_init(void) {}
+
+/**
+ * @brief Sets the time of the always on timer, starting it if needed.
+ *
+ * @param t The new time.
+ * @return true if the time is set, false if it is not valid.
+ */
+static inline bool rtc_set_datetime(const datetime_t *t) {
+  if ((t->month < 1) || (t->month > 12) || (t->day < 1) || (t->day > 31) ||
+      (t->hour > 23) || (t->min > 59) || (t->sec > 59)) {
+    return false;
+  }
+  struct tm tm = {0};
+  rtcclock_toTm(t, &tm);
+  if (!aon_timer_is_running()) {
+    return aon_timer_start_calendar(&tm);
+  }
+  return aon_timer_set_time_calendar(&tm);
+}
+
+/**
+ * @brief Reads the time of the always on timer.
+ *
+ * @param t Where to write the time.
+ * @return true if the timer is running, false otherwise.
+ */
+static inline bool rtc_get_datetime(datetime_t *t) {
+  struct tm tm = {0};
+  if (!aon_timer_is_running() || !aon_timer_get_time_calendar(&tm)) {
+    return false;
+  }
+  t->year = (int16_t)(tm.tm_year + 1900);
+  t->month = (int8_t)(tm.tm_mon + 1);
+  t->day = (int8_t)tm.tm_mday;
+  t->dotw = (int8_t)tm.tm_wday;
+  t->hour = (int8_t)tm.tm_hour;
+  t->min = (int8_t)tm.tm_min;
+  t->sec = (int8_t)tm.tm_sec;
+  return true;
+}
+#endif
+
+#endif  // RTCCLOCK_H
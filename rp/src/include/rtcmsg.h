@@ -0,0 +1,79 @@
+/**
+ * File: rtcmsg.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Date and time published in the shared memory for the computer
+ */
+
+#ifndef RTCMSG_H
+#define RTCMSG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "memfunc.h"
+#include "pico/stdlib.h"
+
+#define RTCEMUL_RANDOM_TOKEN_OFFSET \
+  0xF000  // Random token offset in the shared memory
+#define RTCEMUL_RANDOM_TOKEN_SEED_OFFSET \
+  (RTCEMUL_RANDOM_TOKEN_OFFSET + 4)  // random_token + 4 bytes
+#define RTCEMUL_NTP_SUCCESS \
+  (RTCEMUL_RANDOM_TOKEN_SEED_OFFSET + 4)  // random_token_seed + 4 bytes
+#define RTCEMUL_DATETIME_BCD (RTCEMUL_NTP_SUCCESS + 4)  // ntp_success + 4 bytes
+#define RTCEMUL_DATETIME_MSDOS \
+  (RTCEMUL_DATETIME_BCD + 8)  // datetime_bcd + 8 bytes
+#define RTCEMUL_OLD_XBIOS_TRAP \
+  (RTCEMUL_DATETIME_MSDOS + 8)  // datetime_msdos + 8 bytes
+#define RTCEMUL_OLD_GEMDOS_TRAP \
+  (RTCEMUL_OLD_XBIOS_TRAP + 4)  // old_bios trap + 4 bytes
+#define RTCEMUL_Y2K_PATCH \
+  (RTCEMUL_OLD_GEMDOS_TRAP + 4)  // old_gemdos trap + 4 bytes
+#define RTCEMUL_DATETIME_SEQ \
+  (RTCEMUL_Y2K_PATCH + 4)  // y2k_patch + 4 bytes. Odd while updating
+#define RTCEMUL_DRIFT_PPB \
+  (RTCEMUL_DATETIME_SEQ + 4)  // datetime_seq + 4 bytes. Crystal drift in ppb
+#define RTCEMUL_SYNC_AGE \
+  (RTCEMUL_DRIFT_PPB + 4)  // drift_ppb + 4 bytes. Seconds since the last sync
+#define RTCEMUL_SHARED_VARIABLES \
+  (RTCEMUL_SYNC_AGE + 4)  // sync_age + 4 bytes
+
+#define RTCEMUL_SYNC_AGE_NEVER 0xFFFFFFFF  // No NTP sync since boot
+
+/**
+ * @brief Converts a binary number from 0 to 99 to BCD.
+ *
+ * @param val The number to convert.
+ * @return The two BCD digits.
+ */
+uint8_t rtcmsg_toBcd(uint8_t val);
+
+/**
+ * @brief Adds two BCD numbers, dropping the carry out of the hundreds.
+ *
+ * @param bcd1 The first number.
+ * @param bcd2 The second number.
+ * @return The two BCD digits of the sum.
+ */
+uint8_t rtcmsg_addBcd(uint8_t bcd1, uint8_t bcd2);
+
+/**
+ * @brief Publishes the date and time in the shared memory.
+ *
+ * Writes the IKBD message with the date in BCD, the MSDOS date and time and
+ * the quality of the clock. The sequence counter is odd while the block is
+ * being written, so the computer can detect a torn read and retry. Quiet,
+ * because it is also called from the refresh timer.
+ *
+ * @param memSharedAddr Base of the shared memory.
+ * @param now The local date and time.
+ * @param y2kPatch True to add the Y2K offset to the year of the IKBD message.
+ * Otherwise the patch of the computer is disabled too.
+ * @param driftPpb The drift of the crystal, in ppb.
+ * @param syncAge Seconds since the last sync, or RTCEMUL_SYNC_AGE_NEVER.
+ */
+void rtcmsg_setDatetime(uintptr_t memSharedAddr, const datetime_t *now,
+                        bool y2kPatch, int32_t driftPpb, uint32_t syncAge);
+
+#endif  // RTCMSG_H
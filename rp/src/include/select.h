@@ -11,12 +11,12 @@
 
 #include "constants.h"
 #include "debug.h"
-#include "pico/multicore.h"
 #include "pico/stdlib.h"
 
 #define SELECT_LOOP_DELAY 10  // 10 ms
 
 #define SELECT_LONG_RESET 10000  // 10 seconds
+#define SELECT_DEBOUNCE_MS 50    // Edges ignored after the push starts
 
 // Define a callback typdef for the reset function
 typedef void (*reset_callback_t)();
@@ -47,11 +47,14 @@ void select_waitPush();
 bool select_detectPush();
 
 /**
- * @brief Waits for push in secondary core.
+ * @brief Waits for push using the GPIO interrupt.
  *
- * Launches an asynchronous wait for a SELECT button push on the secondary core.
- * Accepts two callbacks: one for short press reset and one for long press
- * reset.
+ * Enables an edge interrupt on the SELECT button, so no core is spent polling
+ * it. A release before SELECT_LONG_RESET ms is a short press, and a push held
+ * for SELECT_LONG_RESET ms is a long press. The edges within SELECT_DEBOUNCE_MS
+ * of the push are contact bounce and ignored. Accepts two callbacks: one for
+ * short press reset and one for long press reset. Both are called from an
+ * interrupt handler, so they should only flag the work for the main loop.
  *
  * @param reset Callback to be invoked on a short button press.
  * @param resetLong Callback to be invoked on a long button press.
@@ -59,11 +62,10 @@ bool select_detectPush();
 void select_coreWaitPush(reset_callback_t reset, reset_callback_t resetLong);
 
 /**
- * @brief Disables secondary core wait.
+ * @brief Disables the SELECT button interrupt.
  *
- * Disables waiting for the SELECT button push on the secondary core.
- *
- * Useful to cancel or adjust the handling in multicore scenarios.
+ * Disables waiting for the SELECT button push and cancels any pending long
+ * press detection.
  */
 void select_coreWaitPushDisable();
 
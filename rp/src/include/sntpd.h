@@ -0,0 +1,41 @@
+/**
+ * File: sntpd.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Local SNTP server for the other devices of the network
+ */
+
+#ifndef SNTPD_H
+#define SNTPD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "pico/cyw43_arch.h"
+#include "rtc.h"
+
+// Fields of the answer, see RFC 4330
+#define SNTPD_MODE_CLIENT 3
+#define SNTPD_MODE_SERVER 4
+#define SNTPD_MAX_STRATUM 15   // 16 means not synced
+#define SNTPD_PRECISION (-20)  // log2 of the resolution: about 1 us
+#define SNTPD_DISPERSION_PPM \
+  15  // Error added per second since the last sync, like NTP
+
+/**
+ * @brief Answers the SNTP queries on the UDP port 123.
+ *
+ * The answers use the software clock, and only after a sync with a NTP
+ * server. Until then the queries are ignored, so the clients try their
+ * other servers. Call it once the network is up.
+ *
+ * @return 0 if the server is listening, -1 otherwise.
+ */
+int sntpd_start(void);
+
+#endif  // SNTPD_H
@@ -0,0 +1,88 @@
+/**
+ * File: status.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Status of the device published in the shared memory
+ */
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "constants.h"
+#include "debug.h"
+#include "dispatch.h"
+#include "memfunc.h"
+#include "network.h"
+#include "pico/stdlib.h"
+#include "rtc.h"
+#include "tprotocol.h"
+
+// Status page in the ROM4 bank, after the shared variables. The computer
+// reads it without sending any command. Must match the values in main.s
+#define STATUS_OFFSET 0xF200
+#define STATUS_MAGIC 0x53544154  // "STAT"
+#define STATUS_VERSION 1         // Increase when the layout changes
+#define STATUS_SIZE 0x80
+
+// Longwords of the page, big endian for the computer
+#define STATUS_MAGIC_OFFSET (STATUS_OFFSET)
+#define STATUS_VERSION_OFFSET \
+  (STATUS_OFFSET + 0x04)  // Version in the high word, size in the low word
+#define STATUS_SEQ_OFFSET (STATUS_OFFSET + 0x08)   // Odd while updating
+#define STATUS_LINK_OFFSET (STATUS_OFFSET + 0x0C)  // STATUS_LINK_*
+#define STATUS_RSSI_OFFSET \
+  (STATUS_OFFSET + 0x10)  // Signed dBm. 0 if not connected
+#define STATUS_IP_OFFSET \
+  (STATUS_OFFSET + 0x14)  // IPv4 address, first byte highest. 0 if none
+#define STATUS_SYNC_RTT_OFFSET \
+  (STATUS_OFFSET + 0x18)  // Round trip of the last sync in us. 0 if HTTP
+#define STATUS_SYNC_AGE_OFFSET \
+  (STATUS_OFFSET + 0x1C)  // Seconds since the last sync, or NEVER
+#define STATUS_CHECKSUM_ERRORS_OFFSET \
+  (STATUS_OFFSET + 0x20)  // Frames with a wrong checksum
+#define STATUS_OVERFLOWS_OFFSET \
+  (STATUS_OFFSET + 0x24)  // Frames lost with the protocol queue full
+#define STATUS_UPTIME_OFFSET (STATUS_OFFSET + 0x28)  // Seconds since boot
+
+// Strings ended by a zero, in the byte order of the computer
+#define STATUS_FIRMWARE_OFFSET (STATUS_OFFSET + 0x30)
+#define STATUS_FIRMWARE_SIZE 16
+#define STATUS_SERVER_OFFSET \
+  (STATUS_OFFSET + 0x40)  // Host of the last sync. Empty if none
+#define STATUS_SERVER_SIZE 64
+
+// State of the Wi-Fi link
+#define STATUS_LINK_OFF 0     // Radio powered down between the resyncs
+#define STATUS_LINK_DOWN 1    // Not associated with the access point
+#define STATUS_LINK_JOINED 2  // Associated, waiting for the address
+#define STATUS_LINK_UP 3      // Associated and with an address
+
+// The page is refreshed in the idle time of the main loop
+#define STATUS_REFRESH_MS 1000
+
+/**
+ * @brief Writes the fixed part of the status page.
+ *
+ * Call it after the target firmware is copied to the ROM in RAM, because
+ * the copy overwrites the shared memory.
+ */
+void status_init(void);
+
+/**
+ * @brief Refreshes the status page once every STATUS_REFRESH_MS.
+ *
+ * Call it from the main loop. The sequence number is odd while the page is
+ * updated: the computer must read it again if it is odd or if it changes
+ * while reading the page.
+ *
+ * @param radioOn false if the radio is powered down, so the Wi-Fi chip is
+ * not accessed.
+ */
+void status_poll(bool radioOn);
+
+#endif  // STATUS_H
@@ -0,0 +1,110 @@
+/**
+ * File: telemetry.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Non blocking telemetry and commands over the USB CDC port
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "constants.h"
+#include "debug.h"
+
+// Telemetry channel over the USB CDC port (1) or none (0)
+#ifndef USB_TELEMETRY
+#define USB_TELEMETRY 0
+#endif
+
+// Bytes waiting to be sent to the host. Must be a power of two
+#ifndef TELEMETRY_TX_RING_SIZE
+#define TELEMETRY_TX_RING_SIZE 8192
+#endif
+#define TELEMETRY_TX_RING_MASK (TELEMETRY_TX_RING_SIZE - 1)
+
+#define TELEMETRY_LINE_SIZE 64     // Longest command line from the host
+#define TELEMETRY_PRINTF_SIZE 256  // Longest line of TELEMETRY_PRINTF
+
+// Command received from the host, with the rest of the line as argument
+typedef struct {
+  const char *command;
+  void (*handler)(const char *arg);
+} TelemetryCommand;
+
+#if USB_TELEMETRY == 1
+/**
+ * @brief Starts the USB CDC port for the telemetry.
+ *
+ * The port is removed from the stdio drivers, so DPRINTF stays in the UART
+ * and only the telemetry goes through the USB.
+ */
+void telemetry_init(void);
+
+/**
+ * @brief Registers the commands the host can send.
+ *
+ * @param cmds Table of commands.
+ * @param count Number of commands in the table.
+ */
+void telemetry_setCommands(const TelemetryCommand *cmds, size_t count);
+
+/**
+ * @brief Queues bytes for the host. Never blocks.
+ *
+ * Call it only from the main loop of core 0. The bytes that do not fit in
+ * the ring are dropped and counted.
+ *
+ * @param data Bytes to send.
+ * @param len Number of bytes.
+ */
+void telemetry_write(const char *data, size_t len);
+
+/**
+ * @brief Sends the queued bytes and runs the commands received.
+ *
+ * Only writes what fits in the CDC buffer, so it never waits for the host.
+ * TinyUSB itself runs from its background interrupt. Call it from the main
+ * loop of core 0.
+ */
+void telemetry_poll(void);
+
+/**
+ * @brief Returns the bytes dropped because the ring was full.
+ *
+ * @return The number of bytes dropped since boot.
+ */
+uint32_t telemetry_getDropped(void);
+
+/**
+ * @brief Returns the room left in the ring.
+ *
+ * @return The bytes that can be queued without dropping any.
+ */
+uint32_t telemetry_getFree(void);
+
+#define TELEMETRY_PRINTF(fmt, ...)                                   \
+  do {                                                               \
+    char telemetryLine[TELEMETRY_PRINTF_SIZE];                       \
+    int telemetryLen = snprintf(telemetryLine, sizeof(telemetryLine), \
+                                fmt, ##__VA_ARGS__);                 \
+    if (telemetryLen > 0) {                                          \
+      telemetry_write(telemetryLine,                                 \
+                      (telemetryLen < (int)sizeof(telemetryLine))    \
+                          ? (size_t)telemetryLen                     \
+                          : sizeof(telemetryLine) - 1);              \
+    }                                                                \
+  } while (0)
+#else
+static inline void telemetry_init(void) {}
+static inline void telemetry_setCommands(const TelemetryCommand *cmds,
+                                         size_t count) {}
+static inline void telemetry_poll(void) {}
+#define TELEMETRY_PRINTF(fmt, ...)
+#endif
+
+#endif  // TELEMETRY_H
@@ -14,16 +14,23 @@
 #include <string.h>
 
 #include "aconfig.h"
+#include "bench.h"
+#include "boottime.h"
+#include "buscal.h"
+#include "bustrace.h"
 #include "constants.h"
 #include "debug.h"
+#include "dispatch.h"
 #include "display_term.h"
+#include "fetchprof.h"
 #include "hardware/dma.h"
 #include "memfunc.h"
+#include "ota.h"
 #include "reset.h"
+#include "termscreen.h"
 #include "time.h"
 #include "tprotocol.h"
-
-#define ADDRESS_HIGH_BIT 0x8000  // High bit of the address
+#include "trace.h"
 
 #ifndef ROM3_GPIO
 #define ROM3_GPIO 26
@@ -60,28 +67,42 @@
 // App terminal commands
 #define APP_TERMINAL_START 0x00      // Enter terminal command
 #define APP_TERMINAL_KEYSTROKE 0x01  // Keystroke command
-
-#ifdef DISPLAY_ATARIST
-// Terminal size for Atari ST
-#define TERM_SCREEN_SIZE_X 40
-#define TERM_SCREEN_SIZE_Y 24  // Leave last line for status
-#define TERM_SCREEN_SIZE (TERM_SCREEN_SIZE_X * TERM_SCREEN_SIZE_Y)
-
-#define TERM_DISPLAY_BYTES_PER_CHAR 8
-#define TERM_DISPLAY_ROW_BYTES \
-  (TERM_DISPLAY_BYTES_PER_CHAR * TERM_SCREEN_SIZE_X)
-#endif
+#define APP_TERMINAL_BENCH_PING 0x02    // Benchmark round trip. No output
+#define APP_TERMINAL_BENCH_WRITE 0x03   // Benchmark write. Data discarded
+#define APP_TERMINAL_BENCH_RESULT 0x04  // Ticks of a test. D3 index, D4 ticks
+#define APP_TERMINAL_CALIBRATE_RESULT \
+  0x05  // Bus calibration. D3 round, D4 errors, D5 passes
+
+// Keystrokes sent in one APP_TERMINAL_KEYSTROKE command, in D3 to D6
+#define TERM_KEYSTROKES_MAX 4
+
+// Iterations of the benchmark run by the computer. Must match main.s
+#define TERM_BENCH_SYNC_ITERATIONS 256
+#define TERM_BENCH_WRITE_ITERATIONS 32
+#define TERM_BENCH_REFRESH_ITERATIONS 16
+#define TERM_BENCH_WRITE_MAX 2048  // Largest write of the benchmark
+#define TERM_BENCH_TICK_US 5000    // Period of the 200 Hz timer of the computer
+
+// Buckets of the fetch profile shown by the profile command
+#define TERM_PROFILE_TOP 5
+
+// Tests of the benchmark, in the order they run in the computer
+typedef enum {
+  TERM_BENCH_SYNC_0 = 0,
+  TERM_BENCH_SYNC_4,
+  TERM_BENCH_SYNC_16,
+  TERM_BENCH_WRITE_256,
+  TERM_BENCH_WRITE_1024,
+  TERM_BENCH_WRITE_2048,
+  TERM_BENCH_REFRESH,
+  TERM_BENCH_TESTS
+} term_BenchTest;
 
 // Holds up to one line of user input (between '\n' or '\r')
 #define TERM_PRINT_SETTINGS_BUFFER_SIZE 2048
 #define TERM_INPUT_BUFFER_SIZE 256
-#define TERM_ESC_BUFFLINE_SIZE 16
 #define TERM_BOOL_INPUT_BUFF 8
 
-#define TERM_ESC_CHAR 0x1B  // Escape character
-#define TERM_POS_X 0x20     // Position X
-#define TERM_POS_Y 0x20     // Position Y
-
 #define TERM_KEYBOARD_KEY_START 0x20         // Start of the ASCII table
 #define TERM_KEYBOARD_KEY_END 0x7E           // End of the ASCII table
 #define TERM_KEYBOARD_KEY_MASK 0xFF          // Mask for the key
@@ -90,8 +111,6 @@
 #define TERM_KEYBOARD_SCAN_MASK 0xFF0000     // Mask for the scan code
 #define TERM_KEYBOARD_SCAN_SHIFT 16          // Shift for the scan code
 
-#define TERM_PARAMETERS_MAX_SIZE 20  // Maximum size of the parameters
-
 // Display command to enter the terminal mode and ignore other keys
 #define DISPLAY_COMMAND_TERM 0x3  // Enter terminal mode
 
@@ -115,29 +134,16 @@ typedef enum {
 
 } term_CommandLevel;
 
-void __not_in_flash_func(term_dma_irq_handler_lookup)(void);
-
 void term_init(void);
 
 /**
- * @brief Prints a string to the terminal with VT52 escape sequence processing.
- *
- * This function implements a simple state machine that looks for the ESC (0x1B)
- * character. When found, it starts buffering characters until a complete VT52
- * escape sequence is detected. For normal characters, it just calls
- * term_render_char.
+ * @brief Feeds a key typed out of the computer to the terminal.
  *
- * @param str The string to print.
- */
-void term_printString(const char *str);
-
-/**
- * @brief Clear the terminal display area
+ * Same as a keystroke of the computer, in a block of output of its own.
  *
- * Clear the terminal display area. Resets terminal state and removes all
- * previously rendered output, preparing the display for fresh content.
+ * @param chr The ASCII code of the key. '\b' deletes and '\r' ends the line.
  */
-void term_clearScreen(void);
+void term_remoteKey(char chr);
 
 /**
  * @brief Register terminal command handlers
@@ -196,7 +202,22 @@ void term_cmdGet(const char *arg);
 void term_cmdPutInt(const char *arg);
 void term_cmdPutBool(const char *arg);
 void term_cmdPutString(const char *arg);
-
-void __not_in_flash_func(term_loop)();
+// Show the counters of the protocol and the phases of this boot
+void term_cmdStats(const char *arg);
+// Show the phases of the last boots
+void term_cmdBootTimes(const char *arg);
+// Run the microbenchmarks of the parser, the settings and the terminal
+void term_cmdBench(const char *arg);
+// Capture the bus accesses: start, stop, replay or export
+void term_cmdCapture(const char *arg);
+// Run the benchmark of the protocol and the display in the computer
+void term_cmdStBench(const char *arg);
+// Calibrate the timing of the bus, or go back to the default with "reset"
+void term_cmdCalibrate(const char *arg);
+// Profile the ROM4 fetches: start, stop, export, or show the hottest buckets
+void term_cmdProfile(const char *arg);
+// Update the app from the OTA_URL setting with "start", or show the progress
+// with "status". Anything else shows the usage and the risk of the update
+void term_cmdOta(const char *arg);
 
 #endif  // TERML_H
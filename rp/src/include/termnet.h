@@ -0,0 +1,91 @@
+/**
+ * File: termnet.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Mirror of the terminal for a Telnet client
+ */
+
+#ifndef TERMNET_H
+#define TERMNET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "lwip/tcp.h"
+#include "pico/cyw43_arch.h"
+#include "term.h"
+
+// Keys buffered between the callback of lwIP and the main loop. Must be a
+// power of two
+#define TERMNET_INPUT_SIZE 64
+#define TERMNET_INPUT_MASK (TERMNET_INPUT_SIZE - 1)
+
+_Static_assert((TERMNET_INPUT_SIZE & TERMNET_INPUT_MASK) == 0,
+               "TERMNET_INPUT_SIZE must be a power of two");
+
+// Largest delta written in one pass. A full screen fits
+#define TERMNET_TX_SIZE 1536
+
+// Unchanged cells sent inside a run of changes instead of moving the cursor.
+// A move takes up to 8 bytes
+#define TERMNET_RUN_GAP 6
+
+// Longest password of the mirror, with the NUL. Longer ones are cut
+#define TERMNET_PASSWORD_SIZE 64
+
+// New clients refused after a wrong password
+#define TERMNET_LOGIN_LOCKOUT_MS 3000
+
+// Telnet commands, see RFC 854
+#define TERMNET_IAC 255
+#define TERMNET_SB 250
+#define TERMNET_SE 240
+#define TERMNET_WILL 251
+#define TERMNET_DONT 254
+#define TERMNET_OPT_ECHO 1
+#define TERMNET_OPT_SGA 3  // Suppress go ahead: one key at a time
+
+/**
+ * @brief Listens for a Telnet client on the TCP port.
+ *
+ * One client at a time. A new connection replaces the last one, which may be
+ * dead after the radio was powered down. Call it once the network is up.
+ *
+ * Without a password the mirror is view only: the keys of the client are
+ * discarded. With a password the client sees nothing until it types it, and
+ * then its keys reach the terminal. A wrong password drops the client and
+ * refuses new ones for TERMNET_LOGIN_LOCKOUT_MS.
+ *
+ * @param port The TCP port to listen on.
+ * @param password The password to type in the terminal, or "" for a view
+ * only mirror.
+ * @return 0 if listening, -1 otherwise.
+ */
+int termnet_start(uint16_t port, const char *password);
+
+/**
+ * @brief Sends the changes of the screen and feeds the keys of the client.
+ *
+ * The rows are compared with the copy of the client only after a block of
+ * output lands on the screen, and only the runs of changed cells are sent,
+ * with ANSI cursor moves. If the send buffer is full, the rest is sent in
+ * the next calls. Call it from the main loop.
+ *
+ * @param radioOn false if the radio is powered down. The client is dropped.
+ * @param inputLive true to feed the keys of a logged in client to the
+ * terminal. Otherwise they are discarded.
+ */
+void termnet_poll(bool radioOn, bool inputLive);
+
+/**
+ * @brief Tells if a client is connected.
+ *
+ * @return true if a client is connected.
+ */
+bool termnet_isConnected(void);
+
+#endif  // TERMNET_H
@@ -0,0 +1,127 @@
+/**
+ * File: termscreen.h
+ * Author: Diego Parrilla Santamaría
+ * Date: January 2025
+ * Copyright: 2025 - GOODDATA LABS SL
+ * Description: Header for the screen of the terminal
+ */
+
+#ifndef TERMSCREEN_H
+#define TERMSCREEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "display_term.h"
+
+#ifdef DISPLAY_ATARIST
+// Terminal size for Atari ST
+#define TERM_SCREEN_SIZE_X 40
+#define TERM_SCREEN_SIZE_Y 24  // Leave last line for status
+#define TERM_SCREEN_SIZE (TERM_SCREEN_SIZE_X * TERM_SCREEN_SIZE_Y)
+
+// Rows kept after they scroll out of the screen
+#ifndef TERM_SCROLLBACK_ROWS
+#define TERM_SCROLLBACK_ROWS 0
+#endif
+#define TERM_SCREEN_RING_ROWS (TERM_SCREEN_SIZE_Y + TERM_SCROLLBACK_ROWS)
+
+#define TERM_DISPLAY_BYTES_PER_CHAR 8
+#define TERM_DISPLAY_ROW_BYTES \
+  (TERM_DISPLAY_BYTES_PER_CHAR * TERM_SCREEN_SIZE_X)
+#endif
+
+#define TERM_ESC_BUFFLINE_SIZE 16
+
+#define TERM_ESC_CHAR 0x1B  // Escape character
+#define TERM_POS_X 0x20     // Position X
+#define TERM_POS_Y 0x20     // Position Y
+
+/**
+ * @brief Prints a string to the terminal with VT52 escape sequence processing.
+ *
+ * This function implements a simple state machine that looks for the ESC (0x1B)
+ * character. When found, it starts buffering characters until a complete VT52
+ * escape sequence is detected. For normal characters, it just calls
+ * term_render_char.
+ *
+ * @param str The string to print.
+ */
+void term_printString(const char *str);
+
+/**
+ * @brief Starts a block of terminal output.
+ *
+ * Until the matching term_endOutput(), the printed text is drawn without
+ * moving the cursor block or refreshing the display. The blocks can be nested.
+ */
+void term_beginOutput(void);
+
+/**
+ * @brief Ends a block of terminal output.
+ *
+ * The outermost call draws the cursor block and refreshes the display once.
+ */
+void term_endOutput(void);
+
+/**
+ * @brief Returns the number of blocks of output drawn so far.
+ *
+ * It changes each time the display is refreshed, so a mirror of the screen
+ * only compares the rows after a change.
+ *
+ * @return A counter that runs free.
+ */
+uint32_t term_getOutputSerial(void);
+
+/**
+ * @brief Returns the characters of a row of the screen.
+ *
+ * @param posY The row, from 0 to TERM_SCREEN_SIZE_Y - 1.
+ * @return TERM_SCREEN_SIZE_X characters. 0 is an empty cell.
+ */
+const char *term_getRow(uint8_t posY);
+
+/**
+ * @brief Returns the position of the cursor.
+ *
+ * @param posX Where to store the column.
+ * @param posY Where to store the row.
+ */
+void term_getCursor(uint8_t *posX, uint8_t *posY);
+
+/**
+ * @brief Clear the terminal display area
+ *
+ * Clear the terminal display area. Resets terminal state and removes all
+ * previously rendered output, preparing the display for fresh content.
+ */
+void term_clearScreen(void);
+
+/**
+ * @brief Renders a single character at the cursor.
+ *
+ * '\n' and '\r' move to the next line and scroll the screen at the bottom.
+ * '\0' only moves the cursor block.
+ *
+ * @param chr The character to render.
+ */
+void term_renderChar(char chr);
+
+/**
+ * @brief Refreshes the display, unless a block of output is open.
+ */
+void term_refresh(void);
+
+/**
+ * @brief Handles the backspace key on the screen.
+ *
+ * @param erase True to move the cursor back and clear the character there.
+ * Otherwise only the cursor block is drawn again.
+ */
+void term_backspace(bool erase);
+
+#endif  // TERMSCREEN_H
@@ -15,17 +15,78 @@
 
 #include "constants.h"
 #include "debug.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
 
 #define PROTOCOL_CLEAR_MEMORY \
   0  // Set to 1 to clear the memory before starting the protocol
 
 #define PROTOCOL_HEADER 0xABCD
-#define PROTOCOL_READ_RESTART_MICROSECONDS 10000
+#define PROTOCOL_READ_RESTART_MICROSECONDS \
+  10000  // Longest gap between two words of a frame
 #define MAX_PROTOCOL_PAYLOAD_SIZE \
   2048 + 64  // 2048 bytes of payload plus 64 bytes of overhead for safety
 
 #define SHOW_COMMANDS 0  // Set to 1 to show commands received
 
+#ifndef TPROTO_CRC16
+#define TPROTO_CRC16 0  // Set to 1 to check the frames with a CRC-16
+#endif
+
+#ifndef TPROTO_IRQ_IN_SCRATCH
+#define TPROTO_IRQ_IN_SCRATCH 0  // Set to 1 to run the bus IRQ from SCRATCH_X
+#endif
+
+#ifndef TPROTO_IRQ_HISTOGRAM
+#define TPROTO_IRQ_HISTOGRAM 0  // Set to 1 to count the interrupt times
+#endif
+
+// Buckets of the histogram of the interrupt times, in SysTick cycles. The last
+// one counts the interrupts longer than the others
+#define TPROTO_IRQ_BUCKETS 16
+#define TPROTO_IRQ_BUCKET_SHIFT 5  // 32 cycles per bucket
+
+// The bus interrupt and the state of the parser in SCRATCH_X, the bank of the
+// stack of core 1, so core 0 and the DMA of the ROM image never stall them.
+// The frames stay in the main RAM: they do not fit in 4KB
+#if TPROTO_IRQ_IN_SCRATCH == 1
+#define TPROTO_IRQ_FUNC(func_name) __scratch_x(#func_name) func_name
+#define TPROTO_IRQ_DATA __scratch_x("tprotocol")
+#else
+#define TPROTO_IRQ_FUNC(func_name) __not_in_flash_func(func_name)
+#define TPROTO_IRQ_DATA
+#endif
+
+// Capability bits of the protocol. Published for the computer at a fixed
+// offset of the shared memory, the same for all the apps
+#define TPROTO_CAPABILITIES_OFFSET 0xFFFC
+#define TPROTO_CAP_CRC16 0x00000001  // The frames end with a CRC-16/CCITT
+
+#if TPROTO_CRC16 == 1
+#define TPROTO_CAPABILITIES TPROTO_CAP_CRC16
+#define TPROTO_CHECKSUM_INIT 0xFFFF
+#else
+#define TPROTO_CAPABILITIES 0
+#define TPROTO_CHECKSUM_INIT 0
+#endif
+
+// Counters of the protocol mirrored for the computer in the shared memory,
+// one long word each in the order of TransmissionProtocolStats
+#define TPROTO_STATS_OFFSET 0xFFD0
+#define TPROTO_SYSTICK_MASK 0x00FFFFFF  // SysTick is a 24 bit down counter
+
+// Bytes of a stream frame kept in the frame: the random token and D3 to D5 of
+// send_sync_write_command_to_sidecart. The rest goes to the stream buffer
+#define TPROTO_STREAM_PARAMS_SIZE 16
+
+#define TPROTO_QUEUE_SLOTS \
+  8  // Frames buffered between the IRQ and the loop. Must be a power of two
+#define TPROTO_QUEUE_MASK (TPROTO_QUEUE_SLOTS - 1)
+
+_Static_assert((TPROTO_QUEUE_SLOTS & TPROTO_QUEUE_MASK) == 0,
+               "TPROTO_QUEUE_SLOTS must be a power of two");
+
 /**
  * @brief Macro to get a random token from a payload.
  *
@@ -39,6 +100,19 @@
   (((*((uint32_t *)(payload)) & 0xFFFF0000) >> 16) | \
    ((*((uint32_t *)(payload)) & 0x0000FFFF) << 16))
 
+/**
+ * @brief Macro to publish the capabilities of the protocol.
+ *
+ * The words are swapped because the computer reads the high word first.
+ *
+ * @param mem_address Address of the shared memory plus
+ * TPROTO_CAPABILITIES_OFFSET.
+ */
+#define TPROTO_SET_CAPABILITIES(mem_address)                              \
+  *((volatile uint32_t *)(mem_address)) =                                 \
+      (((uint32_t)TPROTO_CAPABILITIES << 16) |                            \
+       ((uint32_t)TPROTO_CAPABILITIES >> 16));
+
 /**
  * @brief Macro to set a random token to a memory address.
  *
@@ -85,24 +159,304 @@ typedef struct __attribute__((packed, aligned(4))) {
   uint16_t payload_size;  // Size of the payload
   uint16_t bytes_read;  // To keep track of how many bytes of the payload we've
                         // read so far.
-  uint16_t final_checksum;  // Accumulate a 16-bit sum of all data read
-  unsigned char
-      payload[MAX_PROTOCOL_PAYLOAD_SIZE];  // Pointer to the payload data
+  uint16_t final_checksum;  // Accumulate a 16-bit checksum of all data read
+  unsigned char payload[];  // Payload data, up to the capacity of the frame
 } TransmissionProtocol;
 
+// Bytes of a frame with room for the payload, rounded to keep the next frame
+// of a queue aligned
+#define TPROTO_FRAME_SIZE(capacity) \
+  ((sizeof(TransmissionProtocol) + (capacity) + 3) & ~(size_t)3)
+
+// Payload kept in the scratch frame of a parser. The frames parsed there are
+// dropped, or only passed to the callback of a parser without queue
+#define TPROTO_SCRATCH_PAYLOAD_SIZE 32
+
+// Single producer (DMA IRQ) / single consumer (active loop) ring of frames.
+// head is only written by the producer and tail only by the consumer, so no
+// locks are needed. The indices run free and are masked on access.
+typedef struct {
+  volatile uint32_t head;       // Next slot to write. Owned by the producer
+  volatile uint32_t tail;       // Next slot to read. Owned by the consumer
+  volatile uint32_t overflows;  // Frames dropped because the ring was full
+  uint16_t capacity;            // Payload bytes of each slot
+  uint16_t slotSize;            // Bytes of each slot
+  unsigned char *slots;         // TPROTO_QUEUE_SLOTS frames of slotSize bytes
+} TransmissionProtocolQueue;
+
+/**
+ * @brief Defines a queue with room for the largest payload of its consumer.
+ *
+ * Each app knows the size of its commands, so the slots are sized at compile
+ * time instead of for MAX_PROTOCOL_PAYLOAD_SIZE. The payload of a longer
+ * frame is parsed and checked, but only the first bytes are stored.
+ *
+ * @param name Name of the queue.
+ * @param size Payload bytes of each slot. Must be even.
+ */
+#define TPROTO_QUEUE_DEFINE(name, size)                                    \
+  _Static_assert((((size) % 2) == 0) &&                                    \
+                     ((size) <= (MAX_PROTOCOL_PAYLOAD_SIZE)),              \
+                 "Invalid payload size of the queue " #name);              \
+  static unsigned char __attribute__((aligned(4)))                        \
+  name##Slots[TPROTO_QUEUE_SLOTS * TPROTO_FRAME_SIZE(size)];               \
+  static TransmissionProtocolQueue name = {.capacity = (size),             \
+                                           .slotSize = TPROTO_FRAME_SIZE(  \
+                                               size),                      \
+                                           .slots = name##Slots}
+
+// Always on counters of the bus and the parser. Only written by the interrupt
+typedef struct {
+  volatile uint32_t accesses;        // ROM3 words received
+  volatile uint32_t headers;         // Protocol headers detected
+  volatile uint32_t frames;          // Frames completed with a good checksum
+  volatile uint32_t checksumErrors;  // Frames with a wrong checksum
+  volatile uint32_t resyncs;         // Frames dropped after a gap in the bus
+  volatile uint32_t irqCount;        // Interrupts timed
+  volatile uint32_t irqMaxCycles;    // Longest interrupt in SysTick cycles
+  volatile uint64_t irqTotalCycles;  // Cycles of all the interrupts timed
+#if TPROTO_IRQ_HISTOGRAM == 1
+  volatile uint32_t irqHistogram[TPROTO_IRQ_BUCKETS];  // Interrupts per time
+#endif
+} TransmissionProtocolStats;
+
+// State of a protocol parser
+typedef struct {
+  TPParseStep step;
+  uint32_t lastWordFound;  // Time of the last word, in microseconds
+
+  // Frame the parser is writing into, a queue slot or the scratch, and the
+  // payload bytes it can store
+  TransmissionProtocol *transmission;
+  uint16_t capacity;
+
+  // Frame used when no queue is attached or the queue is full
+  TransmissionProtocol *scratch;
+
+  // Queue where the parser writes the frames in place. NULL if not attached
+  TransmissionProtocolQueue *queue;
+
+  // Command whose data is written straight into the stream buffer
+  uint16_t streamCommandId;
+  uint16_t streamBufferSize;
+  unsigned char *streamBuffer;
+
+  // The frame being parsed is a stream, and the checksum of its data
+  bool streamActive;
+  uint16_t streamChecksum;
+
+  TransmissionProtocolStats stats;
+} TransmissionParser;
+
+/**
+ * @brief Initial value of a parser without queue.
+ *
+ * @param scratchFrame Buffer aligned to 4 bytes of
+ * TPROTO_FRAME_SIZE(TPROTO_SCRATCH_PAYLOAD_SIZE) bytes.
+ */
+#define TPROTO_PARSER_INIT(scratchFrame)                   \
+  {.step = HEADER_DETECTION,                               \
+   .transmission = (TransmissionProtocol *)(scratchFrame), \
+   .capacity = TPROTO_SCRATCH_PAYLOAD_SIZE,                \
+   .scratch = (TransmissionProtocol *)(scratchFrame)}
+
+// The parser of the bus, shared by all the apps. Defined in tprotocol.c, so
+// there is only one copy however many files include this header
+extern TransmissionParser tprotocolParser;
+
 // Function to handle the commands received
 typedef void (*ProtocolCallback)(const TransmissionProtocol *);
 
 // Function to handle what to do if the checksum is wrong
 typedef void (*ProtocolChecksumErrorCallback)(const TransmissionProtocol *);
 
-static uint32_t last_header_found = 0;
-static uint32_t new_header_found = 0;
+/**
+ * @brief Attaches a queue to the protocol parser.
+ *
+ * Once attached, the parser writes each frame directly into the next free slot
+ * of the queue and publishes it when the checksum matches, so no copy is
+ * needed in the IRQ context. If the queue is full the frame is parsed into a
+ * scratch buffer and dropped, incrementing the overflow counter.
+ *
+ * @param queue The queue to attach, or NULL to detach it.
+ */
+static inline void tprotocol_setQueue(TransmissionProtocolQueue *queue) {
+  tprotocolParser.queue = queue;
+  tprotocolParser.transmission = tprotocolParser.scratch;
+  tprotocolParser.capacity = TPROTO_SCRATCH_PAYLOAD_SIZE;
+}
+
+/**
+ * @brief Writes the data of a command straight into a buffer.
+ *
+ * The frames of the command must be sent with
+ * send_sync_write_command_to_sidecart. The random token and D3 to D5 stay in
+ * the frame payload, and the data words are stored in the buffer as they
+ * arrive, so there is no staging copy. The last word of the payload is the
+ * checksum of the data, verified on the fly instead of the checksum of the
+ * frame. Data past the buffer size is dropped.
+ *
+ * The computer waits for the token of each command, so the buffer is not
+ * written again until the consumer has processed the frame.
+ *
+ * @param commandId The command to stream.
+ * @param buffer Where to write the data, or NULL to stop streaming.
+ * @param size Size of the buffer in bytes.
+ */
+static inline void tprotocol_setStream(uint16_t commandId, void *buffer,
+                                       uint16_t size) {
+  // Disable the stream while it changes, the parser runs in the interrupt
+  tprotocolParser.streamBuffer = NULL;
+  tprotocolParser.streamCommandId = commandId;
+  tprotocolParser.streamBufferSize = size;
+  tprotocolParser.streamBuffer = (unsigned char *)buffer;
+}
 
-static TPParseStep nextTPstep = HEADER_DETECTION;
+/**
+ * @brief Returns the counters of the parser.
+ *
+ * @return Pointer to the counters, updated by the interrupt.
+ */
+static inline const TransmissionProtocolStats *tprotocol_getStats(void) {
+  return &tprotocolParser.stats;
+}
 
-// Placeholder structure for parsed data (declared in tprotocol.h)
-static TransmissionProtocol transmission = {0};
+/**
+ * @brief Reads the SysTick at the start of an interrupt to time it.
+ *
+ * @return The SysTick value to pass to tprotocol_irqEnd.
+ */
+static inline __attribute__((always_inline)) uint32_t __not_in_flash_func(
+    tprotocol_irqStart)(void) {
+  return systick_hw->cvr;
+}
+
+/**
+ * @brief Adds the time of the interrupt to the counters.
+ *
+ * @param start The value returned by tprotocol_irqStart.
+ */
+static inline __attribute__((always_inline)) void __not_in_flash_func(
+    tprotocol_irqEnd)(uint32_t start) {
+  TransmissionProtocolStats *stats = &tprotocolParser.stats;
+  // The SysTick counts down
+  uint32_t cycles = (start - systick_hw->cvr) & TPROTO_SYSTICK_MASK;
+  stats->irqCount++;
+  stats->irqTotalCycles += cycles;
+  if (cycles > stats->irqMaxCycles) {
+    stats->irqMaxCycles = cycles;
+  }
+#if TPROTO_IRQ_HISTOGRAM == 1
+  uint32_t bucket = cycles >> TPROTO_IRQ_BUCKET_SHIFT;
+  stats->irqHistogram[(bucket < TPROTO_IRQ_BUCKETS) ? bucket
+                                                    : TPROTO_IRQ_BUCKETS - 1]++;
+#endif
+}
+
+/**
+ * @brief Copies the counters to the shared memory for the computer.
+ *
+ * The words are swapped because the computer reads the high word first. The
+ * frames dropped because the queue was full follow the checksum errors, the
+ * average interrupt time follows the maximum, and the resyncs come last.
+ *
+ * @param queue The queue of the parser, or NULL.
+ * @param mem_address Address of the shared memory plus TPROTO_STATS_OFFSET.
+ */
+static inline void tprotocol_publishStats(
+    const TransmissionProtocolQueue *queue, uint32_t mem_address) {
+  const TransmissionProtocolStats *stats = &tprotocolParser.stats;
+  uint32_t irqCount = stats->irqCount;
+  uint32_t values[] = {
+      stats->accesses,
+      stats->headers,
+      stats->frames,
+      stats->checksumErrors,
+      (queue != NULL) ? queue->overflows : 0,
+      stats->irqMaxCycles,
+      irqCount ? (uint32_t)(stats->irqTotalCycles / irqCount) : 0,
+      stats->resyncs,
+  };
+  volatile uint32_t *dest = (volatile uint32_t *)(uintptr_t)mem_address;
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    dest[i] = (values[i] << 16) | (values[i] >> 16);
+  }
+}
+
+// Frame of a slot of the queue. The index runs free
+static inline __attribute__((always_inline)) TransmissionProtocol *
+__not_in_flash_func(tprotocol_queueSlot)(TransmissionProtocolQueue *queue,
+                                         uint32_t index) {
+  return (TransmissionProtocol *)(queue->slots + (index & TPROTO_QUEUE_MASK) *
+                                                     queue->slotSize);
+}
+
+/**
+ * @brief Returns the oldest pending frame without removing it.
+ *
+ * @param queue The queue to read from.
+ * @return Pointer to the oldest frame, or NULL if the queue is empty.
+ */
+static inline TransmissionProtocol *__not_in_flash_func(tprotocol_queuePeek)(
+    TransmissionProtocolQueue *queue) {
+  uint32_t tail = queue->tail;
+  if (tail == queue->head) {
+    return NULL;
+  }
+  __dmb();
+  return tprotocol_queueSlot(queue, tail);
+}
+
+/**
+ * @brief Releases the frame returned by tprotocol_queuePeek.
+ *
+ * @param queue The queue to release the oldest frame from.
+ */
+static inline void __not_in_flash_func(tprotocol_queuePop)(
+    TransmissionProtocolQueue *queue) {
+  __dmb();
+  queue->tail = queue->tail + 1;
+}
+
+/**
+ * @brief Sleeps until the parser publishes a frame or the time is reached.
+ *
+ * The parser signals the event flag of the cores with __sev() each time it
+ * publishes a frame, so the caller wakes up at once instead of polling.
+ *
+ * @param queue The queue to wait for.
+ * @param until The time to stop waiting.
+ * @return true if a frame is pending, false on timeout.
+ */
+static inline bool tprotocol_queueWait(TransmissionProtocolQueue *queue,
+                                       absolute_time_t until) {
+  while (queue->tail == queue->head) {
+    if (best_effort_wfe_or_timeout(until)) {
+      return queue->tail != queue->head;
+    }
+  }
+  return true;
+}
+
+#if TPROTO_CRC16 == 1
+// CRC-16/CCITT of each byte. Defined in tprotocol.c
+extern uint16_t tprotocolCrc16Table[256];
+#endif
+
+// Add a word to the checksum of the frame: a CRC-16 of its two bytes, high
+// byte first, or a plain sum
+static inline __attribute__((always_inline)) uint16_t __not_in_flash_func(
+    tprotocol_checksumAdd)(uint16_t checksum, uint16_t data) {
+#if TPROTO_CRC16 == 1
+  checksum = (checksum << 8) ^
+             tprotocolCrc16Table[((checksum >> 8) ^ (data >> 8)) & 0xFF];
+  checksum =
+      (checksum << 8) ^ tprotocolCrc16Table[((checksum >> 8) ^ data) & 0xFF];
+  return checksum;
+#else
+  return checksum + data;
+#endif
+}
 
 // --------------------------------------
 // Inline assembly example for storing a 16-bit payload value (ARM).
@@ -121,13 +475,25 @@ static inline __attribute__((always_inline)) void store_payload_16_asm(
 // Step: Detect Header
 // --------------------------------------
 static inline __attribute__((always_inline)) void __not_in_flash_func(
-    detect_header)(uint16_t data) {
+    detect_header)(TransmissionParser *parser, uint16_t data) {
   if (data == PROTOCOL_HEADER) {
+    parser->stats.headers++;
+    // Parse in place into the next free slot of the queue, if any
+    TransmissionProtocolQueue *queue = parser->queue;
+    parser->transmission = parser->scratch;
+    parser->capacity = TPROTO_SCRATCH_PAYLOAD_SIZE;
+    if (queue != NULL) {
+      uint32_t head = queue->head;
+      if ((head - queue->tail) < TPROTO_QUEUE_SLOTS) {
+        parser->transmission = tprotocol_queueSlot(queue, head);
+        parser->capacity = queue->capacity;
+      }
+    }
     // Move to command read
-    nextTPstep = COMMAND_READ;
+    parser->step = COMMAND_READ;
     // Reset the checksum each time we detect a new header
     // (since we start sum from the command ID forward)
-    transmission.final_checksum = 0;
+    parser->transmission->final_checksum = TPROTO_CHECKSUM_INIT;
   }
 }
 
@@ -135,130 +501,221 @@ static inline __attribute__((always_inline)) void __not_in_flash_func(
 // Step: Read Command
 // --------------------------------------
 static inline __attribute__((always_inline)) void __not_in_flash_func(
-    read_command)(uint16_t data) {
-  transmission.command_id = data;
+    read_command)(TransmissionParser *parser, uint16_t data) {
+  TransmissionProtocol *transmission = parser->transmission;
+  transmission->command_id = data;
   // Accumulate command ID into final_checksum
-  transmission.final_checksum += data;
+  transmission->final_checksum =
+      tprotocol_checksumAdd(transmission->final_checksum, data);
+  parser->streamActive =
+      (parser->streamBuffer != NULL) && (data == parser->streamCommandId);
+  parser->streamChecksum = 0;
 
-  nextTPstep = PAYLOAD_SIZE_READ;
+  parser->step = PAYLOAD_SIZE_READ;
 }
 
 // --------------------------------------
 // Step: Read Payload Size
 // --------------------------------------
 static inline __attribute__((always_inline)) void __not_in_flash_func(
-    read_payload_size)(uint16_t data) {
+    read_payload_size)(TransmissionParser *parser, uint16_t data) {
+  TransmissionProtocol *transmission = parser->transmission;
+  // Always set the size, the frame can be a reused queue slot
+  transmission->payload_size = data;
   if (data > 0) {
-    transmission.payload_size = data;
-    nextTPstep = PAYLOAD_READ_START;
+    parser->step = PAYLOAD_READ_START;
   } else {
     // Zero payload => skip to end
-    nextTPstep = PAYLOAD_READ_END;
+    parser->step = PAYLOAD_READ_END;
   }
   // Accumulate payload size into final_checksum
-  transmission.final_checksum += data;
+  transmission->final_checksum =
+      tprotocol_checksumAdd(transmission->final_checksum, data);
 
   // Reset for reading payload
-  transmission.bytes_read = 0;
+  transmission->bytes_read = 0;
 }
 
 // --------------------------------------
 // Step: Read Payload (16-bit words)
 // --------------------------------------
 static inline __attribute__((always_inline)) void __not_in_flash_func(
-    read_payload)(uint16_t data) {
-  // Store the 16-bit chunk into the payload array
-  store_payload_16_asm(data, &transmission.payload[transmission.bytes_read]);
+    read_payload)(TransmissionParser *parser, uint16_t data) {
+  TransmissionProtocol *transmission = parser->transmission;
+  uint16_t bytesRead = transmission->bytes_read;
+  if (parser->streamActive && (bytesRead >= TPROTO_STREAM_PARAMS_SIZE)) {
+    // The data goes to the stream buffer. The last word is its checksum
+    if (bytesRead + 2 < transmission->payload_size) {
+      uint16_t offset = bytesRead - TPROTO_STREAM_PARAMS_SIZE;
+      if (offset < parser->streamBufferSize) {
+        store_payload_16_asm(data, &parser->streamBuffer[offset]);
+      }
+      parser->streamChecksum += data;
+    }
+  } else if (bytesRead < parser->capacity) {
+    // Store the 16-bit chunk into the payload array. Never write past the end
+    // of the frame, it could be a queue slot followed by another one
+    store_payload_16_asm(data, &transmission->payload[bytesRead]);
+  }
 
   // Accumulate the data into final_checksum
-  transmission.final_checksum += data;
+  transmission->final_checksum =
+      tprotocol_checksumAdd(transmission->final_checksum, data);
 
-  transmission.bytes_read += 2;
-  if (transmission.bytes_read >= transmission.payload_size) {
-    nextTPstep = PAYLOAD_READ_END;
+  transmission->bytes_read += 2;
+  if (transmission->bytes_read >= transmission->payload_size) {
+    parser->step = PAYLOAD_READ_END;
   } else {
-    nextTPstep = PAYLOAD_READ_INPROGRESS;
+    parser->step = PAYLOAD_READ_INPROGRESS;
   }
 }
 
 // This function is called once we finish reading the command + payload
 static inline __attribute__((always_inline)) void __not_in_flash_func(
-    process_command)(ProtocolCallback callback) {
+    process_command)(TransmissionParser *parser, ProtocolCallback callback) {
+  TransmissionProtocol *transmission = parser->transmission;
+  TransmissionProtocolQueue *queue = parser->queue;
+  parser->stats.frames++;
 #if defined(_DEBUG) && (_DEBUG != 0) && defined(SHOW_COMMANDS) && \
     (SHOW_COMMANDS != 0)
   DPRINTF("COMMAND: %d / PAYLOAD SIZE: %d / CHECKSUM: 0x%04X\n",
-          transmission.command_id, transmission.payload_size,
-          transmission.final_checksum);
+          transmission->command_id, transmission->payload_size,
+          transmission->final_checksum);
 #endif
 
+  if (queue != NULL) {
+    if (transmission != parser->scratch) {
+      // Publish the slot only after its content is written
+      __dmb();
+      queue->head = queue->head + 1;
+      // Wake up the consumer if it is waiting for events in the other core
+      __sev();
+    } else {
+      queue->overflows++;
+    }
+  }
+
   if (callback) {
-    callback(&transmission);
+    callback(transmission);
   }
 
 #if PROTOCOL_CLEAR_MEMORY == 1
   // Reset for next message
-  memset(&transmission, 0, sizeof(TransmissionProtocol));
+  if (transmission == parser->scratch) {
+    memset(transmission, 0, TPROTO_FRAME_SIZE(TPROTO_SCRATCH_PAYLOAD_SIZE));
+  }
 #endif
 
-  last_header_found = 0;
-  nextTPstep = HEADER_DETECTION;
+  parser->step = HEADER_DETECTION;
 }
 
 /**
- * @brief Parses protocol data and processes commands.
+ * @brief Checks if the parser is waiting for a new header.
+ *
+ * A frame without words for PROTOCOL_READ_RESTART_MICROSECONDS is aborted:
+ * the parser drops it with the next word.
+ *
+ * @return true if the parser is waiting for a new header, false otherwise.
+ */
+static inline bool __not_in_flash_func(tprotocol_isIdle)(void) {
+  TransmissionParser *parser = &tprotocolParser;
+  return (parser->step == HEADER_DETECTION) ||
+         (timer_hw->timerawl - parser->lastWordFound >
+          PROTOCOL_READ_RESTART_MICROSECONDS);
+}
+
+/**
+ * @brief Parses protocol data with the given parser.
  *
  * This function processes a 16-bit data value based on the current protocol
  * state. It updates the protocol state, accumulates checksum, and calls
  * appropriate callbacks when a command is fully received or a checksum error
  * occurs.
  *
+ * @param parser The state of the parser.
  * @param data The incoming 16-bit data.
  * @param callback Function pointer that is called upon successful command
  * parsing.
  * @param protocolChecksumErrorCallback Function pointer that is called when a
  * checksum error is detected.
  */
-static inline void __not_in_flash_func(tprotocol_parse)(
-    uint16_t data, ProtocolCallback callback,
+static inline __attribute__((always_inline)) void __not_in_flash_func(
+    tprotocol_parseWith)(
+    TransmissionParser *parser, uint16_t data, ProtocolCallback callback,
     ProtocolChecksumErrorCallback protocolChecksumErrorCallback) {
-  // Time-based logic to detect if we should restart parsing
-  new_header_found = timer_hw->timerawl;
-  if (new_header_found - last_header_found >
-      PROTOCOL_READ_RESTART_MICROSECONDS) {
-    nextTPstep = HEADER_DETECTION;
+  parser->stats.accesses++;
+  // The words of a frame come back to back. After a gap the computer was
+  // reset or somebody else read ROM3: look for a header again
+  uint32_t wordFound = timer_hw->timerawl;
+  if ((parser->step != HEADER_DETECTION) &&
+      (wordFound - parser->lastWordFound >
+       PROTOCOL_READ_RESTART_MICROSECONDS)) {
+    parser->stats.resyncs++;
+    parser->step = HEADER_DETECTION;
   }
+  parser->lastWordFound = wordFound;
 
-  switch (nextTPstep) {
+  switch (parser->step) {
     case HEADER_DETECTION:
-      detect_header(data);
-      last_header_found = new_header_found;
+      detect_header(parser, data);
       break;
 
     case COMMAND_READ:
-      read_command(data);
+      read_command(parser, data);
       break;
 
     case PAYLOAD_SIZE_READ:
-      read_payload_size(data);
+      read_payload_size(parser, data);
       break;
 
     case PAYLOAD_READ_START:
     case PAYLOAD_READ_INPROGRESS:
-      if (transmission.bytes_read < transmission.payload_size) {
-        read_payload(data);
+      if (parser->transmission->bytes_read <
+          parser->transmission->payload_size) {
+        read_payload(parser, data);
+      }
+      if (parser->streamActive && (parser->step == PAYLOAD_READ_END)) {
+        // A stream frame ends with the checksum of the data
+        if (data == parser->streamChecksum) {
+          process_command(parser, callback);
+        } else {
+          parser->stats.checksumErrors++;
+          protocolChecksumErrorCallback(parser->transmission);
+          parser->step = HEADER_DETECTION;
+        }
       }
       break;
     case PAYLOAD_READ_END:
       // "data" is the checksum
-      if (data == transmission.final_checksum) {
+      if (data == parser->transmission->final_checksum) {
         // Checksum matches
-        process_command(callback);
+        process_command(parser, callback);
       } else {
         // Checksum mismatch. Notify the caller
-        protocolChecksumErrorCallback(&transmission);
+        parser->stats.checksumErrors++;
+        protocolChecksumErrorCallback(parser->transmission);
+        parser->step = HEADER_DETECTION;
       }
       break;
   }
-};
+}
+
+/**
+ * @brief Parses protocol data and processes commands.
+ *
+ * Runs the parser of the bus, tprotocolParser.
+ *
+ * @param data The incoming 16-bit data.
+ * @param callback Function pointer that is called upon successful command
+ * parsing.
+ * @param protocolChecksumErrorCallback Function pointer that is called when a
+ * checksum error is detected.
+ */
+static inline void __not_in_flash_func(tprotocol_parse)(
+    uint16_t data, ProtocolCallback callback,
+    ProtocolChecksumErrorCallback protocolChecksumErrorCallback) {
+  tprotocol_parseWith(&tprotocolParser, data, callback,
+                      protocolChecksumErrorCallback);
+}
 
 #endif  // TPROTOCOL_H
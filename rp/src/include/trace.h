@@ -0,0 +1,107 @@
+/**
+ * File: trace.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Binary trace ring for the time critical code
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "constants.h"
+#include "debug.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pico/platform.h"
+
+// Records kept per core. Must be a power of two
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 128
+#endif
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+// Records printed by each call to trace_dump, to not stall the main loop
+#ifndef TRACE_DUMP_MAX
+#define TRACE_DUMP_MAX 32
+#endif
+
+// Events. Keep the names in trace.c in the same order
+typedef enum {
+  TRACE_DMA_LOOKUP = 0,      // arg0: address
+  TRACE_DMA_ADDRESS,         // arg0: address, arg1: value
+  TRACE_CHECKSUM_ERROR,      // arg0: command id, arg1: payload size
+  TRACE_COMMAND,             // arg0: command id, arg1: payload size
+  TRACE_COMMAND_PARAM,       // arg0: parameter index, arg1: value
+  TRACE_SHARED_VAR,          // arg0: variable index, arg1: value
+  TRACE_UNKNOWN_COMMAND,     // arg0: command id
+  TRACE_EVENTS
+} TraceEvent;
+
+// 16 bytes per record
+typedef struct {
+  volatile uint32_t seq;  // Position in the ring, written last
+  uint32_t timestamp;     // Microseconds since boot, lower 32 bits
+  uint16_t event;
+  uint16_t reserved;
+  uint32_t arg0;
+  uint32_t arg1;
+} TraceRecord;
+
+// Each core writes only its own ring, so the writers never share an index
+typedef struct {
+  volatile uint32_t head;  // Next record to write
+  uint32_t tail;           // Next record to print
+  uint32_t lost;           // Records overwritten before they were printed
+  TraceRecord records[TRACE_RING_SIZE];
+} TraceRing;
+
+#if defined(_DEBUG) && (_DEBUG != 0)
+extern TraceRing traceRings[NUM_CORES];
+
+/**
+ * @brief Writes an event in the ring of the current core.
+ *
+ * No locks and no formatting, so it can be called from the interrupts. The
+ * interrupts of the core are only masked while the record is written.
+ *
+ * @param event The TraceEvent.
+ * @param arg0 First argument of the event.
+ * @param arg1 Second argument of the event.
+ */
+static inline void __not_in_flash_func(trace_record)(uint16_t event,
+                                                     uint32_t arg0,
+                                                     uint32_t arg1) {
+  TraceRing *ring = &traceRings[get_core_num()];
+  uint32_t ints = save_and_disable_interrupts();
+  uint32_t seq = ring->head;
+  TraceRecord *record = &ring->records[seq & TRACE_RING_MASK];
+  record->timestamp = timer_hw->timerawl;
+  record->event = event;
+  record->arg0 = arg0;
+  record->arg1 = arg1;
+  __dmb();
+  record->seq = seq;
+  ring->head = seq + 1;
+  restore_interrupts(ints);
+}
+
+/**
+ * @brief Prints the pending records of both cores.
+ *
+ * Call it from the main loop. Prints up to TRACE_DUMP_MAX records per call
+ * and reports the records overwritten before they were printed.
+ */
+void trace_dump(void);
+
+#define DTRACE(event, arg0, arg1) \
+  trace_record((event), (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define DTRACE(event, arg0, arg1)
+static inline void trace_dump(void) {}
+#endif
+
+#endif  // TRACE_H
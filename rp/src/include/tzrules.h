@@ -0,0 +1,90 @@
+/**
+ * File: tzrules.h
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: POSIX TZ strings compiled into a table of transitions
+ */
+
+#ifndef TZRULES_H
+#define TZRULES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+
+// Years of transitions in the table. It is built again when it runs out
+#ifndef TZRULES_YEARS
+#define TZRULES_YEARS 8
+#endif
+#define TZRULES_TRANSITIONS (TZRULES_YEARS * 2)
+
+// No transition ahead: the time zone has no daylight saving time
+#define TZRULES_NEVER 0xFFFFFFFF
+
+// Rule of the POSIX TZ string: Mm.w.d, Jn or n
+typedef enum {
+  TZRULES_MONTH_WEEK_DAY = 0,  // Day d of the week w of the month m
+  TZRULES_JULIAN_NO_LEAP = 1,  // Jn: day 1 to 365, February 29 not counted
+  TZRULES_JULIAN = 2,          // n: day 0 to 365
+} TzRulesKind;
+
+typedef struct {
+  TzRulesKind kind;
+  int16_t month;
+  int16_t week;
+  int16_t day;
+  int32_t time;  // Local seconds after midnight. Can be negative
+} TzRulesChange;
+
+typedef struct {
+  uint32_t at;     // UTC seconds since 1970
+  int32_t offset;  // Seconds east of UTC from this instant
+} TzRulesTransition;
+
+typedef struct {
+  int32_t stdOffset;  // Seconds east of UTC
+  int32_t dstOffset;
+  bool hasDst;
+  TzRulesChange start;  // To daylight saving time, in standard time
+  TzRulesChange end;    // To standard time, in daylight saving time
+
+  // Table of the transitions, and the index of the next one
+  TzRulesTransition transitions[TZRULES_TRANSITIONS];
+  int count;
+  int next;
+  int firstYear;
+  uint32_t nextAt;  // UTC instant of the next transition, or TZRULES_NEVER
+} TzRules;
+
+/**
+ * @brief Parses a POSIX TZ string, like "CET-1CEST,M3.5.0,M10.5.0/3".
+ *
+ * The rules are kept, but the table is not built until the first call to
+ * tzrules_offsetAt(). A daylight saving time without rules uses the rules of
+ * the United States.
+ *
+ * @param tz The TZ string.
+ * @param rules Where to store the rules.
+ * @return 0 if the string is valid, -1 otherwise.
+ */
+int tzrules_parse(const char *tz, TzRules *rules);
+
+/**
+ * @brief Returns the offset of the local time at an instant.
+ *
+ * The first call, and any call out of the years of the table, builds the
+ * table. Otherwise the index only moves forward, so the calls with the time
+ * of the clock are cheap. Compare the time with rules->nextAt to know if the
+ * offset changed.
+ *
+ * @param rules The rules of the time zone.
+ * @param utc UTC seconds since 1970.
+ * @return Seconds east of UTC.
+ */
+int32_t tzrules_offsetAt(TzRules *rules, uint32_t utc);
+
+#endif  // TZRULES_H
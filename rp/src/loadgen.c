@@ -0,0 +1,327 @@
+/**
+ * File: loadgen.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Synthetic load of the cartridge bus for the self-test build
+ */
+
+#include "loadgen.h"
+
+#include "telemetry.h"
+#include "term.h"
+
+static const char *const patternNames[LOADGEN_PATTERNS] = {"frames", "noise",
+                                                           "mix"};
+
+static LoadGenResult result = {0};
+static bool hasResult = false;
+
+#if ROMEMUL_SELF_TEST == 1
+static uint32_t pattern[LOADGEN_RING_WORDS]
+    __attribute__((aligned(LOADGEN_RING_BYTES)));
+static uint32_t patternRom3 = 0;    // ROM3 accesses in one pass of the ring
+static uint32_t patternFrames = 0;  // Frames in one pass of the ring
+static uint32_t rawBase = 0;
+
+static int patternChannel = -1;
+static bool running = false;
+static bool settling = false;
+static uint32_t transfers = 0;
+static uint64_t startUs = 0;
+static uint64_t endUs = 0;
+static absolute_time_t settleUntil;
+
+// Counters of the parser when the run started
+static TransmissionProtocolStats startStats;
+static uint32_t startOverflows = 0;
+
+// The raw address of a ROM3 access, as bus_loadgen pushes it: the inverted
+// high bit of the bus and the ROM3 signal
+static inline uint32_t rom3Access(uint16_t word) {
+  return rawBase | ROMEMUL_ROM3_ADDRESS_BIT |
+         (uint32_t)(word ^ DISPATCH_ADDRESS_HIGH_BIT);
+}
+
+// A random ROM3 access that is not a protocol header
+static inline uint32_t rom3Noise(void) {
+  uint16_t word = (uint16_t)rand();
+  if (word == PROTOCOL_HEADER) {
+    word ^= 1;
+  }
+  return rom3Access(word);
+}
+
+// A random ROM4 access. The 68000 only reads even addresses
+static inline uint32_t rom4Noise(void) {
+  return rawBase | ((uint32_t)rand() & 0xFFFE);
+}
+
+// Adds a frame of the bench ping command at the position. The command has no
+// output, so the queue and the handlers run without a computer
+static uint32_t addFrame(uint32_t pos) {
+  uint16_t command = (APP_TERMINAL << 8) | APP_TERMINAL_BENCH_PING;
+  uint16_t checksum = TPROTO_CHECKSUM_INIT;
+  pattern[pos++] = rom3Access(PROTOCOL_HEADER);
+  pattern[pos++] = rom3Access(command);
+  checksum = tprotocol_checksumAdd(checksum, command);
+  pattern[pos++] = rom3Access(LOADGEN_FRAME_PAYLOAD);
+  checksum = tprotocol_checksumAdd(checksum, LOADGEN_FRAME_PAYLOAD);
+  for (int i = 0; i < LOADGEN_FRAME_PAYLOAD / 2; i++) {
+    uint16_t data = (uint16_t)rand();
+    pattern[pos++] = rom3Access(data);
+    checksum = tprotocol_checksumAdd(checksum, data);
+  }
+  pattern[pos++] = rom3Access(checksum);
+  patternFrames++;
+  patternRom3 += LOADGEN_FRAME_WORDS;
+  return pos;
+}
+
+// Fills the ring with whole frames. The end of the ring that can't hold a
+// frame is filled with ROM4 accesses
+static void buildPattern(LoadGenPattern kind) {
+  rawBase = ((uint32_t)&__rom_in_ram_start__ >> ROMEMUL_BUS_BITS)
+            << ROMEMUL_BUS_BITS;
+  patternRom3 = 0;
+  patternFrames = 0;
+  uint32_t pos = 0;
+  while (pos < LOADGEN_RING_WORDS) {
+    bool frameFits = (pos + LOADGEN_FRAME_WORDS) <= LOADGEN_RING_WORDS;
+    if ((kind == LOADGEN_FRAMES) && frameFits) {
+      pos = addFrame(pos);
+    } else if ((kind == LOADGEN_MIX) && frameFits) {
+      pos = addFrame(pos);
+      uint32_t gap = 1 + ((uint32_t)rand() % LOADGEN_MIX_GAP);
+      for (uint32_t i = 0; (i < gap) && (pos < LOADGEN_RING_WORDS); i++) {
+        pattern[pos++] = rom4Noise();
+      }
+      // The parser skips what is not a header between two frames
+      if (pos < LOADGEN_RING_WORDS) {
+        pattern[pos++] = rom3Noise();
+        patternRom3++;
+      }
+    } else if ((kind == LOADGEN_NOISE) &&
+               ((rand() % LOADGEN_NOISE_ROM3_RATIO) == 0)) {
+      pattern[pos++] = rom3Noise();
+      patternRom3++;
+    } else {
+      pattern[pos++] = rom4Noise();
+    }
+  }
+}
+
+static void snapshotStats(TransmissionProtocolStats *dest) {
+  const TransmissionProtocolStats *stats = tprotocol_getStats();
+  dest->accesses = stats->accesses;
+  dest->headers = stats->headers;
+  dest->frames = stats->frames;
+  dest->checksumErrors = stats->checksumErrors;
+  dest->resyncs = stats->resyncs;
+  dest->irqCount = stats->irqCount;
+  dest->irqMaxCycles = stats->irqMaxCycles;
+  dest->irqTotalCycles = stats->irqTotalCycles;
+#if TPROTO_IRQ_HISTOGRAM == 1
+  for (int i = 0; i < TPROTO_IRQ_BUCKETS; i++) {
+    dest->irqHistogram[i] = stats->irqHistogram[i];
+  }
+#endif
+}
+
+// Deltas of the counters of the parser since the start of the run
+static void finish(bool aborted) {
+  TransmissionProtocolStats endStats;
+  snapshotStats(&endStats);
+  uint32_t passes = transfers / LOADGEN_RING_WORDS;
+  uint32_t remaining =
+      dma_hw->ch[patternChannel].transfer_count & LOADGEN_MAX_TRANSFERS;
+  result.sent = transfers - remaining;
+  result.elapsedUs = (uint32_t)(endUs - startUs);
+  result.served = endStats.irqCount - startStats.irqCount;
+  result.rom3Served = endStats.accesses - startStats.accesses;
+  // Only whole passes are counted when the run is stopped
+  uint32_t donePasses = aborted ? (result.sent / LOADGEN_RING_WORDS) : passes;
+  result.rom3Sent = donePasses * patternRom3;
+  result.framesSent = donePasses * patternFrames;
+  result.frames = endStats.frames - startStats.frames;
+  result.checksumErrors = endStats.checksumErrors - startStats.checksumErrors;
+  result.resyncs = endStats.resyncs - startStats.resyncs;
+  result.overflows = dispatch_getOverflows() - startOverflows;
+  result.irqMaxCycles = endStats.irqMaxCycles;
+  result.irqAvgCycles =
+      result.served ? (uint32_t)((endStats.irqTotalCycles -
+                                  startStats.irqTotalCycles) /
+                                 result.served)
+                    : 0;
+#if TPROTO_IRQ_HISTOGRAM == 1
+  for (int i = 0; i < TPROTO_IRQ_BUCKETS; i++) {
+    result.irqHistogram[i] =
+        endStats.irqHistogram[i] - startStats.irqHistogram[i];
+  }
+#endif
+  result.aborted = aborted;
+  hasResult = true;
+  running = false;
+  settling = false;
+  DPRINTF("Load generator done. %lu of %lu accesses served in %lu us\n",
+          (unsigned long)result.served, (unsigned long)result.sent,
+          (unsigned long)result.elapsedUs);
+}
+
+int loadgen_start(LoadGenPattern kind, uint32_t rate, uint32_t durationMs) {
+  if (running || (kind >= LOADGEN_PATTERNS) || (rate == 0) ||
+      (durationMs == 0) || (durationMs > LOADGEN_MAX_MS)) {
+    return -1;
+  }
+  uint32_t periodCycles = clock_get_hz(clk_sys) / rate;
+  if (periodCycles < ROMEMUL_LOADGEN_LOOP_CYCLES) {
+    DPRINTF("Load generator rate too high: %lu\n", (unsigned long)rate);
+    return -1;
+  }
+  if (patternChannel < 0) {
+    patternChannel = dma_claim_unused_channel(false);
+    if (patternChannel < 0) {
+      DPRINTF("No free DMA channel for the load generator.\n");
+      return -1;
+    }
+  }
+  uint64_t accesses = ((uint64_t)rate * durationMs + 999) / 1000;
+  uint64_t passes = (accesses + LOADGEN_RING_WORDS - 1) / LOADGEN_RING_WORDS;
+  if (passes * LOADGEN_RING_WORDS > LOADGEN_MAX_TRANSFERS) {
+    DPRINTF("Load generator run too long: %llu accesses\n",
+            (unsigned long long)accesses);
+    return -1;
+  }
+  buildPattern(kind);
+
+  volatile uint32_t *txFifo;
+  uint dreq;
+  if (romemul_startLoadGen(periodCycles, &txFifo, &dreq) != 0) {
+    return -1;
+  }
+
+  // No computer on the bus, so the interrupt is idle and the longest time can
+  // be cleared from here
+  tprotocolParser.stats.irqMaxCycles = 0;
+  snapshotStats(&startStats);
+  startOverflows = dispatch_getOverflows();
+  memset(&result, 0, sizeof(result));
+  result.pattern = kind;
+  result.rate = rate;
+
+  dma_channel_config cfg = dma_channel_get_default_config(patternChannel);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+  channel_config_set_read_increment(&cfg, true);
+  channel_config_set_write_increment(&cfg, false);
+  channel_config_set_ring(&cfg, false, LOADGEN_RING_BITS);
+  channel_config_set_dreq(&cfg, dreq);
+  transfers = (uint32_t)passes * LOADGEN_RING_WORDS;
+  running = true;
+  settling = false;
+  startUs = time_us_64();
+  dma_channel_configure(patternChannel, &cfg, txFifo, pattern, transfers,
+                        true);
+  DPRINTF("Load generator started: %s, %lu accesses/s, %lu accesses\n",
+          patternNames[kind], (unsigned long)rate, (unsigned long)transfers);
+  return 0;
+}
+
+void loadgen_stop(void) {
+  if (!running) {
+    return;
+  }
+  dma_channel_abort(patternChannel);
+  endUs = time_us_64();
+  finish(true);
+}
+
+bool loadgen_isRunning(void) { return running; }
+
+void loadgen_poll(void) {
+  if (!running) {
+    return;
+  }
+  if (!settling) {
+    if (dma_channel_is_busy(patternChannel)) {
+      return;
+    }
+    // The last accesses are still in the FIFO of the state machine
+    uint32_t fifoUs =
+        (uint32_t)((uint64_t)LOADGEN_FIFO_WORDS * 1000000 / result.rate);
+    endUs = time_us_64() + fifoUs;
+    settling = true;
+    settleUntil = make_timeout_time_us((uint64_t)fifoUs +
+                                       LOADGEN_SETTLE_MS * 1000);
+    return;
+  }
+  if (time_reached(settleUntil)) {
+    finish(false);
+    loadgen_report();
+  }
+}
+#else
+int loadgen_start(LoadGenPattern kind, uint32_t rate, uint32_t durationMs) {
+  DPRINTF("Bus load generator not enabled in this build.\n");
+  return -1;
+}
+void loadgen_stop(void) {}
+bool loadgen_isRunning(void) { return false; }
+void loadgen_poll(void) {}
+#endif
+
+const LoadGenResult *loadgen_getResult(void) {
+  return hasResult ? &result : NULL;
+}
+
+void loadgen_report(void) {
+#if USB_TELEMETRY == 1
+  if (!hasResult) {
+    TELEMETRY_PRINTF("loadgen: no run\n");
+    return;
+  }
+  uint32_t dropped = result.sent - result.served;
+  uint32_t dropPpm =
+      result.sent ? (uint32_t)((uint64_t)dropped * 1000000 / result.sent) : 0;
+  uint32_t throughput =
+      result.elapsedUs
+          ? (uint32_t)((uint64_t)result.served * 1000000 / result.elapsedUs)
+          : 0;
+  TELEMETRY_PRINTF(
+      "loadgen: pattern=%s rate=%lu us=%lu sent=%lu served=%lu "
+      "throughput=%lu drop_ppm=%lu%s\n",
+      patternNames[result.pattern], (unsigned long)result.rate,
+      (unsigned long)result.elapsedUs, (unsigned long)result.sent,
+      (unsigned long)result.served, (unsigned long)throughput,
+      (unsigned long)dropPpm, result.aborted ? " aborted" : "");
+  TELEMETRY_PRINTF(
+      "loadgen: rom3_sent=%lu rom3_served=%lu frames_sent=%lu frames=%lu "
+      "checksum_errors=%lu resyncs=%lu overflows=%lu irq_max=%lu "
+      "irq_avg=%lu\n",
+      (unsigned long)result.rom3Sent, (unsigned long)result.rom3Served,
+      (unsigned long)result.framesSent, (unsigned long)result.frames,
+      (unsigned long)result.checksumErrors, (unsigned long)result.resyncs,
+      (unsigned long)result.overflows, (unsigned long)result.irqMaxCycles,
+      (unsigned long)result.irqAvgCycles);
+#if TPROTO_IRQ_HISTOGRAM == 1
+  // Interrupts per TPROTO_IRQ_BUCKET_SHIFT cycles, the longest last
+  char line[TELEMETRY_PRINTF_SIZE];
+  int len = snprintf(line, sizeof(line), "loadgen: irq_histogram");
+  for (int i = 0; (i < TPROTO_IRQ_BUCKETS) && (len > 0) &&
+                  (len < (int)sizeof(line));
+       i++) {
+    len += snprintf(&line[len], sizeof(line) - len, " %lu",
+                    (unsigned long)result.irqHistogram[i]);
+  }
+  TELEMETRY_PRINTF("%s\n", line);
+#endif
+#endif
+}
+
+LoadGenPattern loadgen_getPattern(const char *name) {
+  for (int i = 0; i < LOADGEN_PATTERNS; i++) {
+    if (strcmp(name, patternNames[i]) == 0) {
+      return (LoadGenPattern)i;
+    }
+  }
+  return LOADGEN_PATTERNS;
+}
@@ -0,0 +1,89 @@
+/**
+ * File: lz4.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Decompression of the LZ4 blocks of the firmware images
+ */
+
+#include "lz4.h"
+
+#include <string.h>
+
+// Add the extended bytes of a length. Returns false past the end of the block
+static inline bool readLength(const uint8_t **ip, const uint8_t *iend,
+                              size_t *length) {
+  uint8_t byte;
+  do {
+    if (*ip >= iend) {
+      return false;
+    }
+    byte = *(*ip)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+int lz4_decompress(const uint8_t *src, size_t srcSize, uint8_t *dst,
+                   size_t dstCapacity) {
+  const uint8_t *ip = src;
+  const uint8_t *iend = src + srcSize;
+  uint8_t *op = dst;
+  const uint8_t *oend = dst + dstCapacity;
+
+  while (ip < iend) {
+    uint8_t token = *ip++;
+
+    // Literals
+    size_t length = token >> 4;
+    if ((length == LZ4_LENGTH_EXTENDED) && !readLength(&ip, iend, &length)) {
+      DPRINTF("LZ4 literal length past the end of the block\n");
+      return -1;
+    }
+    if ((length > (size_t)(iend - ip)) || (length > (size_t)(oend - op))) {
+      DPRINTF("LZ4 literals out of bounds\n");
+      return -1;
+    }
+    memcpy(op, ip, length);
+    op += length;
+    ip += length;
+
+    // The last sequence has only literals
+    if (ip >= iend) {
+      break;
+    }
+
+    // Match
+    if (iend - ip < 2) {
+      DPRINTF("LZ4 offset past the end of the block\n");
+      return -1;
+    }
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if ((offset == 0) || (offset > (size_t)(op - dst))) {
+      DPRINTF("LZ4 offset out of bounds: %u\n", (unsigned)offset);
+      return -1;
+    }
+    length = token & 0x0F;
+    if ((length == LZ4_LENGTH_EXTENDED) && !readLength(&ip, iend, &length)) {
+      DPRINTF("LZ4 match length past the end of the block\n");
+      return -1;
+    }
+    length += LZ4_MIN_MATCH;
+    if (length > (size_t)(oend - op)) {
+      DPRINTF("LZ4 match out of bounds\n");
+      return -1;
+    }
+    const uint8_t *match = op - offset;
+    if (offset >= length) {
+      memcpy(op, match, length);
+      op += length;
+    } else {
+      // The match overlaps the output, so it repeats a short pattern
+      while (length--) {
+        *op++ = *match++;
+      }
+    }
+  }
+  return (int)(op - dst);
+}
@@ -6,12 +6,18 @@
  * Description: Main file for an app.
  */
 
+#include <malloc.h>
+
 #include "aconfig.h"
+#include "boottime.h"
+#include "clkprof.h"
 #include "constants.h"
 #include "debug.h"
 #include "emul.h"
 #include "gconfig.h"
+#include "hardware/regs/addressmap.h"
 #include "reset.h"
+#include "telemetry.h"
 
 // This is the main.c file for the app or microfirmware. It is the entry point
 // for the application. It is the first file that is executed when the
@@ -31,8 +37,11 @@
 // should be modified when adding new features to the application.
 
 int main() {
-  // Set the clock frequency. Keep in mind that if you are managing remote
-  // commands you should overclock the CPU to >=225MHz
+  // Time the boot phases from the start
+  boottime_init();
+
+  // Set the clock frequency of the SAFE profile. Keep in mind that if you are
+  // managing remote commands you should overclock the CPU to >=225MHz
   set_sys_clock_khz(RP2040_CLOCK_FREQ_KHZ, true);
 
   // Set the voltage. Be cautios with this. I don't think it's possible to
@@ -90,9 +99,28 @@ int main() {
   DPRINTF("ROM in RAM start: 0x%X, length: %u bytes\n",
           (unsigned int)&__rom_in_ram_start__, romInRamLength);
 
+  // The latency of the DMA of the ROM image only depends on the bus if no
+  // CPU shares its banks. The striped alias spreads it over all of them
+#if PICO_RP2350
+  bool romInOwnBanks = (unsigned int)&__rom_in_ram_start__ >= SRAM4_BASE;
+  const char *romBanks = "SRAM4-7, not shared with the CPUs";
+#else
+  bool romInOwnBanks = (unsigned int)&__rom_in_ram_start__ >= SRAM0_BASE;
+  const char *romBanks = "SRAM2-3, not shared with the CPUs";
 #endif
+  DPRINTF("ROM in RAM banks: %s\n",
+          romInOwnBanks ? romBanks : "striped, shared with the CPUs");
+  DPRINTF("SCRATCH_X code and data: %u bytes\n",
+          (unsigned int)&__scratch_x_end__ -
+              (unsigned int)&__scratch_x_start__);
+
+#endif
+
+  // The USB only carries the telemetry. It does not slow down the DPRINTF
+  telemetry_init();
 
   // Load the global configuration parameters
+  boottime_begin(BOOT_PHASE_CONFIG);
   int err = gconfig_init(CURRENT_APP_UUID_KEY);
   // If the global settings are not intialized, jump to the booster app to
   // initialize them
@@ -129,6 +157,22 @@ int main() {
       settings_print(aconfig_getContext(), NULL);
       break;
   }
+  boottime_end(BOOT_PHASE_CONFIG);
+
+  // Switch to the clock profile of the settings before the bus starts. Falls
+  // back to the SAFE profile if it is not stable
+  clkprof_init();
+
+#if defined(_DEBUG) && (_DEBUG != 0)
+  // RAM used by the settings during boot: the static entries and the heap
+  struct mallinfo heapInfo = mallinfo();
+  DPRINTF("Settings arena start: 0x%X, length: %u bytes\n",
+          (unsigned int)&__settings_arena_start__,
+          (unsigned int)&__settings_arena_end__ -
+              (unsigned int)&__settings_arena_start__);
+  DPRINTF("Heap peak: %u bytes, in use: %u bytes\n",
+          (unsigned int)heapInfo.arena, (unsigned int)heapInfo.uordblks);
+#endif
 
   // Start the application
   emul_start();
@@ -0,0 +1,69 @@
+/**
+ * File: netpool.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Pbuf pool of lwIP lent to the runtime while the radio is off
+ */
+
+#include "netpool.h"
+
+#if !MEMP_MEM_MALLOC
+static bool lent = false;
+static bool acquired = false;
+static NetpoolReleaseFn releaseFn = NULL;
+
+int netpool_lend(void) {
+  if (lent) {
+    return 0;
+  }
+  const struct memp_desc *desc = memp_pools[MEMP_PBUF_POOL];
+  // A buffer still queued somewhere would be overwritten by the user
+  u16_t freeCount = 0;
+  for (struct memp *elem = *desc->tab; elem != NULL; elem = elem->next) {
+    freeCount++;
+  }
+  if (freeCount != desc->num) {
+    DPRINTF("Pbuf pool in use: %u of %u free\n", freeCount, desc->num);
+    return -1;
+  }
+  // Empty free list: any pbuf_alloc() from the pool fails instead
+  *desc->tab = NULL;
+  lent = true;
+  DPRINTF("Pbuf pool lent: %u bytes\n", desc->num * desc->size);
+  return 0;
+}
+
+void *netpool_acquire(size_t *size, NetpoolReleaseFn release) {
+  if (!lent || acquired) {
+    return NULL;
+  }
+  const struct memp_desc *desc = memp_pools[MEMP_PBUF_POOL];
+  acquired = true;
+  releaseFn = release;
+  *size = (size_t)desc->num * desc->size;
+  return LWIP_MEM_ALIGN(desc->base);
+}
+
+void netpool_reclaim(void) {
+  if (!lent) {
+    return;
+  }
+  if (acquired && (releaseFn != NULL)) {
+    releaseFn();
+  }
+  acquired = false;
+  releaseFn = NULL;
+  memp_init_pool(memp_pools[MEMP_PBUF_POOL]);
+  lent = false;
+  DPRINTF("Pbuf pool back to lwIP\n");
+}
+
+bool netpool_isLent(void) { return lent; }
+#else
+// The pool comes from the heap, there is nothing to lend
+int netpool_lend(void) { return -1; }
+void *netpool_acquire(size_t *size, NetpoolReleaseFn release) { return NULL; }
+void netpool_reclaim(void) {}
+bool netpool_isLent(void) { return false; }
+#endif
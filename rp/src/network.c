@@ -14,6 +14,23 @@ static char connectionStatusStr[NETWORK_MAX_STRING_LENGTH] = {0};
 // Static variable to store the callback function
 static NetworkPollingCallback networkPollingCallback = NULL;
 
+// Last connection to join again without scanning
+static network_fast_connect_t fastConnectInfo = {0};
+static bool fastConnectEnabled = false;
+static bool fastLeaseApplied = false;
+
+// Connection in progress, stepped by network_wifiStaConnectPoll()
+static bool connPending = false;
+static bool connFast = false;
+static bool connFastLease = false;
+static wifi_sta_conn_status_t connPrevStatus = DISCONNECTED;
+static absolute_time_t connStatusTime;
+static absolute_time_t connTimeout;
+
+#ifndef CYW43_IOCTL_GET_CHANNEL
+#define CYW43_IOCTL_GET_CHANNEL 0x3a  // WLC_GET_CHANNEL
+#endif
+
 static const char *picoSerialStr() {
   static char buf[PICO_UNIQUE_BOARD_ID_SIZE_BYTES * 2 + 1];
   pico_unique_board_id_t boardId;
@@ -77,12 +94,43 @@ void network_deInit() {
     cyw43Initialized = false;
     cyw43_arch_deinit();
     DPRINTF("Network deinitialized\n");
+    // lwIP is idle until the next init, the runtime can use its buffers
+    netpool_lend();
   } else {
     DPRINTF("Network already deinitialized\n");
   }
 }
 #endif
 
+// Power management mode selected in the global configuration
+static uint32_t getPowerManagement() {
+  uint32_t pmValue = NETWORK_POWER_MGMT_DISABLED;  // 0: Disable PM
+  SettingsConfigEntry *pmEntry = gconfig_getEntry(GCONFIG_KEY_WIFI_POWER);
+  if (pmEntry != NULL) {
+    pmValue = strtoul(pmEntry->value, NULL, HEX_BASE);
+  }
+  if (pmValue < NETWORK_POWER_MGMT_MAX_OPTIONS) {
+    switch (pmValue) {
+      case 0:
+        pmValue = NETWORK_POWER_MGMT_DISABLED;  // DISABLED_PM
+        break;
+      case 1:
+        pmValue = CYW43_PERFORMANCE_PM;  // PERFORMANCE_PM
+        break;
+      case 2:
+        pmValue = CYW43_AGGRESSIVE_PM;  // AGGRESSIVE_PM
+        break;
+      case 3:
+        pmValue = CYW43_DEFAULT_PM;  // DEFAULT_PM
+        break;
+      default:
+        pmValue = CYW43_NO_POWERSAVE_MODE;  // NO_POWERSAVE_MODE
+        break;
+    }
+  }
+  return pmValue;
+}
+
 // NOLINTBEGIN(readability-magic-numbers)
 static u_int32_t getAuthPicoCode(u_int16_t connectCode) {
   switch (connectCode) {
@@ -110,6 +158,44 @@ void network_setPollingCallback(NetworkPollingCallback callback) {
   networkPollingCallback = callback;
 }
 
+void network_setFastConnect(const network_fast_connect_t *fastConnect) {
+  if (fastConnect == NULL) {
+    fastConnectEnabled = false;
+    return;
+  }
+  fastConnectInfo = *fastConnect;
+  fastConnectEnabled = true;
+}
+
+int network_getFastConnect(network_fast_connect_t *fastConnect) {
+  if (!cyw43Initialized ||
+      (cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) != CYW43_LINK_UP)) {
+    return -1;
+  }
+  memset(fastConnect, 0, sizeof(network_fast_connect_t));
+  struct netif *nif = &cyw43_state.netif[CYW43_ITF_STA];
+
+  cyw43_wifi_get_bssid(&cyw43_state, fastConnect->bssid);
+  // hw_channel, target_channel and scan_channel
+  uint32_t channelInfo[3] = {0};
+  if (cyw43_ioctl(&cyw43_state, CYW43_IOCTL_GET_CHANNEL, sizeof(channelInfo),
+                  (uint8_t *)channelInfo, CYW43_ITF_STA) == 0) {
+    fastConnect->channel = (uint8_t)channelInfo[0];
+  }
+
+  cyw43_arch_lwip_begin();
+  ip_addr_set(&fastConnect->ip, netif_ip_addr4(nif));
+  ip_addr_set(&fastConnect->netmask, netif_ip_netmask4(nif));
+  ip_addr_set(&fastConnect->gateway, netif_ip_gw4(nif));
+  ip_addr_set(&fastConnect->dns, dns_getserver(0));
+  struct dhcp *dhcp = netif_dhcp_data(nif);
+  if ((dhcp != NULL) && dhcp_supplied_address(nif)) {
+    fastConnect->lease_secs = dhcp->offered_t0_lease;
+  }
+  cyw43_arch_lwip_end();
+  return 0;
+}
+
 // NOLINTBEGIN(readability-magic-numbers)
 const char *network_getAuthTypeString(u_int16_t connectCode) {
   switch (connectCode) {
@@ -176,6 +262,7 @@ int network_initChipOnly() {
   DPRINTF("CYW43 Logging level: %d\n", CYW43_VERBOSE_DEBUG);
   int res;
   DPRINTF("Initialization CYW43 chip ONLY...\n");
+  netpool_reclaim();
 
   if ((res = cyw43_arch_init())) {
     DPRINTF("Failed to initialize CYW43: %d\n", res);
@@ -208,7 +295,7 @@ int network_wifiInit(wifi_mode_t mode) {
   DPRINTF("CYW43 Logging level: %d\n", CYW43_VERBOSE_DEBUG);
   uint32_t country = CYW43_COUNTRY_WORLDWIDE;
   SettingsConfigEntry *countryEntry =
-      settings_find_entry(gconfig_getContext(), PARAM_WIFI_COUNTRY);
+      gconfig_getEntry(GCONFIG_KEY_WIFI_COUNTRY);
   if (countryEntry != NULL) {
     char *valid;
     country = getCountryCode(countryEntry->value, &valid);
@@ -217,6 +304,7 @@ int network_wifiInit(wifi_mode_t mode) {
 
   int res;
   DPRINTF("Initialization WiFi...\n");
+  netpool_reclaim();
 
   if ((res = cyw43_arch_init_with_country(country))) {
     DPRINTF("Failed to initialize WiFi: %d\n", res);
@@ -271,35 +359,20 @@ int network_wifiInit(wifi_mode_t mode) {
   }
 
   // Setting the power management
-  uint32_t pmValue = NETWORK_POWER_MGMT_DISABLED;  // 0: Disable PM
-  SettingsConfigEntry *pmEntry =
-      settings_find_entry(gconfig_getContext(), PARAM_WIFI_POWER);
-  if (pmEntry != NULL) {
-    pmValue = strtoul(pmEntry->value, NULL, HEX_BASE);
-  }
-  if (pmValue < NETWORK_POWER_MGMT_MAX_OPTIONS) {
-    switch (pmValue) {
-      case 0:
-        pmValue = NETWORK_POWER_MGMT_DISABLED;  // DISABLED_PM
-        break;
-      case 1:
-        pmValue = CYW43_PERFORMANCE_PM;  // PERFORMANCE_PM
-        break;
-      case 2:
-        pmValue = CYW43_AGGRESSIVE_PM;  // AGGRESSIVE_PM
-        break;
-      case 3:
-        pmValue = CYW43_DEFAULT_PM;  // DEFAULT_PM
-        break;
-      default:
-        pmValue = CYW43_NO_POWERSAVE_MODE;  // NO_POWERSAVE_MODE
-        break;
-    }
-  }
+  uint32_t pmValue = getPowerManagement();
   DPRINTF("Setting power management to: %08x\n", pmValue);
   cyw43_wifi_pm(&cyw43_state, pmValue);
   return 0;
 }
+
+void network_setPowerSave(bool deep) {
+  if (!cyw43Initialized) {
+    return;
+  }
+  uint32_t pmValue = deep ? NETWORK_POWER_MGMT_DEEPEST : getPowerManagement();
+  DPRINTF("Setting power management to: %08x\n", pmValue);
+  cyw43_wifi_pm(&cyw43_state, pmValue);
+}
 #endif
 
 /**
@@ -316,12 +389,178 @@ void network_safePoll() {
   }
 }
 
+// Slot in the BSSID table of each network of the heap
+static uint8_t scanHash[NETWORK_SCAN_HASH_SIZE];
+static uint8_t scanHashSlot[MAX_NETWORKS];
+
+// FNV-1a of the address
+static uint32_t bssidHash(const uint8_t *bssid) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < NETWORK_MAC_SIZE; i++) {
+    hash = (hash ^ bssid[i]) * 16777619u;
+  }
+  return hash & (NETWORK_SCAN_HASH_SIZE - 1);
+}
+
+// Index of the network in the heap, or -1. The slot is where it is, or where
+// it goes
+static int scanFind(const uint8_t *bssid, uint32_t *slot) {
+  uint32_t i = bssidHash(bssid);
+  while (scanHash[i] != NETWORK_SCAN_HASH_EMPTY) {
+    if (memcmp(wifiScanData.networks[scanHash[i]].bssid, bssid,
+               NETWORK_MAC_SIZE) == 0) {
+      *slot = i;
+      return scanHash[i];
+    }
+    i = (i + 1) & (NETWORK_SCAN_HASH_SIZE - 1);
+  }
+  *slot = i;
+  return -1;
+}
+
+// Remove a slot of the table, moving back the next networks of the probe so
+// no lookup stops at the hole
+static void scanUnhash(uint32_t slot) {
+  const uint32_t mask = NETWORK_SCAN_HASH_SIZE - 1;
+  uint32_t next = slot;
+  while (true) {
+    next = (next + 1) & mask;
+    uint8_t index = scanHash[next];
+    if (index == NETWORK_SCAN_HASH_EMPTY) {
+      break;
+    }
+    uint32_t home = bssidHash(wifiScanData.networks[index].bssid);
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      scanHash[slot] = index;
+      scanHashSlot[index] = (uint8_t)slot;
+      slot = next;
+    }
+  }
+  scanHash[slot] = NETWORK_SCAN_HASH_EMPTY;
+}
+
+// Store a network in the heap, keeping the table in step
+static void scanPlace(int index, const wifi_network_info_t *network,
+                      uint8_t slot) {
+  wifiScanData.networks[index] = *network;
+  scanHashSlot[index] = slot;
+  scanHash[slot] = (uint8_t)index;
+}
+
+static void scanSiftUp(int index) {
+  wifi_network_info_t network = wifiScanData.networks[index];
+  uint8_t slot = scanHashSlot[index];
+  while (index > 0) {
+    int parent = (index - 1) / 2;
+    if (wifiScanData.networks[parent].rssi <= network.rssi) {
+      break;
+    }
+    scanPlace(index, &wifiScanData.networks[parent], scanHashSlot[parent]);
+    index = parent;
+  }
+  scanPlace(index, &network, slot);
+}
+
+static void scanSiftDown(int index) {
+  wifi_network_info_t network = wifiScanData.networks[index];
+  uint8_t slot = scanHashSlot[index];
+  int count = wifiScanData.count;
+  while (true) {
+    int child = 2 * index + 1;
+    if (child >= count) {
+      break;
+    }
+    if ((child + 1 < count) && (wifiScanData.networks[child + 1].rssi <
+                                wifiScanData.networks[child].rssi)) {
+      child++;
+    }
+    if (wifiScanData.networks[child].rssi >= network.rssi) {
+      break;
+    }
+    scanPlace(index, &wifiScanData.networks[child], scanHashSlot[child]);
+    index = child;
+  }
+  scanPlace(index, &network, slot);
+}
+
+// Rebuild the table and the heap from the list sorted by the last scan, so
+// a new scan adds to the networks already found
+static void scanRestore() {
+  memset(scanHash, NETWORK_SCAN_HASH_EMPTY, sizeof(scanHash));
+  for (int i = 0; i < wifiScanData.count; i++) {
+    uint32_t slot;
+    scanFind(wifiScanData.networks[i].bssid, &slot);
+    scanHash[slot] = (uint8_t)i;
+    scanHashSlot[i] = (uint8_t)slot;
+  }
+  for (int i = wifiScanData.count / 2 - 1; i >= 0; i--) {
+    scanSiftDown(i);
+  }
+}
+
+// Sort the heap with the strongest network first. The table is not valid
+// until the next scanRestore()
+static void scanSortByRssi() {
+  uint16_t count = wifiScanData.count;
+  while (wifiScanData.count > 1) {
+    wifi_network_info_t weakest = wifiScanData.networks[0];
+    uint16_t last = --wifiScanData.count;
+    wifiScanData.networks[0] = wifiScanData.networks[last];
+    scanHashSlot[0] = scanHashSlot[last];
+    scanSiftDown(0);
+    wifiScanData.networks[last] = weakest;
+  }
+  wifiScanData.count = count;
+}
+
+// Runs in the context of the driver for every beacon: no strings here
+static void scanAdd(const cyw43_ev_scan_result_t *result) {
+  if (result->ssid_len == 0) {
+    return;  // Hidden network
+  }
+  uint32_t slot;
+  int index = scanFind(result->bssid, &slot);
+  if (index >= 0) {
+    // Seen again, keep the strongest signal
+    if (result->rssi > wifiScanData.networks[index].rssi) {
+      wifiScanData.networks[index].rssi = result->rssi;
+      scanSiftDown(index);
+    }
+    return;
+  }
+  if (wifiScanData.count == MAX_NETWORKS) {
+    if (result->rssi <= wifiScanData.networks[0].rssi) {
+      return;  // Weaker than all the networks found
+    }
+    // Drop the weakest network
+    scanUnhash(scanHashSlot[0]);
+    uint16_t last = --wifiScanData.count;
+    if (last > 0) {
+      scanPlace(0, &wifiScanData.networks[last], scanHashSlot[last]);
+      scanSiftDown(0);
+    }
+    // The networks of the table may have moved
+    scanFind(result->bssid, &slot);
+  }
+
+  wifi_network_info_t network;
+  memcpy(network.bssid, result->bssid, NETWORK_MAC_SIZE);
+  network.ssid_len = result->ssid_len < NETWORK_SSID_SIZE ? result->ssid_len
+                                                          : NETWORK_SSID_SIZE;
+  memcpy(network.ssid, result->ssid, network.ssid_len);
+  network.auth_mode = result->auth_mode;
+  network.rssi = result->rssi;
+  index = wifiScanData.count++;
+  scanPlace(index, &network, (uint8_t)slot);
+  scanSiftUp(index);
+}
+
 /**
  * @brief Scans for available Wi-Fi networks and stores the results.
  *
  * This function initiates a Wi-Fi network scan if the network is initialized
  * and the scan interval has elapsed. It processes the scan results and stores
- * unique networks in the global `wifi_scan_data` structure.
+ * the strongest unique networks in the global `wifi_scan_data` structure.
  *
  * @param wifi_scan_time Pointer to the absolute time of the last scan.
  * @param wifi_scan_interval Interval between scans in seconds.
@@ -333,42 +572,8 @@ int network_scan(absolute_time_t *wifiScanTime, int wifiScanInterval) {
     return -1;
   }
   int scan_result(void *env, const cyw43_ev_scan_result_t *result) {
-    // Check if the BSSID already exists in the found networks
-    bool bssid_exists(wifi_network_info_t * network) {
-      for (size_t i = 0; i < wifiScanData.count; i++) {
-        if (strcmp(wifiScanData.networks[i].bssid, network->bssid) == 0) {
-          return true;  // BSSID found
-        }
-      }
-      return false;  // BSSID not found
-    }
-    if (result && wifiScanData.count < MAX_NETWORKS) {
-      wifi_network_info_t network;
-
-      // Copy SSID
-      snprintf(network.ssid, sizeof(network.ssid), "%s", result->ssid);
-
-      // Format BSSID
-      snprintf(network.bssid, sizeof(network.bssid),
-               "%02x:%02x:%02x:%02x:%02x:%02x", result->bssid[0],
-               result->bssid[1], result->bssid[2], result->bssid[3],
-               result->bssid[4], result->bssid[5]);
-
-      // Store authentication mode
-      network.auth_mode = result->auth_mode;
-
-      // Store signal strength
-      network.rssi = result->rssi;
-
-      // Check if BSSID already exists
-      if (!bssid_exists(&network)) {
-        if (strlen(network.ssid) > 0) {
-          wifiScanData.networks[wifiScanData.count] = network;
-          wifiScanData.count++;
-          DPRINTF("FOUND NETWORK %s (%s) with auth %d and RSSI %d\n",
-                  network.ssid, network.bssid, network.auth_mode, network.rssi);
-        }
-      }
+    if (result) {
+      scanAdd(result);
     }
     return 0;
   }
@@ -377,6 +582,7 @@ int network_scan(absolute_time_t *wifiScanTime, int wifiScanInterval) {
   if (absolute_time_diff_us(get_absolute_time(), *wifiScanTime) < 0) {
     if (!wifiScanInProgress) {
       DPRINTF("Scanning networks...\n");
+      scanRestore();
       cyw43_wifi_scan_options_t scanOptions = {0};
       int err = cyw43_wifi_scan(&cyw43_state, &scanOptions, NULL, scan_result);
       if (err == 0) {
@@ -390,6 +596,19 @@ int network_scan(absolute_time_t *wifiScanTime, int wifiScanInterval) {
       if (!cyw43_wifi_scan_active(&cyw43_state)) {
         DPRINTF("Continue scanning...\n");
         wifiScanInProgress = false;
+        scanSortByRssi();
+#if defined(_DEBUG) && (_DEBUG != 0)
+        for (int i = 0; i < wifiScanData.count; i++) {
+          char ssid[MAX_SSID_LENGTH];
+          char bssid[MAX_BSSID_LENGTH];
+          network_formatSsid(&wifiScanData.networks[i], ssid, sizeof(ssid));
+          network_formatBssid(wifiScanData.networks[i].bssid, bssid,
+                              sizeof(bssid));
+          DPRINTF("FOUND NETWORK %s (%s) with auth %d and RSSI %d\n", ssid,
+                  bssid, wifiScanData.networks[i].auth_mode,
+                  wifiScanData.networks[i].rssi);
+        }
+#endif
       }
       *wifiScanTime = make_timeout_time_ms(wifiScanInterval * SEC_TO_MS);
     }
@@ -418,6 +637,17 @@ int network_scanIsActive() {
  */
 wifi_scan_data_t *network_getFoundNetworks() { return &wifiScanData; }
 
+void network_formatSsid(const wifi_network_info_t *network, char *str,
+                        size_t size) {
+  snprintf(str, size, "%.*s", (int)network->ssid_len,
+           (const char *)network->ssid);
+}
+
+void network_formatBssid(const uint8_t *bssid, char *str, size_t size) {
+  snprintf(str, size, "%02x:%02x:%02x:%02x:%02x:%02x", bssid[0], bssid[1],
+           bssid[2], bssid[3], bssid[4], bssid[5]);
+}
+
 static void wifiLinkCallback(struct netif *netif) {
   DPRINTF("WiFi Link: %s\n", (netif_is_link_up(netif) ? "UP" : "DOWN"));
 }
@@ -434,7 +664,8 @@ static void networkStatusCallback(struct netif *netif) {
   }
 }
 
-wifi_sta_conn_process_status_t network_wifiStaConnect() {
+wifi_sta_conn_process_status_t network_wifiStaConnectStart() {
+  connPending = false;
   if (!cyw43Initialized) {
     DPRINTF("WiFi not initialized. Cancelling connection\n");
     return NETWORK_WIFI_STA_CONN_ERR_NOT_INITIALIZED;
@@ -447,8 +678,7 @@ wifi_sta_conn_process_status_t network_wifiStaConnect() {
   int res;
 
   // Set hostname
-  char *hostname =
-      settings_find_entry(gconfig_getContext(), PARAM_HOSTNAME)->value;
+  char *hostname = gconfig_getEntry(GCONFIG_KEY_HOSTNAME)->value;
 
   // Set the STA mode interface mode
   struct netif *nif = &cyw43_state.netif[CYW43_ITF_STA];
@@ -469,24 +699,35 @@ wifi_sta_conn_process_status_t network_wifiStaConnect() {
   netif_set_status_callback(nif, networkStatusCallback);
 
   // DHCP or static IP
-  if ((settings_find_entry(gconfig_getContext(), PARAM_WIFI_DHCP) != NULL) &&
-      (settings_find_entry(gconfig_getContext(), PARAM_WIFI_DHCP)->value[0] ==
-           't' ||
-       settings_find_entry(gconfig_getContext(), PARAM_WIFI_DHCP)->value[0] ==
-           'T')) {
+  connFastLease = false;
+  if (gconfig_getBool(GCONFIG_KEY_WIFI_DHCP, false)) {
     DPRINTF("DHCP enabled\n");
+    if (fastConnectEnabled && fastConnectInfo.use_lease) {
+      // The lease is still valid. Use it now and renew it after joining
+      dhcp_stop(nif);
+      netif_set_addr(nif, ip_2_ip4(&fastConnectInfo.ip),
+                     ip_2_ip4(&fastConnectInfo.netmask),
+                     ip_2_ip4(&fastConnectInfo.gateway));
+      dns_setserver(0, &fastConnectInfo.dns);
+      connFastLease = true;
+      DPRINTF("Reusing the DHCP lease: %s\n",
+              ipaddr_ntoa(&fastConnectInfo.ip));
+    } else if (fastLeaseApplied) {
+      // A previous fast attempt stopped DHCP. Start again from scratch
+      netif_set_addr(nif, IP4_ADDR_ANY4, IP4_ADDR_ANY4, IP4_ADDR_ANY4);
+      dhcp_start(nif);
+    }
+    fastLeaseApplied = connFastLease;
   } else {
     DPRINTF("Static IP enabled\n");
     dhcp_stop(nif);
     ip_addr_t ipaddr;
     ip_addr_t netmask;
     ip_addr_t gwy;
-    ipaddr.addr = ipaddr_addr(
-        settings_find_entry(gconfig_getContext(), PARAM_WIFI_IP)->value);
-    netmask.addr = ipaddr_addr(
-        settings_find_entry(gconfig_getContext(), PARAM_WIFI_NETMASK)->value);
-    gwy.addr = ipaddr_addr(
-        settings_find_entry(gconfig_getContext(), PARAM_WIFI_GATEWAY)->value);
+    ipaddr.addr = ipaddr_addr(gconfig_getEntry(GCONFIG_KEY_WIFI_IP)->value);
+    netmask.addr =
+        ipaddr_addr(gconfig_getEntry(GCONFIG_KEY_WIFI_NETMASK)->value);
+    gwy.addr = ipaddr_addr(gconfig_getEntry(GCONFIG_KEY_WIFI_GATEWAY)->value);
     netif_set_addr(nif, &ipaddr, &netmask, &gwy);
     DPRINTF("IP: %s\n", ipaddr_ntoa(&ipaddr));
     DPRINTF("Netmask: %s\n", ipaddr_ntoa(&netmask));
@@ -495,8 +736,7 @@ wifi_sta_conn_process_status_t network_wifiStaConnect() {
     // Now set the DNS
     // The values in PARAM_WIFI_DNS are separated by commas. Only one or two
     // values are allowed
-    SettingsConfigEntry *entry =
-        settings_find_entry(gconfig_getContext(), PARAM_WIFI_DNS);
+    SettingsConfigEntry *entry = gconfig_getEntry(GCONFIG_KEY_WIFI_DNS);
     if (entry == NULL || entry->value == NULL) {
       DPRINTF("Error: DNS configuration is missing.\n");
     } else {
@@ -542,21 +782,18 @@ wifi_sta_conn_process_status_t network_wifiStaConnect() {
     return NETWORK_WIFI_STA_CONN_ERR_MAC_FAILED;
   }
 
-  SettingsConfigEntry *ssid =
-      settings_find_entry(gconfig_getContext(), PARAM_WIFI_SSID);
+  SettingsConfigEntry *ssid = gconfig_getEntry(GCONFIG_KEY_WIFI_SSID);
   if (strlen(ssid->value) == 0) {
     DPRINTF("No SSID found in config. Can't connect\n");
     return NETWORK_WIFI_STA_CONN_ERR_NO_SSID;
   }
-  SettingsConfigEntry *authMode =
-      settings_find_entry(gconfig_getContext(), PARAM_WIFI_AUTH);
+  SettingsConfigEntry *authMode = gconfig_getEntry(GCONFIG_KEY_WIFI_AUTH);
   if (strlen(authMode->value) == 0) {
     DPRINTF("No auth mode found in config. Can't connect\n");
     return NETWORK_WIFI_STA_CONN_ERR_NO_AUTH_MODE;
   }
   char *passwordValue = NULL;
-  SettingsConfigEntry *password =
-      settings_find_entry(gconfig_getContext(), PARAM_WIFI_PASSWORD);
+  SettingsConfigEntry *password = gconfig_getEntry(GCONFIG_KEY_WIFI_PASSWORD);
   if (strlen(password->value) > 0) {
     passwordValue = strdup(password->value);
   } else {
@@ -565,32 +802,108 @@ wifi_sta_conn_process_status_t network_wifiStaConnect() {
   }
   DPRINTF("The password is: %s\n", passwordValue);
 
-  uint32_t authValue = getAuthPicoCode(atoi(authMode->value));
+  uint32_t authValue =
+      getAuthPicoCode(gconfig_getInt(GCONFIG_KEY_WIFI_AUTH, 0));
   int errorCode = 0;
   DPRINTF("Connecting to SSID=%s, password=%s, auth=%08x. ASYNC\n", ssid->value,
           passwordValue, authValue);
-  errorCode =
-      cyw43_arch_wifi_connect_async(ssid->value, passwordValue, authValue);
+  int connectTimeout = NETWORK_CONNECT_TIMEOUT;
+  if (fastConnectEnabled && (fastConnectInfo.channel != 0)) {
+    // Same access point on the same channel: no scan. Like
+    // cyw43_arch_wifi_connect_async() but with the channel
+    DPRINTF("Fast connect to BSSID %02x:%02x:%02x:%02x:%02x:%02x, channel %d\n",
+            fastConnectInfo.bssid[0], fastConnectInfo.bssid[1],
+            fastConnectInfo.bssid[2], fastConnectInfo.bssid[3],
+            fastConnectInfo.bssid[4], fastConnectInfo.bssid[5],
+            fastConnectInfo.channel);
+    errorCode = cyw43_wifi_join(
+        &cyw43_state, strlen(ssid->value), (const uint8_t *)ssid->value,
+        passwordValue ? strlen(passwordValue) : 0,
+        (const uint8_t *)passwordValue,
+        passwordValue ? authValue : CYW43_AUTH_OPEN, fastConnectInfo.bssid,
+        fastConnectInfo.channel);
+    connectTimeout = NETWORK_FAST_CONNECT_TIMEOUT;
+  } else {
+    errorCode =
+        cyw43_arch_wifi_connect_async(ssid->value, passwordValue, authValue);
+  }
   free(passwordValue);
   if (errorCode != 0) {
     DPRINTF("Failed to connect to WiFi: %d\n", errorCode);
     return NETWORK_WIFI_STA_CONN_ERR_CONNECTION_FAILED;
   }
 
-  // Enter a loop until the device has a WiFi connection with an IP address. Or
-  // timesout.
-  wifi_sta_conn_status_t prevStatus = DISCONNECTED;
+  connPrevStatus = DISCONNECTED;
+  connStatusTime = make_timeout_time_ms(1 * SEC_TO_MS);
+  connFast = (connectTimeout == NETWORK_FAST_CONNECT_TIMEOUT);
+  connTimeout = make_timeout_time_ms(connectTimeout * SEC_TO_MS);
+  connPending = true;
+#ifdef BLINK_H
+  blink_play("T", true);
+#endif
+  return NETWORK_WIFI_STA_CONN_OK;
+}
+
+wifi_sta_conn_process_status_t network_wifiStaConnectPoll() {
+  if (!connPending) {
+    return NETWORK_WIFI_STA_CONN_ERR_NOT_INITIALIZED;
+  }
+#ifdef BLINK_H
+  blink_poll();
+#endif
   int wifiConnPollingInterval = 1;  // 1 seconds
-  absolute_time_t wifiConnStatusTime = make_timeout_time_ms(1 * SEC_TO_MS);
-  absolute_time_t wifiConnConnTimeout =
-      make_timeout_time_ms(NETWORK_CONNECT_TIMEOUT * SEC_TO_MS);  // 30 seconds
-  while (absolute_time_diff_us(get_absolute_time(), wifiConnConnTimeout) > 0) {
+  wifi_sta_conn_status_t status =
+      network_wifiConnStatus(&connStatusTime, wifiConnPollingInterval);
+  if (status != connPrevStatus) {
+    DPRINTF("WiFi connection status: %s[%i]\n", network_wifiConnStatusStr(),
+            status);
+    if (status == CONNECTED_WIFI_NO_IP) {
+      // Joined. Waiting for the address
+      boottime_begin(BOOT_PHASE_DHCP);
+    } else if ((status == CONNECTED_WIFI_IP) && !connFastLease) {
+      boottime_end(BOOT_PHASE_DHCP);
+    }
+    connPrevStatus = status;
+  }
+  if (status == CONNECTED_WIFI_IP) {
+    connPending = false;
+#ifdef BLINK_H
+    blink_stop();
+    blink_on();
+#endif
+    if (connFastLease) {
+      // Renew the lease in the background, keeping the address meanwhile
+      cyw43_arch_lwip_begin();
+      dhcp_start(&cyw43_state.netif[CYW43_ITF_STA]);
+      cyw43_arch_lwip_end();
+    }
+    DPRINTF("Connected. Check the connection status...\n");
+    return NETWORK_WIFI_STA_CONN_OK;
+  }
+  if (time_reached(connTimeout)) {
+    connPending = false;
 #ifdef BLINK_H
-    blink_morse('T');
+    blink_stop();
 #endif
+    DPRINTF("WiFi connection timeout\n");
+    if (connFast) {
+      // Leave the pending join before scanning again
+      cyw43_wifi_leave(&cyw43_state, CYW43_ITF_STA);
+    }
+    return NETWORK_WIFI_STA_CONN_ERR_TIMEOUT;
+  }
+  return NETWORK_WIFI_STA_CONN_PENDING;
+}
 
-    wifi_sta_conn_status_t status =
-        network_wifiConnStatus(&wifiConnStatusTime, wifiConnPollingInterval);
+wifi_sta_conn_process_status_t network_wifiStaConnect() {
+  wifi_sta_conn_process_status_t err = network_wifiStaConnectStart();
+  if (err != NETWORK_WIFI_STA_CONN_OK) {
+    return err;
+  }
+  // Enter a loop until the device has a WiFi connection with an IP address. Or
+  // timesout.
+  while ((err = network_wifiStaConnectPoll()) ==
+         NETWORK_WIFI_STA_CONN_PENDING) {
 #if PICO_CYW43_ARCH_POLL
     network_safePoll();
     cyw43_arch_wait_for_work_until(make_timeout_time_ms(2 * SEC_TO_MS));
@@ -600,25 +913,8 @@ wifi_sta_conn_process_status_t network_wifiStaConnect() {
     if (networkPollingCallback != NULL) {
       networkPollingCallback();
     }
-    if (status != prevStatus) {
-      DPRINTF("WiFi connection status: %s[%i]\n", network_wifiConnStatusStr(),
-              status);
-      prevStatus = status;
-    }
-    if (status == CONNECTED_WIFI_IP) {
-#ifdef BLINK_H
-      blink_on();
-#endif
-      break;
-    }
   }
-  if (absolute_time_diff_us(get_absolute_time(), wifiConnConnTimeout) <= 0) {
-    DPRINTF("WiFi connection timeout\n");
-    return NETWORK_WIFI_STA_CONN_ERR_TIMEOUT;
-  }
-
-  DPRINTF("Connected. Check the connection status...\n");
-  return 0;
+  return err;
 }
 
 char *network_wifiConnStatusStr() { return connectionStatusStr; }
@@ -701,3 +997,14 @@ wifi_sta_conn_status_t network_wifiConnStatus(
  * @return The current IP address as an ip_addr_t structure.
  */
 ip_addr_t network_getCurrentIp() { return currentIp; }
+
+int network_getRssi(int32_t *rssi) {
+  if (!cyw43Initialized || (wifiCurrentMode != WIFI_MODE_STA)) {
+    return -1;
+  }
+  int linkStatus = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+  if ((linkStatus < CYW43_LINK_JOIN) || (linkStatus > CYW43_LINK_UP)) {
+    return -1;
+  }
+  return cyw43_wifi_get_rssi(&cyw43_state, rssi) == 0 ? 0 : -1;
+}
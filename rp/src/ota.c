@@ -0,0 +1,400 @@
+/**
+ * File: ota.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Update of the app image over HTTP
+ */
+
+#include "ota.h"
+
+static OtaState otaState = OTA_IDLE;
+static const char *otaError = "";
+
+static char otaHost[SETTINGS_MAX_VALUE_LENGTH] = {0};
+static char otaPath[SETTINGS_MAX_VALUE_LENGTH] = {0};
+static uint8_t otaHash[OTA_HASH_SIZE];
+static HTTPC_REQUEST_T otaRequest = {0};
+
+// Staging slot: the free flash between the running binary and ROM_TEMP.
+// Offsets from the start of the flash
+static uint32_t slotOffset = 0;
+static uint32_t slotSize = 0;
+
+// Bytes received and bytes written, both from the start of the image. The
+// ring holds the difference, never more than OTA_RING_SIZE
+static uint8_t *ring = NULL;
+static volatile uint32_t ringIn = 0;
+static uint32_t ringOut = 0;
+static struct altcp_pcb *otaConn = NULL;
+
+// Written by the callbacks of lwIP
+static const char *volatile recvError = NULL;
+static volatile bool transferDone = false;
+static volatile httpc_result_t transferResult = HTTPC_RESULT_OK;
+static volatile u32_t transferStatus = 0;
+
+static mbedtls_sha256_context shaContext;
+static uint32_t imageLength = 0;
+static uint32_t hashedLength = 0;
+
+typedef struct {
+  uint32_t offset;
+  const uint8_t *data;
+} OtaSector;
+
+// The version 3 of Mbed TLS drops the _ret suffix
+#if MBEDTLS_VERSION_MAJOR >= 3
+#define OTA_SHA256_STARTS mbedtls_sha256_starts
+#define OTA_SHA256_UPDATE mbedtls_sha256_update
+#define OTA_SHA256_FINISH mbedtls_sha256_finish
+#else
+#define OTA_SHA256_STARTS mbedtls_sha256_starts_ret
+#define OTA_SHA256_UPDATE mbedtls_sha256_update_ret
+#define OTA_SHA256_FINISH mbedtls_sha256_finish_ret
+#endif
+
+static void fail(const char *error) {
+  DPRINTF("OTA update failed: %s\n", error);
+  otaError = error;
+  otaState = OTA_FAILED;
+  if (ring != NULL) {
+    free(ring);
+    ring = NULL;
+  }
+#if APP_DOWNLOAD_HTTPS == 1
+  if (otaRequest.tls_config != NULL) {
+    altcp_tls_free_config(otaRequest.tls_config);
+    otaRequest.tls_config = NULL;
+  }
+#endif
+}
+
+static int parseHash(const char *hex) {
+  if (strlen(hex) != OTA_HASH_SIZE * 2) {
+    return -1;
+  }
+  for (int i = 0; i < OTA_HASH_SIZE; i++) {
+    char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+    char *end;
+    otaHash[i] = (uint8_t)strtoul(byte, &end, 16);
+    if (*end != '\0') {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// http[s]://host[:port]/path
+static int parseUrl(const char *url, bool *https, uint16_t *port) {
+  const char *host;
+  if (strncmp(url, "http://", 7) == 0) {
+    *https = false;
+    host = url + 7;
+  } else if (strncmp(url, "https://", 8) == 0) {
+    *https = true;
+    host = url + 8;
+  } else {
+    return -1;
+  }
+  const char *path = strchr(host, '/');
+  if (path == NULL) {
+    path = host + strlen(host);
+  }
+  const char *colon = strchr(host, ':');
+  const char *hostEnd = ((colon != NULL) && (colon < path)) ? colon : path;
+  if (hostEnd == host) {
+    return -1;
+  }
+  *port = 0;
+  if (hostEnd == colon) {
+    char *end;
+    unsigned long value = strtoul(colon + 1, &end, 10);
+    if ((end != path) || (value == 0) || (value > 65535)) {
+      return -1;
+    }
+    *port = (uint16_t)value;
+  }
+  if (*path == '\0') {
+    path = "/";
+  }
+  snprintf(otaHost, sizeof(otaHost), "%.*s", (int)(hostEnd - host), host);
+  snprintf(otaPath, sizeof(otaPath), "%s", path);
+  return 0;
+}
+
+static err_t otaHeadersCB(httpc_state_t *connection, void *arg,
+                          struct pbuf *hdr, u16_t hdr_len, u32_t content_len) {
+  // 0xFFFFFFFF when the server does not send the length
+  if ((content_len != 0xFFFFFFFF) && (content_len > slotSize)) {
+    recvError = "Image larger than the slot";
+    return ERR_ABRT;
+  }
+  return ERR_OK;
+}
+
+// Copy the body to the ring. It is acknowledged to the server in
+// ota_poll(), once in the flash
+static err_t otaRecvCB(void *arg, struct altcp_pcb *conn, struct pbuf *p,
+                       err_t err) {
+  if (p == NULL) {
+    return ERR_OK;
+  }
+  otaConn = conn;
+  uint32_t in = ringIn;
+  if ((in - ringOut + p->tot_len > OTA_RING_SIZE) ||
+      (in + p->tot_len > slotSize)) {
+    recvError = (in + p->tot_len > slotSize) ? "Image larger than the slot"
+                                             : "Receive window too large";
+    pbuf_free(p);
+    altcp_abort(conn);
+    return ERR_ABRT;
+  }
+  for (struct pbuf *q = p; q != NULL; q = q->next) {
+    const uint8_t *data = (const uint8_t *)q->payload;
+    uint32_t left = q->len;
+    while (left > 0) {
+      uint32_t pos = in % OTA_RING_SIZE;
+      uint32_t chunk = OTA_RING_SIZE - pos;
+      if (chunk > left) {
+        chunk = left;
+      }
+      memcpy(&ring[pos], data, chunk);
+      data += chunk;
+      in += chunk;
+      left -= chunk;
+    }
+  }
+  ringIn = in;
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static void otaResultCB(void *arg, httpc_result_t httpc_result,
+                        u32_t rx_content_len, u32_t srv_res, err_t err) {
+  transferResult = httpc_result;
+  transferStatus = srv_res;
+  transferDone = true;
+}
+
+static void programLocal(void *param) {
+  const OtaSector *sector = (const OtaSector *)param;
+  flash_range_erase(sector->offset, FLASH_SECTOR_SIZE);
+  flash_range_program(sector->offset, sector->data, FLASH_SECTOR_SIZE);
+}
+
+// Copy the slot over the running app and reboot. Everything runs from RAM
+// with the interrupts off: the code in the flash is being erased. Each
+// sector is read before any write reaches it, the slot is above the app
+static void __not_in_flash_func(applyLocal)(void *param) {
+  uint32_t length = *(const uint32_t *)param;
+  volatile uint32_t *buffer = (volatile uint32_t *)ring;
+  for (uint32_t offset = 0; offset < length; offset += FLASH_SECTOR_SIZE) {
+    const volatile uint32_t *src =
+        (const volatile uint32_t *)(XIP_BASE + slotOffset + offset);
+    // No memcpy, it can be in the flash
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE / sizeof(uint32_t); i++) {
+      buffer[i] = src[i];
+    }
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    flash_range_program(offset, ring, FLASH_SECTOR_SIZE);
+  }
+  // Cold boot, not the vector of the watchdog
+  watchdog_hw->scratch[4] = 0;
+  watchdog_hw->ctrl = WATCHDOG_CTRL_TRIGGER_BITS;
+  while (true) {
+  }
+}
+
+int ota_start(const char *url, const char *sha256) {
+  if ((otaState == OTA_DOWNLOADING) || (otaState == OTA_VERIFYING)) {
+    otaError = "Update in progress";
+    return -1;
+  }
+  otaError = "";
+  bool https;
+  uint16_t port;
+  if ((url == NULL) || (parseUrl(url, &https, &port) != 0)) {
+    otaError = "Invalid URL";
+    return -1;
+  }
+  if ((sha256 == NULL) || (parseHash(sha256) != 0)) {
+    otaError = "Invalid SHA-256";
+    return -1;
+  }
+#if APP_DOWNLOAD_HTTPS != 1
+  if (https) {
+    otaError = "No HTTPS in this build";
+    return -1;
+  }
+#endif
+  ip_addr_t ip = network_getCurrentIp();
+  if (ip.addr == 0) {
+    otaError = "No network";
+    return -1;
+  }
+
+  uint32_t binaryEnd = (uint32_t)&__flash_binary_end - XIP_BASE;
+  slotOffset = (binaryEnd + FLASH_SECTOR_SIZE - 1) & ~(FLASH_SECTOR_SIZE - 1);
+  uint32_t slotEnd = (uint32_t)&_rom_temp_start - XIP_BASE;
+  slotSize = (slotEnd > slotOffset) ? slotEnd - slotOffset : 0;
+  if (slotSize == 0) {
+    otaError = "No free flash for the image";
+    return -1;
+  }
+  ring = (uint8_t *)malloc(OTA_RING_SIZE);
+  if (ring == NULL) {
+    otaError = "Out of memory";
+    return -1;
+  }
+  ringIn = 0;
+  ringOut = 0;
+  otaConn = NULL;
+  recvError = NULL;
+  transferDone = false;
+  transferResult = HTTPC_RESULT_OK;
+  transferStatus = 0;
+
+  memset(&otaRequest, 0, sizeof(otaRequest));
+  otaRequest.hostname = otaHost;
+  otaRequest.url = otaPath;
+  otaRequest.port = port;
+  otaRequest.headers_fn = otaHeadersCB;
+  otaRequest.recv_fn = otaRecvCB;
+  otaRequest.result_fn = otaResultCB;
+#if APP_DOWNLOAD_HTTPS == 1
+  // No certificate: the image is trusted by its hash
+  otaRequest.tls_config = https ? altcp_tls_create_config_client(NULL, 0)
+                                : NULL;
+  if (https && (otaRequest.tls_config == NULL)) {
+    free(ring);
+    ring = NULL;
+    otaError = "Cannot start TLS";
+    return -1;
+  }
+#endif
+  otaState = OTA_DOWNLOADING;
+  if (http_client_request_async(cyw43_arch_async_context(), &otaRequest) !=
+      0) {
+    fail("Cannot connect to the server");
+    return -1;
+  }
+  DPRINTF("OTA update from %s%s to the slot at 0x%08lx, %lu bytes\n",
+          otaHost, otaPath, (unsigned long)slotOffset,
+          (unsigned long)slotSize);
+  return 0;
+}
+
+// Write the next sector of the ring. The last one is padded
+static void writeSector(uint32_t in) {
+  uint8_t *data = &ring[ringOut % OTA_RING_SIZE];
+  if (in - ringOut < FLASH_SECTOR_SIZE) {
+    memset(&data[in - ringOut], 0xFF, FLASH_SECTOR_SIZE - (in - ringOut));
+  }
+  OtaSector sector = {slotOffset + ringOut, data};
+  int rc = flash_safe_execute(programLocal, &sector, OTA_LOCKOUT_MS);
+  if (rc != PICO_OK) {
+    if (!transferDone && (otaConn != NULL)) {
+      cyw43_arch_lwip_begin();
+      altcp_abort(otaConn);
+      cyw43_arch_lwip_end();
+    }
+    fail("Cannot write the flash");
+    return;
+  }
+  ringOut += FLASH_SECTOR_SIZE;
+  // Open the window again, unless the connection is closed
+  if (!transferDone && (otaConn != NULL)) {
+    cyw43_arch_lwip_begin();
+    altcp_recved(otaConn, FLASH_SECTOR_SIZE);
+    cyw43_arch_lwip_end();
+  }
+}
+
+static void endDownload(uint32_t in) {
+  if (recvError != NULL) {
+    fail(recvError);
+  } else if (transferResult != HTTPC_RESULT_OK) {
+    fail("Download interrupted");
+  } else if (transferStatus != 200) {
+    fail("HTTP error from the server");
+  } else if (in == 0) {
+    fail("Empty image");
+  } else {
+    DPRINTF("OTA image downloaded, %lu bytes\n", (unsigned long)in);
+    imageLength = in;
+    hashedLength = 0;
+    mbedtls_sha256_init(&shaContext);
+    OTA_SHA256_STARTS(&shaContext, 0);
+    otaState = OTA_VERIFYING;
+  }
+}
+
+// Hash one sector of the slot per call
+static void verifySector(void) {
+  uint32_t chunk = imageLength - hashedLength;
+  if (chunk > FLASH_SECTOR_SIZE) {
+    chunk = FLASH_SECTOR_SIZE;
+  }
+  OTA_SHA256_UPDATE(
+      &shaContext,
+      (const uint8_t *)(XIP_BASE + slotOffset + hashedLength), chunk);
+  hashedLength += chunk;
+  if (hashedLength < imageLength) {
+    return;
+  }
+  uint8_t hash[OTA_HASH_SIZE];
+  OTA_SHA256_FINISH(&shaContext, hash);
+  mbedtls_sha256_free(&shaContext);
+  if (memcmp(hash, otaHash, OTA_HASH_SIZE) != 0) {
+    fail("SHA-256 mismatch");
+    return;
+  }
+  // The initial stack pointer of the image must be in the SRAM
+  uint32_t stack = *(const uint32_t *)(XIP_BASE + slotOffset +
+                                       OTA_VECTOR_OFFSET);
+  if ((imageLength <= OTA_VECTOR_OFFSET) || (stack <= SRAM_BASE) ||
+      (stack > SRAM_END)) {
+    fail("Not an app image");
+    return;
+  }
+  DPRINTF("OTA image verified. Installing and rebooting...\n");
+  uint32_t length = ringOut;
+  int rc = flash_safe_execute(applyLocal, &length, OTA_LOCKOUT_MS);
+  // Only back here if core 1 could not be stopped
+  fail((rc == PICO_OK) ? "Cannot install the image" : "Flash busy");
+}
+
+void ota_poll(void) {
+  if (otaState == OTA_VERIFYING) {
+    verifySector();
+    return;
+  }
+  if (otaState != OTA_DOWNLOADING) {
+    return;
+  }
+  // The end of the transfer before the data, so no bytes are missed
+  bool done = transferDone;
+  uint32_t in = ringIn;
+  if (recvError != NULL) {
+    if (done) {
+      fail(recvError);
+    }
+    return;
+  }
+  // One sector per call, so the loop keeps running
+  if ((in > ringOut) && (done || (in - ringOut >= FLASH_SECTOR_SIZE))) {
+    writeSector(in);
+  } else if (done) {
+    endDownload(in);
+  }
+}
+
+OtaState ota_getState(uint32_t *written) {
+  if (written != NULL) {
+    *written = (ringIn < ringOut) ? ringIn : ringOut;
+  }
+  return otaState;
+}
+
+const char *ota_getError(void) { return otaError; }
@@ -14,10 +14,19 @@ void reset_device() {
   DPRINTF("You should never reach this point\n");
 }
 
+// Runs with the interrupts disabled and core 1 parked
+static void eraseLocal(void *param) {
+  *(int *)param = settings_erase(gconfig_getContext());
+}
+
 void reset_deviceAndEraseFlash() {
   // Erase the settings
   DPRINTF("Erasing the flash memory\n");
-  settings_erase(gconfig_getContext());
+  int err = 0;
+  int rc = flash_safe_execute(eraseLocal, &err, RESET_ERASE_LOCKOUT_MS);
+  if ((rc != PICO_OK) || (err != 0)) {
+    DPRINTF("Cannot erase the settings. rc=%d err=%d\n", rc, err);
+  }
   DPRINTF("Erasing the app lookup table\n");
   sleep_ms(SEC_TO_MS);
 
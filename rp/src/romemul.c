@@ -15,17 +15,332 @@ static int lookupDataRomDmaChannel = -1;
 // Default PIO to use
 static PIO defaultPio = pio0;
 
+// State machines timed by the bus timing, and the offset of the read program
+static int smMonitorRom3 = -1;
+static int smMonitorRom4 = -1;
+static int smReadRom = -1;
+static uint offsetReadRom = 0;
+
+// Current bus timing
+static uint8_t busWaitCycles = READ_ADDRESS_SAFE_WAIT_CYCLES;
+static float busDivider = SAMPLE_DIV_FREQ;
+
+// Ratio of the system clock to RP2040_CLOCK_FREQ_KHZ. The dividers of the bus
+// are scaled by it, so the state machines keep the timing they are tuned for
+static float busClockScale = 1.0f;
+
+// ROM image read by the DMA
+static uint8_t activeImage = 0;
+
+// Function executed in core 1 on behalf of core 0
+typedef int (*Core1Function)(uintptr_t arg);
+
+// Free running SysTick of this core, used to time the bus interrupts
+static inline void enableSysTick(void) {
+  systick_hw->rvr = 0x00FFFFFF;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5;  // Enabled, processor clock, no interrupt
+}
+
+// The monitors and the read program, or the load generator in its place,
+// share the instruction memory of the default PIO
+#if ROMEMUL_SELF_TEST == 1
+#define ROMEMUL_READ_PROGRAM_LENGTH ROMEMUL_PROGRAM_LENGTH(bus_loadgen)
+#else
+#define ROMEMUL_READ_PROGRAM_LENGTH ROMEMUL_PROGRAM_LENGTH(romemul_read)
+#endif
+_Static_assert(ROMEMUL_PROGRAM_LENGTH(monitor_rom3) +
+                       ROMEMUL_PROGRAM_LENGTH(monitor_rom4) +
+                       ROMEMUL_READ_PROGRAM_LENGTH <=
+                   ROMEMUL_PIO_INSTRUCTIONS,
+               "The bus programs do not fit in the default PIO");
+
+#if ROMEMUL_SELF_TEST == 1
+// No bus to write the data words to. The lookup DMA drops them here
+static uint16_t selfTestSink = 0;
+#endif
+
+// Alarm pool with the IRQ in core 1, used by the capture timer
+static alarm_pool_t *core1AlarmPool = NULL;
+
+#if ROMEMUL_CORE1_BUS == 1
+static volatile bool core1Running = false;
+
+// Function called by core 1 each time it wakes up, to process the commands
+static volatile IRQInterceptionCallback core1LoopCB = NULL;
+
+// Core 1 main loop. Owns the bus interrupts and runs the functions requested
+// by core 0 through the FIFO. Sleeps until an interrupt or an event arrives.
+static void __not_in_flash_func(core1Main)(void) {
+  enableSysTick();
+#if ROMEMUL_ROM3_CAPTURE == 1
+  core1AlarmPool = alarm_pool_create_with_unused_hardware_alarm(
+      ROMEMUL_CORE1_MAX_TIMERS);
+#endif
+  while (true) {
+    while (multicore_fifo_rvalid()) {
+      Core1Function fn = (Core1Function)multicore_fifo_pop_blocking();
+      uintptr_t arg = (uintptr_t)multicore_fifo_pop_blocking();
+      multicore_fifo_push_blocking((uint32_t)fn(arg));
+    }
+    IRQInterceptionCallback loop = core1LoopCB;
+    if (loop != NULL) {
+      loop();
+    }
+    __wfe();
+  }
+}
+#endif
+
+// Run the function in core 1 if it owns the bus, otherwise in this core
+static int runOnCore1(Core1Function fn, uintptr_t arg) {
+#if ROMEMUL_CORE1_BUS == 1
+  if (core1Running) {
+    multicore_fifo_push_blocking((uint32_t)fn);
+    multicore_fifo_push_blocking((uint32_t)arg);
+    return (int)multicore_fifo_pop_blocking();
+  }
+#endif
+  return fn(arg);
+}
+
+// Flash safety helper for flash_safe_execute(). The FIFO of core 1 already
+// carries the requests of runOnCore1(), so instead of the SDK lockout victim
+// core 1 is parked in RAM through the same FIFO while the flash is written.
+// The ROM reads are served by the DMA chain and never stop. The bus
+// interrupts run from RAM and stay enabled, so the commands of the computer
+// are still parsed into the queue. They are run once core 1 is released.
+#if ROMEMUL_CORE1_BUS == 1
+static volatile bool core1Parked = false;
+static volatile bool core1Release = false;
+
+// PIO interrupt of the header filter in core 1, or -1
+static int filterIrqNum = -1;
+
+// The handlers of the bus interrupts are in RAM. Any other may run from flash
+static bool isBusIrq(uint num) {
+  return (num == DMA_IRQ_1) || ((int)num == filterIrqNum);
+}
+
+// Disable the interrupts of this core that may run from flash, and return
+// the mask of the ones disabled
+static uint64_t maskFlashIrqs(void) {
+  uint64_t masked = 0;
+  for (uint num = 0; num < NUM_IRQS; num++) {
+    if (!isBusIrq(num) && irq_is_enabled(num)) {
+      irq_set_enabled(num, false);
+      masked |= 1ull << num;
+    }
+  }
+  return masked;
+}
+
+static void restoreFlashIrqs(uint64_t masked) {
+  for (uint num = 0; num < NUM_IRQS; num++) {
+    if (masked & (1ull << num)) {
+      irq_set_enabled(num, true);
+    }
+  }
+}
+
+// Runs in core 1. Spins in RAM with only the bus interrupts enabled until
+// released. The interrupts are masked before core 0 is told to write the
+// flash, and restored once it has finished, so those calls can be in flash
+static int __not_in_flash_func(parkCore1Local)(uintptr_t arg) {
+  uint64_t masked = maskFlashIrqs();
+  core1Parked = true;
+  __sev();
+  while (!core1Release) {
+    __wfe();
+  }
+  core1Parked = false;
+  restoreFlashIrqs(masked);
+  return 0;
+}
+#endif
+
+static uint32_t flashSafeInts = 0;
+
+static bool flashSafeCoreInitDeinit(bool init) { return true; }
+
+static int flashSafeEnter(uint32_t timeoutMs) {
+#if ROMEMUL_CORE1_BUS == 1
+  if (core1Running) {
+    core1Release = false;
+    multicore_fifo_push_blocking((uint32_t)parkCore1Local);
+    multicore_fifo_push_blocking(0);
+    absolute_time_t until = make_timeout_time_ms(timeoutMs);
+    while (!core1Parked) {
+      if (best_effort_wfe_or_timeout(until)) {
+        // Let core 1 go on when it finally gets the request
+        core1Release = true;
+        __sev();
+        multicore_fifo_pop_blocking();
+        return PICO_ERROR_TIMEOUT;
+      }
+    }
+  }
+#endif
+  flashSafeInts = save_and_disable_interrupts();
+  return PICO_OK;
+}
+
+static int flashSafeExit(uint32_t timeoutMs) {
+  restore_interrupts(flashSafeInts);
+#if ROMEMUL_CORE1_BUS == 1
+  if (core1Running) {
+    core1Release = true;
+    __sev();
+    multicore_fifo_pop_blocking();
+  }
+#endif
+  return PICO_OK;
+}
+
+static flash_safety_helper_t flashSafetyHelper = {
+    .core_init_deinit = flashSafeCoreInitDeinit,
+    .enter_safe_zone_timeout_ms = flashSafeEnter,
+    .exit_safe_zone_timeout_ms = flashSafeExit,
+};
+
+// Replaces the weak helper of the SDK used by flash_safe_execute()
+flash_safety_helper_t *get_flash_safety_helper(void) {
+  return &flashSafetyHelper;
+}
+
+#if ROMEMUL_ROM3_CAPTURE == 1
+// Ring buffer with the addresses read from the bus, filled by the DMA
+static uint32_t captureRing[ROMEMUL_CAPTURE_RING_WORDS]
+    __attribute__((aligned(ROMEMUL_CAPTURE_RING_BYTES)));
+static int captureDmaChannel = -1;
+static uint32_t captureReadIndex = 0;
+static repeating_timer_t captureTimer;
+static CaptureAddressCallback captureCB = NULL;
+static volatile uint32_t captureOverruns = 0;
+
+// Drop the unread addresses up to the write position and clear the ring
+// ahead of the guard, so the next overrun can be detected
+static void __not_in_flash_func(captureSkipTo)(uint32_t writeIndex) {
+  for (uint32_t i =
+           (writeIndex + ROMEMUL_CAPTURE_GUARD_WORDS) & ROMEMUL_CAPTURE_RING_MASK;
+       i != writeIndex; i = (i + 1) & ROMEMUL_CAPTURE_RING_MASK) {
+    captureRing[i] = 0;
+  }
+  captureReadIndex = writeIndex;
+}
+
+// Drain the capture ring up to the current DMA write position.
+// The words drained are cleared, and no captured address is zero, so a word
+// set ahead of the write position means the DMA went round the ring over
+// unread addresses. The check skips the next ROMEMUL_CAPTURE_GUARD_WORDS,
+// where the DMA may be writing right now.
+static bool __not_in_flash_func(captureTimerCallback)(repeating_timer_t *t) {
+  uint32_t writeIndex =
+      ((dma_hw->ch[captureDmaChannel].write_addr - (uint32_t)captureRing) >>
+       2) &
+      ROMEMUL_CAPTURE_RING_MASK;
+  uint32_t pending =
+      (writeIndex - captureReadIndex) & ROMEMUL_CAPTURE_RING_MASK;
+  uint32_t ahead =
+      (writeIndex + ROMEMUL_CAPTURE_GUARD_WORDS) & ROMEMUL_CAPTURE_RING_MASK;
+  if ((pending >= ROMEMUL_CAPTURE_RING_WORDS - ROMEMUL_CAPTURE_GUARD_WORDS) ||
+      (captureRing[ahead] != 0)) {
+    // The unread addresses are mixed with newer ones. Drop them
+    captureOverruns++;
+    captureSkipTo(writeIndex);
+    return true;
+  }
+  while (captureReadIndex != writeIndex) {
+    uint32_t addr = captureRing[captureReadIndex];
+    captureRing[captureReadIndex] = 0;
+    captureReadIndex = (captureReadIndex + 1) & ROMEMUL_CAPTURE_RING_MASK;
+    // We expect that the ROM3 signal is not set very often
+    if (__builtin_expect(addr & ROMEMUL_ROM3_ADDRESS_BIT, 0)) {
+      captureCB(addr);
+    }
+  }
+  return true;
+}
+#endif
+
+#if ROMEMUL_ROM3_PIO_FILTER == 1
+// DMA channel that feeds the PIO header filter and the filter state machine
+static int filterDmaChannel = -1;
+static int smFilter = -1;
+static uint offsetFilter = 0;
+
+// The filter runs apart from the state machines that serve the ROM4 reads,
+// whose programs leave no room for it in the instruction memory of pio0. The
+// RP2350 has a third PIO block for it. The RP2040 shares pio1 with the SPI
+// program of the CYW43
+#if NUM_PIOS > 2
+static PIO filterPio = pio2;
+#else
+static PIO filterPio = pio1;
+#endif
+
+_Static_assert(ROMEMUL_PROGRAM_LENGTH(rom3_header_filter) +
+                       ROMEMUL_CYW43_SPI_INSTRUCTIONS <=
+                   ROMEMUL_PIO_INSTRUCTIONS,
+               "The ROM3 header filter does not fit in its PIO block");
+static FrameAddressCallback frameCB = NULL;
+
+// Make the filter state machine look for the next protocol header
+static inline void __not_in_flash_func(filterRearm)(void) {
+  pio_sm_exec(filterPio, smFilter,
+              pio_encode_jmp(offsetFilter + rom3_header_filter_offset_hunt));
+  while (!pio_sm_is_rx_fifo_empty(filterPio, smFilter)) {
+    (void)pio_sm_get(filterPio, smFilter);
+  }
+}
+
+// Only triggered when the filter has found a header and forwards the frame
+static void __not_in_flash_func(filterIrqHandler)(void) {
+  while (!pio_sm_is_rx_fifo_empty(filterPio, smFilter)) {
+    uint32_t addr = pio_sm_get(filterPio, smFilter);
+    if (!frameCB(addr)) {
+      filterRearm();
+      break;
+    }
+  }
+}
+
+static int initHeaderFilter(PIO pio) {
+  uint offset = pio_add_program(pio, &rom3_header_filter_program);
+  int sm = pio_claim_unused_sm(pio, false);
+  if (sm < 0) {
+    DPRINTF("No free state machine for the ROM3 header filter.\n");
+    return -1;
+  }
+  rom3_header_filter_program_init(pio, sm, offset,
+                                  SAMPLE_DIV_FREQ * busClockScale);
+  pio_sm_set_enabled(pio, sm, true);
+
+  // The raw address of the header: MSB of the RAM address, ROM3 signal and the
+  // 16 bits of the bus with the highest bit inverted
+  uint32_t rawHeader =
+      (((uint32_t)&__rom_in_ram_start__ >> ROMEMUL_BUS_BITS)
+       << ROMEMUL_BUS_BITS) |
+      ROMEMUL_ROM3_ADDRESS_BIT | (ROMEMUL_FILTER_HEADER ^ 0x8000);
+  pio_sm_put_blocking(pio, sm, rawHeader);
+
+  offsetFilter = offset;
+  DPRINTF("ROM3 header filter initialized. Header: 0x%08X\n", rawHeader);
+  return sm;
+}
+#endif
+
 // Interrupt handler for DMA completion
 // We don't use at runtime, but they are useful for debugging
-// Keep in mind that printing in an interrupt handler is not a good idea
-// because it can cause delays in the processing of the data
+// They write in the trace ring because printing in an interrupt handler
+// delays the processing of the data
 void __not_in_flash_func(dma_irqHandlerLookup)(void) {
   // Read the address to process
   uint16_t addrLsb = dma_hw->ch[lookupDataRomDmaChannel].al3_read_addr_trig;
 
   dma_hw->ints1 = 1U << lookupDataRomDmaChannel;
 
-  DPRINTF("DMA_LSB LOOKUP: $%x\n", addrLsb);
+  DTRACE(TRACE_DMA_LOOKUP, addrLsb, 0);
 }
 
 void __not_in_flash_func(dma_irqHandlerAddress)(void) {
@@ -35,7 +350,7 @@ void __not_in_flash_func(dma_irqHandlerAddress)(void) {
   // Clear the interrupt request for the channel
   dma_hw->ints0 = 1U << readAddrRomDmaChannel;
 
-  DPRINTF("DMA ADDR: $%x, VALUE: $%x\n", addr, value);
+  DTRACE(TRACE_DMA_ADDRESS, addr, value);
 }
 
 static int initMonitorRom4(PIO pio) {
@@ -49,7 +364,7 @@ static int initMonitorRom4(PIO pio) {
 
   // Start the state machine, executing the PIO read program
   monitor_rom4_program_init(pio, smMonitorROM4, offsetMonitorROM4,
-                            SAMPLE_DIV_FREQ);
+                            SAMPLE_DIV_FREQ * busClockScale);
 
   // Enable the state machine
   pio_sm_set_enabled(pio, smMonitorROM4, true);
@@ -70,7 +385,7 @@ static int initMonitorRom3(PIO pio) {
   // Start the state machine, executing the PIO read program
   // monitor rom3 and rom4 share the same init function
   monitor_rom4_program_init(pio, smMonitorROM3, offsetMonitorROM3,
-                            SAMPLE_DIV_FREQ);
+                            SAMPLE_DIV_FREQ * busClockScale);
 
   // Enable the state machine
   pio_sm_set_enabled(pio, smMonitorROM3, true);
@@ -106,9 +421,41 @@ static int initRomEmulator(PIO pio, IRQInterceptionCallback requestCallback,
     return -1;
   }
 
+#if ROMEMUL_ROM3_CAPTURE == 1
+  // Claim another channel to copy each address looked up into the ring buffer
+  captureDmaChannel = dma_claim_unused_channel(true);
+  DPRINTF("DMA channel for capture_dma_channel: %d\n", captureDmaChannel);
+  if (captureDmaChannel == -1) {
+    DPRINTF("Failed to claim a DMA channel for capture_dma_channel.\n");
+    return -1;
+  }
+#endif
+
+#if ROMEMUL_ROM3_PIO_FILTER == 1
+  // Start the header filter and claim another channel to feed it with each
+  // address looked up
+  smFilter = initHeaderFilter(filterPio);
+  if (smFilter < 0) {
+    return -1;
+  }
+  filterDmaChannel = dma_claim_unused_channel(true);
+  DPRINTF("DMA channel for filter_dma_channel: %d\n", filterDmaChannel);
+  if (filterDmaChannel == -1) {
+    DPRINTF("Failed to claim a DMA channel for filter_dma_channel.\n");
+    return -1;
+  }
+#endif
+
   // Now, read_addr_rom_dma_channel and lookup_data_rom_dma_channel hold the
   // channel numbers for your tasks, and you can use them throughout your code.
 
+#if ROMEMUL_SELF_TEST == 1
+  // The load generator takes the place of the read program. It waits for its
+  // period from romemul_startLoadGen()
+  uint offsetReadROM = pio_add_program(pio, &bus_loadgen_program);
+  uint smReadROM = pio_claim_unused_sm(pio, true);
+  bus_loadgen_program_init(pio, smReadROM, offsetReadROM);
+#else
   // Configure the read PIO state machine
   // Add the assembled program to the PIO into the memory where there are enough
   // space
@@ -120,13 +467,15 @@ static int initRomEmulator(PIO pio, IRQInterceptionCallback requestCallback,
   // Start the state machine, executing the PIO read program
   romemul_read_program_init(pio, smReadROM, offsetReadROM, READ_ADDR_GPIO_BASE,
                             READ_ADDR_PIN_COUNT, READ_SIGNAL_GPIO_BASE,
-                            SAMPLE_DIV_FREQ);
+                            SAMPLE_DIV_FREQ * busClockScale);
+#endif
 
   // Need to clear _input shift counter_, as well as FIFO, because there may be
   // partial ISR contents left over from a previous run. sm_restart does this.
   pio_sm_clear_fifos(pio, smReadROM);
   pio_sm_restart(pio, smReadROM);
   pio_sm_set_enabled(pio, smReadROM, true);
+  offsetReadRom = offsetReadROM;
 
   // DMA configuration
   // Lookup data DMA: the address of the data to read from the ROM is injected
@@ -138,10 +487,59 @@ static int initRomEmulator(PIO pio, IRQInterceptionCallback requestCallback,
   channel_config_set_transfer_data_size(&cdmaLookup, DMA_SIZE_16);
   channel_config_set_read_increment(&cdmaLookup, false);
   channel_config_set_write_increment(&cdmaLookup, false);
+#if ROMEMUL_SELF_TEST == 1
+  // Nobody reads the data words, so the lookup does not wait
+  volatile void *lookupDest = &selfTestSink;
+  channel_config_set_dreq(&cdmaLookup, DREQ_FORCE);
+#else
+  volatile void *lookupDest = &pio->txf[smReadROM];
   channel_config_set_dreq(&cdmaLookup, pio_get_dreq(pio, smReadROM, true));
+#endif
+#if ROMEMUL_ROM3_CAPTURE == 1
+  channel_config_set_chain_to(&cdmaLookup, captureDmaChannel);
+#elif ROMEMUL_ROM3_PIO_FILTER == 1
+  channel_config_set_chain_to(&cdmaLookup, filterDmaChannel);
+#else
   channel_config_set_chain_to(&cdmaLookup, readAddrRomDmaChannel);
-  dma_channel_configure(lookupDataRomDmaChannel, &cdmaLookup,
-                        &pio->txf[smReadROM], NULL, 1, false);
+#endif
+  dma_channel_configure(lookupDataRomDmaChannel, &cdmaLookup, lookupDest, NULL,
+                        1, false);
+
+#if ROMEMUL_ROM3_CAPTURE == 1
+  // Capture DMA: once the data is pushed to the bus, copy the address used by
+  // the lookup channel into the ring buffer and chain back to the read address
+  // channel. The write address wraps around the ring buffer.
+  dma_channel_config cdmaCapture =
+      dma_channel_get_default_config(captureDmaChannel);
+  channel_config_set_transfer_data_size(&cdmaCapture, DMA_SIZE_32);
+  channel_config_set_read_increment(&cdmaCapture, false);
+  channel_config_set_write_increment(&cdmaCapture, true);
+  channel_config_set_ring(&cdmaCapture, true, ROMEMUL_CAPTURE_RING_BITS);
+  channel_config_set_chain_to(&cdmaCapture, readAddrRomDmaChannel);
+  dma_channel_configure(captureDmaChannel, &cdmaCapture, captureRing,
+                        &dma_hw->ch[lookupDataRomDmaChannel].read_addr, 1,
+                        false);
+#endif
+
+#if ROMEMUL_ROM3_PIO_FILTER == 1
+  // Filter DMA: once the data is pushed to the bus, copy the address used by
+  // the lookup channel into the TX FIFO of the header filter and chain back to
+  // the read address channel. Paced by the filter, so no address is lost. The
+  // hunt loop takes three cycles per address, far less than the bus, so the
+  // FIFO never holds the chain back in practice.
+  dma_channel_config cdmaFilter =
+      dma_channel_get_default_config(filterDmaChannel);
+  channel_config_set_transfer_data_size(&cdmaFilter, DMA_SIZE_32);
+  channel_config_set_read_increment(&cdmaFilter, false);
+  channel_config_set_write_increment(&cdmaFilter, false);
+  channel_config_set_dreq(&cdmaFilter,
+                          pio_get_dreq(filterPio, smFilter, true));
+  channel_config_set_chain_to(&cdmaFilter, readAddrRomDmaChannel);
+  dma_channel_configure(filterDmaChannel, &cdmaFilter,
+                        &filterPio->txf[smFilter],
+                        &dma_hw->ch[lookupDataRomDmaChannel].read_addr, 1,
+                        false);
+#endif
 
   // Read address DMA: the address to read from the ROM is obtained from the
   // FIFO and injected into the read address trigger register of the lookup data
@@ -178,7 +576,8 @@ static int initRomEmulator(PIO pio, IRQInterceptionCallback requestCallback,
   DPRINTF("ROM emulator initialized.\n");
   return smReadROM;
 }
-void dma_setResponseCB(IRQInterceptionCallback responseCallback) {
+static int setResponseCBLocal(uintptr_t arg) {
+  IRQInterceptionCallback responseCallback = (IRQInterceptionCallback)arg;
   // Change the the response callback function
   if (responseCallback != NULL) {
     DPRINTF(
@@ -198,6 +597,145 @@ void dma_setResponseCB(IRQInterceptionCallback responseCallback) {
     irq_set_enabled(DMA_IRQ_1, true);
     DPRINTF("DMA callback function changed.\n");
   }
+  return 0;
+}
+
+void dma_setResponseCB(IRQInterceptionCallback responseCallback) {
+  runOnCore1(setResponseCBLocal, (uintptr_t)responseCallback);
+}
+
+static int setCaptureCBLocal(uintptr_t arg) {
+#if ROMEMUL_ROM3_CAPTURE == 1
+  CaptureAddressCallback captureCallback = (CaptureAddressCallback)arg;
+  if (captureCallback == NULL) {
+    DPRINTF("Capture callback function is NULL.\n");
+    return -1;
+  }
+  // The per access interrupt is not needed anymore
+  dma_channel_set_irq1_enabled(lookupDataRomDmaChannel, false);
+  irq_set_enabled(DMA_IRQ_1, false);
+
+  // Skip the addresses captured before the callback was set
+  captureSkipTo(((dma_hw->ch[captureDmaChannel].write_addr -
+                  (uint32_t)captureRing) >>
+                 2) &
+                ROMEMUL_CAPTURE_RING_MASK);
+  captureCB = captureCallback;
+
+  // Negative interval: the period is measured from the start of each callback
+  alarm_pool_t *pool =
+      (core1AlarmPool != NULL) ? core1AlarmPool : alarm_pool_get_default();
+  if (!alarm_pool_add_repeating_timer_us(pool, -ROMEMUL_CAPTURE_POLL_US,
+                                         captureTimerCallback, NULL,
+                                         &captureTimer)) {
+    DPRINTF("Failed to start the capture timer.\n");
+    return -1;
+  }
+  DPRINTF("Capture callback function set.\n");
+  return 0;
+#else
+  DPRINTF("ROM3 capture not enabled in this build.\n");
+  return -1;
+#endif
+}
+
+int dma_setCaptureCB(CaptureAddressCallback captureCallback) {
+  return runOnCore1(setCaptureCBLocal, (uintptr_t)captureCallback);
+}
+
+uint32_t romemul_getCaptureOverruns(void) {
+#if ROMEMUL_ROM3_CAPTURE == 1
+  return captureOverruns;
+#else
+  return 0;
+#endif
+}
+
+static int setFrameCBLocal(uintptr_t arg) {
+#if ROMEMUL_ROM3_PIO_FILTER == 1
+  FrameAddressCallback frameCallback = (FrameAddressCallback)arg;
+  if (frameCallback == NULL) {
+    DPRINTF("Frame callback function is NULL.\n");
+    return -1;
+  }
+  // The per access interrupt is not needed anymore
+  dma_channel_set_irq1_enabled(lookupDataRomDmaChannel, false);
+  irq_set_enabled(DMA_IRQ_1, false);
+
+  // Discard anything forwarded before the callback was set
+  frameCB = frameCallback;
+  filterRearm();
+
+  // Interrupt only when the filter forwards addresses of a frame
+  enum pio_interrupt_source rxNotEmpty =
+      (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + smFilter);
+  uint filterIrq = pio_get_irq_num(filterPio, 0);
+  pio_set_irq0_source_enabled(filterPio, rxNotEmpty, true);
+  irq_set_exclusive_handler(filterIrq, filterIrqHandler);
+  irq_set_enabled(filterIrq, true);
+#if ROMEMUL_CORE1_BUS == 1
+  filterIrqNum = (int)filterIrq;
+#endif
+  DPRINTF("Frame callback function set.\n");
+  return 0;
+#else
+  DPRINTF("ROM3 PIO filter not enabled in this build.\n");
+  return -1;
+#endif
+}
+
+int dma_setFrameCB(FrameAddressCallback frameCallback) {
+  return runOnCore1(setFrameCBLocal, (uintptr_t)frameCallback);
+}
+
+#if ROMEMUL_CORE1_BUS == 1
+static int setCore1LoopLocal(uintptr_t arg) {
+  core1LoopCB = (IRQInterceptionCallback)arg;
+  return 0;
+}
+#endif
+
+int romemul_setCore1Loop(IRQInterceptionCallback loopCallback) {
+#if ROMEMUL_CORE1_BUS == 1
+  if (!core1Running) {
+    DPRINTF("Core 1 is not running the bus.\n");
+    return -1;
+  }
+  return runOnCore1(setCore1LoopLocal, (uintptr_t)loopCallback);
+#else
+  DPRINTF("Core 1 bus servicing not enabled in this build.\n");
+  return -1;
+#endif
+}
+
+// Nothing to do: core 1 answers once its handlers have returned
+static int waitBusIrqsLocal(uintptr_t arg) { return 0; }
+
+void romemul_waitBusIrqs(void) { runOnCore1(waitBusIrqsLocal, 0); }
+
+int romemul_launchCore1Bus(void) {
+#if ROMEMUL_CORE1_BUS == 1
+  if (core1Running) {
+    return 0;
+  }
+  // Move the DMA IRQ handler, if any, from this core to core 1. The vector
+  // table is shared, but the interrupts are enabled per core.
+  IRQInterceptionCallback handler = NULL;
+  if (irq_is_enabled(DMA_IRQ_1)) {
+    handler = (IRQInterceptionCallback)irq_get_exclusive_handler(DMA_IRQ_1);
+    irq_set_enabled(DMA_IRQ_1, false);
+  }
+  DPRINTF("Launching core 1 to service the bus\n");
+  multicore_launch_core1(core1Main);
+  core1Running = true;
+  if (handler != NULL) {
+    dma_setResponseCB(handler);
+  }
+  return 0;
+#else
+  DPRINTF("Core 1 bus servicing not enabled in this build.\n");
+  return -1;
+#endif
 }
 
 int init_romemul(IRQInterceptionCallback requestCallback,
@@ -209,6 +747,9 @@ int init_romemul(IRQInterceptionCallback requestCallback,
   bus_ctrl_hw->priority =
       BUSCTRL_BUS_PRIORITY_DMA_W_BITS | BUSCTRL_BUS_PRIORITY_DMA_R_BITS;
 
+  // The bus interrupts run in this core unless core 1 owns the bus
+  enableSysTick();
+
   // Copy the content of the FLASH to RAM before initializing the emulator code
   // If not initialized, assume somebody else will copy "something" to RAM
   // eventually...
@@ -236,6 +777,9 @@ int init_romemul(IRQInterceptionCallback requestCallback,
     DPRINTF("Error initializing ROM emulator. Error code: %d\n", smReadROM);
     return -1;
   }
+  smMonitorRom3 = smMonitorROM3;
+  smMonitorRom4 = smMonitorROM4;
+  smReadRom = smReadROM;
 
   // Push to the FIFO the Most Significant word of the addresses to read from
   // the ROM in the lower 17 bits of the 32 bits of the FIFO register. Only need
@@ -243,16 +787,22 @@ int init_romemul(IRQInterceptionCallback requestCallback,
   // 16 bits In the PIO program, the address is shifted left 1 bit to make room
   // for the ROM4 signal and the 16 bits of the address from the GPIO input. So
   // the address is created as follows: bits 31-17: MSB of the address from the
-  // rp2040 memory. In our case 0x20020000 bit 16: ROM4 signal. Since is an
+  // rp2040 memory. In our case 0x21020000 bit 16: ROM4 signal. Since is an
   // inverted signal, we set it to 0 for ROM4 and 1 if not ROM4 (ROM3) bits
   // 15-0: 16 bits of the address from the GPIO input The RAM memory address of
   // the rp2040 and the FLASH memory used are defined in the file memmap_rp.ld
   // Please do not modify these values, because they are carefully selected to
   // avoid conflicts and be performant.
 
+  // The base of the first image goes to X and the base of the last one to Y.
+  // With one image both are the same
+#if ROMEMUL_SELF_TEST == 0
+  pio_sm_put_blocking(defaultPio, smReadROM,
+                      romemul_getImageAddress(0) >> ROMEMUL_BUS_BITS);
   pio_sm_put_blocking(
       defaultPio, smReadROM,
-      ((unsigned long int)&__rom_in_ram_start__ >> ROMEMUL_BUS_BITS));
+      romemul_getImageAddress(ROMEMUL_IMAGES - 1) >> ROMEMUL_BUS_BITS);
+#endif
 
   // Setting the signals after configuring the PIO makes the ROM emulator to not
   // put inconsistent data in the address or data bus at any time, avoiding
@@ -290,3 +840,119 @@ int init_romemul(IRQInterceptionCallback requestCallback,
     gpio_put(WRITE_DATA_GPIO_BASE + i, 0);
   }
 }
+
+// Instruction of romemul_read with the delay of the waits and the base of the
+// active image
+static uint16_t readProgramInstruction(uint i, uint8_t waitCycles) {
+  uint16_t instr = romemul_read_program_instructions[i];
+  // Only the waits have a delay in romemul_read
+  if (((instr >> ROMEMUL_DELAY_SHIFT) & ROMEMUL_MAX_WAIT_CYCLES) ==
+      READ_ADDRESS_SAFE_WAIT_CYCLES) {
+    instr = (uint16_t)((instr & ~(ROMEMUL_MAX_WAIT_CYCLES
+                                  << ROMEMUL_DELAY_SHIFT)) |
+                       (waitCycles << ROMEMUL_DELAY_SHIFT));
+  }
+  if ((i == romemul_read_offset_select_base) && (activeImage != 0)) {
+    instr = (uint16_t)((instr & ~ROMEMUL_MOV_SOURCE_MASK) |
+                       ROMEMUL_MOV_SOURCE_Y);
+  }
+  return instr;
+}
+
+int romemul_setBusTiming(uint8_t waitCycles, float divider) {
+  // In the self-test build bus_loadgen runs in place of romemul_read, so
+  // there is nothing to patch
+  if ((ROMEMUL_SELF_TEST == 1) || (smReadRom < 0) ||
+      (waitCycles > ROMEMUL_MAX_WAIT_CYCLES) || (divider < 1.0f) ||
+      (divider > ROMEMUL_MAX_DIVIDER)) {
+    return -1;
+  }
+  // The instruction memory is write only: rebuild the program from the
+  // assembled one. The instructions without a wait are written unchanged
+  for (uint i = 0; i < romemul_read_program.length; i++) {
+    defaultPio->instr_mem[offsetReadRom + i] =
+        readProgramInstruction(i, waitCycles);
+  }
+  // The monitors and the emulator run from the same clock
+  float scaled = divider * busClockScale;
+  pio_sm_set_clkdiv(defaultPio, smMonitorRom3, scaled);
+  pio_sm_set_clkdiv(defaultPio, smMonitorRom4, scaled);
+  pio_sm_set_clkdiv(defaultPio, smReadRom, scaled);
+  pio_clkdiv_restart_sm_mask(defaultPio, (1u << smMonitorRom3) |
+                                             (1u << smMonitorRom4) |
+                                             (1u << smReadRom));
+  busWaitCycles = waitCycles;
+  busDivider = divider;
+  return 0;
+}
+
+uint32_t romemul_getImageAddress(uint8_t image) {
+  switch (image) {
+    case 0:
+      return (uint32_t)&__rom_in_ram_start__;
+#if ROMEMUL_IMAGES > 1
+    case 1:
+      return (uint32_t)&__rom_in_ram_alt_start__;
+#endif
+    default:
+      return 0;
+  }
+}
+
+int romemul_selectImage(uint8_t image) {
+  if ((ROMEMUL_SELF_TEST == 1) || (ROMEMUL_ROM3_PIO_FILTER == 1) ||
+      (smReadRom < 0) || (image >= ROMEMUL_IMAGES)) {
+    return -1;
+  }
+  activeImage = image;
+  // One write, so the switch lands between two bus cycles
+  defaultPio->instr_mem[offsetReadRom + romemul_read_offset_select_base] =
+      readProgramInstruction(romemul_read_offset_select_base, busWaitCycles);
+  DPRINTF("ROM image %u at 0x%08X\n", image, romemul_getImageAddress(image));
+  return 0;
+}
+
+uint8_t romemul_getActiveImage(void) { return activeImage; }
+
+int romemul_setSystemClock(uint32_t clockKhz) {
+  if ((smReadRom >= 0) || (clockKhz < RP2040_CLOCK_FREQ_KHZ)) {
+    return -1;
+  }
+  busClockScale = (float)clockKhz / (float)RP2040_CLOCK_FREQ_KHZ;
+  return 0;
+}
+
+void romemul_getBusTiming(uint8_t *waitCycles, float *divider) {
+  *waitCycles = busWaitCycles;
+  *divider = busDivider;
+}
+
+const volatile uint32_t *romemul_getLookupAddress(void) {
+  if (lookupDataRomDmaChannel < 0) {
+    return NULL;
+  }
+  return &dma_hw->ch[lookupDataRomDmaChannel].read_addr;
+}
+
+int romemul_startLoadGen(uint32_t periodCycles, volatile uint32_t **txFifo,
+                         uint *dreq) {
+#if ROMEMUL_SELF_TEST == 1
+  if ((smReadRom < 0) || (periodCycles < ROMEMUL_LOADGEN_LOOP_CYCLES)) {
+    return -1;
+  }
+  // Drop what is left of the last pattern and wait for the new period
+  pio_sm_set_enabled(defaultPio, smReadRom, false);
+  pio_sm_clear_fifos(defaultPio, smReadRom);
+  pio_sm_restart(defaultPio, smReadRom);
+  pio_sm_exec(defaultPio, smReadRom, pio_encode_jmp(offsetReadRom));
+  pio_sm_put(defaultPio, smReadRom,
+             periodCycles - ROMEMUL_LOADGEN_LOOP_CYCLES);
+  pio_sm_set_enabled(defaultPio, smReadRom, true);
+  *txFifo = (volatile uint32_t *)&defaultPio->txf[smReadRom];
+  *dreq = pio_get_dreq(defaultPio, smReadRom, true);
+  return 0;
+#else
+  DPRINTF("Bus load generator not enabled in this build.\n");
+  return -1;
+#endif
+}
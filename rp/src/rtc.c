@@ -8,9 +8,12 @@
 
 #include "rtc.h"
 
-// Communication with the remote computer
-static TransmissionProtocol lastProtocol;
-static bool lastProtocolValid = false;
+// Communication with the remote computer. The commands of the RTC carry the
+// random token and up to four longs
+_Static_assert(RTCEMUL_PARAMETERS_MAX_SIZE <= DISPATCH_PARAMETERS_MAX_SIZE,
+               "The commands of the RTC do not fit in the dispatch frames");
+_Static_assert(RTCEMUL_SHARED_VARS_MAX_PAIRS >= 2,
+               "The two shared variables do not fit in the frames of the RTC");
 
 // MEmory base
 static uint32_t memorySharedAddress = 0;
@@ -27,48 +30,121 @@ static DallasClock dallasClock = {0};
 static datetime_t rtcTime = {0};
 static NTP_TIME netTime;
 static long utcOffsetSeconds = 0;
+static TzRules tzRules;
+static bool tzRulesActive = false;  // The UTC offset is a POSIX TZ string
 static char ntpServerHost[SETTINGS_MAX_VALUE_LENGTH] = {0};
 static int ntpServerPort = NTP_DEFAULT_PORT;
+static RTC_NTP_STATE ntpState = RTC_NTP_IDLE;
+static absolute_time_t ntpDeadline;
+static absolute_time_t ntpCollectDeadline;
+static int ntpAttempts = 0;
+static bool rtcStarted = false;
+
+// NTP server address cache persisted in the settings
+static ip_addr_t ntpCacheIp;
+static bool ntpCacheValid = false;
+static int ntpCacheTtl = RTCEMUL_NTP_CACHE_TTL_S;
+static int ntpCacheTime = 0;
+static bool ntpCacheDirty = false;
+
+// Clock kept across the watchdog reboots, and checkpointed in the flash
+static RTC_WARM_STATE __uninitialized_ram(warmState);
+static bool rtcTrusted = false;
+static int rtcCheckpoint = 0;
+static repeating_timer_t warmTimer;
+
+// Software clock disciplined by NTP. The published time is the anchor plus
+// the elapsed time corrected by the drift, and the offset found in the last
+// resync is slewed in instead of stepped
+static volatile bool clockAnchored = false;
+static uint64_t anchorMonoUs = 0;
+static int64_t anchorUnixUs = 0;
+static int64_t slewOffsetUs = 0;
+static bool anchorCoarse = false;  // Anchored from a second resolution source
+static uint64_t lastSyncMonoUs = 0;
+static char lastSyncHost[SETTINGS_MAX_VALUE_LENGTH] = {0};
+static uint32_t lastSyncRttUs = 0;  // 0 if synced from the HTTP Date header
+static uint8_t lastSyncStratum = 0;
+static NTP_SYNC_RECORD syncHistory[RTCEMUL_SYNC_HISTORY];
+static uint32_t syncCount = 0;
+static ip_addr_t dhcpNtpServer;  // NTP server of the DHCP option 42
+static bool dhcpNtpValid = false;
+static bool ntpLocalOnly = false;  // Query only the servers of the network
+static uint32_t ntpResyncIntervalS = RTCEMUL_NTP_RESYNC_MIN_S;
+static absolute_time_t ntpNextSync;
+static bool ntpSuspended = false;  // The network is down between resyncs
+
+// HTTP Date header time source
+static char httpTimeHost[SETTINGS_MAX_VALUE_LENGTH] = {0};
+static HTTPC_REQUEST_T httpTimeRequest = {0};
+static bool httpTimeInFlight = false;
+static volatile bool httpTimeValid = false;
+static uint64_t httpTimeMonoUs = 0;
+static int64_t httpTimeUnixUs = 0;
 
 // Y2K patch
 static bool y2kPatchEnabled = false;
 
+// Keep the date and time in the shared memory always fresh
+static repeating_timer_t datetimeTimer;
+
 static void setUtcOffsetSeconds(long offset) { utcOffsetSeconds = offset; }
 
 static long getUtcOffsetSeconds() { return utcOffsetSeconds; }
 
-static datetime_t *getRtcTime() { return &rtcTime; }
+// Offset of the local time at an instant. With a TZ string, it also moves
+// the table of the time zone to the next transition. The main loop, the lwIP
+// callbacks and the warm timer interrupt all call it, so the table and the
+// offset only change with the interrupts disabled
+static long local_offset(int64_t utc_us) {
+  uint32_t ints = save_and_disable_interrupts();
+  if (tzRulesActive) {
+    setUtcOffsetSeconds(
+        tzrules_offsetAt(&tzRules, (uint32_t)(utc_us / 1000000LL)));
+  }
+  long offset = getUtcOffsetSeconds();
+  restore_interrupts(ints);
+  return offset;
+}
 
 static NTP_TIME *getNetTime() { return &netTime; }
 
-static void hostFoundCB(const char *name, const ip_addr_t *ipaddr, void *arg) {
-  if (name == NULL) {
-    DPRINTF("NTP host name is NULL\n");
-    return;
-  }
+// Read a 64-bit NTP timestamp in network order from the message
+static uint64_t ntp_get_timestamp(struct pbuf *p, uint16_t offset) {
+  uint32_t words[2];
+  pbuf_copy_partial(p, words, sizeof(words), offset);
+  return ((uint64_t)lwip_ntohl(words[0]) << 32) | lwip_ntohl(words[1]);
+}
+
+// Convert a 64-bit NTP timestamp to microseconds since the NTP epoch
+static uint64_t ntp_timestamp_to_us(uint64_t timestamp) {
+  return (timestamp >> 32) * 1000000ULL +
+         (((timestamp & 0xFFFFFFFFULL) * 1000000ULL) >> 32);
+}
 
-  NTP_TIME *ntime = (NTP_TIME *)(arg);
-  if (ntime == NULL) {
-    DPRINTF("NTP_TIME argument is NULL\n");
-    ntime->ntp_error = true;
+static void hostFoundCB(const char *name, const ip_addr_t *ipaddr, void *arg) {
+  NTP_SERVER *server = (NTP_SERVER *)(arg);
+  if (server == NULL) {
+    DPRINTF("NTP_SERVER argument is NULL\n");
     return;
   }
 
-  if (ipaddr != NULL && !ntime->ntp_server_found) {
-    ntime->ntp_server_found = true;
-    ntime->ntp_ipaddr = *ipaddr;
-    DPRINTF("NTP Host found: %s\n", name);
-    DPRINTF("NTP Server IP: %s\n", ipaddr_ntoa(&ntime->ntp_ipaddr));
-  } else if (ipaddr == NULL) {
-    DPRINTF("IP address for NTP Host '%s' not found.\n", name);
-    ntime->ntp_error = true;
+  if (ipaddr != NULL) {
+    server->ipaddr = *ipaddr;
+    server->resolved = true;
+    boottime_end(BOOT_PHASE_DNS);
+    DPRINTF("NTP Host found: %s\n", server->host);
+    DPRINTF("NTP Server IP: %s\n", ipaddr_ntoa(&server->ipaddr));
+  } else {
+    DPRINTF("IP address for NTP Host '%s' not found.\n", server->host);
+    server->error = true;
   }
 }
 
 static void ntpRecvCB(void *arg, struct udp_pcb *pcb, struct pbuf *p,
                       const ip_addr_t *addr, u16_t port) {
-  // Logging the entry into the callback
-  DPRINTF("ntpRecvCB\n");
+  // Take the local time first, it is part of the round trip
+  uint64_t recv_us = time_us_64();
 
   // Validate the NTP response
   if (p == NULL || p->tot_len != NTP_MSG_LEN) {
@@ -79,13 +155,6 @@ static void ntpRecvCB(void *arg, struct udp_pcb *pcb, struct pbuf *p,
     return;
   }
 
-  // Ensure we are getting the response from the server we expect
-  if (!ip_addr_cmp(&netTime.ntp_ipaddr, addr) || port != NTP_DEFAULT_PORT) {
-    DPRINTF("Received response from unexpected server or port\n");
-    pbuf_free(p);
-    return;
-  }
-
   // Extract relevant fields from the NTP message
   uint8_t mode =
       pbuf_get_at(p, 0) & 0x07;         // mode should be 4 for server response
@@ -98,48 +167,53 @@ static void ntpRecvCB(void *arg, struct udp_pcb *pcb, struct pbuf *p,
     return;
   }
 
-  // Extract the Transmit Timestamp (field starting at byte 40)
-  uint32_t transmit_timestamp_secs;
-  pbuf_copy_partial(p, &transmit_timestamp_secs,
-                    sizeof(transmit_timestamp_secs), 40);
-  transmit_timestamp_secs =
-      lwip_ntohl(transmit_timestamp_secs) - NTP_DELTA + utcOffsetSeconds;
-
-  // Convert NTP time to a `struct tm`
-  time_t utc_sec = transmit_timestamp_secs;
-  struct tm *utc = gmtime(&utc_sec);
-  if (utc == NULL) {
-    DPRINTF("Error converting NTP time to struct tm\n");
+  // Match the answer with the request by the originate timestamp (byte 24)
+  uint64_t originate = ntp_get_timestamp(p, 24);
+  NTP_SERVER *server = NULL;
+  for (int i = 0; i < netTime.server_count; i++) {
+    NTP_SERVER *candidate = &netTime.servers[i];
+    if (candidate->sent && !candidate->answered &&
+        candidate->originate == originate &&
+        ip_addr_cmp(&candidate->ipaddr, addr)) {
+      server = candidate;
+      break;
+    }
+  }
+  if (server == NULL || port != ntpServerPort) {
+    DPRINTF("Received response from unexpected server or port\n");
     pbuf_free(p);
     return;
   }
 
-  // Fill the rtcTime structure
-  rtcTime.year = utc->tm_year + 1900;
-  rtcTime.month = utc->tm_mon + 1;
-  rtcTime.day = utc->tm_mday;
-  rtcTime.hour = utc->tm_hour;
-  rtcTime.min = utc->tm_min;
-  rtcTime.sec = utc->tm_sec;
-  rtcTime.dotw = utc->tm_wday;  // Day of the week, Sunday is day 0
-
-  // Set the RTC with the received time
-  if (!rtc_set_datetime(&rtcTime)) {
-    DPRINTF("Cannot set internal RTC!\n");
-  } else {
-    DPRINTF("RP2040 RTC set to: %02d/%02d/%04d %02d:%02d:%02d UTC+0\n",
-            rtcTime.day, rtcTime.month, rtcTime.year, rtcTime.hour, rtcTime.min,
-            rtcTime.sec);
-  }
+  // Receive (byte 32) and Transmit (byte 40) timestamps of the server. The
+  // time the server spent between them is not part of the round trip
+  uint64_t receive_us = ntp_timestamp_to_us(ntp_get_timestamp(p, 32));
+  uint64_t transmit_us = ntp_timestamp_to_us(ntp_get_timestamp(p, 40));
+  int64_t rtt_us = (int64_t)(recv_us - server->sent_us) -
+                   (int64_t)(transmit_us - receive_us);
+  server->rtt_us = (rtt_us > 0) ? rtt_us : 0;
+  server->transmit_us = transmit_us;
+  server->recv_us = recv_us;
+  server->stratum = stratum;
+  server->answered = true;
+  boottime_end(BOOT_PHASE_NTP);
+  DPRINTF("NTP answer from %s. RTT: %lld us\n", server->host, server->rtt_us);
 
   // Free the packet buffer
   pbuf_free(p);
 }
 
 static void ntp_init() {
+  // The control block is shared by all the servers and all the queries
+  if (netTime.ntp_pcb != NULL) {
+    return;
+  }
+
   // Attempt to allocate a new UDP control block.
+  cyw43_arch_lwip_begin();
   netTime.ntp_pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
   if (netTime.ntp_pcb == NULL) {
+    cyw43_arch_lwip_end();
     DPRINTF("Failed to allocate a new UDP control block.\n");
     return;
   }
@@ -147,14 +221,115 @@ static void ntp_init() {
   // Set up the callback function that will be called when an NTP response is
   // received.
   udp_recv(netTime.ntp_pcb, ntpRecvCB, &netTime);
-
-  // Initialization success, set flag.
-  netTime.ntp_server_found = false;
-  netTime.ntp_error = false;
+  cyw43_arch_lwip_end();
   DPRINTF("NTP UDP control block initialized and callback set.\n");
 }
 
-static void set_internal_rtc() {
+// Add a server to the list of servers to query, ignoring duplicates
+static void add_ntp_server(const char *host) {
+  if (host == NULL || host[0] == '\0' ||
+      netTime.server_count >= RTCEMUL_NTP_MAX_SERVERS) {
+    return;
+  }
+  for (int i = 0; i < netTime.server_count; i++) {
+    if (!netTime.servers[i].cached &&
+        strcmp(netTime.servers[i].host, host) == 0) {
+      return;
+    }
+  }
+  NTP_SERVER *server = &netTime.servers[netTime.server_count++];
+  memset(server, 0, sizeof(NTP_SERVER));
+  snprintf(server->host, sizeof(server->host), "%s", host);
+  // An address instead of a name is a server of the network, like a time
+  // master
+  ip_addr_t ipaddr;
+  server->local = ipaddr_aton(host, &ipaddr);
+  DPRINTF("NTP server %d: %s\n", netTime.server_count, server->host);
+}
+
+// Called by lwIP with the NTP servers of the DHCP option 42
+void dhcp_set_ntp_servers(u8_t num_ntp_servers,
+                          const ip4_addr_t *ntp_server_addrs) {
+  dhcpNtpValid = (num_ntp_servers > 0) && !ip4_addr_isany(ntp_server_addrs);
+  if (dhcpNtpValid) {
+    ip_addr_copy_from_ip4(dhcpNtpServer, *ntp_server_addrs);
+  }
+}
+
+// The server of the DHCP option goes first, unless it is this device
+static void add_dhcp_ntp_server() {
+  if (!dhcpNtpValid || netTime.server_count >= RTCEMUL_NTP_MAX_SERVERS) {
+    return;
+  }
+  ip_addr_t currentIp = network_getCurrentIp();
+  if (ip_addr_cmp(&currentIp, &dhcpNtpServer)) {
+    return;
+  }
+  NTP_SERVER *server = &netTime.servers[netTime.server_count++];
+  memset(server, 0, sizeof(NTP_SERVER));
+  // The DNS resolves the address without a query
+  ipaddr_ntoa_r(&dhcpNtpServer, server->host, sizeof(server->host));
+  server->local = true;
+  DPRINTF("NTP server of the DHCP: %s\n", server->host);
+}
+
+// Read the cached address of the NTP server from the settings. It is queried
+// directly while the DNS resolves the host again in the background
+static void load_ntp_cache() {
+  ntpCacheValid = false;
+  SettingsConfigEntry *cacheIp = aconfig_getEntry(ACONFIG_KEY_RTC_NTP_CACHE_IP);
+  if (cacheIp == NULL || cacheIp->value == NULL || cacheIp->value[0] == '\0' ||
+      !ipaddr_aton(cacheIp->value, &ntpCacheIp)) {
+    DPRINTF("No cached NTP server address\n");
+    return;
+  }
+  ntpCacheTtl =
+      aconfig_getInt(ACONFIG_KEY_RTC_NTP_CACHE_TTL, RTCEMUL_NTP_CACHE_TTL_S);
+  ntpCacheTime = aconfig_getInt(ACONFIG_KEY_RTC_NTP_CACHE_TIME, 0);
+  ntpCacheValid = true;
+  DPRINTF("Cached NTP server address: %s\n", ipaddr_ntoa(&ntpCacheIp));
+
+  // The cached server goes first
+  NTP_SERVER *server = &netTime.servers[netTime.server_count++];
+  memset(server, 0, sizeof(NTP_SERVER));
+  snprintf(server->host, sizeof(server->host), "%s", ntpServerHost);
+  server->ipaddr = ntpCacheIp;
+  server->cached = true;
+}
+
+// Replace the cached address with the one just resolved for the configured
+// host, only when there is no cache, the cached server did not answer or the
+// cache expired. The pool returns a different address on every query, so
+// refreshing it always would wear out the flash
+static void update_ntp_cache(time_t now) {
+  NTP_SERVER *cached = NULL;
+  NTP_SERVER *resolved = NULL;
+  for (int i = 0; i < netTime.server_count; i++) {
+    NTP_SERVER *server = &netTime.servers[i];
+    if (server->cached) {
+      cached = server;
+    } else if (server->resolved && (resolved == NULL) &&
+               (strcmp(server->host, ntpServerHost) == 0)) {
+      resolved = server;
+    }
+  }
+  if (resolved == NULL) {
+    return;
+  }
+  bool expired =
+      !ntpCacheValid || ((int64_t)ntpCacheTime + ntpCacheTtl < (int64_t)now);
+  if ((cached != NULL) && cached->answered && !expired) {
+    return;
+  }
+  ntpCacheIp = resolved->ipaddr;
+  ntpCacheTtl = RTCEMUL_NTP_CACHE_TTL_S;
+  ntpCacheTime = (int)now;
+  ntpCacheValid = true;
+  ntpCacheDirty = true;
+  DPRINTF("New cached NTP server address: %s\n", ipaddr_ntoa(&ntpCacheIp));
+}
+
+static void send_ntp_request(NTP_SERVER *server) {
   // Begin LwIP operation
   cyw43_arch_lwip_begin();
 
@@ -162,24 +337,34 @@ static void set_internal_rtc() {
   struct pbuf *pb = pbuf_alloc(PBUF_TRANSPORT, NTP_MSG_LEN, PBUF_RAM);
   if (!pb) {
     DPRINTF("Failed to allocate pbuf for NTP request.\n");
+    server->error = true;
     cyw43_arch_lwip_end();
     return;  // Early exit if pbuf allocation fails
   }
 
-  // Prepare the NTP request.
+  // Prepare the NTP request. The transmit timestamp is unique per request,
+  // and the server returns it as the originate timestamp
   uint8_t *req = (uint8_t *)pb->payload;
   memset(req, 0, NTP_MSG_LEN);
   req[0] = 0x1b;  // NTP request header for a client request
+  server->sent_us = time_us_64();
+  boottime_begin(BOOT_PHASE_NTP);
+  server->originate =
+      ((uint64_t)(server - netTime.servers) << 56) ^ server->sent_us;
+  uint32_t originate[2] = {lwip_htonl((uint32_t)(server->originate >> 32)),
+                           lwip_htonl((uint32_t)server->originate)};
+  memcpy(&req[40], originate, sizeof(originate));
 
   // Send the NTP request.
-  err_t err =
-      udp_sendto(netTime.ntp_pcb, pb, &netTime.ntp_ipaddr, ntpServerPort);
+  err_t err = udp_sendto(netTime.ntp_pcb, pb, &server->ipaddr, ntpServerPort);
   if (err != ERR_OK) {
     DPRINTF("Failed to send NTP request: %s\n", lwip_strerr(err));
+    server->error = true;
     pbuf_free(pb);  // Clean up the pbuf
     cyw43_arch_lwip_end();
     return;  // Early exit if sending fails
   }
+  server->sent = true;
 
   // Free the pbuf after sending.
   pbuf_free(pb);
@@ -187,7 +372,304 @@ static void set_internal_rtc() {
   // End LwIP operation.
   cyw43_arch_lwip_end();
 
-  DPRINTF("NTP request sent successfully.\n");
+  DPRINTF("NTP request sent to %s.\n", server->host);
+}
+
+// Local time of the software clock, in microseconds since 1970
+static int64_t clock_model_us(uint64_t mono_us) {
+  int64_t elapsed = (int64_t)(mono_us - anchorMonoUs);
+  int64_t slewMax = elapsed * RTCEMUL_NTP_SLEW_MAX_PPM / 1000000LL;
+  int64_t slew = slewOffsetUs;
+  if (slew > slewMax) {
+    slew = slewMax;
+  } else if (slew < -slewMax) {
+    slew = -slewMax;
+  }
+  return anchorUnixUs + elapsed +
+         elapsed * (int64_t)warmState.drift_ppb / 1000000000LL + slew;
+}
+
+static void schedule_ntp_resync() {
+  ntpNextSync = make_timeout_time_ms(ntpResyncIntervalS * 1000);
+  DPRINTF("Next NTP resync in %u seconds\n", ntpResyncIntervalS);
+}
+
+// Seconds since the last sync with a time server
+static uint32_t sync_age() {
+  return clockAnchored
+             ? (uint32_t)((time_us_64() - lastSyncMonoUs) / 1000000ULL)
+             : RTCEMUL_SYNC_AGE_NEVER;
+}
+
+// Keep the sync in the history for the telemetry, the oldest is replaced
+static void record_sync(uint64_t mono_us, int64_t offset) {
+  NTP_SYNC_RECORD *record = &syncHistory[syncCount++ % RTCEMUL_SYNC_HISTORY];
+  record->bootSecs = (uint32_t)(mono_us / 1000000ULL);
+  record->rttUs = lastSyncRttUs;
+  if (offset > INT32_MAX) {
+    offset = INT32_MAX;
+  } else if (offset < INT32_MIN) {
+    offset = INT32_MIN;
+  }
+  record->offsetUs = (int32_t)offset;
+  record->driftPpb = warmState.drift_ppb;
+}
+
+// Compare the NTP time with the software clock: step if too far, otherwise
+// estimate the drift and slew the offset. The interval doubles while stable
+static void discipline_clock(uint64_t mono_us, int64_t unix_us) {
+  int64_t offset = unix_us - clock_model_us(mono_us);
+  int64_t sinceSync = (int64_t)(mono_us - lastSyncMonoUs);
+  DPRINTF("NTP offset: %lld us\n", offset);
+
+  // The refresh timer reads the software clock too
+  uint32_t ints = save_and_disable_interrupts();
+  if (anchorCoarse || (offset > RTCEMUL_NTP_STEP_US) ||
+      (offset < -RTCEMUL_NTP_STEP_US)) {
+    anchorUnixUs = unix_us;
+    anchorCoarse = false;
+    slewOffsetUs = 0;
+    ntpResyncIntervalS = RTCEMUL_NTP_RESYNC_MIN_S;
+  } else {
+    // The residual offset is the error of the drift estimation. Damped
+    if (sinceSync > 0) {
+      int64_t drift = (int64_t)warmState.drift_ppb +
+                      offset * 1000000000LL / sinceSync / 2;
+      if ((drift < RTCEMUL_NTP_MAX_DRIFT_PPB) &&
+          (drift > -RTCEMUL_NTP_MAX_DRIFT_PPB)) {
+        warmState.drift_ppb = (int32_t)drift;
+      }
+    }
+    anchorUnixUs = clock_model_us(mono_us);
+    slewOffsetUs = offset;
+    if ((offset < RTCEMUL_NTP_STABLE_US) && (offset > -RTCEMUL_NTP_STABLE_US)) {
+      if (ntpResyncIntervalS < RTCEMUL_NTP_RESYNC_MAX_S) {
+        ntpResyncIntervalS *= 2;
+      }
+    } else if (ntpResyncIntervalS > RTCEMUL_NTP_RESYNC_MIN_S) {
+      ntpResyncIntervalS /= 2;
+    }
+  }
+  anchorMonoUs = mono_us;
+  lastSyncMonoUs = mono_us;
+  restore_interrupts(ints);
+  record_sync(mono_us, offset);
+  DPRINTF("Drift: %d ppb\n", warmState.drift_ppb);
+}
+
+// Move the software clock to the new offset when the daylight saving time
+// starts or ends. Until then, a single compare with the next transition
+static void follow_time_zone() {
+  if (!tzRulesActive || !clockAnchored) {
+    return;
+  }
+  // Same lock as local_offset(), so the offset and the anchor move together
+  uint32_t ints = save_and_disable_interrupts();
+  int64_t utc_us = clock_model_us(time_us_64()) -
+                   (int64_t)utcOffsetSeconds * 1000000LL;
+  if (utc_us >= (int64_t)tzRules.nextAt * 1000000LL) {
+    long previous = utcOffsetSeconds;
+    anchorUnixUs += (int64_t)(local_offset(utc_us) - previous) * 1000000LL;
+  }
+  restore_interrupts(ints);
+}
+
+// Seconds since 1970 of a date and time of the RTC
+static uint32_t datetime_to_secs(const datetime_t *dt) {
+  // Days from the civil date, with the year starting in March
+  int year = dt->year - (dt->month <= 2);
+  int era = (year >= 0 ? year : year - 399) / 400;
+  int yoe = year - era * 400;
+  int mp = dt->month + (dt->month > 2 ? -3 : 9);
+  int doy = (153 * mp + 2) / 5 + dt->day - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  int32_t days = era * 146097 + doe - 719468;
+  return (uint32_t)days * 86400 + dt->hour * 3600 + dt->min * 60 + dt->sec;
+}
+
+// Keep the RTC on the second of the software clock
+static void follow_clock_model() {
+  if (!clockAnchored) {
+    return;
+  }
+  time_t secs = (time_t)(clock_model_us(time_us_64()) / 1000000LL);
+  datetime_t now = {0};
+  rtc_get_datetime(&now);
+  if ((uint32_t)secs == datetime_to_secs(&now)) {
+    return;
+  }
+  struct tm utc;
+  if (gmtime_r(&secs, &utc) == NULL) {
+    return;
+  }
+  datetime_t model = {.year = utc.tm_year + 1900,
+                      .month = utc.tm_mon + 1,
+                      .day = utc.tm_mday,
+                      .dotw = utc.tm_wday,
+                      .hour = utc.tm_hour,
+                      .min = utc.tm_min,
+                      .sec = utc.tm_sec};
+  rtc_set_datetime(&model);
+}
+
+// Set the RTC exactly at the second boundary computed from the NTP answer
+static int64_t ntpAlignCB(alarm_id_t id, void *user_data) {
+  if (rtc_set_datetime(&rtcTime)) {
+    netTime.ntp_synced = true;
+    clockAnchored = true;
+  }
+  return 0;  // Do not reschedule
+}
+
+// Pick the answer with the lowest round trip and schedule the RTC update
+static void set_clock(uint64_t now_us, int64_t unix_us, bool coarse);
+
+static void select_ntp_answer() {
+  NTP_SERVER *best = NULL;
+  for (int i = 0; i < netTime.server_count; i++) {
+    NTP_SERVER *server = &netTime.servers[i];
+    if (server->answered && (best == NULL || server->rtt_us < best->rtt_us)) {
+      best = server;
+    }
+  }
+  netTime.ntp_ipaddr = best->ipaddr;
+  DPRINTF("Selected NTP server %s. RTT: %lld us\n", best->host, best->rtt_us);
+  snprintf(lastSyncHost, sizeof(lastSyncHost), "%s", best->host);
+  lastSyncRttUs = (uint32_t)best->rtt_us;
+  lastSyncStratum = best->stratum;
+
+  // The server sent its time half a round trip before we received it
+  uint64_t now_us = time_us_64();
+  int64_t utc_us = (int64_t)(best->transmit_us -
+                             (uint64_t)NTP_DELTA * 1000000ULL) +
+                   best->rtt_us / 2 + (int64_t)(now_us - best->recv_us);
+  int64_t unix_us = utc_us + (int64_t)local_offset(utc_us) * 1000000LL;
+  update_ntp_cache((time_t)(unix_us / 1000000LL));
+  set_clock(now_us, unix_us, false);
+}
+
+// Set the clock from a time source. The first time the RTC is set at the next
+// second boundary, later the software clock is disciplined. A coarse time is
+// replaced by the next precise one instead of slewed
+static void set_clock(uint64_t now_us, int64_t unix_us, bool coarse) {
+  if (clockAnchored) {
+    // Resync: never step the RTC at once
+    discipline_clock(now_us, unix_us);
+    ntpState = RTC_NTP_SYNCED;
+    schedule_ntp_resync();
+    return;
+  }
+  uint64_t wait_us = 1000000ULL - (uint64_t)(unix_us % 1000000LL);
+  time_t next_sec = (time_t)(unix_us / 1000000LL) + 1;
+
+  // Convert NTP time to a `struct tm`
+  struct tm *utc = gmtime(&next_sec);
+  if (utc == NULL) {
+    DPRINTF("Error converting NTP time to struct tm\n");
+    ntpState = RTC_NTP_FAILED;
+    return;
+  }
+
+  // Fill the rtcTime structure
+  rtcTime.year = utc->tm_year + 1900;
+  rtcTime.month = utc->tm_mon + 1;
+  rtcTime.day = utc->tm_mday;
+  rtcTime.hour = utc->tm_hour;
+  rtcTime.min = utc->tm_min;
+  rtcTime.sec = utc->tm_sec;
+  rtcTime.dotw = utc->tm_wday;  // Day of the week, Sunday is day 0
+
+  // The software clock starts at the same second boundary
+  anchorMonoUs = now_us + wait_us;
+  anchorUnixUs = (int64_t)next_sec * 1000000LL;
+  anchorCoarse = coarse;
+  slewOffsetUs = 0;
+  lastSyncMonoUs = anchorMonoUs;
+  record_sync(now_us, 0);
+
+  ntpState = RTC_NTP_ALIGNING;
+  if (add_alarm_at(delayed_by_us(from_us_since_boot(now_us), wait_us),
+                   ntpAlignCB, NULL, true) < 0) {
+    // No alarm slots. Set the RTC now, a fraction of a second early
+    ntpAlignCB(0, NULL);
+  }
+}
+
+// Parse the Date header, like "Date: Tue, 14 Oct 2025 10:00:00 GMT". HTTP/2
+// proxies send it in lower case
+static bool parse_http_date(struct pbuf *hdr, u16_t hdr_len,
+                            time_t *date_secs) {
+  u16_t offset = pbuf_memfind(hdr, "\r\nDate:", 7, 0);
+  if (offset >= hdr_len) {
+    offset = pbuf_memfind(hdr, "\r\ndate:", 7, 0);
+  }
+  if (offset >= hdr_len) {
+    return false;
+  }
+  char line[RTCEMUL_HTTP_DATE_MAX_LENGTH + 1] = {0};
+  pbuf_copy_partial(hdr, line, RTCEMUL_HTTP_DATE_MAX_LENGTH, offset + 2);
+
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char month[4] = {0};
+  struct tm utc = {0};
+  if (sscanf(line + 5, " %*3s, %d %3s %d %d:%d:%d", &utc.tm_mday, month,
+             &utc.tm_year, &utc.tm_hour, &utc.tm_min, &utc.tm_sec) != 6) {
+    return false;
+  }
+  const char *found = strstr(months, month);
+  if (found == NULL || ((found - months) % 3) != 0) {
+    return false;
+  }
+  datetime_t dt = {.year = utc.tm_year,
+                   .month = (int8_t)((found - months) / 3 + 1),
+                   .day = utc.tm_mday,
+                   .hour = utc.tm_hour,
+                   .min = utc.tm_min,
+                   .sec = utc.tm_sec};
+  *date_secs = (time_t)datetime_to_secs(&dt);
+  return true;
+}
+
+// Headers of the HTTP time source. The body is not needed, so abort
+static err_t httpTimeHeadersCB(httpc_state_t *connection, void *arg,
+                               struct pbuf *hdr, u16_t hdr_len,
+                               u32_t content_len) {
+  uint64_t recv_us = time_us_64();
+  time_t date_secs = 0;
+  if (parse_http_date(hdr, hdr_len, &date_secs)) {
+    // The Date header truncates to the second. Assume the middle of it
+    int64_t utc_us = (int64_t)date_secs * 1000000LL + 500000LL;
+    httpTimeUnixUs = utc_us + (int64_t)local_offset(utc_us) * 1000000LL;
+    httpTimeMonoUs = recv_us;
+    httpTimeValid = true;
+    DPRINTF("HTTP Date header from %s\n", httpTimeHost);
+  } else {
+    DPRINTF("No valid Date header from %s\n", httpTimeHost);
+  }
+  return ERR_ABRT;
+}
+
+static void httpTimeResultCB(void *arg, httpc_result_t httpc_result,
+                             u32_t rx_content_len, u32_t srv_res, err_t err) {
+  httpTimeInFlight = false;
+}
+
+// Ask the HTTP server for the Date header, if configured
+static void query_http_time() {
+  if (httpTimeHost[0] == '\0' || httpTimeInFlight || httpTimeValid) {
+    return;
+  }
+  memset(&httpTimeRequest, 0, sizeof(httpTimeRequest));
+  httpTimeRequest.hostname = httpTimeHost;
+  httpTimeRequest.url = RTCEMUL_HTTP_TIME_URL;
+  httpTimeRequest.headers_fn = httpTimeHeadersCB;
+  httpTimeRequest.result_fn = httpTimeResultCB;
+  httpTimeInFlight = true;
+  if (http_client_request_async(cyw43_arch_async_context(),
+                                &httpTimeRequest) != 0) {
+    DPRINTF("Cannot start the HTTP time request\n");
+    httpTimeInFlight = false;
+  }
 }
 
 // Function to populate the magic_sequence_dallas_rtc
@@ -205,187 +687,553 @@ static void populateMagicSequence(uint8_t *sequence, uint64_t hex_value) {
   }
 }
 
-int rtc_queryNTPTime() {
+static uint32_t warm_checksum(const RTC_WARM_STATE *state) {
+  return (state->magic ^ state->utc_secs ^ state->sync_secs ^
+          state->uptime_secs ^ (uint32_t)state->drift_ppb) +
+         0x9E3779B9;
+}
+
+static bool warm_state_valid() {
+  return (warmState.magic == RTCEMUL_WARM_MAGIC) &&
+         (warmState.checksum == warm_checksum(&warmState));
+}
+
+// Write the current time in the warm state
+static void checkpoint_warm_state() {
+  if (!rtcTrusted) {
+    // Do not keep a made up time across resets
+    return;
+  }
+  datetime_t now = {0};
+  rtc_get_datetime(&now);
+  warmState.utc_secs = datetime_to_secs(&now);
+  warmState.uptime_secs = (uint32_t)(time_us_64() / 1000000ULL);
+  warmState.magic = RTCEMUL_WARM_MAGIC;
+  warmState.checksum = warm_checksum(&warmState);
+}
+
+static bool warmTimerCallback(repeating_timer_t *t) {
+  follow_time_zone();
+  follow_clock_model();
+  checkpoint_warm_state();
+  return true;
+}
+
+void rtc_invalidateWarmStart() {
+  cancel_repeating_timer(&warmTimer);
+  warmState.magic = 0;
+}
+
+// Seconds since 1970 of the release date, "YYYY-MM-DD HH:MM:SS". The time
+// can't be older than the firmware that keeps it. 0 if it can't be parsed
+static time_t release_date_secs() {
+  int year, month, day, hour, min, sec;
+  if ((sscanf(RELEASE_DATE, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour,
+              &min, &sec) != 6) ||
+      (year < RTCEMUL_FALLBACK_YEAR) || (month < 1) || (month > 12) ||
+      (day < 1) || (day > 31)) {
+    return 0;
+  }
+  datetime_t release = {.year = year,
+                        .month = month,
+                        .day = day,
+                        .hour = hour,
+                        .min = min,
+                        .sec = sec};
+  return (time_t)datetime_to_secs(&release);
+}
+
+// Start the internal RTC once. After a reset it runs from the time kept in
+// RAM, otherwise from the last checkpoint in the flash, or the release date
+// on the first boot, until the NTP server answers
+static void start_internal_rtc() {
+  if (rtcStarted) {
+    return;
+  }
+  rtc_init();
+  datetime_t seed = {.year = RTCEMUL_FALLBACK_YEAR,
+                     .month = RTCEMUL_FALLBACK_MONTH,
+                     .day = RTCEMUL_FALLBACK_DAY,
+                     .dotw = RTCEMUL_FALLBACK_DOTW,
+                     .hour = 0,
+                     .min = 0,
+                     .sec = 0};
+
+  rtcCheckpoint = aconfig_getInt(ACONFIG_KEY_RTC_CHECKPOINT, rtcCheckpoint);
+
+  time_t seedSecs = 0;
+  if (warm_state_valid()) {
+    // The time since the reset is the uptime of this boot
+    seedSecs = (time_t)warmState.utc_secs + RTCEMUL_WARM_RESET_LATENCY_S +
+               (time_t)(time_us_64() / 1000000ULL);
+    rtcTrusted = true;
+    DPRINTF("Warm start. Last sync: %u\n", warmState.sync_secs);
+  } else {
+    warmState.sync_secs = 0;
+    warmState.drift_ppb = 0;
+    if (rtcCheckpoint > 0) {
+      seedSecs = (time_t)rtcCheckpoint;
+      DPRINTF("Cold start from the checkpoint\n");
+    } else {
+      seedSecs = release_date_secs();
+      DPRINTF("Cold start from the release date\n");
+    }
+  }
+
+  struct tm utc;
+  if ((seedSecs > 0) && (gmtime_r(&seedSecs, &utc) != NULL)) {
+    seed.year = utc.tm_year + 1900;
+    seed.month = utc.tm_mon + 1;
+    seed.day = utc.tm_mday;
+    seed.dotw = utc.tm_wday;
+    seed.hour = utc.tm_hour;
+    seed.min = utc.tm_min;
+    seed.sec = utc.tm_sec;
+  }
+  if (!rtc_set_datetime(&seed)) {
+    DPRINTF("Cannot set the initial date and time!\n");
+  }
+  rtcStarted = true;
+
+  // Keep the warm state fresh from now on, also in the setup mode
+  checkpoint_warm_state();
+  if (!add_repeating_timer_ms(-RTCEMUL_DATETIME_REFRESH_MS, warmTimerCallback,
+                              NULL, &warmTimer)) {
+    DPRINTF("Cannot start the warm start checkpoint timer\n");
+  }
+}
+
+uint32_t rtc_getLastSync(const char **host, uint32_t *rttUs) {
+  *host = lastSyncHost;
+  *rttUs = lastSyncRttUs;
+  return sync_age();
+}
+
+bool rtc_getNtpTime(uint64_t monoUs, int64_t *utcUs, NTP_REFERENCE *ref) {
+  // The refresh timer moves the anchor when the time zone changes
+  uint32_t ints = save_and_disable_interrupts();
+  bool synced = clockAnchored && !anchorCoarse && (lastSyncStratum != 0);
+  int64_t offsetUs = (int64_t)utcOffsetSeconds * 1000000LL;
+  *utcUs = clock_model_us(monoUs) - offsetUs;
+  ref->refUtcUs = clock_model_us(lastSyncMonoUs) - offsetUs;
+  restore_interrupts(ints);
+  ref->stratum = lastSyncStratum;
+  ref->refId = ip4_addr_get_u32(ip_2_ip4(&netTime.ntp_ipaddr));
+  ref->rttUs = lastSyncRttUs;
+  return synced;
+}
+
+int rtc_getSyncHistory(NTP_SYNC_RECORD *records, int max) {
+  int count = 0;
+  while ((count < max) && (count < RTCEMUL_SYNC_HISTORY) &&
+         ((uint32_t)count < syncCount)) {
+    records[count] =
+        syncHistory[(syncCount - 1 - count) % RTCEMUL_SYNC_HISTORY];
+    count++;
+  }
+  return count;
+}
+
+bool rtc_getTrustedTime(uint32_t *secs) {
+  start_internal_rtc();
+  datetime_t now = {0};
+  rtc_get_datetime(&now);
+  *secs = datetime_to_secs(&now);
+  return rtcTrusted;
+}
+
+// Send the DNS queries for all the NTP servers. The addresses can be in the
+// DNS cache already
+static void query_ntp_servers() {
+  ntpDeadline = make_timeout_time_ms(RTCEMUL_NTP_TIMEOUT_MS);
+  ntpCollectDeadline = nil_time;
+  ntpState = RTC_NTP_RESOLVING;
+
+  // The servers of the network answer in a few milliseconds and save the
+  // traffic to the internet. The rest only after they failed
+  ntpLocalOnly = false;
+  if (ntpAttempts == 0) {
+    for (int i = 0; i < netTime.server_count; i++) {
+      ntpLocalOnly |= netTime.servers[i].local;
+    }
+  }
+
+  DPRINTF("Querying the DNS...\n");
+  for (int i = 0; i < netTime.server_count; i++) {
+    NTP_SERVER *server = &netTime.servers[i];
+    server->resolved = false;
+    server->sent = false;
+    server->answered = false;
+    server->error = false;
+    if (server->cached) {
+      // No need to wait for the DNS
+      server->resolved = true;
+      continue;
+    }
+    boottime_begin(BOOT_PHASE_DNS);
+    cyw43_arch_lwip_begin();
+    err_t dns_ret = dns_gethostbyname(server->host, &server->ipaddr,
+                                      hostFoundCB, server);
+    cyw43_arch_lwip_end();
+    if (dns_ret == ERR_OK) {
+      // Already in the DNS cache, the callback is not called
+      server->resolved = true;
+      boottime_end(BOOT_PHASE_DNS);
+    } else if (dns_ret != ERR_INPROGRESS) {
+      DPRINTF("DNS query for %s failed: %d\n", server->host, dns_ret);
+      server->error = true;
+    }
+  }
+}
+
+// Try again from the DNS queries, or give up after the last attempt
+static void retry_ntp_query() {
+  if (++ntpAttempts >= RTCEMUL_NTP_MAX_ATTEMPTS) {
+    DPRINTF("No answer from the NTP servers after %d attempts\n", ntpAttempts);
+    ntpState = RTC_NTP_FAILED;
+    ntpResyncIntervalS = RTCEMUL_NTP_RESYNC_MIN_S;
+    schedule_ntp_resync();
+    return;
+  }
+  DPRINTF("Retrying the NTP query. Attempt %d\n", ntpAttempts + 1);
+  query_ntp_servers();
+  if (!clockAnchored) {
+    query_http_time();
+  }
+}
+
+int rtc_startNTPQuery() {
   // We have network connection. Otherwise, we would not be here.
   // Start the internal RTC
-  rtc_init();
+  start_internal_rtc();
 
-  SettingsConfigEntry *ntpHost = settings_find_entry(
-      aconfig_getContext(), ACONFIG_PARAM_RTC_NTP_SERVER_HOST);
+  SettingsConfigEntry *ntpHost =
+      aconfig_getEntry(ACONFIG_KEY_RTC_NTP_SERVER_HOST);
   if (ntpHost != NULL && ntpHost->value != NULL && ntpHost->value[0] != '\0') {
     snprintf(ntpServerHost, SETTINGS_MAX_VALUE_LENGTH, "%s", ntpHost->value);
   } else {
     snprintf(ntpServerHost, SETTINGS_MAX_VALUE_LENGTH, "%s", NTP_DEFAULT_HOST);
   }
-  SettingsConfigEntry *ntpPort = settings_find_entry(
-      aconfig_getContext(), ACONFIG_PARAM_RTC_NTP_SERVER_PORT);
-  if (ntpPort != NULL && ntpPort->value != NULL && ntpPort->value[0] != '\0') {
-    int port = atoi(ntpPort->value);
-    if (port > 0 && port <= 65535) {
-      ntpServerPort = port;
-    } else {
-      ntpServerPort = NTP_DEFAULT_PORT;
-    }
+  int port = aconfig_getInt(ACONFIG_KEY_RTC_NTP_SERVER_PORT, 0);
+  if (port > 0 && port <= 65535) {
+    ntpServerPort = port;
   } else {
     ntpServerPort = NTP_DEFAULT_PORT;
   }
   DPRINTF("NTP server host: %s\n", ntpServerHost);
   DPRINTF("NTP server port: %d\n", ntpServerPort);
 
-  SettingsConfigEntry *utcOffset =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_RTC_UTC_OFFSET);
-  if (utcOffset != NULL && utcOffset->value != NULL &&
-      utcOffset->value[0] != '\0') {
-    char *endptr = NULL;
-    double offsetHours = strtod(utcOffset->value, &endptr);
-
-    // Check if the entire string was parsed and it's within valid range
-    if (endptr != utcOffset->value && *endptr == '\0' && offsetHours >= -12.0 &&
-        offsetHours <= 14.0) {
-      long offsetSeconds = (long)(offsetHours * 3600);
-      setUtcOffsetSeconds(offsetSeconds);
-    } else {
-      // Optionally: fall back to default or log invalid input
-      // setUtcOffsetSeconds(DEFAULT_OFFSET);
-    }
+  // NAN if the entire string is not a number
+  double offsetHours = aconfig_getDouble(ACONFIG_KEY_RTC_UTC_OFFSET, NAN);
+  const char *timeZone = aconfig_getString(ACONFIG_KEY_RTC_UTC_OFFSET, "");
+  TzRules rules;
+  // Check if it's within valid range, otherwise it can be a POSIX TZ string
+  if (offsetHours >= -12.0 && offsetHours <= 14.0) {
+    long offsetSeconds = (long)(offsetHours * 3600);
+    uint32_t ints = save_and_disable_interrupts();
+    tzRulesActive = false;
+    setUtcOffsetSeconds(offsetSeconds);
+    restore_interrupts(ints);
+  } else if (tzrules_parse(timeZone, &rules) == 0) {
+    DPRINTF("Time zone: %s\n", timeZone);
+    // The refresh timer follows the time zone, from its next tick
+    uint32_t ints = save_and_disable_interrupts();
+    tzRules = rules;
+    tzRules.nextAt = 0;
+    tzRulesActive = true;
+    restore_interrupts(ints);
+  } else {
+    // Optionally: fall back to default or log invalid input
+    // setUtcOffsetSeconds(DEFAULT_OFFSET);
   }
 
   DPRINTF("UTC offset: %ld\n", getUtcOffsetSeconds());
 
+  // The configured server first, then the fallbacks. lwIP only returns one
+  // address per name, so the pool is queried through its numbered names
+  netTime.server_count = 0;
+  add_dhcp_ntp_server();
+  load_ntp_cache();
+  add_ntp_server(ntpServerHost);
+  SettingsConfigEntry *ntpFallbacks =
+      aconfig_getEntry(ACONFIG_KEY_RTC_NTP_FALLBACK_HOSTS);
+  if (ntpFallbacks != NULL && ntpFallbacks->value != NULL) {
+    char hosts[SETTINGS_MAX_VALUE_LENGTH];
+    snprintf(hosts, sizeof(hosts), "%s", ntpFallbacks->value);
+    char *savePtr = NULL;
+    for (char *host = strtok_r(hosts, ", ", &savePtr); host != NULL;
+         host = strtok_r(NULL, ", ", &savePtr)) {
+      add_ntp_server(host);
+    }
+  }
+
   // Start the NTP client
   ntp_init();
-  getNetTime()->ntp_server_found = false;
-
-  bool dns_query_done = false;
-  absolute_time_t rtcTimeoutSec =
-      make_timeout_time_ms(5 * 1000);  // 3 seconds minimum for network scanning
-  uint32_t rtcPoll_ms = 200;           // 200ms
-
-  while ((absolute_time_diff_us(get_absolute_time(), rtcTimeoutSec) > 0) &&
-         (getRtcTime()->year == 0)) {
-#if PICO_CYW43_ARCH_POLL
-    network_safePoll();
-#else
-    sleep_ms(rtcPoll_ms);
-#endif
+  if (getNetTime()->ntp_pcb == NULL) {
+    ntpState = RTC_NTP_FAILED;
+    return -1;
+  }
+  getNetTime()->ntp_synced = false;
+  ntpAttempts = 0;
+  query_ntp_servers();
+
+  // Race the HTTP Date header against NTP. Not needed with a server of the
+  // network: it is tried if the first attempt fails
+  SettingsConfigEntry *httpHost =
+      aconfig_getEntry(ACONFIG_KEY_RTC_HTTP_TIME_HOST);
+  if (httpHost != NULL && httpHost->value != NULL) {
+    snprintf(httpTimeHost, sizeof(httpTimeHost), "%s", httpHost->value);
+  }
+  if (!ntpLocalOnly) {
+    query_http_time();
+  }
+  return 0;
+}
 
-    if ((getNetTime()->ntp_server_found) && dns_query_done) {
-      DPRINTF("NTP server found. Connecting to NTP server...\n");
-      getNetTime()->ntp_server_found = false;
-      set_internal_rtc();
-    }
-    // Get the IP address from the DNS server if the wifi is connected and
-    // no IP address is found yet
-    if (!(dns_query_done)) {
-      // Let's connect to ntp server
-      DPRINTF("Querying the DNS...\n");
-      err_t dns_ret = dns_gethostbyname(
-          ntpServerHost, &getNetTime()->ntp_ipaddr, hostFoundCB, getNetTime());
-#if PICO_CYW43_ARCH_POLL
-      network_safePoll();
-#endif
-      if (dns_ret == ERR_ARG) {
-        DPRINTF("Invalid DNS argument\n");
-      }
-      DPRINTF("DNS query done\n");
-      dns_query_done = true;
-    }
-    if (getNetTime()->ntp_error) {
-      DPRINTF("Error getting the NTP server IP address\n");
-      dns_query_done = false;
-      getNetTime()->ntp_error = false;
-      getNetTime()->ntp_server_found = false;
+int rtc_saveState() {
+  // Checkpoint the clock for the cold boots, but not too often
+  bool checkpointDue = false;
+  if (rtcTrusted) {
+    datetime_t now = {0};
+    rtc_get_datetime(&now);
+    uint32_t nowSecs = datetime_to_secs(&now);
+    if ((int64_t)nowSecs - rtcCheckpoint >= RTCEMUL_CHECKPOINT_INTERVAL_S) {
+      rtcCheckpoint = (int)nowSecs;
+      settings_put_integer(aconfig_getContext(), ACONFIG_PARAM_RTC_CHECKPOINT,
+                           rtcCheckpoint);
+      checkpointDue = true;
     }
   }
-  if (getRtcTime()->year != 0) {
-    DPRINTF("RTC set by NTP server\n");
-    rtc_get_datetime(&rtcTime);
-
-    DPRINTF("RP2040 RTC set to: %02d/%02d/%04d %02d:%02d:%02d UTC+0\n",
-            rtcTime.day, rtcTime.month, rtcTime.year, rtcTime.hour, rtcTime.min,
-            rtcTime.sec);
-    return 0;  // Success
+  if (!ntpCacheDirty && !checkpointDue) {
+    return 0;
+  }
+  char ip[IPADDR_STRLEN_MAX];
+  ipaddr_ntoa_r(&ntpCacheIp, ip, sizeof(ip));
+  if (ntpCacheValid) {
+    settings_put_string(aconfig_getContext(), ACONFIG_PARAM_RTC_NTP_CACHE_IP,
+                        ip);
+  }
+  settings_put_integer(aconfig_getContext(), ACONFIG_PARAM_RTC_NTP_CACHE_TTL,
+                       ntpCacheTtl);
+  settings_put_integer(aconfig_getContext(), ACONFIG_PARAM_RTC_NTP_CACHE_TIME,
+                       ntpCacheTime);
+  // Written with the other pending changes by aconfig_flush()
+  aconfig_requestSave();
+  ntpCacheDirty = false;
+  DPRINTF("RTC state stored. NTP server: %s\n", ip);
+  return 0;
+}
 
-  } else {
-    DPRINTF("Timeout waiting for NTP server\n");
+RTC_NTP_STATE rtc_pollNTPQuery() {
+  switch (ntpState) {
+    case RTC_NTP_RESOLVING:
+    case RTC_NTP_REQUESTING: {
+      int pending = 0;
+      int answered = 0;
+      for (int i = 0; i < netTime.server_count; i++) {
+        NTP_SERVER *server = &netTime.servers[i];
+        if (ntpLocalOnly && !server->local) {
+          continue;
+        }
+        // Send the request as soon as each server is resolved
+        if (server->resolved && !server->sent && !server->error) {
+          send_ntp_request(server);
+          if (server->sent) {
+            ntpState = RTC_NTP_REQUESTING;
+          }
+        }
+        if (server->answered) {
+          answered++;
+        } else if (!server->error) {
+          pending++;
+        }
+      }
+      if ((answered == 0) && !clockAnchored && httpTimeValid) {
+        // The HTTP Date header was first. NTP refines it in the next resync
+        DPRINTF("Clock set from the HTTP Date header\n");
+        snprintf(lastSyncHost, sizeof(lastSyncHost), "%s", httpTimeHost);
+        lastSyncRttUs = 0;
+        uint64_t now_us = time_us_64();
+        set_clock(now_us,
+                  httpTimeUnixUs + (int64_t)(now_us - httpTimeMonoUs), true);
+      } else if (answered > 0) {
+        // Give the other servers a short time to answer with a lower RTT
+        if (is_nil_time(ntpCollectDeadline)) {
+          ntpCollectDeadline = make_timeout_time_ms(RTCEMUL_NTP_COLLECT_MS);
+        }
+        if ((pending == 0) || time_reached(ntpCollectDeadline)) {
+          select_ntp_answer();
+        }
+      } else if ((pending == 0) || time_reached(ntpDeadline)) {
+        DPRINTF("Timeout waiting for NTP servers\n");
+        retry_ntp_query();
+      }
+      break;
+    }
+    case RTC_NTP_ALIGNING:
+      if (getNetTime()->ntp_synced) {
+        DPRINTF("RTC set by NTP server\n");
+        DPRINTF("RP2040 RTC set to: %02d/%02d/%04d %02d:%02d:%02d\n",
+                rtcTime.day, rtcTime.month, rtcTime.year, rtcTime.hour,
+                rtcTime.min, rtcTime.sec);
+        ntpState = RTC_NTP_SYNCED;
+        rtcTrusted = true;
+        warmState.sync_secs = datetime_to_secs(&rtcTime);
+        checkpoint_warm_state();
+        // The refresh timer publishes the new time in the next tick
+        if (memorySharedAddress != 0) {
+          WRITE_LONGWORD_RAW(memorySharedAddress, RTCEMUL_NTP_SUCCESS,
+                             0xFFFFFFFF);  // 0xFFFFFFFF: NTP success
+        }
+        schedule_ntp_resync();
+      }
+      break;
+    case RTC_NTP_SYNCED:
+    case RTC_NTP_FAILED:
+      // Low priority resync in the background
+      if ((netTime.ntp_pcb != NULL) && !ntpSuspended &&
+          !is_nil_time(ntpNextSync) && time_reached(ntpNextSync)) {
+        DPRINTF("NTP resync\n");
+        ntpAttempts = 0;
+        query_ntp_servers();
+      }
+      break;
+    default:
+      break;
   }
-  return -1;  // Failure
+  return ntpState;
 }
 
-// Function to convert a binary number to BCD format
-static uint8_t to_bcd(uint8_t val) { return ((val / 10) << 4) | (val % 10); }
+bool rtc_isNTPIdle() {
+  return ((ntpState == RTC_NTP_SYNCED) || (ntpState == RTC_NTP_FAILED)) &&
+         !httpTimeInFlight;
+}
 
-// Function to add two BCD values
-static uint8_t add_bcd(uint8_t bcd1, uint8_t bcd2) {
-  uint8_t low_nibble = (bcd1 & 0x0F) + (bcd2 & 0x0F);
-  uint8_t high_nibble = (bcd1 & 0xF0) + (bcd2 & 0xF0);
+void rtc_suspendNTP(bool suspend) { ntpSuspended = suspend; }
 
-  if (low_nibble > 9) {
-    low_nibble += 6;
+int rtc_requestNTPSync() {
+  if ((netTime.ntp_pcb == NULL) || ntpSuspended || !rtc_isNTPIdle()) {
+    return -1;
   }
+  // The next rtc_pollNTPQuery() starts the resync
+  ntpNextSync = get_absolute_time();
+  return 0;
+}
 
-  high_nibble += (low_nibble & 0xF0);  // Add carry to high nibble
-  low_nibble &= 0x0F;                  // Keep only the low nibble
-
-  if ((high_nibble & 0x1F0) > 0x90) {
-    high_nibble += 0x60;
+int64_t rtc_getNextSyncUs() {
+  if (is_nil_time(ntpNextSync)) {
+    return INT64_MAX;
   }
+  return absolute_time_diff_us(get_absolute_time(), ntpNextSync);
+}
 
-  return (high_nibble & 0xF0) | (low_nibble & 0x0F);
+// Update the date and time in the shared memory with the clock
+static void set_ikb_datetime_msg(uint32_t mem_shared_addr, bool y2k_patch) {
+  datetime_t now = {0};
+  rtc_get_datetime(&now);
+  rtcmsg_setDatetime(mem_shared_addr, &now, y2k_patch, warmState.drift_ppb,
+                     sync_age());
 }
-static void set_ikb_datetime_msg(uint32_t mem_shared_addr,
-                                 uint16_t rtcemul_datetime_bcd_idx,
-                                 uint16_t rtcemul_y2k_patch_idx,
-                                 uint16_t rtcemul_datetime_msdos_idx,
-                                 uint16_t gemdos_version, bool y2k_patch) {
-  uint8_t *rtc_time_ptr =
-      (uint8_t *)(mem_shared_addr + rtcemul_datetime_bcd_idx);
-  DPRINTF("GEMDOS version: %x\n", gemdos_version);
-  rtc_get_datetime(&rtcTime);
 
-  DPRINTF("RP2040 RTC set to: %02d/%02d/%04d %02d:%02d:%02d UTC+0\n",
-          rtcTime.day, rtcTime.month, rtcTime.year, rtcTime.hour, rtcTime.min,
-          rtcTime.sec);
+// Precompute the 64 bits of the DS1216 clock registers in the idle buffer and
+// make it the active one. The registers are sent LSB first, starting with the
+// hundredths of second and ending with the year.
+static void set_dallas_clock_sequence(void) {
+  datetime_t now = {0};
+  rtc_get_datetime(&now);
+
+  uint8_t registers[8] = {
+      0x00,                         // Hundredths of second
+      rtcmsg_toBcd(now.sec),        // Seconds
+      rtcmsg_toBcd(now.min),        // Minutes
+      rtcmsg_toBcd(now.hour),       // Hours. Bit 7 cleared: 24 hours mode
+      (uint8_t)(now.dotw + 1),      // Day of the week. OSC and RST bits cleared
+      rtcmsg_toBcd(now.day),        // Date
+      rtcmsg_toBcd(now.month),      // Month
+      rtcmsg_toBcd(now.year % 100)  // Year
+  };
+
+  uint8_t idle = dallasClock.clock_sequence_active ^ 1;
+  uint8_t *sequence = dallasClock.clock_sequence[idle];
+  for (int i = 0; i < dallasClock.size_clock_sequence; i++) {
+    sequence[i] = (registers[i >> 3] >> (i & 7)) & 1;
+  }
+  __dmb();
+  dallasClock.clock_sequence_active = idle;
+}
 
-  // Now set the MSDOS time format after the BCD format
-  uint32_t msdos_datetime = 0;
+// Refresh the date and time in the shared memory every second
+static bool datetimeTimerCallback(repeating_timer_t *t) {
+  set_ikb_datetime_msg(memorySharedAddress, y2kPatchEnabled);
+  if (rtcTypeVar == RTC_DALLAS) {
+    set_dallas_clock_sequence();
+  }
+  return true;
+}
 
-  // Convert the RTC time to MSDOS datetime format
-  uint16_t msdos_date =
-      ((rtcTime.year - 1980) << 9) | (rtcTime.month << 5) | (rtcTime.day);
-  uint16_t msdos_time =
-      (rtcTime.hour << 11) | (rtcTime.min << 5) | (rtcTime.sec / 2);
+// The date and time are always fresh in the shared memory, refreshed by the
+// timer. Only acknowledge the command
+static void rtcCmdReadTime(const TransmissionProtocol *protocol) {}
+
+static void rtcCmdSaveVectors(const TransmissionProtocol *protocol) {
+  uint16_t *payload = ((uint16_t *)protocol->payload);
+  // Jump the random token
+  TPROTO_NEXT32_PAYLOAD_PTR(payload);
+  // Extract the 32 bit payload
+  uint32_t payload32 = TPROTO_GET_PAYLOAD_PARAM32(payload);
+  WRITE_AND_SWAP_LONGWORD(
+      memorySharedAddress, RTCEMUL_OLD_XBIOS_TRAP,
+      payload32);  // Save the old XBIOS trap address in the shared memory
+  if (protocol->payload_size >= 3 * sizeof(uint32_t)) {
+    // The old GEMDOS trap address follows
+    TPROTO_NEXT32_PAYLOAD_PTR(payload);
+    WRITE_AND_SWAP_LONGWORD(memorySharedAddress, RTCEMUL_OLD_GEMDOS_TRAP,
+                            TPROTO_GET_PAYLOAD_PARAM32(payload));
+  }
+}
 
-  // Change order for the endianess
-  rtc_time_ptr[1] = 0x1b;
+static void rtcCmdSetSharedVar(const TransmissionProtocol *protocol) {
+  uint16_t *payload = ((uint16_t *)protocol->payload);
+  // Jump the random token
+  TPROTO_NEXT32_PAYLOAD_PTR(payload);
+  // Extract the 32 bit payload with the variable index
+  uint32_t sharedVarIdx = TPROTO_GET_PAYLOAD_PARAM32(payload);
+  TPROTO_NEXT32_PAYLOAD_PTR(payload);
+  // Extract the 32 bit payload with the variable value
+  uint32_t sharedVarValue = TPROTO_GET_PAYLOAD_PARAM32(payload);
+  // Set the shared variable in the shared memory
+  SET_SHARED_VAR(sharedVarIdx, sharedVarValue, memorySharedAddress,
+                 RTCEMUL_SHARED_VARIABLES);
+  DTRACE(TRACE_SHARED_VAR, sharedVarIdx, sharedVarValue);
+}
 
-  // If negative number, it is EmuTOS
-  if ((gemdos_version >= 0) && (y2k_patch)) {
-    DPRINTF("Applying Y2K fix in the date\n");
-    rtc_time_ptr[0] =
-        add_bcd(to_bcd((rtcTime.year % 100)),
-                to_bcd((2000 - 1980) + (80 - 30)));  // Fix Y2K issue
-  } else {
-    DPRINTF("Not applying Y2K fix in the date\n");
-    rtc_time_ptr[0] =
-        to_bcd(rtcTime.year % 100);  // EmuTOS already handles the Y2K issue
-    // If the TOS is EmuTOS, then we disable the Y2K fix
-    WRITE_LONGWORD_RAW(mem_shared_addr, rtcemul_y2k_patch_idx, 0);
-  }
-  rtc_time_ptr[3] = to_bcd(rtcTime.month);
-  rtc_time_ptr[2] = to_bcd(rtcTime.day);
-  rtc_time_ptr[5] = to_bcd(rtcTime.hour);
-  rtc_time_ptr[4] = to_bcd(rtcTime.min);
-  rtc_time_ptr[7] = to_bcd(rtcTime.sec);
-  rtc_time_ptr[6] = 0x0;
-
-  // Store MSDOS datetime into shared memory
-  msdos_datetime = (msdos_date << 16) | msdos_time;
-  WRITE_LONGWORD_RAW(mem_shared_addr, rtcemul_datetime_msdos_idx,
-                     msdos_datetime);
-  DPRINTF("MSDOS datetime: 0x%08x\n", msdos_datetime);
+static void rtcCmdSetSharedVars(const TransmissionProtocol *protocol) {
+  uint16_t *payload = ((uint16_t *)protocol->payload);
+  // The (index, value) pairs follow the random token
+  uint16_t pairs =
+      (protocol->payload_size - sizeof(uint32_t)) / (2 * sizeof(uint32_t));
+  if (pairs > RTCEMUL_SHARED_VARS_MAX_PAIRS) {
+    pairs = RTCEMUL_SHARED_VARS_MAX_PAIRS;
+  }
+  for (uint16_t i = 0; i < pairs; i++) {
+    // Jump the random token or the previous value
+    TPROTO_NEXT32_PAYLOAD_PTR(payload);
+    uint32_t sharedVarIdx = TPROTO_GET_PAYLOAD_PARAM32(payload);
+    TPROTO_NEXT32_PAYLOAD_PTR(payload);
+    uint32_t sharedVarValue = TPROTO_GET_PAYLOAD_PARAM32(payload);
+    SET_SHARED_VAR(sharedVarIdx, sharedVarValue, memorySharedAddress,
+                   RTCEMUL_SHARED_VARIABLES);
+    DTRACE(TRACE_SHARED_VAR, sharedVarIdx, sharedVarValue);
+  }
 }
 
+static const DispatchCommand rtcCommands[] = {
+    {RTCEMUL_READ_TIME, rtcCmdReadTime},
+    {RTCEMUL_SAVE_VECTORS, rtcCmdSaveVectors},
+    {RTCEMUL_SET_SHARED_VAR, rtcCmdSetSharedVar},
+    {RTCEMUL_SET_SHARED_VARS, rtcCmdSetSharedVars},
+};
+
 int rtc_preinit() {
   DPRINTF("RTC preinit\n");
   memorySharedAddress =
@@ -393,6 +1241,8 @@ int rtc_preinit() {
   memoryRandomTokenAddress = memorySharedAddress + RTCEMUL_RANDOM_TOKEN_OFFSET;
   memoryRandomTokenSeedAddress =
       memorySharedAddress + RTCEMUL_RANDOM_TOKEN_SEED_OFFSET;
+  // The commands of the RTC are live from the setup mode on
+  dispatch_register(rtcCommands, sizeof(rtcCommands) / sizeof(rtcCommands[0]));
   // We should use 128KB of RAM for the RTC emulator, since there is no need to
   // restrict the size of the RTC emulator to 64KB.
   // ROM4 will contain the RTC emulator
@@ -406,9 +1256,12 @@ int rtc_preinit() {
 
 int rtc_postinit() {
   DPRINTF("RTC postinit\n");
-  WRITE_LONGWORD_RAW(memorySharedAddress, RTCEMUL_NTP_SUCCESS,
-                     0xFFFFFFFF);  // 0xFFFFFFFF: NTP success
-  WRITE_LONGWORD_RAW(memorySharedAddress, RTCEMUL_REENTRY_TRAP, 0x0);
+  // Without network the clock runs from the last known time
+  start_internal_rtc();
+  WRITE_LONGWORD_RAW(
+      memorySharedAddress, RTCEMUL_NTP_SUCCESS,
+      (ntpState == RTC_NTP_SYNCED) ? 0xFFFFFFFF : 0);  // 0xFFFFFFFF: success
+  WRITE_LONGWORD_RAW(memorySharedAddress, RTCEMUL_OLD_GEMDOS_TRAP, 0x0);
   SET_SHARED_VAR(SHARED_VARIABLE_HARDWARE_TYPE, 0, memorySharedAddress,
                  RTCEMUL_SHARED_VARIABLES);
   SET_SHARED_VAR(SHARED_VARIABLE_SVERSION, 0, memorySharedAddress,
@@ -416,9 +1269,12 @@ int rtc_postinit() {
   SET_SHARED_VAR(SHARED_VARIABLE_BUFFER_TYPE, 0, memorySharedAddress,
                  RTCEMUL_SHARED_VARIABLES);  // 0: Diskbuffer, 1: Stack. But
                                              // useless in the RTC
+  SET_SHARED_VAR(SHARED_VARIABLE_SYNC_TIMEOUT, 0, memorySharedAddress,
+                 RTCEMUL_SHARED_VARIABLES);  // Default until calibrated
+  SET_SHARED_VAR(SHARED_VARIABLE_RESIDENT_ADDR, 0, memorySharedAddress,
+                 RTCEMUL_SHARED_VARIABLES);  // Until it is relocated
   // RTC type
-  SettingsConfigEntry *rtcType =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_RTC_TYPE);
+  SettingsConfigEntry *rtcType = aconfig_getEntry(ACONFIG_KEY_RTC_TYPE);
 
   if (rtcType != NULL && rtcType->value != NULL) {
     DPRINTF("RTC type value: %s\n", rtcType->value);
@@ -435,8 +1291,11 @@ int rtc_postinit() {
       dallasClock.write_address_bit_zero = 0x1;
       dallasClock.write_address_bit_one = 0x3;
       dallasClock.size_magic_sequence = sizeof(dallasClock.magic_sequence);
-      dallasClock.size_clock_sequence = sizeof(dallasClock.clock_sequence);
+      dallasClock.size_clock_sequence = sizeof(dallasClock.clock_sequence[0]);
       dallasClock.rom_address = memorySharedAddress;
+      dallasClock.magic_index = RTCEMUL_DALLAS_MAGIC_START;
+      dallasClock.clock_latch = NULL;
+      dallasClock.answer_word = NULL;
 
       populateMagicSequence(dallasClock.magic_sequence,
                             dallasClock.magic_sequence_hex);
@@ -459,16 +1318,12 @@ int rtc_postinit() {
   // Set the RTC type in the shared memory
 
   // Y2K patch command
-  SettingsConfigEntry *y2kPatch =
-      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_RTC_Y2K_PATCH);
+  SettingsConfigEntry *y2kPatch = aconfig_getEntry(ACONFIG_KEY_RTC_Y2K_PATCH);
 
   if (y2kPatch != NULL && y2kPatch->value != NULL &&
       y2kPatch->value[0] != '\0') {
     DPRINTF("Y2K patch value: %s\n", y2kPatch->value);
-    char firstChar = y2kPatch->value[0];
-    y2kPatchEnabled =
-        (firstChar == 't' || firstChar == 'T' || firstChar == 'y' ||
-         firstChar == 'Y' || firstChar == '1');
+    y2kPatchEnabled = aconfig_getBool(ACONFIG_KEY_RTC_Y2K_PATCH, false);
 
     WRITE_LONGWORD_RAW(memorySharedAddress, RTCEMUL_Y2K_PATCH,
                        y2kPatchEnabled ? 0xFFFFFFFF : 0);
@@ -477,22 +1332,54 @@ int rtc_postinit() {
     WRITE_LONGWORD_RAW(memorySharedAddress, RTCEMUL_Y2K_PATCH, 0);
   }
 
+  // The computer checks its clock against the shared time in the VBL. Only
+  // without the Y2K patch: the XBIOS hook already returns the shared time
+  SET_SHARED_VAR(SHARED_VARIABLE_RTC_DISCIPLINE,
+                 aconfig_getBool(ACONFIG_KEY_RTC_DISCIPLINE, false)
+                     ? 0xFFFFFFFF
+                     : 0,
+                 memorySharedAddress, RTCEMUL_SHARED_VARIABLES);
+
+  // The GEMDOS hook answers Tgettime and Tgetdate with the shared time
+  SET_SHARED_VAR(SHARED_VARIABLE_RTC_GEMDOS_HOOK,
+                 aconfig_getBool(ACONFIG_KEY_RTC_GEMDOS_HOOK, false)
+                     ? 0xFFFFFFFF
+                     : 0,
+                 memorySharedAddress, RTCEMUL_SHARED_VARIABLES);
+
   // Set the RTC time for the Atari ST to read
   uint32_t gemdos_version = 0;
   GET_SHARED_VAR(SHARED_VARIABLE_SVERSION, &gemdos_version, memorySharedAddress,
                  RTCEMUL_SHARED_VARIABLES);
   DPRINTF("Shared variable SVERSION: %x\n", gemdos_version);
-  set_ikb_datetime_msg(memorySharedAddress, RTCEMUL_DATETIME_BCD,
-                       RTCEMUL_Y2K_PATCH, RTCEMUL_DATETIME_MSDOS,
-                       (int16_t)gemdos_version, y2kPatchEnabled);
+  set_ikb_datetime_msg(memorySharedAddress, y2kPatchEnabled);
+  if (rtcTypeVar == RTC_DALLAS) {
+#if (ROMEMUL_ROM3_CAPTURE == 1) || (ROMEMUL_ROM3_PIO_FILTER == 1)
+    // Only the per access interrupt sees the ROM4 accesses
+    DPRINTF(
+        "Warning: the DALLAS RTC does not work with the ROM3 capture or the "
+        "PIO filter. The computer will not find the clock\n");
+#endif
+    // Fill both buffers before the first access
+    set_dallas_clock_sequence();
+    set_dallas_clock_sequence();
+    // The bus interrupt runs the DS1216 state machine from now on
+    dispatch_setAccessHandler(rtc_dallasAccessHandler);
+  }
+
+  // From now on the date and time are refreshed without waiting for commands
+  if (!add_repeating_timer_ms(-RTCEMUL_DATETIME_REFRESH_MS,
+                              datetimeTimerCallback, NULL, &datetimeTimer)) {
+    DPRINTF("Cannot start the date and time refresh timer\n");
+  }
 
   if (memoryRandomTokenAddress != 0) {
-    uint32_t randomToken = rand();  // Generate a random 32-bit value
+    uint32_t randomToken = dispatch_nextToken();
     DPRINTF("Init random token: %08X\n", memoryRandomTokenAddress);
     // Set the random token in the shared memory
     TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenAddress, randomToken);
     // Init the random token seed in the shared memory for the next command
-    uint32_t newRandomSeedToken = rand();  // Generate a new random 32-bit value
+    uint32_t newRandomSeedToken = dispatch_nextToken();
     DPRINTF("Set the new random token seed: %08X\n", newRandomSeedToken);
     TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenSeedAddress, newRandomSeedToken);
   }
@@ -502,176 +1389,66 @@ int rtc_postinit() {
   return 0;  // Success
 }
 
-/**
- * @brief Callback that handles the protocol command received.
- *
- * This callback copy the content of the protocol to the last_protocol
- * structure. The last_protocol_valid flag is set to true to indicate that the
- * last_protocol structure contains a valid protocol. We return to the
- * dma_irq_handler_lookup function to continue asap with the next
- *
- * @param protocol The TransmissionProtocol structure containing the protocol
- * information.
- */
-static inline void __not_in_flash_func(handle_protocol_command)(
-    const TransmissionProtocol *protocol) {
-  // Copy the content of protocol to last_protocol
-  // Copy the 8-byte header directly
-  lastProtocol.command_id = protocol->command_id;
-  lastProtocol.payload_size = protocol->payload_size;
-  lastProtocol.bytes_read = protocol->bytes_read;
-  lastProtocol.final_checksum = protocol->final_checksum;
-
-  // Sanity check: clamp payload_size to avoid overflow
-  uint16_t size = protocol->payload_size;
-  if (size > MAX_PROTOCOL_PAYLOAD_SIZE) {
-    size = MAX_PROTOCOL_PAYLOAD_SIZE;
-  }
-
-  memcpy(lastProtocol.payload, protocol->payload, size);
-
-  lastProtocolValid = true;
-};
-
-static inline void __not_in_flash_func(handle_protocol_checksum_error)(
-    const TransmissionProtocol *protocol) {
-  DPRINTF("Checksum error detected (ID=%u, Size=%u)\n", protocol->command_id,
-          protocol->payload_size);
-}
-
-// Interrupt handler for DMA completion
-void __not_in_flash_func(rtc_dma_irq_handler_lookup)(void) {
-  // Read the rom3 signal and if so then process the command
-  dma_hw->ints1 = 1U << 2;
-
-  // Read once to avoid redundant hardware access
-  uint32_t addr = dma_hw->ch[2].al3_read_addr_trig;
-
-  // We expect that the ROM3 signal is not set very often, so this should help
-  // the compilar to run faster
-  if (__builtin_expect(addr & 0x00010000, 0)) {
-    // Invert highest bit of low word to get 16-bit address
-    uint16_t addr_lsb = (uint16_t)(addr ^ ADDRESS_HIGH_BIT);
-
-    tprotocol_parse(addr_lsb, handle_protocol_command,
-                    handle_protocol_checksum_error);
+// Put the next bit of the latched clock sequence in the answer word, or
+// restore the original content once the 64 bits are read.
+static inline void __not_in_flash_func(dallas_next_answer)(void) {
+  if (dallasClock.clock_index < dallasClock.size_clock_sequence) {
+    *dallasClock.answer_word =
+        (dallasClock.answer_word_saved & ~RTCEMUL_DALLAS_DATA_BIT) |
+        dallasClock.clock_latch[dallasClock.clock_index++];
+  } else {
+    *dallasClock.answer_word = dallasClock.answer_word_saved;
+    dallasClock.clock_latch = NULL;
+    dallasClock.magic_index = RTCEMUL_DALLAS_MAGIC_START;
   }
 }
 
-// Invoke this function to process the commands from the active loop in the
-// main functionforma
-void __not_in_flash_func(rtc_loop)() {
-  if (lastProtocolValid) {
-    // Shared by all commands
-    // Read the random token from the command and increment the payload
-    // pointer to the first parameter available in the payload
-    uint32_t randomToken = TPROTO_GET_RANDOM_TOKEN(lastProtocol.payload);
-    uint16_t *payloadPtr = ((uint16_t *)(lastProtocol).payload);
-    uint16_t commandId = lastProtocol.command_id;
-    DPRINTF(
-        "Command ID: %d. Size: %d. Random token: 0x%08X, Checksum: 0x%04X\n",
-        lastProtocol.command_id, lastProtocol.payload_size, randomToken,
-        lastProtocol.final_checksum);
-
-    // Jump the random token
-    TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-
-    // Read the payload parameters
-    uint16_t payloadSizeTmp = 4;
-    if ((lastProtocol.payload_size > payloadSizeTmp) &&
-        (lastProtocol.payload_size <= RTCEMUL_PARAMETERS_MAX_SIZE)) {
-      DPRINTF("Payload D3: 0x%04X\n", TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
-      TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-    }
-    payloadSizeTmp += 4;
-    if ((lastProtocol.payload_size > payloadSizeTmp) &&
-        (lastProtocol.payload_size <= RTCEMUL_PARAMETERS_MAX_SIZE)) {
-      DPRINTF("Payload D4: 0x%04X\n", TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
-      TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-    }
-    payloadSizeTmp += 4;
-    if ((lastProtocol.payload_size > payloadSizeTmp) &&
-        (lastProtocol.payload_size <= RTCEMUL_PARAMETERS_MAX_SIZE)) {
-      DPRINTF("Payload D5: 0x%04X\n", TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
-      TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-    }
-    payloadSizeTmp += 4;
-    if ((lastProtocol.payload_size > payloadSizeTmp) &&
-        (lastProtocol.payload_size <= RTCEMUL_PARAMETERS_MAX_SIZE)) {
-      DPRINTF("Payload D6: 0x%04X\n", TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
-      TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
+// DS1216 state machine, run for every ROM4 access. The DMA has already
+// answered the access with the word in RAM, so the answer for the next read
+// is prepared here.
+static inline void __not_in_flash_func(dallas_handle_access)(uint32_t addr) {
+  uint8_t access =
+      (addr >> RTCEMUL_DALLAS_ADDRESS_SHIFT) & RTCEMUL_DALLAS_ADDRESS_MASK;
+
+  if (dallasClock.clock_latch != NULL) {
+    // Unlocked: every access to the read or the write addresses takes one of
+    // the 64 bit slots. A write while setting the clock must move the answer
+    // on as well, or the latch falls out of step with the computer
+    if ((access == dallasClock.read_address_bit) ||
+        (access == dallasClock.write_address_bit_zero) ||
+        (access == dallasClock.write_address_bit_one)) {
+      dallas_next_answer();
     }
+    return;
+  }
 
-    // Handle the command
-    switch (lastProtocol.command_id) {
-      case RTCEMUL_READ_TIME: {
-        // Set the RTC time for the Atari ST to read
-        uint32_t gemdos_version = 0;
-        GET_SHARED_VAR(SHARED_VARIABLE_SVERSION, &gemdos_version,
-                       memorySharedAddress, RTCEMUL_SHARED_VARIABLES);
-        DPRINTF("Shared variable SVERSION: %x\n", gemdos_version);
-        set_ikb_datetime_msg(memorySharedAddress, RTCEMUL_DATETIME_BCD,
-                             RTCEMUL_Y2K_PATCH, RTCEMUL_DATETIME_MSDOS,
-                             (int16_t)gemdos_version, y2kPatchEnabled);
-        DPRINTF("RTCEMUL_READ_TIME received. Setting the time\n");
-        break;
-      }
-      case RTCEMUL_SAVE_VECTORS: {
-        uint16_t *payload = ((uint16_t *)(lastProtocol).payload);
-        // Jump the random token
-        TPROTO_NEXT32_PAYLOAD_PTR(payload);
-        // Extract the 32 bit payload
-        uint32_t payload32 = TPROTO_GET_PAYLOAD_PARAM32(payload);
-        WRITE_AND_SWAP_LONGWORD(
-            memorySharedAddress, RTCEMUL_OLD_XBIOS_TRAP,
-            payload32);  // Save the reentry trap address in the shared memory
-        DPRINTF("RTCEMUL_SAVE_VECTORS received. Saving the vectors\n");
-        break;
-      }
-      case RTCEMUL_REENTRY_LOCK: {
-        WRITE_LONGWORD_RAW(
-            memorySharedAddress, RTCEMUL_REENTRY_TRAP,
-            0xFFFFFFFF);  // Set the reentry trap address to 0xFFFFFFFF
-        DPRINTF("RTCEMUL_REENTRY_LOCK received. Locking the reentry trap\n");
-        break;
-      }
-      case RTCEMUL_REENTRY_UNLOCK: {
-        WRITE_LONGWORD_RAW(memorySharedAddress, RTCEMUL_REENTRY_TRAP,
-                           0x0);  // Set the reentry trap address to 0x0
-        DPRINTF(
-            "RTCEMUL_REENTRY_UNLOCK received. Unlocking the reentry trap\n");
-        break;
-      }
-      case RTCEMUL_SET_SHARED_VAR: {
-        uint16_t *payload = ((uint16_t *)(lastProtocol).payload);
-        // Jump the random token
-        TPROTO_NEXT32_PAYLOAD_PTR(payload);
-        // Extract the 32 bit payload with the variable index
-        uint32_t sharedVarIdx = TPROTO_GET_PAYLOAD_PARAM32(payload);
-        TPROTO_NEXT32_PAYLOAD_PTR(payload);
-        // Extract the 32 bit payload with the variable value
-        uint32_t sharedVarValue = TPROTO_GET_PAYLOAD_PARAM32(payload);
-        // Set the shared variable in the shared memory
-        SET_SHARED_VAR(sharedVarIdx, sharedVarValue, memorySharedAddress,
-                       RTCEMUL_SHARED_VARIABLES);
-        DPRINTF("RTCEMUL_SET_SHARED_VAR received. Setting %d to %x\n",
-                sharedVarIdx, sharedVarValue);
-        break;
-      }
-      default:
-        // Unknown command
-        DPRINTF("Unknown command\n");
-        break;
-    }
-    if (memoryRandomTokenAddress != 0) {
-      // Set the random token in the shared memory
-      TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenAddress, randomToken);
-
-      // Init the random token seed in the shared memory for the next command
-      uint32_t newRandomSeedToken =
-          rand();  // Generate a new random 32-bit value
-      TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenSeedAddress, newRandomSeedToken);
+  if (access == dallasClock.magic_sequence[dallasClock.magic_index]) {
+    if (++dallasClock.magic_index < dallasClock.size_magic_sequence) {
+      return;
     }
+    // Magic sequence recognized. Answer from the same block of addresses
+    dallasClock.last_magic_found++;
+    dallasClock.answer_word =
+        (uint16_t *)(dallasClock.rom_address +
+                     (addr & RTCEMUL_DALLAS_BLOCK_MASK) +
+                     (dallasClock.read_address_bit
+                      << RTCEMUL_DALLAS_ADDRESS_SHIFT));
+    dallasClock.answer_word_saved = *dallasClock.answer_word;
+    dallasClock.clock_latch =
+        dallasClock.clock_sequence[dallasClock.clock_sequence_active];
+    dallasClock.clock_index = 0;
+    dallas_next_answer();
+  } else if (access ==
+             dallasClock.magic_sequence[RTCEMUL_DALLAS_MAGIC_START]) {
+    // The mismatch can be the start of a new sequence
+    dallasClock.retries++;
+    dallasClock.magic_index = RTCEMUL_DALLAS_MAGIC_START + 1;
+  } else {
+    dallasClock.magic_index = RTCEMUL_DALLAS_MAGIC_START;
   }
-  lastProtocolValid = false;
+}
+
+// Handler of the ROM4 accesses, called by the bus interrupt
+void TPROTO_IRQ_FUNC(rtc_dallasAccessHandler)(uint32_t addr) {
+  dallas_handle_access(addr);
 }
@@ -0,0 +1,81 @@
+/**
+ * File: rtcmsg.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Date and time published in the shared memory for the computer
+ */
+
+#include "rtcmsg.h"
+
+// Sequence counter of the published date and time. Odd while updating
+static uint32_t datetimeSeq = 0;
+
+// Function to convert a binary number to BCD format
+uint8_t rtcmsg_toBcd(uint8_t val) { return ((val / 10) << 4) | (val % 10); }
+
+// Function to add two BCD values
+uint8_t rtcmsg_addBcd(uint8_t bcd1, uint8_t bcd2) {
+  uint8_t low_nibble = (bcd1 & 0x0F) + (bcd2 & 0x0F);
+  uint8_t high_nibble = (bcd1 & 0xF0) + (bcd2 & 0xF0);
+
+  if (low_nibble > 9) {
+    low_nibble += 6;
+  }
+
+  high_nibble += (low_nibble & 0xF0);  // Add carry to high nibble
+  low_nibble &= 0x0F;                  // Keep only the low nibble
+
+  if ((high_nibble & 0x1F0) > 0x90) {
+    high_nibble += 0x60;
+  }
+
+  return (high_nibble & 0xF0) | (low_nibble & 0x0F);
+}
+
+void rtcmsg_setDatetime(uintptr_t memSharedAddr, const datetime_t *now,
+                        bool y2kPatch, int32_t driftPpb, uint32_t syncAge) {
+  uint8_t *rtc_time_ptr = (uint8_t *)(memSharedAddr + RTCEMUL_DATETIME_BCD);
+
+  // Convert the RTC time to MSDOS datetime format
+  uint16_t msdos_date =
+      ((now->year - 1980) << 9) | (now->month << 5) | (now->day);
+  uint16_t msdos_time = (now->hour << 11) | (now->min << 5) | (now->sec / 2);
+
+  // Start the update
+  WRITE_AND_SWAP_LONGWORD(memSharedAddr, RTCEMUL_DATETIME_SEQ, ++datetimeSeq);
+  __dmb();
+
+  // Change order for the endianess
+  rtc_time_ptr[1] = 0x1b;
+
+  if (y2kPatch) {
+    rtc_time_ptr[0] =
+        rtcmsg_addBcd(rtcmsg_toBcd((now->year % 100)),
+                      rtcmsg_toBcd((2000 - 1980) + (80 - 30)));  // Fix Y2K
+  } else {
+    // EmuTOS already handles the Y2K issue
+    rtc_time_ptr[0] = rtcmsg_toBcd(now->year % 100);
+    // If the TOS is EmuTOS, then we disable the Y2K fix
+    WRITE_LONGWORD_RAW(memSharedAddr, RTCEMUL_Y2K_PATCH, 0);
+  }
+  rtc_time_ptr[3] = rtcmsg_toBcd(now->month);
+  rtc_time_ptr[2] = rtcmsg_toBcd(now->day);
+  rtc_time_ptr[5] = rtcmsg_toBcd(now->hour);
+  rtc_time_ptr[4] = rtcmsg_toBcd(now->min);
+  rtc_time_ptr[7] = rtcmsg_toBcd(now->sec);
+  rtc_time_ptr[6] = 0x0;
+
+  // Store MSDOS datetime into shared memory
+  uint32_t msdos_datetime = ((uint32_t)msdos_date << 16) | msdos_time;
+  WRITE_LONGWORD_RAW(memSharedAddr, RTCEMUL_DATETIME_MSDOS, msdos_datetime);
+
+  // Quality of the clock
+  WRITE_AND_SWAP_LONGWORD(memSharedAddr, RTCEMUL_DRIFT_PPB,
+                          (uint32_t)driftPpb);
+  WRITE_AND_SWAP_LONGWORD(memSharedAddr, RTCEMUL_SYNC_AGE, syncAge);
+
+  // End the update
+  __dmb();
+  WRITE_AND_SWAP_LONGWORD(memSharedAddr, RTCEMUL_DATETIME_SEQ, ++datetimeSeq);
+}
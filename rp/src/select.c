@@ -40,27 +40,69 @@ void select_configure() {
 
 bool select_detectPush() { return (gpio_get(SELECT_GPIO) != 0); }
 
-void select_coreWaitPush(reset_callback_t reset, reset_callback_t resetLong) {
-  inline void core1_waitPush(void) {
-    DPRINTF("Waiting for SELECT button to be pushed\n");
-    // Wait until the SELECT button is pushed.
-    while (!select_detectPush()) {
-      tight_loop_contents();
-      sleep_ms(SELECT_LOOP_DELAY);
+// Long press alarm. Fired if the button is still pushed after the long reset
+static alarm_id_t longPressAlarm = 0;
+
+// Time of the rising edge that started the push
+static absolute_time_t pushStart;
+
+static int64_t __not_in_flash_func(longPressAlarmCallback)(alarm_id_t id,
+                                                           void *userData) {
+  longPressAlarm = 0;
+  if (select_detectPush() && (reset_long_cb != NULL)) {
+    DPRINTF("Long press detected. Executing long reset callback\n");
+    reset_long_cb();
+  }
+  return 0;  // Do not reschedule the alarm
+}
+
+static void __not_in_flash_func(selectGpioCallback)(uint gpio,
+                                                    uint32_t events) {
+  if (gpio != SELECT_GPIO) {
+    return;
+  }
+  if (events & GPIO_IRQ_EDGE_RISE) {
+    // Button pushed. Check again after the long reset time
+    if (longPressAlarm == 0) {
+      pushStart = get_absolute_time();
+      longPressAlarm =
+          add_alarm_in_ms(SELECT_LONG_RESET, longPressAlarmCallback, NULL, true);
+    }
+  }
+  if (events & GPIO_IRQ_EDGE_FALL) {
+    // Button released before the long reset time. A falling edge right after
+    // the push, or with the button still pushed, is contact bounce
+    if ((longPressAlarm > 0) &&
+        (absolute_time_diff_us(pushStart, get_absolute_time()) >=
+         SELECT_DEBOUNCE_MS * 1000) &&
+        !select_detectPush()) {
+      cancel_alarm(longPressAlarm);
+      longPressAlarm = 0;
+      if (reset_cb != NULL) {
+        DPRINTF("Short press detected. Executing reset callback\n");
+        reset_cb();
+      }
     }
-    DPRINTF("SELECT button pushed!\n");
-    select_waitPush();
   }
+}
 
-  DPRINTF("Launching core 1 to wait for SELECT button push\n");
+void select_coreWaitPush(reset_callback_t reset, reset_callback_t resetLong) {
+  DPRINTF("Enabling the SELECT button interrupt\n");
   reset_cb = reset;
   reset_long_cb = resetLong;
-  multicore_launch_core1(core1_waitPush);
+  gpio_set_irq_enabled_with_callback(SELECT_GPIO,
+                                     GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL,
+                                     true, selectGpioCallback);
 }
 
 void select_coreWaitPushDisable() {
-  DPRINTF("Disabling core 1\n");
-  multicore_reset_core1();
+  DPRINTF("Disabling the SELECT button interrupt\n");
+  gpio_set_irq_enabled(SELECT_GPIO, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL,
+                       false);
+  if (longPressAlarm > 0) {
+    cancel_alarm(longPressAlarm);
+    longPressAlarm = 0;
+  }
 }
 
 void select_checkPushReset() {
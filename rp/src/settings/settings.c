@@ -4,6 +4,8 @@
 
 #include "settings.h"
 
+#include <stddef.h>
+
 /*
  * -----------
  * STATIC HELPER FUNCTIONS
@@ -14,14 +16,16 @@
  * @brief Verify the format of a given key (uppercase, numbers, or '_').
  */
 static int checkKeyFormat(const char key[SETTINGS_MAX_KEY_LENGTH]) {
-  // Check if the key is empty
-  if (strlen(key) == 0) {
+  // Check if the key is empty. The keys read from erased flash have no null
+  // terminator
+  size_t length = strnlen(key, SETTINGS_MAX_KEY_LENGTH);
+  if (length == 0) {
     DPRINTF("Error: Key is empty.\n");
     return -1;  // Invalid key format
   }
 
   // Loop through each character in the key
-  for (size_t i = 0; i < strlen(key); i++) {
+  for (size_t i = 0; i < length; i++) {
     char chr = key[i];
 
     // Check if the character is not an uppercase letter, digit or underscore
@@ -49,6 +53,127 @@ static int checkTypeFormat(SettingsDataType type) {
   return 0;
 }
 
+/**
+ * @brief Hash slot of a key. FNV-1a of the key, mixed with the seed.
+ */
+static uint32_t settingsKeySlot(const char *key, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+  for (size_t i = 0; i < SETTINGS_MAX_KEY_LENGTH && key[i] != '\0'; i++) {
+    hash ^= (uint8_t)key[i];
+    hash *= 16777619u;
+  }
+  hash ^= hash >> SETTINGS_SHIFT_LEFT_16_BITS;
+  return hash & (SETTINGS_INDEX_SLOTS - 1);
+}
+
+/**
+ * @brief Fill the index with a seed. Returns the number of collisions.
+ */
+static size_t settingsFillIndex(SettingsContext *ctx, uint32_t seed) {
+  size_t collisions = 0;
+  memset(ctx->index, SETTINGS_INDEX_EMPTY, sizeof(ctx->index));
+  for (size_t i = 0; i < ctx->configData.count; i++) {
+    uint32_t slot = settingsKeySlot(ctx->configData.entries[i].key, seed);
+    while (ctx->index[slot] != SETTINGS_INDEX_EMPTY) {
+      collisions++;
+      slot = (slot + 1) & (SETTINGS_INDEX_SLOTS - 1);
+    }
+    ctx->index[slot] = (uint8_t)i;
+  }
+  return collisions;
+}
+
+/**
+ * @brief Build the hash index of the loaded keys.
+ *
+ * Tries the seeds until one has no collisions. Otherwise keeps the last one,
+ * and the lookups probe the next slots.
+ */
+static void settingsBuildIndex(SettingsContext *ctx) {
+  ctx->indexed = (ctx->configData.count <= SETTINGS_INDEX_SLOTS / 2);
+  if (!ctx->indexed) {
+    DPRINTF("Too many entries to index (%zu).\n", ctx->configData.count);
+    return;
+  }
+  size_t collisions = 0;
+  for (uint32_t seed = 0; seed < SETTINGS_INDEX_MAX_SEEDS; seed++) {
+    ctx->indexSeed = seed;
+    collisions = settingsFillIndex(ctx, seed);
+    if (collisions == 0) {
+      break;
+    }
+  }
+  DPRINTF("Key index seed: %lu. Collisions: %zu.\n",
+          (unsigned long)ctx->indexSeed, collisions);
+}
+
+/**
+ * @brief Position of the entry with the key, or -1 if not found.
+ */
+static int settingsLookup(const SettingsContext *ctx, const char *key) {
+  if (!ctx->indexed) {
+    for (size_t i = 0; i < ctx->configData.count; i++) {
+      if (strncmp(ctx->configData.entries[i].key, key,
+                  SETTINGS_MAX_KEY_LENGTH) == 0) {
+        return (int)i;
+      }
+    }
+    return -1;
+  }
+  uint32_t slot = settingsKeySlot(key, ctx->indexSeed);
+  while (ctx->index[slot] != SETTINGS_INDEX_EMPTY) {
+    uint8_t i = ctx->index[slot];
+    if (strncmp(ctx->configData.entries[i].key, key,
+                SETTINGS_MAX_KEY_LENGTH) == 0) {
+      return i;
+    }
+    slot = (slot + 1) & (SETTINGS_INDEX_SLOTS - 1);
+  }
+  return -1;
+}
+
+/**
+ * @brief Parse the typed value of a string.
+ */
+static void settingsParseValue(const char *value, SettingsTypedValue *typed) {
+  char *end = NULL;
+  typed->intValue = (int)strtol(value, NULL, SETTINGS_BASE_10);
+  typed->doubleValue = strtod(value, &end);
+  typed->isNumber = (end != value) && (*end == '\0');
+  if (!typed->isNumber) {
+    typed->doubleValue = 0.0;
+  }
+  char first = value[0];
+  typed->boolValue = (first == 't' || first == 'T' || first == 'y' ||
+                      first == 'Y' || first == '1');
+}
+
+/**
+ * @brief Refresh the cached typed value of an entry.
+ */
+static void settingsUpdateTyped(SettingsContext *ctx, size_t index) {
+  if (index < SETTINGS_MAX_TYPED_ENTRIES) {
+    settingsParseValue(ctx->configData.entries[index].value,
+                       &ctx->typed[index]);
+  }
+}
+
+/**
+ * @brief Typed value of an entry, from the cache or parsed now.
+ */
+static const SettingsTypedValue *settingsGetTyped(SettingsContext *ctx,
+                                                  size_t index,
+                                                  SettingsTypedValue *tmp) {
+  if (!ctx || index >= ctx->configData.count) {
+    return NULL;
+  }
+  if (index < SETTINGS_MAX_TYPED_ENTRIES) {
+    return &ctx->typed[index];
+  }
+  settingsParseValue(ctx->configData.entries[index].value, tmp);
+  return tmp;
+}
+
 /**
  * @brief Load the default entries into memory as the initial config.
  *
@@ -57,8 +182,8 @@ static int checkTypeFormat(SettingsDataType type) {
 static void settingsLoadDefaultEntries(SettingsContext *ctx,
                                        const SettingsConfigEntry *entries,
                                        uint16_t numEntries) {
-  // Start with zero count
-  ctx->configData.count = 0;
+  // The MAGICVERSION entry is already in place
+  ctx->configData.count = SETTINGS_FIRST_ENTRY;
 
   for (uint16_t i = 0; i < numEntries; i++) {
     if (entries[i].key[0] == '\0' || strlen(entries[i].key) == 0) {
@@ -86,7 +211,7 @@ static void settingsLoadDefaultEntries(SettingsContext *ctx,
     }
   }
 
-  if (ctx->configData.count != numEntries) {
+  if (ctx->configData.count != numEntries + SETTINGS_FIRST_ENTRY) {
     DPRINTF(
         "WARNING: Mismatch between the number of default entries (%d) "
         "and the number of entries loaded (%zu).\n",
@@ -94,6 +219,313 @@ static void settingsLoadDefaultEntries(SettingsContext *ctx,
   } else {
     DPRINTF("Loaded %zu default entries.\n", ctx->configData.count);
   }
+
+  // The keys don't change from now on
+  settingsBuildIndex(ctx);
+}
+
+/**
+ * @brief Offset of the journal: the first flash page after the snapshot.
+ */
+static uint32_t settingsJournalStart(size_t count) {
+  size_t snapshotSize = count * sizeof(SettingsConfigEntry);
+  return (uint32_t)((snapshotSize + FLASH_PAGE_SIZE - 1) &
+                    ~(size_t)(FLASH_PAGE_SIZE - 1));
+}
+
+/**
+ * @brief Size of a journal record, including the padding.
+ */
+static size_t settingsJournalRecordSize(const SettingsJournalRecord *record) {
+  size_t size = sizeof(SettingsJournalRecord) + record->keyLength +
+                record->valueLength;
+  return (size + SETTINGS_JOURNAL_ALIGN - 1) &
+         ~(size_t)(SETTINGS_JOURNAL_ALIGN - 1);
+}
+
+/**
+ * @brief Checksum of a journal record: the header, the key and the value.
+ */
+static uint8_t settingsJournalChecksum(const SettingsJournalRecord *record,
+                                       const uint8_t *data) {
+  const uint8_t *header = (const uint8_t *)record;
+  uint8_t sum = 0;
+  for (size_t i = 0; i < offsetof(SettingsJournalRecord, checksum); i++) {
+    sum += header[i];
+  }
+  for (size_t i = 0; i < (size_t)record->keyLength + record->valueLength;
+       i++) {
+    sum += data[i];
+  }
+  return sum;
+}
+
+/**
+ * @brief Mark an entry as changed since the last save.
+ */
+static void settingsMarkDirty(SettingsContext *ctx, size_t index) {
+  if (index < SETTINGS_MAX_DIRTY_ENTRIES) {
+    ctx->dirtyMask |= (1UL << index);
+  } else {
+    ctx->dirtyOverflow = true;
+  }
+}
+
+/**
+ * @brief Check if an entry changed since the last save.
+ */
+static bool settingsIsDirty(const SettingsContext *ctx, size_t index) {
+  return (index < SETTINGS_MAX_DIRTY_ENTRIES) &&
+         ((ctx->dirtyMask & (1UL << index)) != 0);
+}
+
+/**
+ * @brief Check if there is a journal header at the offset of the region.
+ */
+static bool settingsHasJournalHeader(const SettingsContext *ctx,
+                                     uint32_t offset) {
+  const uint8_t *base = (const uint8_t *)(ctx->flashSettingsOffset + XIP_BASE);
+  SettingsJournalHeader header;
+  if (offset + sizeof(header) > ctx->flashSettingsSize) {
+    return false;
+  }
+  memcpy(&header, base + offset, sizeof(header));
+  return (header.marker == SETTINGS_JOURNAL_MARKER) &&
+         (header.markerCheck == (uint32_t)~SETTINGS_JOURNAL_MARKER);
+}
+
+/**
+ * @brief Apply the journal records stored in FLASH from the offset.
+ *
+ * The records are applied in order, so the last record of each key wins. A
+ * damaged record ends the journal and forces a compaction in the next save.
+ */
+static void settingsApplyJournal(SettingsContext *ctx, uint32_t offset) {
+  const uint8_t *base = (const uint8_t *)(ctx->flashSettingsOffset + XIP_BASE);
+  uint16_t sequence = 0;
+  while (offset + sizeof(SettingsJournalRecord) <= ctx->flashSettingsSize) {
+    SettingsJournalRecord record;
+    memcpy(&record, base + offset, sizeof(record));
+    if (record.tag == 0xFFFF) {
+      // Erased flash. End of the journal
+      break;
+    }
+    size_t recordSize = settingsJournalRecordSize(&record);
+    const uint8_t *data = base + offset + sizeof(record);
+    if (record.tag != SETTINGS_JOURNAL_RECORD_TAG ||
+        record.sequence != sequence || record.keyLength == 0 ||
+        record.keyLength >= SETTINGS_MAX_KEY_LENGTH ||
+        record.valueLength >= SETTINGS_MAX_VALUE_LENGTH ||
+        offset + recordSize > ctx->flashSettingsSize ||
+        settingsJournalChecksum(&record, data) != record.checksum) {
+      DPRINTF("Damaged journal record %u. Compact in the next save.\n",
+              sequence);
+      ctx->dirtyOverflow = true;
+      break;
+    }
+
+    char key[SETTINGS_MAX_KEY_LENGTH] = {0};
+    memcpy(key, data, record.keyLength);
+    int index = settingsLookup(ctx, key);
+    if (index >= 0) {
+      SettingsConfigEntry *entry = &ctx->configData.entries[index];
+      entry->dataType = (SettingsDataType)record.dataType;
+      memset(entry->value, 0, SETTINGS_MAX_VALUE_LENGTH);
+      memcpy(entry->value, data + record.keyLength, record.valueLength);
+    }
+    offset += recordSize;
+    sequence++;
+  }
+
+  ctx->journalOffset = offset;
+  ctx->journalSeq = sequence;
+  DPRINTF("Journal found in FLASH: %u records, next at 0x%lx.\n", sequence,
+          (unsigned long)offset);
+}
+
+/**
+ * @brief Load the journal of a journaled context from the start of the region.
+ *
+ * @return 0 if loaded, -1 if there is no journal or the first record is not
+ * the MAGICVERSION entry of this context.
+ */
+static int settingsLoadJournal(SettingsContext *ctx) {
+  if (!settingsHasJournalHeader(ctx, 0)) {
+    return -1;
+  }
+  const uint8_t *base = (const uint8_t *)(ctx->flashSettingsOffset + XIP_BASE);
+  uint32_t offset = sizeof(SettingsJournalHeader);
+  SettingsJournalRecord record;
+  memcpy(&record, base + offset, sizeof(record));
+  const char *data = (const char *)(base + offset + sizeof(record));
+  const char *magic = ctx->configData.entries[0].value;
+  size_t keyLength = strlen(SETTINGS_MAGICVERSION_KEY);
+  if (record.tag != SETTINGS_JOURNAL_RECORD_TAG ||
+      record.keyLength != keyLength ||
+      memcmp(data, SETTINGS_MAGICVERSION_KEY, keyLength) != 0 ||
+      record.valueLength != strlen(magic) ||
+      memcmp(data + keyLength, magic, record.valueLength) != 0) {
+    DPRINTF("The journal is not for %s. Using default values.\n", magic);
+    return -1;
+  }
+  settingsApplyJournal(ctx, offset);
+  return 0;
+}
+
+/**
+ * @brief Apply the journal older firmwares stored after the snapshot.
+ *
+ * The next save compacts the region into the current layout.
+ */
+static void settingsLoadLegacyJournal(SettingsContext *ctx,
+                                      size_t snapshotCount,
+                                      size_t maxEntries) {
+  const uint8_t *base = (const uint8_t *)(ctx->flashSettingsOffset + XIP_BASE);
+  ctx->journalOffset = 0;
+  ctx->journalSeq = 0;
+
+  // The snapshot can have more entries than the defaults of this firmware
+  while (snapshotCount < maxEntries) {
+    const SettingsConfigEntry *stored =
+        (const SettingsConfigEntry *)(base + snapshotCount *
+                                                 sizeof(SettingsConfigEntry));
+    char key[SETTINGS_MAX_KEY_LENGTH] = {0};
+    memcpy(key, stored->key, SETTINGS_MAX_KEY_LENGTH - 1);
+    if (key[0] == '\0' || !isupper((unsigned char)key[0])) {
+      break;
+    }
+    snapshotCount++;
+  }
+
+  uint32_t offset = settingsJournalStart(snapshotCount);
+  if (!settingsHasJournalHeader(ctx, offset)) {
+    DPRINTF("No journal found in FLASH.\n");
+    return;
+  }
+  settingsApplyJournal(ctx, offset + sizeof(SettingsJournalHeader));
+  ctx->journalOffset = 0;
+  ctx->journalSeq = 0;
+}
+
+/**
+ * @brief Append entries to the journal.
+ *
+ * Appends the changed entries, or all of them to compact the journal in an
+ * erased region. An empty journal gets the header first. Only programs the
+ * flash pages the new records touch. The bytes of the page around the
+ * records are programmed as 0xFF, which leaves them unchanged.
+ *
+ * @return 0 on success, -1 if the journal has no room for the records.
+ */
+static int settingsAppendJournal(SettingsContext *ctx, bool all,
+                                 bool disable_interrupts) {
+  // Size of the new records
+  SettingsJournalHeader header = {SETTINGS_JOURNAL_MARKER,
+                                  (uint32_t)~SETTINGS_JOURNAL_MARKER};
+  bool withHeader = (ctx->journalOffset == 0);
+  size_t total = withHeader ? sizeof(header) : 0;
+  for (size_t i = 0; i < ctx->configData.count; i++) {
+    if (all || settingsIsDirty(ctx, i)) {
+      SettingsJournalRecord record = {0};
+      record.keyLength =
+          (uint8_t)strnlen(ctx->configData.entries[i].key,
+                           SETTINGS_MAX_KEY_LENGTH - 1);
+      record.valueLength =
+          (uint8_t)strnlen(ctx->configData.entries[i].value,
+                           SETTINGS_MAX_VALUE_LENGTH - 1);
+      total += settingsJournalRecordSize(&record);
+    }
+  }
+  if (ctx->journalOffset + total > ctx->flashSettingsSize) {
+    return -1;
+  }
+
+  uint8_t *records = (uint8_t *)malloc(total);
+  if (!records) {
+    DPRINTF("Error: Unable to allocate memory for the journal records.\n");
+    return -1;
+  }
+  memset(records, 0xFF, total);
+
+  size_t position = 0;
+  if (withHeader) {
+    memcpy(records, &header, sizeof(header));
+    position = sizeof(header);
+  }
+  uint16_t sequence = ctx->journalSeq;
+  for (size_t i = 0; i < ctx->configData.count; i++) {
+    if (!all && !settingsIsDirty(ctx, i)) {
+      continue;
+    }
+    const SettingsConfigEntry *entry = &ctx->configData.entries[i];
+    SettingsJournalRecord record = {0};
+    record.tag = SETTINGS_JOURNAL_RECORD_TAG;
+    record.sequence = sequence++;
+    record.dataType = (uint8_t)entry->dataType;
+    record.keyLength =
+        (uint8_t)strnlen(entry->key, SETTINGS_MAX_KEY_LENGTH - 1);
+    record.valueLength =
+        (uint8_t)strnlen(entry->value, SETTINGS_MAX_VALUE_LENGTH - 1);
+    uint8_t *data = records + position + sizeof(record);
+    memcpy(data, entry->key, record.keyLength);
+    memcpy(data + record.keyLength, entry->value, record.valueLength);
+    record.checksum = settingsJournalChecksum(&record, data);
+    memcpy(records + position, &record, sizeof(record));
+    position += settingsJournalRecordSize(&record);
+  }
+
+  uint32_t start = ctx->journalOffset;
+  uint32_t end = ctx->journalOffset + (uint32_t)total;
+  uint32_t page = start & ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+  DPRINTF("Appending %zu bytes to the journal at 0x%lx.\n", total,
+          (unsigned long)start);
+  for (; page < end; page += FLASH_PAGE_SIZE) {
+    uint8_t pageBuffer[FLASH_PAGE_SIZE];
+    memset(pageBuffer, 0xFF, sizeof(pageBuffer));
+    uint32_t from = (page > start) ? page : start;
+    uint32_t to = (page + FLASH_PAGE_SIZE < end) ? page + FLASH_PAGE_SIZE : end;
+    memcpy(pageBuffer + (from - page), records + (from - start), to - from);
+
+    uint32_t ints = 0;
+    if (disable_interrupts) {
+      ints = save_and_disable_interrupts();
+    }
+    flash_range_program(ctx->flashSettingsOffset + page, pageBuffer,
+                        FLASH_PAGE_SIZE);
+    if (disable_interrupts) {
+      restore_interrupts(ints);
+    }
+  }
+  free(records);
+
+  ctx->journalOffset = end;
+  ctx->journalSeq = sequence;
+  return 0;
+}
+
+/**
+ * @brief Erase the region and write one journal record per entry.
+ */
+static int settingsCompactJournal(SettingsContext *ctx,
+                                  bool disable_interrupts) {
+  DPRINTF("Compacting %zu entries in the journal.\n", ctx->configData.count);
+  uint32_t ints = 0;
+  if (disable_interrupts) {
+    ints = save_and_disable_interrupts();
+  }
+  flash_range_erase(ctx->flashSettingsOffset, ctx->flashSettingsSize);
+  if (disable_interrupts) {
+    restore_interrupts(ints);
+  }
+  ctx->journalOffset = 0;
+  ctx->journalSeq = 0;
+  if (settingsAppendJournal(ctx, true, disable_interrupts) != 0) {
+    DPRINTF("Error: The entries do not fit in the region.\n");
+    return -1;
+  }
+  ctx->dirtyMask = 0;
+  ctx->dirtyOverflow = false;
+  return 0;
 }
 
 /**
@@ -104,18 +536,23 @@ static int settingsLoadAllEntries(SettingsContext *ctx,
                                   uint16_t numEntries, uint16_t maxEntries) {
   uint8_t *currentAddress = (uint8_t *)(ctx->flashSettingsOffset + XIP_BASE);
 
-  // Avoid overflows
-  if (numEntries > maxEntries) {
+  // Avoid overflows. The MAGICVERSION entry takes one
+  if (numEntries > maxEntries - SETTINGS_FIRST_ENTRY) {
     DPRINTF(
         "Warning: Number of entries (%d) exceeds the maximum allowed (%d). "
         "Fixing.\n",
-        numEntries, maxEntries);
-    numEntries = maxEntries;
+        numEntries, maxEntries - SETTINGS_FIRST_ENTRY);
+    numEntries = maxEntries - SETTINGS_FIRST_ENTRY;
   }
 
   // First, load default entries
   settingsLoadDefaultEntries(ctx, entries, numEntries);
 
+  // A journaled region starts with the journal
+  if (ctx->journaled && settingsLoadJournal(ctx) == 0) {
+    return 0;
+  }
+
   // The magic value is stored as a string in the first "entry",
   // i.e. at offset = first entry's value field. By design, your code
   // placed it in the first entry's value, which is:
@@ -160,9 +597,10 @@ static int settingsLoadAllEntries(SettingsContext *ctx,
           storedMagic);
 
   // Now read each entry in a loop
-  // We'll simply read as many entries as we can, up to numEntries
+  // We'll simply read as many entries as we can, up to the size of the
+  // region. The stored entries can be more than the defaults
   uint16_t count = 0;
-  while (count < numEntries) {
+  while (count < maxEntries) {
     SettingsConfigEntry entry = {0};
     memcpy(&entry, currentAddress, sizeof(SettingsConfigEntry));
     currentAddress += sizeof(SettingsConfigEntry);
@@ -190,16 +628,16 @@ static int settingsLoadAllEntries(SettingsContext *ctx,
 
     // Overwrite the matching default entry in ctx->configData
     // if it exists:
-    for (size_t i = 0; i < ctx->configData.count; i++) {
-      if (strncmp(ctx->configData.entries[i].key, entry.key,
-                  SETTINGS_MAX_KEY_LENGTH) == 0) {
-        ctx->configData.entries[i] = entry;
-        break;  // Found the match, updated, done
-      }
+    int index = settingsLookup(ctx, entry.key);
+    if (index >= 0) {
+      ctx->configData.entries[index] = entry;
     }
     count++;
   }
 
+  // The changes saved after the snapshot by older firmwares
+  settingsLoadLegacyJournal(ctx, count, maxEntries);
+
   return 0;
 }
 
@@ -223,58 +661,62 @@ int settings_init(SettingsContext *ctx,
   DPRINTF("Flash settings offset: 0x%lx\n",
           (unsigned long)ctx->flashSettingsOffset);
 
-  // 2) Allocate memory for all possible entries
+  // 2) Entries in the flash region, and entries needed in memory
   size_t maxEntries = ctx->flashSettingsSize / sizeof(SettingsConfigEntry);
   DPRINTF("Max entries count: %zu\n", maxEntries);
 
   assert(defaultNumEntries <= maxEntries);
   DPRINTF("Default entries count: %d\n", defaultNumEntries);
+  size_t needed = defaultNumEntries + SETTINGS_FIRST_ENTRY;
+  if (needed > maxEntries) {
+    needed = maxEntries;
+  }
 
-  // 3) Prepare the configData structure
-  ctx->configData.entries =
-      (SettingsConfigEntry *)malloc(ctx->flashSettingsSize);
-  if (!ctx->configData.entries) {
-    DPRINTF("Error: Unable to allocate memory for config entries.\n");
-    return -1;
+  // 3) Prepare the configData structure, in the arena if there is one
+  if (ctx->arena) {
+    if (ctx->arenaCapacity < needed) {
+      DPRINTF("Error: The arena has %zu entries, %zu needed.\n",
+              ctx->arenaCapacity, needed);
+      return -1;
+    }
+    ctx->configData.entries = ctx->arena;
+  } else {
+    ctx->configData.entries =
+        (SettingsConfigEntry *)malloc(needed * sizeof(SettingsConfigEntry));
+    if (!ctx->configData.entries) {
+      DPRINTF("Error: Unable to allocate memory for config entries.\n");
+      return -1;
+    }
   }
   ctx->configData.count = 0;
+  ctx->indexed = false;
+  ctx->journalOffset = 0;
+  ctx->journalSeq = 0;
+  ctx->dirtyMask = 0;
+  ctx->dirtyOverflow = false;
 
   // 4) Build the 32-bit magic from (magic << 16) | version
   ctx->configData.magic =
       ((uint32_t)magic << SETTINGS_SHIFT_LEFT_16_BITS) | version;
   DPRINTF("Combined magic: 0x%08lx\n", (unsigned long)ctx->configData.magic);
 
-  // 5) Create an augmented default array with the MAGICVERSION entry at the
-  // front.
-  defaultNumEntries++;  // Add one for the magic entry
-  SettingsConfigEntry *defaultEntriesWithMagic = (SettingsConfigEntry *)malloc(
-      defaultNumEntries * sizeof(SettingsConfigEntry));
-  if (!defaultEntriesWithMagic) {
-    DPRINTF(
-        "Error: Unable to allocate memory for default entries with magic.\n");
-    return -1;
-  }
-
-  // Fill the special "MAGICVERSION" entry
-  char magicValue[SETTINGS_MAX_VALUE_LENGTH];
-  snprintf(magicValue, sizeof(magicValue), "%lu",
+  // 5) Fill the special "MAGICVERSION" entry in place, before the defaults
+  SettingsConfigEntry *magicEntry = &ctx->configData.entries[0];
+  memset(magicEntry, 0, sizeof(SettingsConfigEntry));
+  strncpy(magicEntry->key, SETTINGS_MAGICVERSION_KEY,
+          SETTINGS_MAX_KEY_LENGTH - 1);
+  magicEntry->dataType = SETTINGS_TYPE_INT;
+  snprintf(magicEntry->value, SETTINGS_MAX_VALUE_LENGTH, "%lu",
            (unsigned long)ctx->configData.magic);
-  SettingsConfigEntry magicEntry = {
-      SETTINGS_MAGICVERSION_KEY, SETTINGS_TYPE_INT, {0}};
-  strncpy(magicEntry.value, magicValue, SETTINGS_MAX_VALUE_LENGTH - 1);
-  magicEntry.value[SETTINGS_MAX_VALUE_LENGTH - 1] = '\0';
-
-  // Put the magic entry first, then copy the user’s defaults
-  defaultEntriesWithMagic[0] = magicEntry;
-  memcpy(defaultEntriesWithMagic + 1, defaultEntries,
-         (defaultNumEntries - 1) * sizeof(SettingsConfigEntry));
 
   // 6) Load from flash (or default) into ctx->configData
-  int error =
-      settingsLoadAllEntries(ctx, defaultEntriesWithMagic,
-                             (uint16_t)defaultNumEntries, (uint16_t)maxEntries);
+  int error = settingsLoadAllEntries(ctx, defaultEntries, defaultNumEntries,
+                                     (uint16_t)maxEntries);
 
-  free(defaultEntriesWithMagic);
+  // Parse the values once. The updates refresh them
+  for (size_t i = 0; i < ctx->configData.count; i++) {
+    settingsUpdateTyped(ctx, i);
+  }
 
   // Return the number of entries loaded, or error
   return (error == 0 ? (int)ctx->configData.count : error);
@@ -284,20 +726,48 @@ int settings_deinit(SettingsContext *ctx) {
   if (!ctx) return -1;
 
   // Reset the entire structure
-  if (ctx->configData.entries) {
+  if (ctx->configData.entries && !ctx->arena) {
     free(ctx->configData.entries);
-    ctx->configData.entries = NULL;
   }
+  ctx->configData.entries = NULL;
   ctx->configData.count = 0;
+  ctx->indexed = false;
   ctx->flashSettingsSize = SETTINGS_DEFAULT_FLASH_SIZE;
   ctx->flashSettingsOffset = 0;
 
   return 0;
 }
 
+void settings_setArena(SettingsContext *ctx, SettingsConfigEntry *arena,
+                       size_t capacity) {
+  if (!ctx) return;
+  ctx->arena = arena;
+  ctx->arenaCapacity = arena ? capacity : 0;
+}
+
+void settings_setJournaled(SettingsContext *ctx, bool journaled) {
+  if (!ctx) return;
+  ctx->journaled = journaled;
+}
+
 int settings_save(SettingsContext *ctx, bool disable_interrupts) {
   if (!ctx) return -1;
 
+  if (ctx->journaled) {
+    if ((ctx->journalOffset != 0) && !ctx->dirtyOverflow) {
+      if (ctx->dirtyMask == 0) {
+        DPRINTF("No changes to save.\n");
+        return 0;
+      }
+      if (settingsAppendJournal(ctx, false, disable_interrupts) == 0) {
+        ctx->dirtyMask = 0;
+        return 0;
+      }
+      DPRINTF("Journal full. Compacting.\n");
+    }
+    return settingsCompactJournal(ctx, disable_interrupts);
+  }
+
   // Check if we don't exceed the reserved space
   size_t totalUsed = ctx->configData.count * sizeof(SettingsConfigEntry);
   if (totalUsed > ctx->flashSettingsSize) {
@@ -309,19 +779,29 @@ int settings_save(SettingsContext *ctx, bool disable_interrupts) {
   DPRINTF("Writing %zu entries to FLASH (size=%zu bytes).\n",
           ctx->configData.count, totalUsed);
 
+  const uint8_t *snapshot = (const uint8_t *)ctx->configData.entries;
   uint32_t ints = 0;
   if (disable_interrupts) {
     ints = save_and_disable_interrupts();
   }
 
   flash_range_erase(ctx->flashSettingsOffset, ctx->flashSettingsSize);
-  flash_range_program(ctx->flashSettingsOffset,
-                      (uint8_t *)ctx->configData.entries,
-                      ctx->flashSettingsSize);
+  // Program the pages with data only. The entries don't fill the region
+  for (uint32_t page = 0; page < totalUsed; page += FLASH_PAGE_SIZE) {
+    uint8_t pageBuffer[FLASH_PAGE_SIZE];
+    memset(pageBuffer, 0xFF, sizeof(pageBuffer));
+    size_t length = totalUsed - page;
+    memcpy(pageBuffer, snapshot + page,
+           length < FLASH_PAGE_SIZE ? length : FLASH_PAGE_SIZE);
+    flash_range_program(ctx->flashSettingsOffset + page, pageBuffer,
+                        FLASH_PAGE_SIZE);
+  }
 
   if (disable_interrupts) {
     restore_interrupts(ints);
   }
+  ctx->dirtyMask = 0;
+  ctx->dirtyOverflow = false;
 
   return 0;
 }
@@ -335,11 +815,14 @@ int settings_erase(SettingsContext *ctx) {
   restore_interrupts(ints);
 
   // Free and reset
-  if (ctx->configData.entries) {
+  if (ctx->configData.entries && !ctx->arena) {
     free(ctx->configData.entries);
-    ctx->configData.entries = NULL;
   }
+  ctx->configData.entries = NULL;
   ctx->configData.count = 0;
+  ctx->indexed = false;
+  ctx->journalOffset = 0;
+  ctx->journalSeq = 0;
 
   return 0;
 }
@@ -352,16 +835,44 @@ SettingsConfigEntry *settings_find_entry(SettingsContext *ctx,
     return NULL;
   }
 
-  for (size_t i = 0; i < ctx->configData.count; i++) {
-    if (strncmp(ctx->configData.entries[i].key, key, SETTINGS_MAX_KEY_LENGTH) ==
-        0) {
-      return &ctx->configData.entries[i];
-    }
+  int index = settingsLookup(ctx, key);
+  if (index >= 0) {
+    return &ctx->configData.entries[index];
   }
   DPRINTF("Key %s not found.\n", key);
   return NULL;
 }
 
+SettingsConfigEntry *settings_get_entry(SettingsContext *ctx, size_t index) {
+  if (!ctx || index >= ctx->configData.count) return NULL;
+  return &ctx->configData.entries[index];
+}
+
+int settings_get_int(SettingsContext *ctx, size_t index, int defaultValue) {
+  SettingsTypedValue tmp;
+  const SettingsTypedValue *typed = settingsGetTyped(ctx, index, &tmp);
+  return typed ? typed->intValue : defaultValue;
+}
+
+bool settings_get_bool(SettingsContext *ctx, size_t index, bool defaultValue) {
+  SettingsTypedValue tmp;
+  const SettingsTypedValue *typed = settingsGetTyped(ctx, index, &tmp);
+  return typed ? typed->boolValue : defaultValue;
+}
+
+double settings_get_double(SettingsContext *ctx, size_t index,
+                           double defaultValue) {
+  SettingsTypedValue tmp;
+  const SettingsTypedValue *typed = settingsGetTyped(ctx, index, &tmp);
+  return (typed && typed->isNumber) ? typed->doubleValue : defaultValue;
+}
+
+const char *settings_get_string(SettingsContext *ctx, size_t index,
+                                const char *defaultValue) {
+  SettingsConfigEntry *entry = settings_get_entry(ctx, index);
+  return entry ? entry->value : defaultValue;
+}
+
 /**
  * @brief Internal helper to update an entry if it exists.
  */
@@ -376,16 +887,20 @@ static int settingsUpdateEntry(SettingsContext *ctx, const char *key,
     return -1;
   }
 
-  for (size_t i = 0; i < ctx->configData.count; i++) {
-    if (strncmp(ctx->configData.entries[i].key, key, SETTINGS_MAX_KEY_LENGTH) ==
-        0) {
-      // Key found, update
-      ctx->configData.entries[i].dataType = dataType;
-      strncpy(ctx->configData.entries[i].value, value,
-              SETTINGS_MAX_VALUE_LENGTH - 1);
-      ctx->configData.entries[i].value[SETTINGS_MAX_VALUE_LENGTH - 1] = '\0';
-      return 0;
+  int i = settingsLookup(ctx, key);
+  if (i >= 0) {
+    // Key found, update
+    if ((ctx->configData.entries[i].dataType != dataType) ||
+        (strncmp(ctx->configData.entries[i].value, value,
+                 SETTINGS_MAX_VALUE_LENGTH - 1) != 0)) {
+      settingsMarkDirty(ctx, (size_t)i);
     }
+    ctx->configData.entries[i].dataType = dataType;
+    strncpy(ctx->configData.entries[i].value, value,
+            SETTINGS_MAX_VALUE_LENGTH - 1);
+    ctx->configData.entries[i].value[SETTINGS_MAX_VALUE_LENGTH - 1] = '\0';
+    settingsUpdateTyped(ctx, (size_t)i);
+    return 0;
   }
   DPRINTF("Key %s not found (cannot update).\n", key);
   return -1;
@@ -77,6 +77,64 @@
  #define SETTINGS_BASE_10 10
  #define SETTINGS_SHIFT_LEFT_16_BITS 16
  
+ /**
+  * @brief Journal of the entries of a journaled context.
+  *
+  * The region starts with a marker, followed by variable length records. Each
+  * record holds one entry and the sequence number of the change, so the last
+  * record of a key is its current value. A compaction erases the region and
+  * writes one record per entry, MAGICVERSION first, and the changes are
+  * appended after them. Appending a record only programs the pages it
+  * touches. The records drop the unused bytes of the fixed size entries, so
+  * the journal has room in a region the snapshot alone would fill.
+  *
+  * Older firmwares kept a snapshot of fixed size entries at the start of the
+  * region and the journal in the first page after it. That layout is still
+  * loaded, and the next save compacts it into the new one.
+  */
+ #define SETTINGS_JOURNAL_MARKER 0xA55A5EC7
+ #define SETTINGS_JOURNAL_RECORD_TAG 0x5EC7
+ #define SETTINGS_JOURNAL_ALIGN 4
+ #define SETTINGS_MAX_DIRTY_ENTRIES 32
+ 
+ /**
+  * @brief Largest journal record of a key, with its null terminator in
+  * keySize, and the longest value.
+  */
+ #define SETTINGS_JOURNAL_RECORD_MAX(keySize)                              \
+   ((sizeof(SettingsJournalRecord) + (keySize)-1 +                         \
+     SETTINGS_MAX_VALUE_LENGTH - 1 + SETTINGS_JOURNAL_ALIGN - 1) &         \
+    ~(size_t)(SETTINGS_JOURNAL_ALIGN - 1))
+ 
+ /**
+  * @brief Hash index of the keys.
+  *
+  * The keys are fixed once the default entries are loaded, so the index looks
+  * for a hash seed without collisions: a perfect hash, with a single key
+  * comparison per lookup. If no seed is found the index probes the next slots.
+  * Entry 0 is always the MAGICVERSION entry, so the default entry N is at the
+  * index SETTINGS_FIRST_ENTRY + N.
+  */
+ #define SETTINGS_INDEX_SLOTS 64  ///< Power of two. 2x the entries or more
+ #define SETTINGS_INDEX_EMPTY 0xFF
+ #define SETTINGS_INDEX_MAX_SEEDS 256
+ #define SETTINGS_FIRST_ENTRY 1
+ 
+ /**
+  * @brief Entries with a pre-parsed typed value. Others are parsed on access.
+  */
+ #define SETTINGS_MAX_TYPED_ENTRIES 32
+ 
+ /**
+  * @brief Static storage for the entries of a context, instead of the heap.
+  *
+  * SETTINGS_ARENA_ENTRIES() gives the size for a table of default entries,
+  * with the MAGICVERSION entry. The arenas go to the .settings_arena section
+  * of the linker script, so the map file shows their size.
+  */
+ #define SETTINGS_ARENA_ENTRIES(count) ((count) + SETTINGS_FIRST_ENTRY)
+ #define SETTINGS_ARENA __attribute__((section(".settings_arena")))
+ 
  /**
   * @brief Enumeration of possible data types for configuration entries.
   */
@@ -95,6 +153,16 @@
    char value[SETTINGS_MAX_VALUE_LENGTH];  ///< The value of the setting (string)
  } SettingsConfigEntry;
  
+ /**
+  * @brief Value of an entry parsed once, when loaded or updated.
+  */
+ typedef struct {
+   double doubleValue;  ///< Floating point value, if isNumber
+   int intValue;        ///< Base 10 integer, parsed like atoi()
+   bool boolValue;      ///< Starts with 't', 'T', 'y', 'Y' or '1'
+   bool isNumber;       ///< The whole value is a floating point number
+ } SettingsTypedValue;
+ 
  /**
   * @brief Structure representing the overall configuration data.
   */
@@ -104,6 +172,27 @@
    size_t count;                  ///< Number of configuration entries
  } ConfigData;
  
+ /**
+  * @brief Header of a journal record. The key and the value follow it, without
+  * the null terminators.
+  */
+ typedef struct {
+   uint16_t tag;          ///< SETTINGS_JOURNAL_RECORD_TAG
+   uint16_t sequence;     ///< One more than the previous record
+   uint8_t dataType;      ///< The data type of the setting
+   uint8_t keyLength;     ///< Length of the key
+   uint8_t valueLength;   ///< Length of the value
+   uint8_t checksum;      ///< Sum of the header, the key and the value
+ } SettingsJournalRecord;
+ 
+ /**
+  * @brief Header of the journal, at the start of the region.
+  */
+ typedef struct {
+   uint32_t marker;       ///< SETTINGS_JOURNAL_MARKER
+   uint32_t markerCheck;  ///< ~SETTINGS_JOURNAL_MARKER
+ } SettingsJournalHeader;
+ 
  /**
   * @brief The "context" structure holding all state for one "instance"
   *        of the settings manager (e.g. for one block in flash).
@@ -112,6 +201,17 @@
    ConfigData configData;
    uint32_t flashSettingsSize;
    uint32_t flashSettingsOffset;
+   bool journaled;          ///< Append the changes instead of rewriting
+   uint32_t journalOffset;  ///< Next record in the region. 0 if no journal
+   uint16_t journalSeq;     ///< Sequence number of the next record
+   uint32_t dirtyMask;      ///< Entries changed since the last save
+   bool dirtyOverflow;      ///< Changed entries not in the mask
+   uint8_t index[SETTINGS_INDEX_SLOTS];  ///< Entry of each hash slot
+   uint32_t indexSeed;      ///< Seed of the hash of the keys
+   bool indexed;            ///< False if there are too many entries to index
+   SettingsTypedValue typed[SETTINGS_MAX_TYPED_ENTRIES];  ///< Parsed values
+   SettingsConfigEntry *arena;  ///< Static storage. NULL to use the heap
+   size_t arenaCapacity;        ///< Entries in the arena
  } SettingsContext;
  
  /**
@@ -147,9 +247,37 @@
   */
  int settings_deinit(SettingsContext *ctx);
  
+ /**
+  * @brief Use static storage for the entries (for one context).
+  *
+  * Call it before settings_init(). Without an arena the entries are allocated
+  * in the heap.
+  *
+  * @param ctx      Pointer to the SettingsContext.
+  * @param arena    Storage for the entries. NULL to use the heap.
+  * @param capacity Entries in the arena. See SETTINGS_ARENA_ENTRIES().
+  */
+ void settings_setArena(SettingsContext *ctx, SettingsConfigEntry *arena,
+                        size_t capacity);
+ 
+ /**
+  * @brief Select how settings_save() writes the flash (for one context).
+  *
+  * A journaled context appends the changed entries to the journal, and only
+  * erases the region to compact it when the journal is full. The region has
+  * no snapshot of fixed size entries, which other firmwares like the Booster
+  * app expect, so only use it for regions owned by this firmware.
+  *
+  * @param ctx       Pointer to the SettingsContext.
+  * @param journaled true to append the changes, false to rewrite the region.
+  */
+ void settings_setJournaled(SettingsContext *ctx, bool journaled);
+ 
  /**
   * @brief Save the current configuration settings to flash (for one context).
   *
+  * A journaled context with no changes does not write the flash at all.
+  *
   * @param ctx               Pointer to the SettingsContext.
   * @param disable_interrupts If true, interrupts will be disabled while writing.
   * @return int             0 on success, non-zero on failure.
@@ -187,6 +315,63 @@
  SettingsConfigEntry *settings_find_entry(
      SettingsContext *ctx, const char *key);
  
+ /**
+  * @brief Get a configuration entry by its position, in constant time.
+  *
+  * The entries keep the order of the default entries, after the MAGICVERSION
+  * entry. See SETTINGS_FIRST_ENTRY.
+  *
+  * @param ctx   Pointer to the SettingsContext.
+  * @param index Position of the entry.
+  * @return Pointer to the entry, or NULL if the index is out of range.
+  */
+ SettingsConfigEntry *settings_get_entry(SettingsContext *ctx, size_t index);
+ 
+ /**
+  * @brief Get the value of an entry as an integer, without parsing it.
+  *
+  * @param ctx          Pointer to the SettingsContext.
+  * @param index        Position of the entry.
+  * @param defaultValue Value returned if the index is out of range.
+  * @return int The value parsed like atoi(), or defaultValue.
+  */
+ int settings_get_int(SettingsContext *ctx, size_t index, int defaultValue);
+ 
+ /**
+  * @brief Get the value of an entry as a boolean, without parsing it.
+  *
+  * @param ctx          Pointer to the SettingsContext.
+  * @param index        Position of the entry.
+  * @param defaultValue Value returned if the index is out of range.
+  * @return bool true if the value starts with 't', 'T', 'y', 'Y' or '1'.
+  */
+ bool settings_get_bool(SettingsContext *ctx, size_t index, bool defaultValue);
+ 
+ /**
+  * @brief Get the value of an entry as a double, without parsing it.
+  *
+  * @param ctx          Pointer to the SettingsContext.
+  * @param index        Position of the entry.
+  * @param defaultValue Value returned if the index is out of range or the
+  *                     value is not a number.
+  * @return double The value, or defaultValue.
+  */
+ double settings_get_double(SettingsContext *ctx, size_t index,
+                            double defaultValue);
+ 
+ /**
+  * @brief Get the value of an entry as a string.
+  *
+  * The pointer stays valid, and sees the updates, until settings_deinit().
+  *
+  * @param ctx          Pointer to the SettingsContext.
+  * @param index        Position of the entry.
+  * @param defaultValue Value returned if the index is out of range.
+  * @return const char* The value, or defaultValue.
+  */
+ const char *settings_get_string(SettingsContext *ctx, size_t index,
+                                 const char *defaultValue);
+ 
  /**
   * @brief Update a boolean configuration entry.
   *
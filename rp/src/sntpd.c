@@ -0,0 +1,107 @@
+/**
+ * File: sntpd.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Local SNTP server for the other devices of the network
+ */
+
+#include "sntpd.h"
+
+static struct udp_pcb *sntpdPcb = NULL;
+static uint32_t sntpdAnswers = 0;
+
+// Write a time in microseconds since 1970 as a 64-bit NTP timestamp
+static void putTimestamp(uint8_t *dest, int64_t unixUs) {
+  uint64_t us = (uint64_t)unixUs;
+  uint32_t words[2] = {
+      lwip_htonl((uint32_t)(us / 1000000ULL + NTP_DELTA)),
+      lwip_htonl((uint32_t)(((us % 1000000ULL) << 32) / 1000000ULL))};
+  memcpy(dest, words, sizeof(words));
+}
+
+// Microseconds as a 32-bit NTP short format: seconds and a 16-bit fraction
+static void putShort(uint8_t *dest, uint64_t us) {
+  uint32_t value = lwip_htonl((uint32_t)((us << 16) / 1000000ULL));
+  memcpy(dest, &value, sizeof(value));
+}
+
+static void sntpdRecvCB(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                        const ip_addr_t *addr, u16_t port) {
+  // Take the local time first, it is the receive timestamp
+  uint64_t recvUs = time_us_64();
+  if (p == NULL) {
+    return;
+  }
+  uint8_t version = (pbuf_get_at(p, 0) >> 3) & 0x07;
+  NTP_REFERENCE ref;
+  int64_t recvUtcUs;
+  if ((p->tot_len < NTP_MSG_LEN) ||
+      ((pbuf_get_at(p, 0) & 0x07) != SNTPD_MODE_CLIENT) || (version == 0) ||
+      !rtc_getNtpTime(recvUs, &recvUtcUs, &ref)) {
+    pbuf_free(p);
+    return;
+  }
+
+  struct pbuf *answer = pbuf_alloc(PBUF_TRANSPORT, NTP_MSG_LEN, PBUF_RAM);
+  if (answer == NULL) {
+    DPRINTF("Failed to allocate pbuf for the SNTP answer.\n");
+    pbuf_free(p);
+    return;
+  }
+  uint8_t *msg = (uint8_t *)answer->payload;
+  memset(msg, 0, NTP_MSG_LEN);
+  msg[0] = (uint8_t)((version << 3) | SNTPD_MODE_SERVER);  // No leap second
+  msg[1] = (ref.stratum < SNTPD_MAX_STRATUM) ? ref.stratum + 1
+                                             : SNTPD_MAX_STRATUM;
+  msg[2] = pbuf_get_at(p, 2);  // The poll interval of the client
+  msg[3] = (uint8_t)SNTPD_PRECISION;
+  uint64_t ageUs = (recvUtcUs > ref.refUtcUs)
+                       ? (uint64_t)(recvUtcUs - ref.refUtcUs)
+                       : 0;
+  putShort(&msg[4], ref.rttUs);  // Root delay
+  putShort(&msg[8], ref.rttUs / 2 + ageUs / 1000000ULL * SNTPD_DISPERSION_PPM);
+  memcpy(&msg[12], &ref.refId, sizeof(ref.refId));
+  putTimestamp(&msg[16], ref.refUtcUs);
+  // The transmit timestamp of the client is the originate timestamp
+  pbuf_copy_partial(p, &msg[24], 8, 40);
+  putTimestamp(&msg[32], recvUtcUs);
+  pbuf_free(p);
+
+  NTP_REFERENCE now;
+  int64_t transmitUtcUs;
+  rtc_getNtpTime(time_us_64(), &transmitUtcUs, &now);
+  putTimestamp(&msg[40], transmitUtcUs);
+  err_t err = udp_sendto(pcb, answer, addr, port);
+  if (err != ERR_OK) {
+    DPRINTF("Failed to send the SNTP answer: %s\n", lwip_strerr(err));
+  } else if ((++sntpdAnswers & 0xFF) == 1) {
+    DPRINTF("SNTP answers: %u\n", sntpdAnswers);
+  }
+  pbuf_free(answer);
+}
+
+int sntpd_start(void) {
+  if (sntpdPcb != NULL) {
+    return 0;
+  }
+  cyw43_arch_lwip_begin();
+  sntpdPcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+  if (sntpdPcb == NULL) {
+    cyw43_arch_lwip_end();
+    DPRINTF("Failed to allocate the SNTP server control block.\n");
+    return -1;
+  }
+  err_t err = udp_bind(sntpdPcb, IP_ANY_TYPE, NTP_DEFAULT_PORT);
+  if (err != ERR_OK) {
+    udp_remove(sntpdPcb);
+    sntpdPcb = NULL;
+    cyw43_arch_lwip_end();
+    DPRINTF("Cannot listen on the NTP port: %s\n", lwip_strerr(err));
+    return -1;
+  }
+  udp_recv(sntpdPcb, sntpdRecvCB, NULL);
+  cyw43_arch_lwip_end();
+  DPRINTF("SNTP server listening on port %d\n", NTP_DEFAULT_PORT);
+  return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * File: status.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Status of the device published in the shared memory
+ */
+
+#include "status.h"
+
+static uint32_t memorySharedAddress = 0;
+static uint32_t statusSeq = 0;
+static absolute_time_t nextRefresh;
+
+// The computer reads the words big endian, so the bytes of each word are
+// swapped. The rest of the field is cleared
+static void writeString(uint32_t offset, const char *str, size_t size) {
+  uint8_t *dest = (uint8_t *)(memorySharedAddress + offset);
+  size_t length = strnlen(str, size - 1);
+  for (size_t i = 0; i < size; i++) {
+    dest[i ^ 1] = (i < length) ? (uint8_t)str[i] : 0;
+  }
+}
+
+static uint32_t linkState(bool radioOn, uint32_t ip, int32_t *rssi) {
+  *rssi = 0;
+  if (!radioOn) {
+    return STATUS_LINK_OFF;
+  }
+  if (network_getRssi(rssi) != 0) {
+    *rssi = 0;
+    return STATUS_LINK_DOWN;
+  }
+  return (ip != 0) ? STATUS_LINK_UP : STATUS_LINK_JOINED;
+}
+
+void status_init(void) {
+  memorySharedAddress =
+      (unsigned int)&__rom_in_ram_start__ + FLASH_ROM4_LOAD_OFFSET;
+  memset((void *)(memorySharedAddress + STATUS_OFFSET), 0, STATUS_SIZE);
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_MAGIC_OFFSET,
+                          STATUS_MAGIC);
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_VERSION_OFFSET,
+                          (STATUS_VERSION << 16) | STATUS_SIZE);
+  writeString(STATUS_FIRMWARE_OFFSET, RELEASE_VERSION, STATUS_FIRMWARE_SIZE);
+  statusSeq = 0;
+  nextRefresh = get_absolute_time();
+}
+
+void status_poll(bool radioOn) {
+  if ((memorySharedAddress == 0) || !time_reached(nextRefresh)) {
+    return;
+  }
+  nextRefresh = make_timeout_time_ms(STATUS_REFRESH_MS);
+
+  // The address is not valid while the radio is down
+  uint32_t ip = 0;
+  if (radioOn) {
+    ip_addr_t currentIp = network_getCurrentIp();
+    ip = lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(&currentIp)));
+  }
+  int32_t rssi;
+  uint32_t link = linkState(radioOn, ip, &rssi);
+  const char *server;
+  uint32_t rttUs;
+  uint32_t syncAge = rtc_getLastSync(&server, &rttUs);
+  const TransmissionProtocolStats *stats = tprotocol_getStats();
+
+  // Start the update
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_SEQ_OFFSET,
+                          ++statusSeq);
+  __dmb();
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_LINK_OFFSET, link);
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_RSSI_OFFSET,
+                          (uint32_t)rssi);
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_IP_OFFSET, ip);
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_SYNC_RTT_OFFSET, rttUs);
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_SYNC_AGE_OFFSET,
+                          syncAge);
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_CHECKSUM_ERRORS_OFFSET,
+                          stats->checksumErrors);
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_OVERFLOWS_OFFSET,
+                          dispatch_getOverflows());
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_UPTIME_OFFSET,
+                          (uint32_t)(time_us_64() / 1000000ULL));
+  writeString(STATUS_SERVER_OFFSET, server, STATUS_SERVER_SIZE);
+
+  // End the update
+  __dmb();
+  WRITE_AND_SWAP_LONGWORD(memorySharedAddress, STATUS_SEQ_OFFSET,
+                          ++statusSeq);
+}
@@ -0,0 +1,115 @@
+/**
+ * File: telemetry.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Non blocking telemetry and commands over the USB CDC port
+ */
+
+#include "telemetry.h"
+
+#if USB_TELEMETRY == 1
+#include "pico/stdio_usb.h"
+#include "tusb.h"
+
+static char txRing[TELEMETRY_TX_RING_SIZE];
+static uint32_t txHead = 0;  // Next byte to write
+static uint32_t txTail = 0;  // Next byte to send
+static uint32_t txDropped = 0;
+
+static char line[TELEMETRY_LINE_SIZE];
+static size_t lineLen = 0;
+
+static const TelemetryCommand *commands = NULL;
+static size_t numCommands = 0;
+
+void telemetry_init(void) {
+#if !defined(_DEBUG) || (_DEBUG == 0)
+  // stdio_init_all() already started the USB in the debug builds
+  stdio_usb_init();
+#endif
+  stdio_set_driver_enabled(&stdio_usb, false);
+  DPRINTF("USB telemetry channel initialized\n");
+}
+
+void telemetry_setCommands(const TelemetryCommand *cmds, size_t count) {
+  commands = cmds;
+  numCommands = count;
+}
+
+void telemetry_write(const char *data, size_t len) {
+  uint32_t freeBytes = TELEMETRY_TX_RING_SIZE - (txHead - txTail);
+  if (len > freeBytes) {
+    txDropped += len - freeBytes;
+    len = freeBytes;
+  }
+  for (size_t i = 0; i < len; i++) {
+    txRing[(txHead + i) & TELEMETRY_TX_RING_MASK] = data[i];
+  }
+  txHead += len;
+}
+
+uint32_t telemetry_getDropped(void) { return txDropped; }
+
+uint32_t telemetry_getFree(void) {
+  return TELEMETRY_TX_RING_SIZE - (txHead - txTail);
+}
+
+static void runCommand(void) {
+  line[lineLen] = '\0';
+  char *arg = strchr(line, ' ');
+  if (arg != NULL) {
+    *arg++ = '\0';
+  } else {
+    arg = line + lineLen;
+  }
+  for (size_t i = 0; i < numCommands; i++) {
+    if (strcmp(line, commands[i].command) == 0) {
+      commands[i].handler(arg);
+      return;
+    }
+  }
+  TELEMETRY_PRINTF("Unknown command: %s\n", line);
+}
+
+static void readCommands(void) {
+  char buffer[TELEMETRY_LINE_SIZE];
+  int count = stdio_usb.in_chars(buffer, sizeof(buffer));
+  for (int i = 0; i < count; i++) {
+    char chr = buffer[i];
+    if ((chr == '\r') || (chr == '\n')) {
+      if (lineLen > 0) {
+        runCommand();
+      }
+      lineLen = 0;
+    } else if (lineLen < TELEMETRY_LINE_SIZE - 1) {
+      line[lineLen++] = chr;
+    }
+  }
+}
+
+void telemetry_poll(void) {
+  if (!tud_cdc_connected()) {
+    // Nobody is listening. Keep the ring for the live data
+    txTail = txHead;
+    lineLen = 0;
+    return;
+  }
+  readCommands();
+  uint32_t room = tud_cdc_write_available();
+  while ((txHead != txTail) && (room > 0)) {
+    uint32_t offset = txTail & TELEMETRY_TX_RING_MASK;
+    uint32_t chunk = txHead - txTail;
+    // Only the contiguous part of the ring in each write
+    if (chunk > TELEMETRY_TX_RING_SIZE - offset) {
+      chunk = TELEMETRY_TX_RING_SIZE - offset;
+    }
+    if (chunk > room) {
+      chunk = room;
+    }
+    stdio_usb.out_chars(&txRing[offset], (int)chunk);
+    txTail += chunk;
+    room -= chunk;
+  }
+}
+#endif
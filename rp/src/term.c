@@ -8,18 +8,22 @@
 
 #include "term.h"
 
-static TransmissionProtocol lastProtocol;
-static bool lastProtocolValid = false;
+// The commands of the terminal carry the random token and up to four longs.
+// The data of the writes goes to the stream buffer
+_Static_assert(DISPATCH_PARAMETERS_MAX_SIZE >=
+                   sizeof(uint32_t) * (1 + TERM_KEYSTROKES_MAX),
+               "The keystrokes do not fit in the frames of the terminal");
+_Static_assert(DISPATCH_PARAMETERS_MAX_SIZE >= TPROTO_STREAM_PARAMS_SIZE,
+               "The stream parameters do not fit in the terminal frames");
 
 static uint32_t memorySharedAddress = 0;
-static uint32_t memoryRandomTokenAddress = 0;
-static uint32_t memoryRandomTokenSeedAddress = 0;
 
 // Command handlers
 static void cmdClear(const char *arg);
 static void cmdExit(const char *arg);
 static void cmdHelp(const char *arg);
 static void cmdUnknown(const char *arg);
+static void termStBenchResult(uint32_t test, uint32_t ticks);
 
 // Command table
 static const Command *commands;
@@ -33,6 +37,23 @@ static uint8_t commandLevel = TERM_COMMAND_LEVEL_SINGLE_KEY;
 // last single key command
 static char lastSingleKeyCommand = 0;
 
+// Ticks of the 200 Hz timer of each test of the benchmark of the computer
+static uint32_t stBenchTicks[TERM_BENCH_TESTS] = {0};
+static bool stBenchDone = false;
+
+// Where the writes of the benchmark land. Only allocated while it runs
+static void *stBenchBuffer = NULL;
+
+static const char *const stBenchNames[TERM_BENCH_TESTS] = {
+    "Sync 0 bytes", "Sync 4 bytes", "Sync 16 bytes", "Write 256",
+    "Write 1024",   "Write 2048",   "Screen copy"};
+
+static const uint16_t stBenchIterations[TERM_BENCH_TESTS] = {
+    TERM_BENCH_SYNC_ITERATIONS,    TERM_BENCH_SYNC_ITERATIONS,
+    TERM_BENCH_SYNC_ITERATIONS,    TERM_BENCH_WRITE_ITERATIONS,
+    TERM_BENCH_WRITE_ITERATIONS,   TERM_BENCH_WRITE_ITERATIONS,
+    TERM_BENCH_REFRESH_ITERATIONS};
+
 uint8_t term_getCommandLevel(void) { return commandLevel; }
 
 void term_setCommandLevel(uint8_t level) { commandLevel = level; }
@@ -43,72 +64,6 @@ void term_setCommands(const Command *cmds, size_t count) {
   numCommands = count;
 }
 
-/**
- * @brief Callback that handles the protocol command received.
- *
- * This callback copy the content of the protocol to the last_protocol
- * structure. The last_protocol_valid flag is set to true to indicate that the
- * last_protocol structure contains a valid protocol. We return to the
- * dma_irq_handler_lookup function to continue asap with the next
- *
- * @param protocol The TransmissionProtocol structure containing the protocol
- * information.
- */
-static inline void __not_in_flash_func(handle_protocol_command)(
-    const TransmissionProtocol *protocol) {
-  // Copy the content of protocol to last_protocol
-  // Copy the 8-byte header directly
-  lastProtocol.command_id = protocol->command_id;
-  lastProtocol.payload_size = protocol->payload_size;
-  lastProtocol.bytes_read = protocol->bytes_read;
-  lastProtocol.final_checksum = protocol->final_checksum;
-
-  // Sanity check: clamp payload_size to avoid overflow
-  uint16_t size = protocol->payload_size;
-  if (size > MAX_PROTOCOL_PAYLOAD_SIZE) {
-    size = MAX_PROTOCOL_PAYLOAD_SIZE;
-  }
-
-  // Copy only used payload bytes
-  memcpy(lastProtocol.payload, protocol->payload, size);
-
-  lastProtocolValid = true;
-};
-
-static inline void __not_in_flash_func(handle_protocol_checksum_error)(
-    const TransmissionProtocol *protocol) {
-  DPRINTF("Checksum error detected (ID=%u, Size=%u)\n", protocol->command_id,
-          protocol->payload_size);
-}
-
-// Interrupt handler for DMA completion
-void __not_in_flash_func(term_dma_irq_handler_lookup)(void) {
-  // Read the rom3 signal and if so then process the command
-  dma_hw->ints1 = 1U << 2;
-
-  // Read once to avoid redundant hardware access
-  uint32_t addr = dma_hw->ch[2].al3_read_addr_trig;
-
-  // Check ROM3 signal (bit 16)
-  // We expect that the ROM3 signal is not set very often, so this should help
-  // the compilar to run faster
-  if (__builtin_expect(addr & 0x00010000, 0)) {
-    // Invert highest bit of low word to get 16-bit address
-    uint16_t addr_lsb = (uint16_t)(addr ^ ADDRESS_HIGH_BIT);
-
-    tprotocol_parse(addr_lsb, handle_protocol_command,
-                    handle_protocol_checksum_error);
-  }
-}
-
-static char screen[TERM_SCREEN_SIZE];
-static uint8_t cursorX = 0;
-static uint8_t cursorY = 0;
-
-// Store previous cursor position for block removal
-static uint8_t prevCursorX = 0;
-static uint8_t prevCursorY = 0;
-
 // Buffer to keep track of chars entered between newlines
 static char inputBuffer[TERM_INPUT_BUFFER_SIZE];
 static size_t inputLength = 0;
@@ -116,268 +71,24 @@ static size_t inputLength = 0;
 // Getter method for inputBuffer
 char *term_getInputBuffer(void) { return inputBuffer; }
 
-// Clears entire screen buffer and resets cursor
-void term_clearScreen(void) {
-  memset(screen, 0, TERM_SCREEN_SIZE);
-  cursorX = 0;
-  cursorY = 0;
-  display_termClear();
-}
-
 // Clears the input buffer
 void term_clearInputBuffer(void) {
   memset(inputBuffer, 0, TERM_INPUT_BUFFER_SIZE);
   inputLength = 0;
 }
 
-// Custom scrollup function to scroll except for the last row
-void termScrollupBuffer(uint16_t blankBytes) {
-  // blank bytes is the number of bytes to blank out at the bottom of the
-  // screen
-
-  unsigned char *u8g2Buffer = u8g2_GetBufferPtr(display_getU8g2Ref());
-  memmove(u8g2Buffer, u8g2Buffer + blankBytes,
-          DISPLAY_BUFFER_SIZE - blankBytes -
-              TERM_SCREEN_SIZE_X * DISPLAY_TERM_CHAR_HEIGHT);
-  memset(u8g2Buffer + DISPLAY_BUFFER_SIZE - blankBytes -
-             TERM_SCREEN_SIZE_X * DISPLAY_TERM_CHAR_HEIGHT,
-         0, blankBytes);
-}
-
-// Scrolls the screen up by one row
-static void termScrollUp(void) {
-  memmove(screen, screen + TERM_SCREEN_SIZE_X,
-          TERM_SCREEN_SIZE - TERM_SCREEN_SIZE_X);
-  memset(screen + TERM_SCREEN_SIZE - TERM_SCREEN_SIZE_X, 0, TERM_SCREEN_SIZE_X);
-  termScrollupBuffer(TERM_DISPLAY_ROW_BYTES);
-}
-
-// Prints a character to the screen, handles scrolling
-static void termPutChar(char chr) {
-  screen[cursorY * TERM_SCREEN_SIZE_X + cursorX] = chr;
-  display_termChar(cursorX, cursorY, chr);
-  cursorX++;
-  if (cursorX >= TERM_SCREEN_SIZE_X) {
-    cursorX = 0;
-    cursorY++;
-    if (cursorY >= TERM_SCREEN_SIZE_Y) {
-      termScrollUp();
-      cursorY = TERM_SCREEN_SIZE_Y - 1;
-    }
-  }
-}
-
-// Renders a single character, with special handling for newline and carriage
-// return
-static void termRenderChar(char chr) {
-  // First, remove the old block by restoring the character
-  display_termChar(prevCursorX, prevCursorY, ' ');
-  if (chr == '\n' || chr == '\r') {
-    // Move to new line
-    cursorX = 0;
-    cursorY++;
-    if (cursorY >= TERM_SCREEN_SIZE_Y) {
-      termScrollUp();
-      cursorY = TERM_SCREEN_SIZE_Y - 1;
-    }
-  } else if (chr != '\0') {
-    termPutChar(chr);
-  }
-
-  // Draw a block at the new cursor position
-  display_termCursor(cursorX, cursorY);
-  // Update previous cursor coords
-  prevCursorX = cursorX;
-  prevCursorY = cursorY;
-}
-
-// Prints entire screen to stdout
-static void termPrintScreen(void) {
-  for (int posY = 0; posY < TERM_SCREEN_SIZE_Y; posY++) {
-    for (int posX = 0; posX < TERM_SCREEN_SIZE_X; posX++) {
-      char chr = screen[posY * TERM_SCREEN_SIZE_X + posX];
-      putchar(chr ? chr : ' ');
-    }
-    putchar('\n');
-  }
-}
-
-/**
- * @brief Processes a complete VT52 escape sequence.
- *
- * This function interprets the VT52 sequence stored in `seq` (with given
- * length) and performs the corresponding cursor movements. Modify the TODO
- * sections to implement additional features as needed.
- *
- * @param seq Pointer to the escape sequence buffer.
- * @param length The length of the escape sequence.
- */
-static void vt52ProcessSequence(const char *seq, size_t length) {
-  // Ensure we have at least an ESC and a command character.
-  if (length < 2) return;
-
-  char command = seq[1];
-  switch (command) {
-    case 'A':  // Move cursor up
-      // TODO(diego): Improve behavior if needed.
-      if (cursorY > 0) {
-        cursorY--;
-      }
-      termRenderChar('\0');
-      break;
-    case 'B':  // Move cursor down
-      if (cursorY < TERM_SCREEN_SIZE_Y - 1) {
-        cursorY++;
-      }
-      termRenderChar('\0');
-      break;
-    case 'C':  // Move cursor right
-      if (cursorX < TERM_SCREEN_SIZE_X - 1) {
-        cursorX++;
-      }
-      termRenderChar('\0');
-      break;
-    case 'D':  // Move cursor left
-      if (cursorX > 0) {
-        cursorX--;
-      }
-      termRenderChar('\0');
-      break;
-    case 'E':  // Clear screen and place cursor at top left corner
-      cursorX = 0;
-      cursorY = 0;
-      termRenderChar('\0');
-      for (int posY = 0; posY < TERM_SCREEN_SIZE_Y; posY++) {
-        for (int posX = 0; posX < TERM_SCREEN_SIZE_X; posX++) {
-          screen[posY * TERM_SCREEN_SIZE_X + posX] = 0;
-          display_termChar(posX, posY, ' ');
-        }
-      }
-      break;
-    case 'H':  // Cursor home
-      cursorX = 0;
-      cursorY = 0;
-      termRenderChar('\0');
-      break;
-    case 'J':  // Erases from the current cursor position to the end of the
-               // screen
-      for (int posY = cursorY; posY < TERM_SCREEN_SIZE_Y; posY++) {
-        for (int posX = cursorX; posX < TERM_SCREEN_SIZE_X; posX++) {
-          screen[posY * TERM_SCREEN_SIZE_X + posX] = 0;
-          display_termChar(posX, posY, ' ');
-        }
-      }
-      break;
-    case 'K':  // Clear to end of line
-      for (int posX = cursorX; posX < TERM_SCREEN_SIZE_X; posX++) {
-        screen[cursorY * TERM_SCREEN_SIZE_X + posX] = 0;
-        display_termChar(posX, cursorY, ' ');
-      }
-      break;
-    case 'Y':  // Direct cursor addressing: ESC Y <row> <col>
-      if (length == 4) {
-        int row = seq[2] - TERM_POS_Y;
-        int col = seq[3] - TERM_POS_X;
-        if (row >= 0 && row < TERM_SCREEN_SIZE_Y && col >= 0 &&
-            col < TERM_SCREEN_SIZE_X) {
-          cursorY = row;
-          cursorX = col;
-        }
-        termRenderChar('\0');
-      }
-      break;
-    default:
-      // Unrecognized sequence. Optionally, print or ignore.
-      // For now, we'll ignore it.
-      break;
-  }
-}
-
-void term_printString(const char *str) {
-  enum { STATE_NORMAL, STATE_ESC } state = STATE_NORMAL;
-  char escBuffer[TERM_ESC_BUFFLINE_SIZE];
-  size_t escLen = 0;
-
-  while (*str) {
-    char chr = *str;
-    if (state == STATE_NORMAL) {
-      if (chr == TERM_ESC_CHAR) {  // ESC character detected
-        state = STATE_ESC;
-        escLen = 0;
-        escBuffer[escLen++] = chr;
-      } else {
-        termRenderChar(chr);
-      }
-    } else {  // STATE_ESC: we're accumulating an escape sequence
-      escBuffer[escLen++] = chr;
-      // Check for sequence completion:
-      // Most VT52 sequences are two characters (ESC + command)...
-      if (escLen == 2) {
-        if (escBuffer[1] == 'Y') {
-          // ESC Y requires two more characters (for row and col)
-          // Do nothing now—wait until esc_len == 4.
-        } else {
-          // Sequence complete (ESC + single command)
-          vt52ProcessSequence(escBuffer, escLen);
-          state = STATE_NORMAL;
-        }
-      } else if (escBuffer[1] == 'Y' && escLen == 4) {
-        // ESC Y <row> <col> sequence complete
-        vt52ProcessSequence(escBuffer, escLen);
-        state = STATE_NORMAL;
-      }
-      // In case the buffer gets too long, flush it as normal text
-      if (escLen >= sizeof(escBuffer)) {
-        for (size_t i = 0; i < escLen; i++) {
-          termRenderChar(escBuffer[i]);
-        }
-        state = STATE_NORMAL;
-      }
-    }
-    str++;
-  }
-  // If the string ends while still in ESC state, flush the buffered
-  // characters as normal text.
-  if (state == STATE_ESC) {
-    for (size_t i = 0; i < escLen; i++) {
-      termRenderChar(escBuffer[i]);
-    }
-  }
-  display_termRefresh();
-}
-
 // Called whenever a character is entered by the user
 // This is the single point of entry for user input
 static void termInputChar(char chr) {
   // Check for backspace
   if (chr == '\b') {
-    display_termChar(prevCursorX, prevCursorY, ' ');
-
     // If we have chars in input_buffer, remove last char
-    if (inputLength > 0) {
+    bool erase = (inputLength > 0);
+    if (erase) {
       inputLength--;
       inputBuffer[inputLength] = '\0';  // Null-terminate the string
-      // Also reflect on screen
-      // same as term_backspace
-      if (cursorX == 0) {
-        if (cursorY > 0) {
-          cursorY--;
-          cursorX = TERM_SCREEN_SIZE_X - 1;
-        } else {
-          // already top-left corner
-          return;
-        }
-      } else {
-        cursorX--;
-      }
-      screen[cursorY * TERM_SCREEN_SIZE_X + cursorX] = 0;
-      display_termChar(cursorX, cursorY, ' ');
     }
-
-    display_termCursor(cursorX, cursorY);
-    prevCursorX = cursorX;
-    prevCursorY = cursorY;
-    display_termRefresh();
+    term_backspace(erase);
     return;
   }
 
@@ -393,12 +104,12 @@ static void termInputChar(char chr) {
     // Reset input buffer
     memset(inputBuffer, 0, TERM_INPUT_BUFFER_SIZE);
     inputLength = 0;
-    display_termRefresh();
+    term_refresh();
   } else {
     // If it's newline or carriage return, finalize the line
     if (chr == '\n' || chr == '\r') {
       // Render newline on screen
-      termRenderChar('\n');
+      term_renderChar('\n');
 
       // Process input_buffer
       if (commandLevel == TERM_COMMAND_LEVEL_COMMAND_INPUT) {
@@ -431,7 +142,7 @@ static void termInputChar(char chr) {
         inputLength = 0;
 
         term_printString("> ");
-        display_termRefresh();
+        term_refresh();
       }
       if (commandLevel == TERM_COMMAND_LEVEL_DATA_INPUT) {
         for (size_t i = 0; i < numCommands; i++) {
@@ -449,17 +160,46 @@ static void termInputChar(char chr) {
     if (inputLength < TERM_INPUT_BUFFER_SIZE - 1) {
       inputBuffer[inputLength++] = chr;
       // Render char on screen
-      termRenderChar(chr);
+      term_renderChar(chr);
 
       // show block cursor
 
-      display_termRefresh();
+      term_refresh();
     } else {
       // Buffer full, ignore or beep?
     }
   }
 }
 
+// Decode a keystroke read by the ST with Cnecin and feed it to the input
+static void termKeystroke(uint32_t payload32) {
+  // Extract the ascii code from the payload lower 8 bits
+  char keystroke = (char)(payload32 & TERM_KEYBOARD_KEY_MASK);
+  // Get the shift key status from the higher byte of the payload
+  uint8_t shiftKey =
+      (payload32 & TERM_KEYBOARD_SHIFT_MASK) >> TERM_KEYBOARD_SHIFT_SHIFT;
+  // Get the keyboard scan code from the bits 16 to 23 of the payload
+  uint8_t scanCode =
+      (payload32 & TERM_KEYBOARD_SCAN_MASK) >> TERM_KEYBOARD_SCAN_SHIFT;
+  if (keystroke >= TERM_KEYBOARD_KEY_START &&
+      keystroke <= TERM_KEYBOARD_KEY_END) {
+    // Print the keystroke and the shift key status
+    DPRINTF("Keystroke: %c. Shift key: %d, Scan code: %d\n", keystroke,
+            shiftKey, scanCode);
+  } else {
+    // Print the keystroke and the shift key status
+    DPRINTF("Keystroke: %d. Shift key: %d, Scan code: %d\n", keystroke,
+            shiftKey, scanCode);
+  }
+  termInputChar(keystroke);
+}
+
+void term_remoteKey(char chr) {
+  term_beginOutput();
+  termInputChar(chr);
+  term_endOutput();
+}
+
 // For convenience, we can also have a helper function that "types" a string
 // as if typed by user
 static void termTypeString(const char *str) {
@@ -469,12 +209,77 @@ static void termTypeString(const char *str) {
   }
 }
 
+// Handlers of the commands of the computer. The output of each command
+// lands in one refresh
+static void termCmdStart(const TransmissionProtocol *protocol) {
+  term_beginOutput();
+  display_termStart(DISPLAY_TILES_WIDTH, DISPLAY_TILES_HEIGHT);
+  commandLevel = TERM_COMMAND_LEVEL_SINGLE_KEY;
+  term_clearInputBuffer();
+  term_clearScreen();
+  termInputChar('m');  // Force menu
+  SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_TERM);
+  DPRINTF("Send command to display: DISPLAY_COMMAND_TERM\n");
+  term_endOutput();
+}
+
+static void termCmdKeystroke(const TransmissionProtocol *protocol) {
+  uint16_t *payload = ((uint16_t *)protocol->payload);
+  // The keystrokes follow the random token, one per 32 bit word
+  uint16_t keystrokes =
+      (protocol->payload_size - sizeof(uint32_t)) / sizeof(uint32_t);
+  if (keystrokes > TERM_KEYSTROKES_MAX) {
+    keystrokes = TERM_KEYSTROKES_MAX;
+  }
+  term_beginOutput();
+  for (uint16_t i = 0; i < keystrokes; i++) {
+    // Jump the random token or the previous keystroke
+    TPROTO_NEXT32_PAYLOAD_PTR(payload);
+    termKeystroke(TPROTO_GET_PAYLOAD_PARAM32(payload));
+  }
+  term_endOutput();
+}
+
+// The round trips of the benchmark do not touch the terminal
+static void termCmdBench(const TransmissionProtocol *protocol) {}
+
+static void termCmdBenchResult(const TransmissionProtocol *protocol) {
+  uint16_t *payload = ((uint16_t *)protocol->payload);
+  TPROTO_NEXT32_PAYLOAD_PTR(payload);  // Jump the random token
+  uint32_t test = TPROTO_GET_PAYLOAD_PARAM32(payload);
+  TPROTO_NEXT32_PAYLOAD_PTR(payload);
+  term_beginOutput();
+  termStBenchResult(test, TPROTO_GET_PAYLOAD_PARAM32(payload));
+  term_endOutput();
+}
+
+static void termCmdCalibrateResult(const TransmissionProtocol *protocol) {
+  uint16_t *payload = ((uint16_t *)protocol->payload);
+  TPROTO_NEXT32_PAYLOAD_PTR(payload);  // Jump the random token
+  uint32_t round = TPROTO_GET_PAYLOAD_PARAM32(payload);
+  TPROTO_NEXT32_PAYLOAD_PTR(payload);
+  uint32_t errors = TPROTO_GET_PAYLOAD_PARAM32(payload);
+  TPROTO_NEXT32_PAYLOAD_PTR(payload);
+  term_beginOutput();
+  buscal_result(round, errors, TPROTO_GET_PAYLOAD_PARAM32(payload));
+  term_endOutput();
+}
+
+static const DispatchCommand termCommands[] = {
+    {APP_TERMINAL_START, termCmdStart},
+    {APP_TERMINAL_KEYSTROKE, termCmdKeystroke},
+    {APP_TERMINAL_BENCH_PING, termCmdBench},
+    {APP_TERMINAL_BENCH_WRITE, termCmdBench},
+    {APP_TERMINAL_BENCH_RESULT, termCmdBenchResult},
+    {APP_TERMINAL_CALIBRATE_RESULT, termCmdCalibrateResult},
+};
+
 void term_init(void) {
   // Memory shared address
   memorySharedAddress = (unsigned int)&__rom_in_ram_start__;
-  memoryRandomTokenAddress = memorySharedAddress + TERM_RANDOM_TOKEN_OFFSET;
-  memoryRandomTokenSeedAddress =
-      memorySharedAddress + TERM_RANDON_TOKEN_SEED_OFFSET;
+  // The commands of the terminal stay live after the emulation starts
+  dispatch_register(termCommands,
+                    sizeof(termCommands) / sizeof(termCommands[0]));
   SET_SHARED_VAR(TERM_HARDWARE_TYPE, 0, memorySharedAddress,
                  TERM_SHARED_VARIABLES_OFFSET);  // Clean the hardware type
   SET_SHARED_VAR(TERM_HARDWARE_VERSION, 0, memorySharedAddress,
@@ -483,8 +288,10 @@ void term_init(void) {
   // Initialize the random seed (add this line)
   srand(time(NULL));
   // Init the random token seed in the shared memory for the next command
-  uint32_t newRandomSeedToken = rand();  // Generate a new random 32-bit value
-  TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenSeedAddress, newRandomSeedToken);
+  uint32_t newRandomSeedToken = dispatch_nextToken();
+  TPROTO_SET_RANDOM_TOKEN(
+      memorySharedAddress + DISPATCH_RANDOM_TOKEN_SEED_OFFSET,
+      newRandomSeedToken);
 
   // Initialize the welcome messages
   term_clearScreen();
@@ -518,106 +325,30 @@ void term_init(void) {
   display_refresh();
 }
 
-// Invoke this function to process the commands from the active loop in the
-// main function
-void __not_in_flash_func(term_loop)() {
-  if (lastProtocolValid) {
-    // Shared by all commands
-    // Read the random token from the command and increment the payload
-    // pointer to the first parameter available in the payload
-    uint32_t randomToken = TPROTO_GET_RANDOM_TOKEN(lastProtocol.payload);
-    uint16_t *payloadPtr = ((uint16_t *)(lastProtocol).payload);
-    uint16_t commandId = lastProtocol.command_id;
-    DPRINTF(
-        "Command ID: %d. Size: %d. Random token: 0x%08X, Checksum: 0x%04X\n",
-        lastProtocol.command_id, lastProtocol.payload_size, randomToken,
-        lastProtocol.final_checksum);
-
-#if defined(_DEBUG) && (_DEBUG != 0)
-    // Jump the random token
-    TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-
-    // Read the payload parameters
-    uint16_t payloadSizeTmp = 4;
-    if ((lastProtocol.payload_size > payloadSizeTmp) &&
-        (lastProtocol.payload_size <= TERM_PARAMETERS_MAX_SIZE)) {
-      DPRINTF("Payload D3: 0x%04X\n", TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
-      TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-    }
-    payloadSizeTmp += 4;
-    if ((lastProtocol.payload_size > payloadSizeTmp) &&
-        (lastProtocol.payload_size <= TERM_PARAMETERS_MAX_SIZE)) {
-      DPRINTF("Payload D4: 0x%04X\n", TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
-      TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-    }
-    payloadSizeTmp += 4;
-    if ((lastProtocol.payload_size > payloadSizeTmp) &&
-        (lastProtocol.payload_size <= TERM_PARAMETERS_MAX_SIZE)) {
-      DPRINTF("Payload D5: 0x%04X\n", TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
-      TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-    }
-    payloadSizeTmp += 4;
-    if ((lastProtocol.payload_size > payloadSizeTmp) &&
-        (lastProtocol.payload_size <= TERM_PARAMETERS_MAX_SIZE)) {
-      DPRINTF("Payload D6: 0x%04X\n", TPROTO_GET_PAYLOAD_PARAM32(payloadPtr));
-      TPROTO_NEXT32_PAYLOAD_PTR(payloadPtr);
-    }
-#endif
+static void termPrintStBench(void) {
+  TPRINTF("Computer benchmark (us per op):\n");
+  for (int i = 0; i < TERM_BENCH_TESTS; i++) {
+    uint32_t us = (uint32_t)((uint64_t)stBenchTicks[i] * TERM_BENCH_TICK_US /
+                             stBenchIterations[i]);
+    TPRINTF("  %-13s: %lu\n", stBenchNames[i], (unsigned long)us);
+  }
+}
 
-    // Handle the command
-    switch (lastProtocol.command_id) {
-      case APP_TERMINAL_START: {
-        display_termStart(DISPLAY_TILES_WIDTH, DISPLAY_TILES_HEIGHT);
-        commandLevel = TERM_COMMAND_LEVEL_SINGLE_KEY;
-        term_clearInputBuffer();
-        term_clearScreen();
-        termInputChar('m');  // Force menu
-        SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_TERM);
-        DPRINTF("Send command to display: DISPLAY_COMMAND_TERM\n");
-      } break;
-      case APP_TERMINAL_KEYSTROKE: {
-        uint16_t *payload = ((uint16_t *)(lastProtocol).payload);
-        // Jump the random token
-        TPROTO_NEXT32_PAYLOAD_PTR(payload);
-        // Extract the 32 bit payload
-        uint32_t payload32 = TPROTO_GET_PAYLOAD_PARAM32(payload);
-        // Extract the ascii code from the payload lower 8 bits
-        char keystroke = (char)(payload32 & TERM_KEYBOARD_KEY_MASK);
-        // Get the shift key status from the higher byte of the payload
-        uint8_t shiftKey =
-            (payload32 & TERM_KEYBOARD_SHIFT_MASK) >> TERM_KEYBOARD_SHIFT_SHIFT;
-        // Get the keyboard scan code from the bits 16 to 23 of the payload
-        uint8_t scanCode =
-            (payload32 & TERM_KEYBOARD_SCAN_MASK) >> TERM_KEYBOARD_SCAN_SHIFT;
-        if (keystroke >= TERM_KEYBOARD_KEY_START &&
-            keystroke <= TERM_KEYBOARD_KEY_END) {
-          // Print the keystroke and the shift key status
-          DPRINTF("Keystroke: %c. Shift key: %d, Scan code: %d\n", keystroke,
-                  shiftKey, scanCode);
-        } else {
-          // Print the keystroke and the shift key status
-          DPRINTF("Keystroke: %d. Shift key: %d, Scan code: %d\n", keystroke,
-                  shiftKey, scanCode);
-        }
-        termInputChar(keystroke);
-        break;
-      }
-      default:
-        // Unknown command
-        DPRINTF("Unknown command\n");
-        break;
-    }
-    if (memoryRandomTokenAddress != 0) {
-      // Set the random token in the shared memory
-      TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenAddress, randomToken);
-
-      // Init the random token seed in the shared memory for the next command
-      uint32_t newRandomSeedToken =
-          rand();  // Generate a new random 32-bit value
-      TPROTO_SET_RANDOM_TOKEN(memoryRandomTokenSeedAddress, newRandomSeedToken);
-    }
+// Store the ticks of a test. The results arrive after all the tests
+static void termStBenchResult(uint32_t test, uint32_t ticks) {
+  // Do not run the benchmark again when the computer checks the commands
+  SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_TERM);
+  if (test >= TERM_BENCH_TESTS) {
+    return;
+  }
+  stBenchTicks[test] = ticks;
+  if (test == TERM_BENCH_TESTS - 1) {
+    tprotocol_setStream(APP_TERMINAL_BENCH_WRITE, NULL, 0);
+    free(stBenchBuffer);
+    stBenchBuffer = NULL;
+    stBenchDone = true;
+    termPrintStBench();
   }
-  lastProtocolValid = false;
 }
 
 // Command handlers
@@ -660,7 +391,8 @@ void term_cmdUnknown(const char *arg) {
 }
 
 void term_cmdSave(const char *arg) {
-  settings_save(aconfig_getContext(), true);
+  aconfig_requestSave();
+  aconfig_flush();
   term_printString("Settings saved.\n");
 }
 
@@ -791,3 +523,244 @@ void term_cmdPutString(const char *arg) {
     TPRINTF("Invalid arguments for 'put_string' command.\n");
   }
 }
+
+void term_cmdStats(const char *arg) {
+  const TransmissionProtocolStats *stats = tprotocol_getStats();
+  uint32_t irqCount = stats->irqCount;
+  uint32_t irqAverage =
+      irqCount ? (uint32_t)(stats->irqTotalCycles / irqCount) : 0;
+  TPRINTF("Protocol statistics:\n");
+  TPRINTF("  ROM3 accesses : %lu\n", (unsigned long)stats->accesses);
+  TPRINTF("  Headers       : %lu\n", (unsigned long)stats->headers);
+  TPRINTF("  Frames        : %lu\n", (unsigned long)stats->frames);
+  TPRINTF("  Checksum errs : %lu\n", (unsigned long)stats->checksumErrors);
+  TPRINTF("  Resyncs       : %lu\n", (unsigned long)stats->resyncs);
+  TPRINTF("  Dropped       : %lu\n", (unsigned long)dispatch_getOverflows());
+  TPRINTF("  IRQ max cycles: %lu\n", (unsigned long)stats->irqMaxCycles);
+  TPRINTF("  IRQ avg cycles: %lu\n", (unsigned long)irqAverage);
+
+  if (stBenchDone) {
+    termPrintStBench();
+  }
+
+  const BootRecord *boot = boottime_getRecord(0);
+  if (boot == NULL) {
+    return;
+  }
+  TPRINTF("Boot phases (ms):\n");
+  for (int i = 0; i < BOOT_PHASES; i++) {
+    const BootPhaseTime *phase = &boot->phases[i];
+    int32_t ms = boottime_getPhaseMs(phase);
+    if (ms < 0) {
+      TPRINTF("  %-10s: -\n", boottime_getPhaseName(i));
+    } else if (phase->count > 1) {
+      TPRINTF("  %-10s: %ld (%u runs)\n", boottime_getPhaseName(i), (long)ms,
+              phase->count);
+    } else {
+      TPRINTF("  %-10s: %ld\n", boottime_getPhaseName(i), (long)ms);
+    }
+  }
+}
+
+void term_cmdBench(const char *arg) {
+  uint32_t frames = 0;
+  uint32_t parserNs = bench_parser(&frames);
+  uint32_t settingsNs = bench_settings();
+
+  // Start from the last row, so every new line scrolls the screen
+  for (int i = 0; i < TERM_SCREEN_SIZE_Y; i++) {
+    term_printString("\n");
+  }
+  uint64_t start = time_us_64();
+  for (int i = 0; i < BENCH_SCROLL_LINES; i++) {
+    term_printString("0123456789012345678901234567890123456789\n");
+  }
+  uint32_t scrollNs =
+      (uint32_t)((time_us_64() - start) * 1000 / BENCH_SCROLL_LINES);
+
+  term_clearScreen();
+  TPRINTF("Benchmarks (ns):\n");
+  TPRINTF("  Parsed word   : %lu\n", (unsigned long)parserNs);
+  TPRINTF("  Frames parsed : %lu/%u\n", (unsigned long)frames,
+          BENCH_PARSER_FRAMES);
+  TPRINTF("  Setting lookup: %lu\n", (unsigned long)settingsNs);
+  TPRINTF("  Scrolled line : %lu\n", (unsigned long)scrollNs);
+}
+
+void term_cmdStBench(const char *arg) {
+  if (stBenchBuffer == NULL) {
+    stBenchBuffer = malloc(TERM_BENCH_WRITE_MAX);
+    if (stBenchBuffer == NULL) {
+      term_printString("Error: Out of memory.\n");
+      return;
+    }
+  }
+  // The data of the writes goes straight to the buffer and is discarded
+  tprotocol_setStream(APP_TERMINAL_BENCH_WRITE, stBenchBuffer,
+                      TERM_BENCH_WRITE_MAX);
+  stBenchDone = false;
+  term_printString("Running the benchmark in the computer...\n");
+  SEND_COMMAND_TO_DISPLAY(DISPLAY_COMMAND_BENCH);
+}
+
+void term_cmdCalibrate(const char *arg) {
+  if ((arg != NULL) && (strcmp(arg, "reset") == 0)) {
+    buscal_reset();
+    term_printString("Default bus timing restored.\n");
+    return;
+  }
+  if (buscal_start() != 0) {
+    term_printString("The calibration is already running.\n");
+    return;
+  }
+  term_printString("Calibrating the bus. Do not touch the computer...\n");
+}
+
+void term_cmdProfile(const char *arg) {
+  if (strcmp(arg, "start") == 0) {
+    if (fetchprof_start() == 0) {
+      TPRINTF("Profiling the ROM4 at %u Hz\n", FETCHPROF_SAMPLE_HZ);
+    } else {
+      TPRINTF("No fetch profiler in this build\n");
+    }
+    return;
+  }
+  if (strcmp(arg, "stop") == 0) {
+    fetchprof_stop();
+  } else if (strcmp(arg, "export") == 0) {
+    if (fetchprof_export() != 0) {
+      TPRINTF("No USB telemetry in this build\n");
+      return;
+    }
+  }
+  const uint32_t *histogram = fetchprof_getHistogram();
+  if (histogram == NULL) {
+    TPRINTF("No fetch profiler in this build\n");
+    return;
+  }
+  const FetchProfStats *stats = fetchprof_getStats();
+  TPRINTF("Profile %s. %lu samples, %lu in the ROM4\n",
+          fetchprof_isRunning() ? "running" : "stopped",
+          (unsigned long)stats->samples, (unsigned long)stats->rom4);
+  // The hottest buckets, sorted as they are found
+  int top[TERM_PROFILE_TOP];
+  int count = 0;
+  for (int i = 0; i < FETCHPROF_BUCKETS; i++) {
+    int pos = count;
+    while ((pos > 0) && (histogram[top[pos - 1]] < histogram[i])) {
+      pos--;
+    }
+    if ((histogram[i] == 0) || (pos >= TERM_PROFILE_TOP)) {
+      continue;
+    }
+    if (count < TERM_PROFILE_TOP) {
+      count++;
+    }
+    memmove(&top[pos + 1], &top[pos], (count - 1 - pos) * sizeof(int));
+    top[pos] = i;
+  }
+  for (int i = 0; i < count; i++) {
+    TPRINTF("  $FA%04X: %lu\n", top[i] << FETCHPROF_BUCKET_SHIFT,
+            (unsigned long)histogram[top[i]]);
+  }
+}
+
+void term_cmdOta(const char *arg) {
+  static const char *stateNames[] = {"idle", "downloading", "verifying",
+                                     "failed"};
+  uint32_t written = 0;
+  OtaState state = ota_getState(&written);
+  if ((arg == NULL) ||
+      ((strcmp(arg, "start") != 0) && (strcmp(arg, "status") != 0))) {
+    TPRINTF("Usage: ota start|status\n");
+    TPRINTF("  start: download OTA_URL, check OTA_SHA256 and install it\n");
+    TPRINTF("  status: show the progress of the update\n");
+    TPRINTF("The image is copied over the running app in place. Do not\n");
+    TPRINTF("power off until it reboots: an interrupted copy needs a\n");
+    TPRINTF("reflash through BOOTSEL.\n");
+    return;
+  }
+  if (strcmp(arg, "status") == 0) {
+    TPRINTF("Update %s. %lu bytes written\n", stateNames[state],
+            (unsigned long)written);
+    if (state == OTA_FAILED) {
+      TPRINTF("  Error: %s\n", ota_getError());
+    }
+    return;
+  }
+  const char *url = aconfig_getString(ACONFIG_KEY_OTA_URL, "");
+  const char *hash = aconfig_getString(ACONFIG_KEY_OTA_SHA256, "");
+  if (url[0] == '\0') {
+    TPRINTF("Set OTA_URL and OTA_SHA256 first\n");
+    return;
+  }
+  if (ota_start(url, hash) != 0) {
+    TPRINTF("Cannot start the update: %s\n", ota_getError());
+    return;
+  }
+  TPRINTF("Downloading %s\n", url);
+  TPRINTF("The app reboots when the image is installed. Do not power off\n");
+  TPRINTF("until then\n");
+}
+
+void term_cmdCapture(const char *arg) {
+  uint32_t count = 0;
+  bustrace_getRecords(&count);
+  if (strcmp(arg, "start") == 0) {
+    bustrace_start();
+    TPRINTF("Capture started. Up to %lu accesses\n",
+            (unsigned long)bustrace_getCapacity());
+  } else if (strcmp(arg, "stop") == 0) {
+    bustrace_stop();
+    TPRINTF("Capture stopped. %lu accesses\n", (unsigned long)count);
+  } else if (strcmp(arg, "replay") == 0) {
+    uint32_t frames = 0;
+    uint32_t errors = 0;
+    uint32_t ns = bench_replay(&frames, &errors);
+    TPRINTF("Replayed %lu accesses\n", (unsigned long)count);
+    TPRINTF("  Frames        : %lu\n", (unsigned long)frames);
+    TPRINTF("  Checksum errs : %lu\n", (unsigned long)errors);
+    TPRINTF("  Parsed word ns: %lu\n", (unsigned long)ns);
+  } else if (strcmp(arg, "export") == 0) {
+    if (bustrace_export() == 0) {
+      TPRINTF("Exporting %lu accesses to USB\n", (unsigned long)count);
+    } else {
+      TPRINTF("No USB telemetry in this build\n");
+    }
+  } else {
+#if ROMEMUL_BUS_TRACE == 1
+    TPRINTF("Capture %s. %lu accesses\n",
+            bustrace_isArmed() ? "running" : "stopped", (unsigned long)count);
+    TPRINTF("Usage: capture start|stop|replay|export\n");
+#else
+    TPRINTF("No bus capture in this build\n");
+#endif
+  }
+}
+
+void term_cmdBootTimes(const char *arg) {
+  // One column per boot, the current one first
+  TPRINTF("Boot phases (ms):\n");
+  TPRINTF("%-10s", "phase");
+  for (int age = 0; age < BOOTTIME_HISTORY; age++) {
+    if (age == 0) {
+      TPRINTF("%7s", "now");
+    } else {
+      TPRINTF("%6s%d", "-", age);
+    }
+  }
+  TPRINTF("\n");
+  for (int i = 0; i < BOOT_PHASES; i++) {
+    TPRINTF("%-10s", boottime_getPhaseName(i));
+    for (int age = 0; age < BOOTTIME_HISTORY; age++) {
+      const BootRecord *boot = boottime_getRecord(age);
+      int32_t ms = (boot != NULL) ? boottime_getPhaseMs(&boot->phases[i]) : -1;
+      if (ms < 0) {
+        TPRINTF("%7s", "-");
+      } else {
+        TPRINTF("%7ld", (long)ms);
+      }
+    }
+    TPRINTF("\n");
+  }
+}
@@ -0,0 +1,455 @@
+/**
+ * File: termnet.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Mirror of the terminal for a Telnet client
+ */
+
+#include "termnet.h"
+
+static struct tcp_pcb *listenPcb = NULL;
+static struct tcp_pcb *clientPcb = NULL;
+
+// Keys of the client, written by the callback of lwIP. No locks needed: head
+// is only written by the callback and tail only by the main loop
+static char inputRing[TERMNET_INPUT_SIZE];
+static volatile uint32_t inputHead = 0;
+static volatile uint32_t inputTail = 0;
+
+// State of the Telnet stream of the client
+typedef enum {
+  TELNET_DATA,
+  TELNET_CR,       // After a carriage return, skip the LF or NUL
+  TELNET_IAC,      // After the IAC byte
+  TELNET_OPTION,   // After WILL, WONT, DO or DONT
+  TELNET_SUB,      // In a subnegotiation
+  TELNET_SUB_IAC,  // IAC in a subnegotiation
+  TELNET_ESC,      // After ESC. The arrow keys are not used
+  TELNET_CSI       // In an ANSI sequence
+} TelnetState;
+
+static TelnetState telnetState = TELNET_DATA;
+
+// What the client can do with the terminal
+typedef enum {
+  TERMNET_VIEW,   // No password set: watch only, the keys are discarded
+  TERMNET_LOGIN,  // Typing the password. Nothing is sent to the client
+  TERMNET_INPUT   // Password accepted: the keys reach the terminal
+} TermnetAccess;
+
+static char mirrorPassword[TERMNET_PASSWORD_SIZE] = {0};
+static TermnetAccess clientAccess = TERMNET_VIEW;
+
+// Password typed by the client. One byte more than the longest password, so
+// a longer one never matches
+static char login[TERMNET_PASSWORD_SIZE];
+static size_t loginLen = 0;
+
+// No new clients until then, after a wrong password
+static uint64_t lockoutUntilUs = 0;
+
+// The screen as the client shows it, and its cursor. -1 if not known
+static char shadow[TERM_SCREEN_SIZE_Y][TERM_SCREEN_SIZE_X];
+static int remoteX = -1;
+static int remoteY = -1;
+
+// The client must clear its screen before the next delta
+static volatile bool redraw = false;
+
+// Output serial of the terminal of the last delta, and rows left to compare
+static uint32_t lastSerial = 0;
+static bool pending = false;
+
+static char txBuffer[TERMNET_TX_SIZE];
+static size_t txLen = 0;
+static size_t txLimit = 0;
+
+// Echo the keys in the mirror and send them one at a time
+static const char telnetOptions[] = {
+    (char)TERMNET_IAC, (char)TERMNET_WILL, TERMNET_OPT_ECHO,
+    (char)TERMNET_IAC, (char)TERMNET_WILL, TERMNET_OPT_SGA};
+
+static void pushKey(char chr) {
+  uint32_t head = inputHead;
+  if (head - inputTail >= TERMNET_INPUT_SIZE) {
+    return;  // Full. The client types faster than the terminal
+  }
+  inputRing[head & TERMNET_INPUT_MASK] = chr;
+  inputHead = head + 1;
+}
+
+// Decode a byte of the client into the keys of the terminal
+static void telnetByte(uint8_t byte) {
+  switch (telnetState) {
+    case TELNET_CR:
+      telnetState = TELNET_DATA;
+      if ((byte == '\n') || (byte == '\0')) {
+        break;
+      }
+      telnetByte(byte);
+      break;
+    case TELNET_IAC:
+      if ((byte >= TERMNET_WILL) && (byte <= TERMNET_DONT)) {
+        telnetState = TELNET_OPTION;
+      } else if (byte == TERMNET_SB) {
+        telnetState = TELNET_SUB;
+      } else {
+        telnetState = TELNET_DATA;
+      }
+      break;
+    case TELNET_OPTION:
+      telnetState = TELNET_DATA;
+      break;
+    case TELNET_SUB:
+      if (byte == TERMNET_IAC) {
+        telnetState = TELNET_SUB_IAC;
+      }
+      break;
+    case TELNET_SUB_IAC:
+      telnetState = (byte == TERMNET_SE) ? TELNET_DATA : TELNET_SUB;
+      break;
+    case TELNET_ESC:
+      telnetState =
+          ((byte == '[') || (byte == 'O')) ? TELNET_CSI : TELNET_DATA;
+      break;
+    case TELNET_CSI:
+      if ((byte >= 0x40) && (byte <= 0x7E)) {
+        telnetState = TELNET_DATA;
+      }
+      break;
+    case TELNET_DATA:
+    default:
+      if (byte == TERMNET_IAC) {
+        telnetState = TELNET_IAC;
+      } else if (byte == TERM_ESC_CHAR) {
+        telnetState = TELNET_ESC;
+      } else if (byte == '\r') {
+        pushKey('\r');
+        telnetState = TELNET_CR;
+      } else if (byte == '\n') {
+        pushKey('\r');  // Clients that only send LF
+      } else if ((byte == '\b') || (byte == 0x7F)) {
+        pushKey('\b');
+      } else if ((byte >= TERM_KEYBOARD_KEY_START) &&
+                 (byte <= TERM_KEYBOARD_KEY_END)) {
+        pushKey((char)byte);
+      }
+      break;
+  }
+}
+
+static void closeClient(void) {
+  if (clientPcb == NULL) {
+    return;
+  }
+  tcp_arg(clientPcb, NULL);
+  tcp_recv(clientPcb, NULL);
+  tcp_err(clientPcb, NULL);
+  if (tcp_close(clientPcb) != ERR_OK) {
+    tcp_abort(clientPcb);
+  }
+  clientPcb = NULL;
+}
+
+static err_t termnetRecvCB(void *arg, struct tcp_pcb *pcb, struct pbuf *p,
+                           err_t err) {
+  if (p == NULL) {
+    DPRINTF("Terminal mirror client closed\n");
+    closeClient();
+    return ERR_OK;
+  }
+  for (struct pbuf *q = p; q != NULL; q = q->next) {
+    const uint8_t *data = (const uint8_t *)q->payload;
+    for (u16_t i = 0; i < q->len; i++) {
+      telnetByte(data[i]);
+    }
+  }
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+// The control block is already freed by lwIP
+static void termnetErrCB(void *arg, err_t err) {
+  DPRINTF("Terminal mirror client lost: %s\n", lwip_strerr(err));
+  clientPcb = NULL;
+}
+
+static err_t termnetAcceptCB(void *arg, struct tcp_pcb *newPcb, err_t err) {
+  if ((err != ERR_OK) || (newPcb == NULL)) {
+    return ERR_VAL;
+  }
+  if (time_us_64() < lockoutUntilUs) {
+    DPRINTF("Terminal mirror client refused after a wrong password\n");
+    tcp_abort(newPcb);
+    return ERR_ABRT;
+  }
+  closeClient();
+  clientPcb = newPcb;
+  tcp_recv(newPcb, termnetRecvCB);
+  tcp_err(newPcb, termnetErrCB);
+  tcp_nagle_disable(newPcb);
+  telnetState = TELNET_DATA;
+  inputTail = inputHead;
+  tcp_write(newPcb, telnetOptions, sizeof(telnetOptions),
+            TCP_WRITE_FLAG_COPY);
+  loginLen = 0;
+  if (mirrorPassword[0] != '\0') {
+    static const char prompt[] = "Password: ";
+    clientAccess = TERMNET_LOGIN;
+    tcp_write(newPcb, prompt, sizeof(prompt) - 1, TCP_WRITE_FLAG_COPY);
+  } else {
+    clientAccess = TERMNET_VIEW;
+  }
+  redraw = true;
+  DPRINTF("Terminal mirror client connected\n");
+  return ERR_OK;
+}
+
+int termnet_start(uint16_t port, const char *password) {
+  if (listenPcb != NULL) {
+    return 0;
+  }
+  if (password == NULL) {
+    password = "";
+  }
+  if (strlen(password) >= sizeof(mirrorPassword)) {
+    DPRINTF("The terminal mirror password is cut to %u characters\n",
+            (unsigned)(sizeof(mirrorPassword) - 1));
+  }
+  snprintf(mirrorPassword, sizeof(mirrorPassword), "%s", password);
+  cyw43_arch_lwip_begin();
+  struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+  if (pcb == NULL) {
+    cyw43_arch_lwip_end();
+    DPRINTF("Failed to allocate the terminal mirror control block.\n");
+    return -1;
+  }
+  err_t err = tcp_bind(pcb, IP_ANY_TYPE, port);
+  if (err != ERR_OK) {
+    tcp_close(pcb);
+    cyw43_arch_lwip_end();
+    DPRINTF("Cannot listen on the terminal mirror port: %s\n",
+            lwip_strerr(err));
+    return -1;
+  }
+  // The listening block is smaller. The first one is freed by lwIP
+  listenPcb = tcp_listen_with_backlog(pcb, 1);
+  if (listenPcb == NULL) {
+    tcp_close(pcb);
+    cyw43_arch_lwip_end();
+    DPRINTF("Cannot listen on the terminal mirror port.\n");
+    return -1;
+  }
+  tcp_accept(listenPcb, termnetAcceptCB);
+  cyw43_arch_lwip_end();
+  DPRINTF("Terminal mirror listening on port %u\n", port);
+  return 0;
+}
+
+bool termnet_isConnected(void) { return clientPcb != NULL; }
+
+static bool append(const char *data, size_t len) {
+  if (txLen + len > txLimit) {
+    return false;
+  }
+  memcpy(&txBuffer[txLen], data, len);
+  txLen += len;
+  return true;
+}
+
+static bool moveTo(int posX, int posY) {
+  if ((posX == remoteX) && (posY == remoteY)) {
+    return true;
+  }
+  char seq[12];
+  int len = snprintf(seq, sizeof(seq), "\x1b[%d;%dH", posY + 1, posX + 1);
+  if (!append(seq, (size_t)len)) {
+    return false;
+  }
+  remoteX = posX;
+  remoteY = posY;
+  return true;
+}
+
+// Character shown by the client for a cell
+static inline char cellChar(char chr) {
+  return ((chr >= TERM_KEYBOARD_KEY_START) && (chr <= TERM_KEYBOARD_KEY_END))
+             ? chr
+             : ' ';
+}
+
+// Adds the runs of changed cells of a row to the delta. If they do not fit,
+// nothing of the row is added and it is compared again in the next pass
+static bool addRow(int posY) {
+  const char *row = term_getRow((uint8_t)posY);
+  size_t startLen = txLen;
+  int startX = remoteX;
+  int startY = remoteY;
+  char sent[TERM_SCREEN_SIZE_X];
+  memcpy(sent, shadow[posY], sizeof(sent));
+  bool fits = true;
+  int posX = 0;
+  while (fits && (posX < TERM_SCREEN_SIZE_X)) {
+    if (cellChar(row[posX]) == shadow[posY][posX]) {
+      posX++;
+      continue;
+    }
+    // The run ends at the last change before a gap of unchanged cells too
+    // long to send
+    int last = posX;
+    for (int i = posX + 1;
+         (i < TERM_SCREEN_SIZE_X) && (i - last <= TERMNET_RUN_GAP); i++) {
+      if (cellChar(row[i]) != shadow[posY][i]) {
+        last = i;
+      }
+    }
+    for (int i = posX; i <= last; i++) {
+      sent[i] = cellChar(row[i]);
+    }
+    fits = moveTo(posX, posY) &&
+           append(&sent[posX], (size_t)(last - posX + 1));
+    // A client as wide as the screen wraps after the last column
+    remoteX = (last + 1 < TERM_SCREEN_SIZE_X) ? last + 1 : -1;
+    posX = last + 1;
+  }
+  if (!fits) {
+    txLen = startLen;
+    remoteX = startX;
+    remoteY = startY;
+    return false;
+  }
+  memcpy(shadow[posY], sent, sizeof(sent));
+  return true;
+}
+
+// Builds the delta of the screen. Returns true if all the rows are in it
+static bool buildDelta(void) {
+  if (redraw) {
+    static const char clear[] = "\x1b[2J";
+    if (!append(clear, sizeof(clear) - 1)) {
+      return false;
+    }
+    memset(shadow, ' ', sizeof(shadow));
+    remoteX = -1;
+    remoteY = -1;
+    redraw = false;
+  }
+  for (int posY = 0; posY < TERM_SCREEN_SIZE_Y; posY++) {
+    if (!addRow(posY)) {
+      return false;
+    }
+  }
+  uint8_t cursorX;
+  uint8_t cursorY;
+  term_getCursor(&cursorX, &cursorY);
+  return moveTo(cursorX, cursorY);
+}
+
+// Check the password typed by the client. Every byte is compared, so the
+// time does not tell how much of it was right
+static void checkLogin(void) {
+  size_t len = strlen(mirrorPassword);
+  uint8_t diff = (loginLen == len) ? 0 : 1;
+  for (size_t i = 0; i < len; i++) {
+    diff |= (uint8_t)(login[i] ^ mirrorPassword[i]);
+  }
+  memset(login, 0, sizeof(login));
+  loginLen = 0;
+  if (diff == 0) {
+    DPRINTF("Terminal mirror client logged in\n");
+    clientAccess = TERMNET_INPUT;
+    redraw = true;
+    return;
+  }
+  DPRINTF("Wrong terminal mirror password\n");
+  lockoutUntilUs = time_us_64() + TERMNET_LOGIN_LOCKOUT_MS * 1000ULL;
+  static const char wrong[] = "\r\nWrong password\r\n";
+  cyw43_arch_lwip_begin();
+  if (clientPcb != NULL) {
+    tcp_write(clientPcb, wrong, sizeof(wrong) - 1, TCP_WRITE_FLAG_COPY);
+    tcp_output(clientPcb);
+    closeClient();
+  }
+  cyw43_arch_lwip_end();
+}
+
+static void loginKey(char chr) {
+  if (chr == '\r') {
+    checkLogin();
+  } else if (chr == '\b') {
+    if (loginLen > 0) {
+      loginLen--;
+    }
+  } else if (loginLen < sizeof(login)) {
+    login[loginLen++] = chr;
+  }
+}
+
+void termnet_poll(bool radioOn, bool inputLive) {
+  if (listenPcb == NULL) {
+    return;
+  }
+  cyw43_arch_lwip_begin();
+  if (!radioOn) {
+    closeClient();
+    cyw43_arch_lwip_end();
+    return;
+  }
+  if (clientPcb == NULL) {
+    cyw43_arch_lwip_end();
+    return;
+  }
+  cyw43_arch_lwip_end();
+
+  // The keys land in the terminal as if typed in the computer, only after
+  // the password
+  while ((inputTail != inputHead) && (clientPcb != NULL)) {
+    char chr = inputRing[inputTail & TERMNET_INPUT_MASK];
+    inputTail++;
+    if (clientAccess == TERMNET_LOGIN) {
+      loginKey(chr);
+    } else if ((clientAccess == TERMNET_INPUT) && inputLive) {
+      term_remoteKey(chr);
+    }
+  }
+  if ((clientPcb == NULL) || (clientAccess == TERMNET_LOGIN)) {
+    return;
+  }
+
+  uint32_t serial = term_getOutputSerial();
+  if ((serial != lastSerial) || redraw) {
+    lastSerial = serial;
+    pending = true;
+  }
+  if (!pending) {
+    return;
+  }
+
+  cyw43_arch_lwip_begin();
+  if (clientPcb == NULL) {
+    cyw43_arch_lwip_end();
+    return;
+  }
+  txLen = 0;
+  txLimit = tcp_sndbuf(clientPcb);
+  if (txLimit > sizeof(txBuffer)) {
+    txLimit = sizeof(txBuffer);
+  }
+  bool done = buildDelta();
+  if (txLen > 0) {
+    err_t err =
+        tcp_write(clientPcb, txBuffer, (u16_t)txLen, TCP_WRITE_FLAG_COPY);
+    if (err == ERR_OK) {
+      tcp_output(clientPcb);
+    } else {
+      // The copy of the client is not known anymore. Draw it all again
+      DPRINTF("Cannot send the terminal delta: %s\n", lwip_strerr(err));
+      redraw = true;
+      done = false;
+    }
+  }
+  cyw43_arch_lwip_end();
+  pending = !done;
+}
@@ -0,0 +1,320 @@
+/**
+ * File: termscreen.c
+ * Author: Diego Parrilla Santamaría
+ * Date: January 2025
+ * Copyright: 2025 - GOODDATA LABS
+ * Description: Screen of the terminal and its VT52 escape sequences
+ */
+
+#include "termscreen.h"
+
+// Circular buffer of rows. The screen starts at screenHead and the rows
+// before it are the scrollback
+static char screen[TERM_SCREEN_RING_ROWS * TERM_SCREEN_SIZE_X];
+static uint16_t screenHead = 0;
+static uint8_t cursorX = 0;
+static uint8_t cursorY = 0;
+
+// Character at a position of the screen
+static inline char *termCell(int posX, int posY) {
+  return &screen[((screenHead + posY) % TERM_SCREEN_RING_ROWS) *
+                     TERM_SCREEN_SIZE_X +
+                 posX];
+}
+
+// Incremented each time a block of output lands on the screen
+static uint32_t outputSerial = 0;
+
+// Store previous cursor position for block removal
+static uint8_t prevCursorX = 0;
+static uint8_t prevCursorY = 0;
+
+// Clears entire screen buffer and resets cursor
+void term_clearScreen(void) {
+  memset(screen, 0, sizeof(screen));
+  screenHead = 0;
+  cursorX = 0;
+  cursorY = 0;
+  display_termClear();
+  outputSerial++;
+}
+
+// Scrolls the screen up by one row. The top row goes to the scrollback
+static void termScrollUp(void) {
+  screenHead = (screenHead + 1) % TERM_SCREEN_RING_ROWS;
+  memset(termCell(0, TERM_SCREEN_SIZE_Y - 1), 0, TERM_SCREEN_SIZE_X);
+  display_scrollBands();
+}
+
+// Prints a character to the screen, handles scrolling
+static void termPutChar(char chr) {
+  *termCell(cursorX, cursorY) = chr;
+  display_termChar(cursorX, cursorY, chr);
+  cursorX++;
+  if (cursorX >= TERM_SCREEN_SIZE_X) {
+    cursorX = 0;
+    cursorY++;
+    if (cursorY >= TERM_SCREEN_SIZE_Y) {
+      termScrollUp();
+      cursorY = TERM_SCREEN_SIZE_Y - 1;
+    }
+  }
+}
+
+// Nesting of term_beginOutput(). The cursor is hidden while not zero
+static uint8_t outputDepth = 0;
+
+// Remove the block by restoring the character under it
+static void termHideCursor(void) {
+  char chr = *termCell(prevCursorX, prevCursorY);
+  display_termChar(prevCursorX, prevCursorY, chr ? chr : ' ');
+}
+
+// Draw the block at the cursor position
+static void termShowCursor(void) {
+  display_termCursor(cursorX, cursorY);
+  prevCursorX = cursorX;
+  prevCursorY = cursorY;
+}
+
+// Refresh the display, unless we are in the middle of a block of output
+void term_refresh(void) {
+  if (outputDepth == 0) {
+    display_termRefresh();
+    outputSerial++;
+  }
+}
+
+void term_beginOutput(void) {
+  if (outputDepth++ == 0) {
+    termHideCursor();
+  }
+}
+
+void term_endOutput(void) {
+  if (outputDepth == 0) {
+    return;
+  }
+  if (--outputDepth == 0) {
+    termShowCursor();
+    display_termRefresh();
+    outputSerial++;
+  }
+}
+
+uint32_t term_getOutputSerial(void) { return outputSerial; }
+
+const char *term_getRow(uint8_t posY) { return termCell(0, posY); }
+
+void term_getCursor(uint8_t *posX, uint8_t *posY) {
+  *posX = cursorX;
+  *posY = cursorY;
+}
+
+// Renders a single character, with special handling for newline and carriage
+// return. The cursor only moves out of a block of output
+void term_renderChar(char chr) {
+  // First, remove the old block by restoring the character
+  if (outputDepth == 0) {
+    termHideCursor();
+  }
+  if (chr == '\n' || chr == '\r') {
+    // Move to new line
+    cursorX = 0;
+    cursorY++;
+    if (cursorY >= TERM_SCREEN_SIZE_Y) {
+      termScrollUp();
+      cursorY = TERM_SCREEN_SIZE_Y - 1;
+    }
+  } else if (chr != '\0') {
+    termPutChar(chr);
+  }
+
+  // Draw a block at the new cursor position
+  if (outputDepth == 0) {
+    termShowCursor();
+  }
+}
+
+// Prints entire screen to stdout
+static void termPrintScreen(void) {
+  for (int posY = 0; posY < TERM_SCREEN_SIZE_Y; posY++) {
+    for (int posX = 0; posX < TERM_SCREEN_SIZE_X; posX++) {
+      char chr = *termCell(posX, posY);
+      putchar(chr ? chr : ' ');
+    }
+    putchar('\n');
+  }
+}
+
+/**
+ * @brief Processes a complete VT52 escape sequence.
+ *
+ * This function interprets the VT52 sequence stored in `seq` (with given
+ * length) and performs the corresponding cursor movements. Modify the TODO
+ * sections to implement additional features as needed.
+ *
+ * @param seq Pointer to the escape sequence buffer.
+ * @param length The length of the escape sequence.
+ */
+static void vt52ProcessSequence(const char *seq, size_t length) {
+  // Ensure we have at least an ESC and a command character.
+  if (length < 2) return;
+
+  char command = seq[1];
+  switch (command) {
+    case 'A':  // Move cursor up
+      // TODO(diego): Improve behavior if needed.
+      if (cursorY > 0) {
+        cursorY--;
+      }
+      term_renderChar('\0');
+      break;
+    case 'B':  // Move cursor down
+      if (cursorY < TERM_SCREEN_SIZE_Y - 1) {
+        cursorY++;
+      }
+      term_renderChar('\0');
+      break;
+    case 'C':  // Move cursor right
+      if (cursorX < TERM_SCREEN_SIZE_X - 1) {
+        cursorX++;
+      }
+      term_renderChar('\0');
+      break;
+    case 'D':  // Move cursor left
+      if (cursorX > 0) {
+        cursorX--;
+      }
+      term_renderChar('\0');
+      break;
+    case 'E':  // Clear screen and place cursor at top left corner
+      cursorX = 0;
+      cursorY = 0;
+      term_renderChar('\0');
+      for (int posY = 0; posY < TERM_SCREEN_SIZE_Y; posY++) {
+        for (int posX = 0; posX < TERM_SCREEN_SIZE_X; posX++) {
+          *termCell(posX, posY) = 0;
+          display_termChar(posX, posY, ' ');
+        }
+      }
+      break;
+    case 'H':  // Cursor home
+      cursorX = 0;
+      cursorY = 0;
+      term_renderChar('\0');
+      break;
+    case 'J':  // Erases from the current cursor position to the end of the
+               // screen
+      for (int posY = cursorY; posY < TERM_SCREEN_SIZE_Y; posY++) {
+        for (int posX = cursorX; posX < TERM_SCREEN_SIZE_X; posX++) {
+          *termCell(posX, posY) = 0;
+          display_termChar(posX, posY, ' ');
+        }
+      }
+      break;
+    case 'K':  // Clear to end of line
+      for (int posX = cursorX; posX < TERM_SCREEN_SIZE_X; posX++) {
+        *termCell(posX, cursorY) = 0;
+        display_termChar(posX, cursorY, ' ');
+      }
+      break;
+    case 'Y':  // Direct cursor addressing: ESC Y <row> <col>
+      if (length == 4) {
+        int row = seq[2] - TERM_POS_Y;
+        int col = seq[3] - TERM_POS_X;
+        if (row >= 0 && row < TERM_SCREEN_SIZE_Y && col >= 0 &&
+            col < TERM_SCREEN_SIZE_X) {
+          cursorY = row;
+          cursorX = col;
+        }
+        term_renderChar('\0');
+      }
+      break;
+    default:
+      // Unrecognized sequence. Optionally, print or ignore.
+      // For now, we'll ignore it.
+      break;
+  }
+}
+
+void term_printString(const char *str) {
+  enum { STATE_NORMAL, STATE_ESC } state = STATE_NORMAL;
+  char escBuffer[TERM_ESC_BUFFLINE_SIZE];
+  size_t escLen = 0;
+
+  // The whole string is one block: the cursor moves once
+  term_beginOutput();
+
+  while (*str) {
+    char chr = *str;
+    if (state == STATE_NORMAL) {
+      if (chr == TERM_ESC_CHAR) {  // ESC character detected
+        state = STATE_ESC;
+        escLen = 0;
+        escBuffer[escLen++] = chr;
+      } else {
+        term_renderChar(chr);
+      }
+    } else {  // STATE_ESC: we're accumulating an escape sequence
+      escBuffer[escLen++] = chr;
+      // Check for sequence completion:
+      // Most VT52 sequences are two characters (ESC + command)...
+      if (escLen == 2) {
+        if (escBuffer[1] == 'Y') {
+          // ESC Y requires two more characters (for row and col)
+          // Do nothing now—wait until esc_len == 4.
+        } else {
+          // Sequence complete (ESC + single command)
+          vt52ProcessSequence(escBuffer, escLen);
+          state = STATE_NORMAL;
+        }
+      } else if (escBuffer[1] == 'Y' && escLen == 4) {
+        // ESC Y <row> <col> sequence complete
+        vt52ProcessSequence(escBuffer, escLen);
+        state = STATE_NORMAL;
+      }
+      // In case the buffer gets too long, flush it as normal text
+      if (escLen >= sizeof(escBuffer)) {
+        for (size_t i = 0; i < escLen; i++) {
+          term_renderChar(escBuffer[i]);
+        }
+        state = STATE_NORMAL;
+      }
+    }
+    str++;
+  }
+  // If the string ends while still in ESC state, flush the buffered
+  // characters as normal text.
+  if (state == STATE_ESC) {
+    for (size_t i = 0; i < escLen; i++) {
+      term_renderChar(escBuffer[i]);
+    }
+  }
+  term_endOutput();
+}
+
+// Removes the cursor block and, if asked, the character before it
+void term_backspace(bool erase) {
+  display_termChar(prevCursorX, prevCursorY, ' ');
+  if (erase) {
+    if (cursorX == 0) {
+      if (cursorY > 0) {
+        cursorY--;
+        cursorX = TERM_SCREEN_SIZE_X - 1;
+      } else {
+        // already top-left corner
+        return;
+      }
+    } else {
+      cursorX--;
+    }
+    *termCell(cursorX, cursorY) = 0;
+    display_termChar(cursorX, cursorY, ' ');
+  }
+
+  display_termCursor(cursorX, cursorY);
+  prevCursorX = cursorX;
+  prevCursorY = cursorY;
+  term_refresh();
+}
@@ -0,0 +1,65 @@
+/**
+ * File: trace.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: Binary trace ring for the time critical code
+ */
+
+#include "trace.h"
+
+#include "telemetry.h"
+
+#if defined(_DEBUG) && (_DEBUG != 0)
+// The records go to the USB telemetry channel if there is one
+#if USB_TELEMETRY == 1
+#define TRACE_PRINTF(fmt, ...) TELEMETRY_PRINTF(fmt, ##__VA_ARGS__)
+#else
+#define TRACE_PRINTF(fmt, ...) DPRINTFRAW(fmt, ##__VA_ARGS__)
+#endif
+
+TraceRing traceRings[NUM_CORES] = {0};
+
+// Names of the events, in the order of TraceEvent
+static const char *traceEventNames[TRACE_EVENTS] = {
+    "DMA_LOOKUP",    "DMA_ADDRESS", "CHECKSUM_ERROR",  "COMMAND",
+    "COMMAND_PARAM", "SHARED_VAR",  "UNKNOWN_COMMAND",
+};
+
+void trace_dump(void) {
+  int printed = 0;
+  for (uint core = 0; core < NUM_CORES; core++) {
+    TraceRing *ring = &traceRings[core];
+    uint32_t head = ring->head;
+    // The writer went a full lap ahead: skip the records overwritten
+    if (head - ring->tail > TRACE_RING_SIZE) {
+      ring->lost += head - ring->tail - TRACE_RING_SIZE;
+      ring->tail = head - TRACE_RING_SIZE;
+    }
+    while ((ring->tail != head) && (printed < TRACE_DUMP_MAX)) {
+      const TraceRecord *slot = &ring->records[ring->tail & TRACE_RING_MASK];
+      TraceRecord record = *slot;
+      __dmb();
+      // Overwritten while it was copied
+      if ((record.seq != ring->tail) || (slot->seq != ring->tail)) {
+        ring->lost++;
+        ring->tail++;
+        continue;
+      }
+      const char *name = (record.event < TRACE_EVENTS)
+                             ? traceEventNames[record.event]
+                             : "UNKNOWN";
+      TRACE_PRINTF("[%10" PRIu32 "] C%u %-15s 0x%08" PRIX32 " 0x%08" PRIX32
+                   "\n",
+                   record.timestamp, core, name, record.arg0, record.arg1);
+      ring->tail++;
+      printed++;
+    }
+    if (ring->lost != 0) {
+      TRACE_PRINTF("Trace core %u: %" PRIu32 " records lost\n", core,
+                   ring->lost);
+      ring->lost = 0;
+    }
+  }
+}
+#endif
@@ -0,0 +1,220 @@
+/**
+ * File: tzrules.c
+ * Author: Diego Parrilla Santamaría
+ * Date: October 2026
+ * Copyright: 2026 - GOODDATA LABS SL
+ * Description: POSIX TZ strings compiled into a table of transitions
+ */
+
+#include "tzrules.h"
+
+#define TZRULES_SECS_DAY 86400
+#define TZRULES_DEFAULT_TIME 7200  // The changes are at 02:00 by default
+
+// Days since 1970 of a civil date, with the year starting in March
+static int32_t daysFromCivil(int year, int month, int day) {
+  year -= (month <= 2);
+  int era = (year >= 0 ? year : year - 399) / 400;
+  int yoe = year - era * 400;
+  int mp = month + (month > 2 ? -3 : 9);
+  int doy = (153 * mp + 2) / 5 + day - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static bool isLeap(int year) {
+  return ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+}
+
+static int yearOf(uint32_t utc) {
+  // Civil date from the days, see daysFromCivil()
+  int32_t z = (int32_t)(utc / TZRULES_SECS_DAY) + 719468;
+  int era = z / 146097;
+  int doe = z - era * 146097;
+  int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int mp = (5 * doy + 2) / 153;
+  return yoe + era * 400 + (mp >= 10);
+}
+
+// Name of a zone: three letters or more, or any text between < and >
+static const char *parseName(const char *tz) {
+  const char *start = tz;
+  if (*tz == '<') {
+    const char *end = strchr(tz, '>');
+    return ((end == NULL) || (end - tz < 4)) ? NULL : end + 1;
+  }
+  while (((*tz >= 'A') && (*tz <= 'Z')) || ((*tz >= 'a') && (*tz <= 'z'))) {
+    tz++;
+  }
+  return (tz - start < 3) ? NULL : tz;
+}
+
+// [+|-]hh[:mm[:ss]]
+static const char *parseTime(const char *tz, int32_t *secs) {
+  int sign = 1;
+  if ((*tz == '+') || (*tz == '-')) {
+    sign = (*tz == '-') ? -1 : 1;
+    tz++;
+  }
+  if ((*tz < '0') || (*tz > '9')) {
+    return NULL;
+  }
+  char *end;
+  int32_t value = (int32_t)strtol(tz, &end, 10) * 3600;
+  for (int32_t unit = 60; (*end == ':') && (unit > 0); unit /= 60) {
+    tz = end + 1;
+    value += (int32_t)strtol(tz, &end, 10) * unit;
+    if (end == tz) {
+      return NULL;
+    }
+  }
+  *secs = sign * value;
+  return end;
+}
+
+// Mm.w.d, Jn or n, and an optional /time
+static const char *parseChange(const char *tz, TzRulesChange *change) {
+  char *end;
+  if (*tz == 'M') {
+    change->kind = TZRULES_MONTH_WEEK_DAY;
+    change->month = (int16_t)strtol(tz + 1, &end, 10);
+    if ((*end != '.') || (change->month < 1) || (change->month > 12)) {
+      return NULL;
+    }
+    change->week = (int16_t)strtol(end + 1, &end, 10);
+    if ((*end != '.') || (change->week < 1) || (change->week > 5)) {
+      return NULL;
+    }
+    change->day = (int16_t)strtol(end + 1, &end, 10);
+    if ((change->day < 0) || (change->day > 6)) {
+      return NULL;
+    }
+  } else if ((*tz == 'J') || ((*tz >= '0') && (*tz <= '9'))) {
+    bool julian = (*tz == 'J');
+    change->kind = julian ? TZRULES_JULIAN_NO_LEAP : TZRULES_JULIAN;
+    change->day = (int16_t)strtol(julian ? tz + 1 : tz, &end, 10);
+    if ((change->day < (julian ? 1 : 0)) || (change->day > 365)) {
+      return NULL;
+    }
+  } else {
+    return NULL;
+  }
+  change->time = TZRULES_DEFAULT_TIME;
+  if (*end == '/') {
+    return parseTime(end + 1, &change->time);
+  }
+  return end;
+}
+
+int tzrules_parse(const char *tz, TzRules *rules) {
+  memset(rules, 0, sizeof(TzRules));
+  rules->nextAt = TZRULES_NEVER;
+  int32_t secs;
+  if (((tz = parseName(tz)) == NULL) ||
+      ((tz = parseTime(tz, &secs)) == NULL)) {
+    return -1;
+  }
+  // POSIX counts the hours west of UTC
+  rules->stdOffset = -secs;
+  rules->dstOffset = rules->stdOffset;
+  if (*tz == '\0') {
+    return 0;
+  }
+  if ((tz = parseName(tz)) == NULL) {
+    return -1;
+  }
+  rules->hasDst = true;
+  rules->dstOffset = rules->stdOffset + 3600;
+  if ((*tz != ',') && (*tz != '\0')) {
+    if ((tz = parseTime(tz, &secs)) == NULL) {
+      return -1;
+    }
+    rules->dstOffset = -secs;
+  }
+  if (*tz == '\0') {
+    // The rules of the United States since 2007
+    tz = ",M3.2.0,M11.1.0";
+  }
+  if ((*tz != ',') || ((tz = parseChange(tz + 1, &rules->start)) == NULL) ||
+      (*tz != ',') || ((tz = parseChange(tz + 1, &rules->end)) == NULL)) {
+    return -1;
+  }
+  return (*tz == '\0') ? 0 : -1;
+}
+
+// UTC instant of a change in a year. offset is the one in force before it
+static uint32_t changeAt(const TzRulesChange *change, int year,
+                         int32_t offset) {
+  int32_t days;
+  if (change->kind == TZRULES_MONTH_WEEK_DAY) {
+    static const uint8_t monthDays[] = {31, 28, 31, 30, 31, 30,
+                                        31, 31, 30, 31, 30, 31};
+    days = daysFromCivil(year, change->month, 1);
+    // January 1 1970 was a Thursday
+    int firstDay = (int)((days + 4) % 7);
+    int day = 1 + (change->day - firstDay + 7) % 7 + (change->week - 1) * 7;
+    int length = monthDays[change->month - 1] +
+                 (((change->month == 2) && isLeap(year)) ? 1 : 0);
+    while (day > length) {
+      day -= 7;  // Week 5 is the last week of the month
+    }
+    days += day - 1;
+  } else {
+    days = daysFromCivil(year, 1, 1) + change->day;
+    if (change->kind == TZRULES_JULIAN_NO_LEAP) {
+      days += ((change->day > 59) && isLeap(year)) ? 0 : -1;
+    }
+  }
+  int64_t at = (int64_t)days * TZRULES_SECS_DAY + change->time - offset;
+  return (at < 0) ? 0 : (uint32_t)at;
+}
+
+static void buildTable(TzRules *rules, int firstYear) {
+  rules->count = 0;
+  rules->firstYear = firstYear;
+  for (int year = firstYear; year < firstYear + TZRULES_YEARS; year++) {
+    TzRulesTransition changes[2] = {
+        {changeAt(&rules->start, year, rules->stdOffset), rules->dstOffset},
+        {changeAt(&rules->end, year, rules->dstOffset), rules->stdOffset}};
+    // The southern hemisphere ends the daylight saving time first
+    if (changes[1].at < changes[0].at) {
+      TzRulesTransition swap = changes[0];
+      changes[0] = changes[1];
+      changes[1] = swap;
+    }
+    rules->transitions[rules->count++] = changes[0];
+    rules->transitions[rules->count++] = changes[1];
+  }
+  rules->next = 0;
+  DPRINTF("Time zone table from %d to %d\n", firstYear,
+          firstYear + TZRULES_YEARS - 1);
+}
+
+int32_t tzrules_offsetAt(TzRules *rules, uint32_t utc) {
+  if (!rules->hasDst) {
+    return rules->stdOffset;
+  }
+  if ((rules->count == 0) ||
+      (utc >= rules->transitions[rules->count - 1].at) ||
+      ((utc < rules->transitions[0].at) &&
+       (yearOf(utc) < rules->firstYear))) {
+    buildTable(rules, yearOf(utc));
+  }
+  if ((rules->next > 0) && (utc < rules->transitions[rules->next - 1].at)) {
+    rules->next = 0;  // The clock went back
+  }
+  while ((rules->next < rules->count) &&
+         (utc >= rules->transitions[rules->next].at)) {
+    rules->next++;
+  }
+  rules->nextAt = (rules->next < rules->count)
+                      ? rules->transitions[rules->next].at
+                      : TZRULES_NEVER;
+  if (rules->next > 0) {
+    return rules->transitions[rules->next - 1].offset;
+  }
+  // Before the first transition, the offset is the one it ends
+  return (rules->transitions[0].offset == rules->dstOffset) ? rules->stdOffset
+                                                            : rules->dstOffset;
+}
@@ -3,6 +3,13 @@ import os
 import argparse
 
 MAX_WORDS_PER_LINE = 16  # This results in 32 bytes per line
+MAX_BYTES_PER_LINE = 32
+
+# LZ4 block format limits
+LZ4_MIN_MATCH = 4
+LZ4_LAST_LITERALS = 5  # The last bytes are always literals
+LZ4_MATCH_LIMIT = 12  # The last match starts before the last 12 bytes
+LZ4_MAX_OFFSET = 65535
 
 
 def read_binary_from_file(file_path):
@@ -10,7 +17,68 @@ def read_binary_from_file(file_path):
         return file.read()
 
 
-def binary_to_c_array(input_source, output_file, array_name, endian_format="little"):
+def lz4_write_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def lz4_write_sequence(out, literals, offset, match_length):
+    literal_length = len(literals)
+    extra_match = match_length - LZ4_MIN_MATCH if match_length else 0
+    out.append((min(literal_length, 15) << 4) | min(extra_match, 15))
+    if literal_length >= 15:
+        lz4_write_length(out, literal_length - 15)
+    out += literals
+    if match_length:
+        out += offset.to_bytes(2, "little")
+        if extra_match >= 15:
+            lz4_write_length(out, extra_match - 15)
+
+
+def lz4_compress(data):
+    """Compress the data as a single LZ4 block, without frame header."""
+    out = bytearray()
+    last_seen = {}
+    anchor = 0
+    pos = 0
+    limit = len(data) - LZ4_MATCH_LIMIT
+    while pos < limit:
+        key = data[pos : pos + LZ4_MIN_MATCH]
+        candidate = last_seen.get(key)
+        last_seen[key] = pos
+        if candidate is None or pos - candidate > LZ4_MAX_OFFSET:
+            pos += 1
+            continue
+        max_length = len(data) - LZ4_LAST_LITERALS - pos
+        length = LZ4_MIN_MATCH
+        while length < max_length and data[candidate + length] == data[pos + length]:
+            length += 1
+        lz4_write_sequence(out, data[anchor:pos], pos - candidate, length)
+        pos += length
+        anchor = pos
+    lz4_write_sequence(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def words_to_bytes(words):
+    # The bytes of the words as they are in the memory of the RP2040
+    return b"".join(word.to_bytes(2, "little") for word in words)
+
+
+def bytes_to_c_array(data, array_name):
+    content = f"const uint8_t {array_name}[] = {{\n"
+    for i in range(0, len(data), MAX_BYTES_PER_LINE):
+        chunk = data[i : i + MAX_BYTES_PER_LINE]
+        content += "    " + ", ".join(f"0x{byte:02X}" for byte in chunk) + ",\n"
+    content = content.rstrip(",\n") + "\n};\n"
+    return content
+
+
+def binary_to_c_array(
+    input_source, output_file, array_name, endian_format="little", compress="none"
+):
     offset = 0
 
     data = read_binary_from_file(input_source)
@@ -32,23 +100,33 @@ def binary_to_c_array(input_source, output_file, array_name, endian_format="litt
     if len(trimmed_data) % 2 != 0:
         raise ValueError("The binary file size (after trimming zeros) should be an even number of bytes for word processing.")
 
-    # Prepare the output content
-    content = f"const uint16_t {array_name}[] = {{\n"
-
-    # Convert trimmed data to comma-separated hex values with MAX_WORDS_PER_LINE words per line
-    for i in range(offset, len(trimmed_data) - offset, 2 * MAX_WORDS_PER_LINE):
-        chunk = trimmed_data[i : i + 2 * MAX_WORDS_PER_LINE]
-
-        if endian_format == "big":
-            words = [chunk[j] + (chunk[j + 1] << 8) for j in range(0, len(chunk), 2)]
-        else:  # little endian
-            words = [(chunk[j] << 8) + chunk[j + 1] for j in range(0, len(chunk), 2)]
+    # Convert the trimmed data to the words of the ROM
+    if endian_format == "big":
+        words = [trimmed_data[j] + (trimmed_data[j + 1] << 8) for j in range(0, len(trimmed_data), 2)]
+    else:  # little endian
+        words = [(trimmed_data[j] << 8) + trimmed_data[j + 1] for j in range(0, len(trimmed_data), 2)]
+
+    if compress == "lz4":
+        # The firmware decompresses the block straight into the RAM of the ROM
+        image = words_to_bytes(words)
+        compressed = lz4_compress(image)
+        content = f"#define {array_name.upper()}_LZ4 1\n"
+        content += bytes_to_c_array(compressed, f"{array_name}_lz4")
+        content += f"uint32_t {array_name}_lz4_length = sizeof({array_name}_lz4);\n"
+        content += f"uint32_t {array_name}_size = {len(image)};  // Bytes once decompressed\n\n"
+        print(f"LZ4 compressed {len(image)} bytes to {len(compressed)} bytes")
+    else:
+        # Prepare the output content
+        content = f"const uint16_t {array_name}[] = {{\n"
 
-        content += "    " + ", ".join(f"0x{word:04X}" for word in words) + ",\n"
+        # Comma-separated hex values with MAX_WORDS_PER_LINE words per line
+        for i in range(offset, len(words), MAX_WORDS_PER_LINE):
+            chunk = words[i : i + MAX_WORDS_PER_LINE]
+            content += "    " + ", ".join(f"0x{word:04X}" for word in chunk) + ",\n"
 
-    # Remove the trailing comma and add closing brace
-    content = content.rstrip(",\n") + "\n};\n"
-    content += f"uint16_t {array_name}_length = sizeof({array_name}) / sizeof({array_name}[0]);\n\n"
+        # Remove the trailing comma and add closing brace
+        content = content.rstrip(",\n") + "\n};\n"
+        content += f"uint16_t {array_name}_length = sizeof({array_name}) / sizeof({array_name}[0]);\n\n"
 
     # Write to output .h file
     with open(output_file, "w") as f:
@@ -85,11 +163,19 @@ if __name__ == "__main__":
         default="little",
         help="Endianness of the words in the output array ('little' or 'big').",
     )
+    parser.add_argument(
+        "--compress",
+        required=False,
+        default="none",
+        choices=["none", "lz4"],
+        help="Compress the firmware as a LZ4 block ('none' or 'lz4').",
+    )
 
     args = parser.parse_args()
     array_name = args.array_name
     output_file = args.output
     input_source = args.input
     endian_format = args.endian_format
+    compress = args.compress
 
-    binary_to_c_array(input_source, output_file, array_name, endian_format)
+    binary_to_c_array(input_source, output_file, array_name, endian_format, compress)
@@ -6,12 +6,17 @@ COOKIE_JAR_MEGASTE                      equ $00010010 ; Mega STE computer
 SHARED_VARIABLE_SHARED_FUNCTIONS_SIZE   equ 16      ; Size of the shared variables for the shared functions
 SHARED_VARIABLE_HARDWARE_TYPE           equ 0       ; Hardware type of the Atari ST computer
 SHARED_VARIABLE_SVERSION                equ 1       ; TOS version from Sversion
+PROTOCOL_CAP_CRC16                      equ 0       ; Capability bit: the frames end with a CRC-16/CCITT
+SHARED_VARIABLE_SYNC_TIMEOUT            equ 3       ; Iterations of the sync wait loop. 0 until calibrated
+SHARED_VARIABLE_RESIDENT_ADDR           equ 4       ; Address of the resident code in RAM. 0 if it runs from the ROM
+_hz_200                                 equ $4ba    ; 200 Hz system timer
+SYNC_TIMEOUT_CALIBRATION_TICKS          equ 4       ; Measure the wait loop during 20 ms
+SYNC_TIMEOUT_CALIBRATION_BLOCK          equ 256     ; Iterations of the wait loop between timer checks
+SYNC_TIMEOUT_CALIBRATION_SCALE          equ 250     ; 250 times 20 ms: the timeout is 5 seconds
 
 COMMAND_SYNC_CODE_SIZE                  equ (4 + _end_sync_code_in_stack - _start_sync_code_in_stack)
 
 ; Detect the hardware of the computer we are running on
-; This code checks for the cookie-jar and reads the _MCH cookie to determine the hardware
-; If the cookie-jar is not present, we assume it's an old machine before 1.06
 ; It writes the value in the shared variable SHARED_VARIABLE_HARDWARE_TYPE
 ;
 ; Inputs:
@@ -20,27 +25,106 @@ COMMAND_SYNC_CODE_SIZE                  equ (4 + _end_sync_code_in_stack - _star
 ; Outputs:
 ;   d0.l contains the hardware type as stored in the shared variable SHARED_VARIABLE_HARDWARE_TYPE
 detect_hw:
-	move.l _p_cookies.w,d0      ; Check the cookie-jar to know what type of machine we are running on
-	beq _old_hardware           ; No cookie-jar, so it's a TOS <= 1.04
+    bsr calibrate_sync_timeout
+    bsr read_hw_type
+    move.l d0, -(sp)            ; Save the hardware type    
+    move.l #SHARED_VARIABLE_HARDWARE_TYPE, d3   ; D3 Variable index
+    move.l d0, d4                               ; D4 Variable value
+    send_sync CMD_SET_SHARED_VAR, 8
+    move.l (sp)+, d0            ; Restore the hardware type in d0.l as result
+    rts
+
+; Measure the speed of the sync wait loop against the 200 Hz timer, so the timeout
+; is the same time in all the CPUs. It writes the iterations of the loop in the shared
+; variable SHARED_VARIABLE_SYNC_TIMEOUT, used by the sync commands from now on
+; Never shorter than the default timeout of a stock ST
+;
+; Inputs:
+;   None
+;
+; Outputs:
+;   d0: error code, 0 if no error
+calibrate_sync_timeout:
+    lea RANDOM_TOKEN_ADDR, a1
+    move.l (a1), d2
+    not.l d2                    ; Never matches the token, like a command that never completes
+    move.l _hz_200.w, d3
+_calibrate_sync_edge:
+    cmp.l _hz_200.w, d3         ; Start at the beginning of a timer tick
+    beq.s _calibrate_sync_edge
+    move.l _hz_200.w, d3
+    addq.l #SYNC_TIMEOUT_CALIBRATION_TICKS, d3
+    moveq #0, d4                ; Blocks of iterations measured
+_calibrate_sync_block:
+    move.l #SYNC_TIMEOUT_CALIBRATION_BLOCK, d7
+_calibrate_sync_loop:
+    cmp.l (a1), d2              ; Same loop as the sync wait code
+    beq.s _calibrate_sync_next
+    subq.l #1, d7
+    bne.s _calibrate_sync_loop
+_calibrate_sync_next:
+    addq.l #1, d4
+    cmp.l _hz_200.w, d3
+    bhi.s _calibrate_sync_block
+
+    mulu.w #(SYNC_TIMEOUT_CALIBRATION_BLOCK * SYNC_TIMEOUT_CALIBRATION_SCALE), d4
+    cmp.l #SYNC_TIMEOUT_DEFAULT, d4
+    bcc.s _calibrate_sync_save
+    move.l #SYNC_TIMEOUT_DEFAULT, d4
+_calibrate_sync_save:
+    move.l #SHARED_VARIABLE_SYNC_TIMEOUT, d3    ; D3 Variable index
+                                                ; D4 Variable value
+    send_sync CMD_SET_SHARED_VAR, 8
+    rts
+
+; Read the hardware type of the computer we are running on
+; This code checks for the cookie-jar and reads the _MCH cookie to determine the hardware
+; If the cookie-jar is not present, we assume it's an old machine before 1.06
+;
+; Inputs:
+;   None
+;
+; Outputs:
+;   d0.l contains the hardware type
+read_hw_type:
+    move.l #'_MCH',d1           ; Machine type. 0 for an Atari ST (260 ST,520 ST,1040 ST,Mega ST,...)
+    bra.s read_cookie
+
+; Read the CPU of the computer we are running on
+; If the cookie-jar is not present, we assume it's a 68000
+;
+; Inputs:
+;   None
+;
+; Outputs:
+;   d0.l contains the value of the _CPU cookie: 0, 10, 20, 30, 40 or 60
+read_cpu_type:
+    move.l #'_CPU',d1
+;   Fall through to read the cookie
+
+; Read the value of a cookie
+;
+; Inputs:
+;   d1.l name of the cookie
+;
+; Outputs:
+;   d0.l contains the value of the cookie, 0 if not found or if there is no cookie-jar
+read_cookie:
+	move.l _p_cookies.w,d0      ; Check the cookie-jar
+	beq.s _no_cookie            ; No cookie-jar, so it's a TOS <= 1.04
 	movea.l d0,a0               ; Get the address of the cookie-jar
 _loop_cookie:
-	move.l (a0)+,d0             ; The cookie jar value is zero, so old hardware again
-	beq _old_hardware
-	cmp.l #'_MCH',d0            ; Is it the _MCH cookie?
-	beq.s _found_cookie         ; Yes, so we found the machine type
-	addq.w #4,a0                ; No, so skip the cookie name
+	move.l (a0)+,d0             ; The cookie jar value is zero, so the cookie is not there
+	beq.s _no_cookie
+	cmp.l d1,d0                 ; Is it the cookie?
+	beq.s _found_cookie         ; Yes, so we found the value
+	addq.w #4,a0                ; No, so skip the cookie value
 	bra.s _loop_cookie          ; And try the next cookie
 _found_cookie:
-	move.l	(a0)+,d4            ; Get the cookie value
-	bra.s	_save_hw
-_old_hardware:
-    clr.l d4                    ; 0x0000	0x0000	Atari ST (260 ST,520 ST,1040 ST,Mega ST,...)
-_save_hw:
-    move.l d4, -(sp)            ; Save the hardware type    
-    move.l #SHARED_VARIABLE_HARDWARE_TYPE, d3   ; D3 Variable index
-                                                ; D4 Variable value
-    send_sync CMD_SET_SHARED_VAR, 8
-    move.l (sp)+, d0            ; Restore the hardware type in d0.l as result
+	move.l	(a0),d0             ; Get the cookie value
+	rts
+_no_cookie:
+    clr.l d0
     rts
 
 ; Get the TOS version
@@ -51,6 +135,20 @@ _save_hw:
 ; Outputs:
 ;   None
 get_tos_version:
+    bsr read_tos_version
+    move.l #SHARED_VARIABLE_SVERSION, d3    ; Variable index
+    move.l d0, d4                           ; Variable value
+    send_sync CMD_SET_SHARED_VAR, 8
+    rts
+
+; Read the TOS version
+; This code reads the TOS version from GEMDOS and the ROM
+;
+; Inputs:
+;   None
+; Outputs:
+;   d0.l contains the TOS version in the upper word and the GEMDOS version in the lower word
+read_tos_version:
     gemdos Sversion, 2
     and.l #$FFFF,d0
     cmp.w #$FC, $4.w            ; Check if the TOS version is a 192Kb or 256Kb
@@ -65,9 +163,6 @@ get_tos_version:
     and.l #$FFFF,d1             ; Mask the upper word
     swap d1
     or.l d1, d0                 ; Set the TOS version in the upper word of d0
-    move.l #SHARED_VARIABLE_SVERSION, d3    ; Variable index
-    move.l d0, d4                           ; Variable value
-    send_sync CMD_SET_SHARED_VAR, 8
     rts
 
 ; Send an sync command to the Sidecart
@@ -80,6 +175,16 @@ get_tos_version:
 ; d0: error code, 0 if no error
 ; d1-d7 are modified. a0-a3 modified.
 send_sync_command_to_sidecart:
+    move.l RESIDENT_ADDR, d7         ; Wait loop in RAM. 0 if not relocated
+    beq.s send_sync_command_from_stack
+    move.l (sp)+, a2                 ; Return address
+    move.l d7, a3
+    add.l #(resident_sync_wait - resident_start), a3
+    bra.s _send_frame_to_sidecart
+
+; Same as send_sync_command_to_sidecart, but the wait loop is copied to the
+; stack in each call
+send_sync_command_from_stack:
     move.l (sp)+, a0                 ; Return address
     move.l #COMMAND_SYNC_CODE_SIZE, d7
     lea -(COMMAND_SYNC_CODE_SIZE)(sp), sp
@@ -94,6 +199,7 @@ _copy_sync_code:
 
     move.l a0, a2                       ; Return address to a2
 
+_send_frame_to_sidecart:
     ; The sync command synchronize with a random token
     move.l RANDOM_TOKEN_SEED_ADDR,d2
     addq.w #4, d1                       ; Add 4 bytes to the payload size to include the token
@@ -101,6 +207,13 @@ _copy_sync_code:
     ; a1 points to the addres of the token modified by the rp2040
     lea RANDOM_TOKEN_ADDR, a1
 
+    ; If the Multi-device checks the frames with a CRC-16, keep it in the stack
+    btst #PROTOCOL_CAP_CRC16, (PROTOCOL_CAPS_ADDR + 3)
+    beq.s _no_crc_stack
+    bsr crc16_sync_frame
+    move.w d7, -(sp)
+_no_crc_stack:
+
     ; For performance reasons, we will positive and negative index values to avoid some operations
     move.l #ROMCMD_START_ADDR, a0 ; Start address of the ROM3
     add.l #$8000, a0              ; Add 32Kb to the address to point to the middle of the ROM
@@ -188,38 +301,134 @@ _copy_sync_code:
 
 _no_more_payload_stack:
     ; SEND CHECKSUM
+    btst #PROTOCOL_CAP_CRC16, (PROTOCOL_CAPS_ADDR + 3)
+    beq.s _send_checksum_stack
+    move.w (sp)+, d7          ; The CRC-16 instead of the sum
+_send_checksum_stack:
     nop
     nop
     tst.b (a0, d7.w)
 
     ; End of the command loop. Now we need to wait for the token
     swap d2                   ; D2 is the only register that is not used as a scratch register
-    move.l #$000FFFFF, d7     ; Most significant word is the inner loop, least significant word is the outer loop
+    cmp.l #0, a3
+    beq.s _async_frame_sent   ; Async command, do not wait
+    get_sync_timeout d7       ; Iterations of the wait loop
     moveq #0, d0              ; No Timeout
 
     jmp (a3)                  ; Jump to the code in the stack
+_async_frame_sent:
+    move.l d2, d0             ; The token is the ticket to wait for
+    jmp (a2)
 ; This is the code that cannot run in ROM while waiting for the command to complete
 _start_sync_code_in_stack:
-    cmp.l (a1), d2                           ; Compare the random number with the token
-    beq.s _sync_token_found                  ; Token found, we can finish succesfully
-    subq.l #1, d7                            ; Decrement the inner loop
-    bne.s _start_sync_code_in_stack          ; If the inner loop is not finished, continue
-
-    ; Sync token not found, timeout
-    subq.l #1, d0                            ; Timeout
-_sync_token_found:
-
-    move.l #RANDOM_TOKEN_POST_WAIT, d7
-_wait_me:
-    subq.l #1, d7                            ; Decrement the outer loop
-    bne.s _wait_me                           ; Wait for the timeout
-
-_no_wait_me:
+    sync_token_wait (a1), d7
     lea (COMMAND_SYNC_CODE_SIZE)(sp), sp
     jmp (a2)                                 ; Return to the code in the ROM
     nop
 _end_sync_code_in_stack:
 
+; Send an async command to the Sidecart and return at once, without waiting for the token
+; Call wait_ticket with the ticket before sending the next command, because the random
+; token seed only changes when the Multi-device completes the command. Only one ticket
+; can be outstanding: a second command sent before wait_ticket, sync or async, reuses
+; the same token and its wait can end when the first command completes
+; Input registers:
+; d0.w: command code
+; d1.w: payload size
+; From d3 to d6 the payload based on the size of the payload field d1.w
+; Output registers:
+; d0: ticket of the command
+; d1-d7 are modified. a0-a3 modified.
+send_async_command_to_sidecart:
+    move.l (sp)+, a2                 ; Return address
+    sub.l a3, a3                     ; No code in the stack to wait for the token
+    bra _send_frame_to_sidecart
+
+; Wait until the Multi-device completes an async command
+; Input registers:
+; d0.l: ticket returned by send_async_command_to_sidecart
+; Output registers:
+; d0: error code, 0 if no error
+; d1-d7 are modified. a0-a3 modified.
+wait_ticket:
+    move.l d0, d2                    ; Token to wait for
+    move.l RESIDENT_ADDR, d7         ; Wait loop in RAM. 0 if not relocated
+    beq.s _wait_ticket_from_stack
+    move.l (sp)+, a2                 ; Return address
+    move.l d7, a3
+    add.l #(resident_sync_wait - resident_start), a3
+    bra.s _wait_ticket_ready
+_wait_ticket_from_stack:
+    move.l (sp)+, a0                 ; Return address
+    move.l #COMMAND_SYNC_CODE_SIZE, d7
+    lea -(COMMAND_SYNC_CODE_SIZE)(sp), sp
+    move.l sp, a2
+    move.l sp, a3
+    lea _start_sync_code_in_stack, a1    ; a1 points to the start of the code in ROM
+    lsr.w #1, d7
+    subq #1, d7
+_copy_wait_ticket_code:
+    move.w (a1)+, (a2)+
+    dbf d7, _copy_wait_ticket_code
+
+    move.l a0, a2                       ; Return address to a2
+_wait_ticket_ready:
+    lea RANDOM_TOKEN_ADDR, a1
+    get_sync_timeout d7       ; Iterations of the wait loop
+    moveq #0, d0              ; No Timeout
+    jmp (a3)                  ; Jump to the code in the stack
+
+; Compute the CRC-16/CCITT of a sync command, in the same order the words are sent
+; Input registers:
+; d0.w: command code
+; d1.w: payload size, including the random token
+; From d2 to d6 the payload, low word first
+; Output registers:
+; d7.w: CRC-16 of the command code, the payload size and the payload
+crc16_sync_frame:
+    movem.l d0-d6/a0-a1, -(sp)
+    lea crc16_table, a0
+    moveq #-1, d7               ; Initial value $FFFF
+    bsr.s _crc16_word           ; Command code
+    move.w d1, d0
+    bsr.s _crc16_word           ; Payload size
+    lea 8(sp), a1               ; D2 in the stack
+    move.w d1, d5
+    lsr.w #1, d5                ; Words of the payload
+    beq.s _crc16_done
+_crc16_payload:
+    move.w 2(a1), d0            ; Low word of the register
+    bsr.s _crc16_word
+    subq.w #1, d5
+    beq.s _crc16_done
+    move.w (a1), d0             ; High word of the register
+    bsr.s _crc16_word
+    addq.l #4, a1
+    subq.w #1, d5
+    bne.s _crc16_payload
+_crc16_done:
+    movem.l (sp)+, d0-d6/a0-a1
+    rts
+
+; Add the word in d0.w to the CRC in d7.w, high byte first. d4 and d6 are modified
+_crc16_word:
+    move.w d0, d6
+    lsr.w #8, d6
+    bsr.s _crc16_byte
+    move.w d0, d6
+; Add the byte in d6.w to the CRC in d7.w
+_crc16_byte:
+    move.w d7, d4
+    lsr.w #8, d4
+    eor.w d4, d6                ; (CRC >> 8) ^ byte
+    and.w #$FF, d6
+    add.w d6, d6
+    lsl.w #8, d7
+    move.w (a0, d6.w), d4
+    eor.w d4, d7
+    rts
+
 ; Send an sync write command to the Sidecart
 ; Wait until the command sets a response in the memory with a random number used as a token
 ; Input registers:
@@ -236,6 +445,13 @@ _end_sync_code_in_stack:
 ; d1-d6 are modified. a0-a3 modified.
 send_sync_write_command_to_sidecart:
     move.l (sp)+, a0                 ; Return address
+    move.l RESIDENT_ADDR, d7         ; Wait loop in RAM. 0 if not relocated
+    beq.s _send_sync_write_from_stack
+    move.l d7, a3
+    add.l #(resident_sync_write_wait - resident_start), a3
+    move.l a0, a2                    ; Return address to a2
+    bra.s _send_sync_write_frame
+_send_sync_write_from_stack:
     move.l #_end_sync_write_code_in_stack - _start_sync_write_code_in_stack, d7
     lea -(_end_sync_write_code_in_stack - _start_sync_write_code_in_stack)(sp), sp
     move.l sp, a2
@@ -255,6 +471,7 @@ _copy_write_sync_code:
 
     move.l a0, a2                       ; Return address to a2
 
+_send_sync_write_frame:
     ; The sync write command synchronize with a random token
     move.l RANDOM_TOKEN_SEED_ADDR,d2
     moveq #18, d1                       ; We are going to send the data in d2.l (random token), d3.l, d4.l, d5.l  and CHCK.w at the end. ALWAYS!!!!
@@ -393,32 +610,88 @@ _write_to_sidecart_end_loop:
     
     ; End of the command loop. Now we need to wait for the token
     swap d2                   ; D2 is the only register that is not used as a scratch register
-    move.l #$000FFFFF, d6     ; Most significant word is the inner loop, least significant word is the outer loop
+    get_sync_timeout d6       ; Iterations of the wait loop
     moveq #0, d0              ; Timeout
     jmp (a3)                  ; Jump to the code in the stack
 
 ; This is the code that cannot run in ROM while waiting for the command to complete
 _start_sync_write_code_in_stack:
-    cmp.l RANDOM_TOKEN_ADDR, d2                    ; Compare the random number with the token
-    beq.s _sync_write_token_found                  ; Token found, we can finish succesfully
-    subq.l #1, d6                                  ; Decrement the inner loop
-    bne.s _start_sync_write_code_in_stack          ; If the inner loop is not finished, continue
-
-    ; Sync token not found, timeout
-    subq.l #1, d0                                  ; Timeout
-
-_sync_write_token_found:
-
-    move.l #RANDOM_TOKEN_POST_WAIT, d6
-_wait_me_write:
-    subq.l #1, d6                            ; Decrement the outer loop
-    bne.s _wait_me_write                     ; Wait for the timeout
-
-
+    sync_token_wait RANDOM_TOKEN_ADDR, d6
     lea (_end_sync_write_code_in_stack - _start_sync_write_code_in_stack)(sp), sp
     jmp (a2)                                 ; Return to the code in the ROM
 
     even    ; Do not remove this line
     nop     ; Do not remove this line
     nop     ; Do not remove this line
-_end_sync_write_code_in_stack:
\ No newline at end of file
+_end_sync_write_code_in_stack:
+
+; Copy the resident code, from resident_start to resident_end, to a block of
+; RAM taken with Malloc, and publish its address in the shared variable
+; SHARED_VARIABLE_RESIDENT_ADDR. The hooks installed after this call and the
+; wait loops of the sync commands run from the RAM copy, so their instructions
+; are not fetched through the cartridge port. Without memory, they keep
+; running from the ROM
+; Call it before any other command: the address of a previous boot is not
+; valid anymore
+;
+; Outputs:
+;   d0: error code, 0 if no error
+relocate_resident:
+    move.l #(resident_end - resident_start), -(sp)
+    move.w #Malloc, -(sp)
+    trap #1
+    addq.l #6, sp
+    move.l d0, d4                       ; Address of the block, 0 if no memory
+    bgt.s _relocate_resident_copy
+    moveq #0, d4                        ; Keep running from the ROM
+    bra.s _relocate_resident_save
+_relocate_resident_copy:
+    move.l d4, a0
+    lea resident_start, a1
+    move.w #(((resident_end - resident_start) / 2) - 1), d1
+_relocate_resident_loop:
+    move.w (a1)+, (a0)+
+    dbf d1, _relocate_resident_loop
+_relocate_resident_save:
+    move.l #SHARED_VARIABLE_RESIDENT_ADDR, d3   ; D3 Variable index
+                                                ; D4 Variable value
+    moveq.l #8, d1
+    move.w #CMD_SET_SHARED_VAR, d0
+    bsr send_sync_command_from_stack    ; Never the wait loop of the old address
+    rts
+
+; CRC-16/CCITT of each byte
+    even
+crc16_table:
+    dc.w $0000,$1021,$2042,$3063,$4084,$50A5,$60C6,$70E7
+    dc.w $8108,$9129,$A14A,$B16B,$C18C,$D1AD,$E1CE,$F1EF
+    dc.w $1231,$0210,$3273,$2252,$52B5,$4294,$72F7,$62D6
+    dc.w $9339,$8318,$B37B,$A35A,$D3BD,$C39C,$F3FF,$E3DE
+    dc.w $2462,$3443,$0420,$1401,$64E6,$74C7,$44A4,$5485
+    dc.w $A56A,$B54B,$8528,$9509,$E5EE,$F5CF,$C5AC,$D58D
+    dc.w $3653,$2672,$1611,$0630,$76D7,$66F6,$5695,$46B4
+    dc.w $B75B,$A77A,$9719,$8738,$F7DF,$E7FE,$D79D,$C7BC
+    dc.w $48C4,$58E5,$6886,$78A7,$0840,$1861,$2802,$3823
+    dc.w $C9CC,$D9ED,$E98E,$F9AF,$8948,$9969,$A90A,$B92B
+    dc.w $5AF5,$4AD4,$7AB7,$6A96,$1A71,$0A50,$3A33,$2A12
+    dc.w $DBFD,$CBDC,$FBBF,$EB9E,$9B79,$8B58,$BB3B,$AB1A
+    dc.w $6CA6,$7C87,$4CE4,$5CC5,$2C22,$3C03,$0C60,$1C41
+    dc.w $EDAE,$FD8F,$CDEC,$DDCD,$AD2A,$BD0B,$8D68,$9D49
+    dc.w $7E97,$6EB6,$5ED5,$4EF4,$3E13,$2E32,$1E51,$0E70
+    dc.w $FF9F,$EFBE,$DFDD,$CFFC,$BF1B,$AF3A,$9F59,$8F78
+    dc.w $9188,$81A9,$B1CA,$A1EB,$D10C,$C12D,$F14E,$E16F
+    dc.w $1080,$00A1,$30C2,$20E3,$5004,$4025,$7046,$6067
+    dc.w $83B9,$9398,$A3FB,$B3DA,$C33D,$D31C,$E37F,$F35E
+    dc.w $02B1,$1290,$22F3,$32D2,$4235,$5214,$6277,$7256
+    dc.w $B5EA,$A5CB,$95A8,$8589,$F56E,$E54F,$D52C,$C50D
+    dc.w $34E2,$24C3,$14A0,$0481,$7466,$6447,$5424,$4405
+    dc.w $A7DB,$B7FA,$8799,$97B8,$E75F,$F77E,$C71D,$D73C
+    dc.w $26D3,$36F2,$0691,$16B0,$6657,$7676,$4615,$5634
+    dc.w $D94C,$C96D,$F90E,$E92F,$99C8,$89E9,$B98A,$A9AB
+    dc.w $5844,$4865,$7806,$6827,$18C0,$08E1,$3882,$28A3
+    dc.w $CB7D,$DB5C,$EB3F,$FB1E,$8BF9,$9BD8,$ABBB,$BB9A
+    dc.w $4A75,$5A54,$6A37,$7A16,$0AF1,$1AD0,$2AB3,$3A92
+    dc.w $FD2E,$ED0F,$DD6C,$CD4D,$BDAA,$AD8B,$9DE8,$8DC9
+    dc.w $7C26,$6C07,$5C64,$4C45,$3CA2,$2C83,$1CE0,$0CC1
+    dc.w $EF1F,$FF3E,$CF5D,$DF7C,$AF9B,$BFBA,$8FD9,$9FF8
+    dc.w $6E17,$7E36,$4E55,$5E74,$2E93,$3EB2,$0ED1,$1EF0
@@ -11,6 +11,16 @@ send_sync           macro
                     bsr send_sync_command_to_sidecart    ; Send the command to the Multi-device
                     endm    
 
+; Send an asynchronous command to the Multi-device passing arguments in the Dx registers
+; Returns the ticket in d0 for wait_ticket
+; /1 : The command code
+; /2 : The payload size (even number always)
+send_async          macro
+                    moveq.l #\2, d1                      ; Set the payload size of the command
+                    move.w #\1,d0                        ; Command code
+                    bsr send_async_command_to_sidecart   ; Send the command to the Multi-device
+                    endm    
+
 ; Send a synchronous write command to the Multi-device passing arguments in the D3-D5 registers
 ; A4 address of the buffer to send
 ; /1 : The command code
@@ -22,6 +32,15 @@ send_write_sync     macro
                     bsr send_sync_write_command_to_sidecart ; Send the command to the Multi-device
                     endm    
 
+; Get the iterations of the sync wait loop. The default until calibrated
+; /1 : The register to set
+get_sync_timeout    macro
+                    move.l SYNC_TIMEOUT_ADDR, \1       ; Calibrated at boot. 0 if not
+                    bne.s .\@calibrated
+                    move.l #SYNC_TIMEOUT_DEFAULT, \1
+.\@calibrated:
+                    endm
+
 ; Wait for second (aprox 50 VBlanks)
 wait_sec                macro
                         move.l d7, -(sp)                    ; Save the number counter reg
@@ -54,3 +73,49 @@ wait_sec_or_key_press   macro
                         move.l (sp)+, d7                    ; Restore the number counter reg
                         endm
 
+
+; Wait for the token of a sync command, the loop that cannot run in ROM
+; d2.l: the token to wait for
+; d0.l: 0 on entry, -1 on timeout
+; /1 : The address of the token modified by the Multi-device
+; /2 : The register with the iterations of the wait loop
+sync_token_wait     macro
+.\@wait:
+                    cmp.l \1, d2                ; Compare the random number with the token
+                    beq.s .\@found              ; Token found, we can finish succesfully
+                    subq.l #1, \2               ; Decrement the inner loop
+                    bne.s .\@wait               ; If the inner loop is not finished, continue
+
+                    ; Sync token not found, timeout
+                    subq.l #1, d0               ; Timeout
+.\@found:
+                    move.l #RANDOM_TOKEN_POST_WAIT, \2
+.\@post_wait:
+                    subq.l #1, \2               ; Decrement the outer loop
+                    bne.s .\@post_wait          ; Wait for the timeout
+                    endm
+
+; Wait loops of the sync commands copied to RAM with the resident code
+; Place it once between the resident_start and resident_end labels
+resident_sync_code  macro
+resident_sync_wait:
+                    sync_token_wait (a1), d7
+                    jmp (a2)                    ; Return to the code in the ROM
+resident_sync_write_wait:
+                    sync_token_wait RANDOM_TOKEN_ADDR, d6
+                    jmp (a2)                    ; Return to the code in the ROM
+                    endm
+
+; Get the address of a routine of the resident code. In RAM if it was
+; relocated with relocate_resident, in the ROM if not
+; /1 : The label of the routine, between resident_start and resident_end
+; /2 : The data register to set
+resident_address    macro
+                    move.l RESIDENT_ADDR, \2   ; 0 if not relocated
+                    beq.s .\@rom
+                    add.l #(\1 - resident_start), \2
+                    bra.s .\@done
+.\@rom:
+                    move.l #\1, \2
+.\@done:
+                    endm
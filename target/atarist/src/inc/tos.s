@@ -174,7 +174,9 @@ Cauxis		EQU	18
 Dgetdrv		EQU	25
 Fsetdta		EQU	26
 Super		EQU	32
+Tgetdate	EQU	42
 Tsetdate	EQU	43
+Tgettime	EQU	44
 Tsettime	EQU	45
 Fgetdta		EQU	47
 Sversion	EQU	48
@@ -26,6 +26,18 @@
 ROM4_ADDR			equ $FA0000
 FRAMEBUFFER_ADDR	equ $FA8000
 FRAMEBUFFER_SIZE 	equ 8000	; 8Kbytes of a 320x200 monochrome screen
+FRAMEBUFFER_SEQ		equ (FRAMEBUFFER_ADDR + FRAMEBUFFER_SIZE + 4)	; Odd while the RP2040 updates the dirty bands
+FRAMEBUFFER_DIRTY	equ (FRAMEBUFFER_SEQ + 4)	; Bands changed in the last refresh. One bit per band
+FRAMEBUFFER_ALL_BANDS	equ $1FFFFFF	; 25 bands of 8 rows
+FRAMEBUFFER_BAND_SIZE	equ 320		; 8 rows of 40 bytes in the framebuffer
+SCREEN_BAND_SIZE	equ 1280	; 8 rows of 160 bytes in the screen, low and high resolution
+BAND_ROWS			equ 8		; Rows in a band
+FRAMEBUFFER_HIGHRES	equ (FRAMEBUFFER_DIRTY + 4)	; Not zero if the RP2040 expands the high resolution rows
+HIGHRES_ADDR		equ (ROM4_ADDR + $2000)	; Expanded high resolution rows of 80 bytes
+HIGHRES_HALF_ROW	equ 40		; Bytes copied by a movem.l of 10 registers
+LOW_FAST_MIN_CPU	equ 20		; _CPU cookie of the first CPU with a cache for the unrolled low resolution copy
+LOW_FAST_UNROLL_BYTES	equ 16	; Framebuffer bytes copied in each iteration of the unrolled loop
+FRAMEBUFFER_BANDS	equ (FRAMEBUFFER_HIGHRES + 4)	; Offset in the framebuffer of each band of the screen. The terminal scrolls rotating them
 COLS_HIGH			equ 20		; 16 bit columns in the ST
 ROWS_HIGH			equ 200		; 200 rows in the ST
 BYTES_ROW_HIGH		equ 80		; 80 bytes per row in the ST
@@ -37,6 +49,8 @@ CMD_RESET			equ 1		; Reset command
 CMD_BOOT_GEM		equ 2		; Boot GEM command
 CMD_TERMINAL		equ 3		; Terminal command
 CMD_START 			equ 4  		; Continue boot process and emulation
+CMD_BENCH			equ 5		; Run the benchmark of the protocol and the display
+CMD_CALIBRATE		equ 6		; Run the calibration of the timing of the bus
 
 
 _conterm			equ $484	; Conterm device number
@@ -45,8 +59,38 @@ _conterm			equ $484	; Conterm device number
 RANDOM_TOKEN_ADDR:        equ (ROM4_ADDR + $F000) 	      ; Random token address at $FAF000
 RANDOM_TOKEN_SEED_ADDR:   equ (RANDOM_TOKEN_ADDR + 4) 	  ; RANDOM_TOKEN_ADDR + 4 bytes
 RANDOM_TOKEN_POST_WAIT:   equ $1        		      	  ; Wait this cycles after the random number generator is ready
+SYNC_TIMEOUT_DEFAULT:     equ $000FFFFF				  ; Iterations of the sync wait loop until calibrated. About 5 seconds in a stock ST
 
 SHARED_VARIABLES:     	  equ (RANDOM_TOKEN_ADDR + (16 * 4)); random token + 16*4 bytes to the shared variables area
+PROTOCOL_CAPS_ADDR:       equ (ROM4_ADDR + $FFFC)		  ; Capabilities of the protocol published by the RP2040
+PROTOCOL_STATS_ADDR:      equ (ROM4_ADDR + $FFD0)		  ; Counters of the protocol published by the RP2040
+
+; Status of the device published by the RP2040. Must match the values in status.h
+STATUS_ADDR:              equ (ROM4_ADDR + $F200)		  ; Status page at $FAF200
+STATUS_MAGIC_ADDR:        equ STATUS_ADDR				  ; "STAT"
+STATUS_VERSION_ADDR:      equ (STATUS_ADDR + $04)		  ; Version in the high word, size in the low word
+STATUS_SEQ_ADDR:          equ (STATUS_ADDR + $08)		  ; Odd while the RP2040 updates the page
+STATUS_LINK_ADDR:         equ (STATUS_ADDR + $0C)		  ; 0: radio off, 1: down, 2: joined, 3: up
+STATUS_RSSI_ADDR:         equ (STATUS_ADDR + $10)		  ; Signed dBm
+STATUS_IP_ADDR:           equ (STATUS_ADDR + $14)		  ; IPv4 address
+STATUS_SYNC_RTT_ADDR:     equ (STATUS_ADDR + $18)		  ; Round trip of the last sync in us
+STATUS_SYNC_AGE_ADDR:     equ (STATUS_ADDR + $1C)		  ; Seconds since the last sync. $FFFFFFFF: never
+STATUS_CHECKSUM_ERR_ADDR: equ (STATUS_ADDR + $20)		  ; Frames with a wrong checksum
+STATUS_OVERFLOWS_ADDR:    equ (STATUS_ADDR + $24)		  ; Frames lost with the queue full
+STATUS_UPTIME_ADDR:       equ (STATUS_ADDR + $28)		  ; Seconds since boot
+STATUS_FIRMWARE_ADDR:     equ (STATUS_ADDR + $30)		  ; Firmware version, 16 bytes ended by a zero
+STATUS_SERVER_ADDR:       equ (STATUS_ADDR + $40)		  ; Host of the last sync, 64 bytes ended by a zero
+
+; Calibration of the timing of the bus. Must match the values in buscal.h
+CALIB_ADDR:               equ (ROM4_ADDR + $E000)		  ; Area of the calibration at $FAE000
+CALIB_STATE_ADDR:         equ CALIB_ADDR				  ; What the computer must do
+CALIB_ROUND_ADDR:         equ (CALIB_ADDR + 4)			  ; Candidate timing under test
+CALIB_PATTERN_ADDR:       equ (CALIB_ADDR + $10)		  ; Known pattern read in each pass
+CALIB_PATTERN_LONGS       equ 256						  ; Longs of the pattern
+CALIB_STATE_TEST          equ $54455354				  ; 'TEST'. Read the pattern
+CALIB_STATE_REPORT        equ $52455054				  ; 'REPT'. Send the errors
+CALIB_STATE_DONE          equ $444F4E45				  ; 'DONE'. Back to the terminal
+CALIB_CONFIRM_READS       equ 8						  ; Equal reads to accept a new state
 
 ROMCMD_START_ADDR:        equ $FB0000					  ; We are going to use ROM3 address
 CMD_MAGIC_NUMBER    	  equ ($ABCD) 					  ; Magic number header to identify a command
@@ -57,6 +101,20 @@ APP_TERMINAL 				equ $0 ; The terminal app
 ; App terminal commands
 APP_TERMINAL_START   		equ $0 ; Start terminal command
 APP_TERMINAL_KEYSTROKE 		equ $1 ; Keystroke command
+KEYSTROKES_SIZE				equ 16 ; Up to four keystrokes in D3-D6 sent in one keystroke command
+KEYSTROKES_DONE				equ 0	; No more keys pending
+KEYSTROKES_MORE				equ 1	; The batch is full, read more keys
+KEYSTROKES_ESC				equ 2	; ESC pressed, start the terminal
+APP_TERMINAL_BENCH_PING		equ $2 ; Benchmark round trip. Does nothing in the RP2040
+APP_TERMINAL_BENCH_WRITE	equ $3 ; Benchmark write. The data is discarded in the RP2040
+APP_TERMINAL_BENCH_RESULT	equ $4 ; Ticks of a benchmark test. D3 test index, D4 ticks
+APP_TERMINAL_CALIBRATE_RESULT	equ $5 ; Errors of a timing. D3 round, D4 errors, D5 passes
+
+; Iterations of each test of the benchmark. Must match the values in term.h
+BENCH_SYNC_ITERATIONS		equ 256	; Sync commands without data
+BENCH_WRITE_ITERATIONS		equ 32	; Sync write commands
+BENCH_REFRESH_ITERATIONS	equ 16	; Copies of the whole framebuffer to the screen
+BENCH_TESTS					equ 7	; Tests of the benchmark, in the order of term.h
 
 
 
@@ -71,6 +129,57 @@ vsync_wait          macro
 					addq.l #2,sp
                     endm    
 
+; Read the bands to copy to the screen in D7. The last sequence number seen is in D5
+; The RP2040 adds 2 to the sequence number on each refresh. If we missed one, copy all
+read_dirty_bands	macro
+.\@retry:
+					move.l FRAMEBUFFER_SEQ, d2	; Odd while the RP2040 updates the bands
+					btst #0, d2
+					bne.s .\@retry
+					move.l FRAMEBUFFER_DIRTY, d7
+					cmp.l FRAMEBUFFER_SEQ, d2	; Retry if updated while reading
+					bne.s .\@retry
+					move.l d2, d1
+					sub.l d5, d1				; Refreshes since the last copy, times 2
+					move.l d2, d5
+					tst.l d1
+					bne.s .\@changed
+					clr.l d7					; Nothing changed
+					bra.s .\@done
+.\@changed:
+					cmp.l #2, d1
+					beq.s .\@done
+					move.l #FRAMEBUFFER_ALL_BANDS, d7
+.\@done:
+					endm
+
+; Copy an expanded high resolution row from A4 to two lines of the screen in A5
+copy_expanded_row	macro
+					movem.l (a4)+, d0-d5/a0-a3		; First half of the row
+					movem.l d0-d5/a0-a3, (a5)
+					movem.l d0-d5/a0-a3, BYTES_ROW_HIGH(a5)
+					lea HIGHRES_HALF_ROW(a5), a5
+					movem.l (a4)+, d0-d5/a0-a3		; Second half of the row
+					movem.l d0-d5/a0-a3, (a5)
+					movem.l d0-d5/a0-a3, BYTES_ROW_HIGH(a5)
+					lea (HIGHRES_HALF_ROW + BYTES_ROW_HIGH)(a5), a5	; Skip the doubled line
+					endm
+
+; Copy a long of the framebuffer in A1 to four longs of the low resolution
+; screen in A0. Each word is doubled in a long and written twice
+copy_low_long		macro
+					move.l (a1)+, d1		; Two words of the framebuffer
+					move.l d1, d2
+					swap d2
+					move.l d1, d3
+					move.w d2, d3			; First word doubled in a long
+					move.w d1, d2			; Second word doubled in a long
+					move.l d3, (a0)+
+					move.l d3, (a0)+
+					move.l d2, (a0)+
+					move.l d2, (a0)+
+					endm
+
 ; XBIOS GetRez
 ; Return the current screen resolution in D0
 get_rez				macro
@@ -102,31 +211,100 @@ check_shift_keys	macro
 
 					endm
 
-; Check the keys pressed
+; Check the keys pressed. Send all the pending keys in batches of up to four
 check_keys			macro
-
+					move.l d5, -(sp)			; The command clobbers the sequence number
+.\@next_batch:
+					lea -KEYSTROKES_SIZE(sp), sp	; Keystrokes of the batch
+					move.l sp, a4
+					moveq #0, d7				; Bytes of keystrokes in the batch
+					move.w #KEYSTROKES_DONE, a5
+.\@read_key:
 					gemdos	Cconis,2		; Check if a key is pressed
 					tst.l d0
-					beq .\@no_key
+					beq .\@send_batch
 
 					gemdos	Cnecin,2		; Read the key pressed
 
 					cmp.b #27, d0		; Check if the key is ESC
 					beq .\@esc_key	; If it is, send terminal command
 
-					move.l d0, d3
-					send_sync APP_TERMINAL_KEYSTROKE, 4
-
-					bra .\@no_key
+					move.l d0, (a4)+
+					addq.l #4, d7
+					cmp.l #KEYSTROKES_SIZE, d7
+					bne .\@read_key
+					move.w #KEYSTROKES_MORE, a5	; Batch full, more keys can be pending
+					bra .\@send_batch
 .\@esc_key:
+					move.w #KEYSTROKES_ESC, a5
+.\@send_batch:
+					movem.l (sp)+, d3-d6		; D3 is the first keystroke
+					tst.l d7
+					beq .\@batch_sent			; No keystrokes in the batch
+					move.l d7, d1				; Payload of four bytes per keystroke
+					move.w #APP_TERMINAL_KEYSTROKE, d0
+					bsr send_sync_command_to_sidecart
+.\@batch_sent:
+					cmp.w #KEYSTROKES_MORE, a5
+					beq .\@next_batch
+					cmp.w #KEYSTROKES_ESC, a5
+					bne .\@no_key
 					send_sync APP_TERMINAL_START, 0
 
 .\@no_key:
+					move.l (sp)+, d5
+					endm
+
+; Store the ticks since the start tick in (a5) and move to the next test
+bench_end			macro
+					move.l _hz_200.w, d0
+					sub.l (a5), d0
+					move.l d0, (a5)+
+					endm
+
+; Time BENCH_SYNC_ITERATIONS sync commands
+; /1 : The bytes of data sent after the random token
+bench_sync			macro
+					move.l _hz_200.w, (a5)		; Start tick
+					move.w #(BENCH_SYNC_ITERATIONS - 1), -(sp)
+.\@loop:
+					send_sync APP_TERMINAL_BENCH_PING, \1
+					subq.w #1, (sp)
+					bpl.s .\@loop
+					addq.l #2, sp
+					bench_end
+					endm
 
+; Time BENCH_WRITE_ITERATIONS sync write commands. The data is the screen
+; /1 : The bytes of data to write
+bench_write			macro
+					move.l _hz_200.w, (a5)		; Start tick
+					move.w #(BENCH_WRITE_ITERATIONS - 1), -(sp)
+.\@loop:
+					move.l a6, a4				; Send the screen memory
+					send_write_sync APP_TERMINAL_BENCH_WRITE, \1
+					subq.w #1, (sp)
+					bpl.s .\@loop
+					addq.l #2, sp
+					bench_end
 					endm
 
 check_commands		macro
 					move.l (FRAMEBUFFER_ADDR + FRAMEBUFFER_SIZE), d6	; Store in the D6 register the remote command value
+					cmp.l #CMD_BENCH, d6		; Check if the command is to run the benchmark
+					bne.s .\@no_bench
+					bsr run_benchmark
+					move.l FRAMEBUFFER_SEQ, d5	; Force a full copy to repaint the screen
+					subq.l #4, d5
+					bra .\@bypass
+.\@no_bench:
+					cmp.l #CMD_CALIBRATE, d6	; Check if the command is to calibrate the bus
+					bne.s .\@no_calibrate
+					bsr run_calibration
+					move.l FRAMEBUFFER_SEQ, d5	; Force a full copy to repaint the screen
+					subq.l #4, d5
+					bra .\@bypass
+.\@no_calibrate:
 					cmp.l #CMD_RESET, d6		; Check if the command is a reset
 					beq .reset					; If it is, reset the computer
 					cmp.l #CMD_BOOT_GEM, d6		; Check if the command is to boot GEM
@@ -166,18 +344,35 @@ pre_auto:
 ; Enable bconin to return shift key status
 	or.b #%1000, _conterm.w
 
+; Force a full copy in the first frame
+	move.l FRAMEBUFFER_SEQ, d5
+	subq.l #4, d5
+
 ; Get the resolution of the screen
 	get_rez
 	cmp.w #2, d0				; Check if the resolution is 640x400 (high resolution)
 	beq .print_loop_high		; If it is, print the message in high resolution
 
+	bsr read_cpu_type
+	cmp.l #LOW_FAST_MIN_CPU, d0
+	bcc .print_loop_low_fast	; Unrolled copy with long reads in a 68020 or better
+
 .print_loop_low:
 	vsync_wait
+	read_dirty_bands
 
 ; We must move from the cartridge ROM to the screen memory to display the messages
-	move.l a6, a0				; Set the screen memory address in a0
-	move.l #FRAMEBUFFER_ADDR, a1			; Set the cartridge ROM address in a1
-	move.l #((FRAMEBUFFER_SIZE / 2) -1), d0			; Set the number of words to copy
+	move.l a6, a5				; Screen address of the first band
+	move.l #FRAMEBUFFER_BANDS, a4	; Offset of the first band in the framebuffer
+.copy_band_low:
+	tst.l d7
+	beq.s .copy_done_low		; No more bands to copy
+	lsr.l #1, d7
+	bcc.s .next_band_low		; This band did not change
+	move.l a5, a0				; Set the screen memory address in a0
+	move.l (a4), a1
+	add.l #FRAMEBUFFER_ADDR, a1	; Set the cartridge ROM address in a1
+	move.l #((FRAMEBUFFER_BAND_SIZE / 2) -1), d0	; Set the number of words to copy
 .copy_screen_low:
 	move.w (a1)+ , d1			; Copy a word from the cartridge ROM
 	move.w d1, d2				; Copy the word to d2
@@ -185,23 +380,71 @@ pre_auto:
 	move.w d1, d2				; Copy the word to d2
 	move.l d2, (a0)+			; Copy the word to the screen memory
 	move.l d2, (a0)+			; Copy the word to the screen memory
-	dbf d0, .copy_screen_low    ; Loop until all the message is copied
+	dbf d0, .copy_screen_low    ; Loop until all the band is copied
+.next_band_low:
+	addq.l #4, a4
+	lea SCREEN_BAND_SIZE(a5), a5
+	bra.s .copy_band_low
+.copy_done_low:
 
 ; Check the different commands and the keyboard
 	check_commands
 
 	bra .print_loop_low		; Continue printing the message
 
+.print_loop_low_fast:
+	vsync_wait
+	read_dirty_bands
+
+; Same copy as the 68000 path, reading a long and unrolled to save the loop instructions
+	move.l a6, a5				; Screen address of the first band
+	move.l #FRAMEBUFFER_BANDS, a4	; Offset of the first band in the framebuffer
+.copy_band_low_fast:
+	tst.l d7
+	beq .copy_done_low_fast	; No more bands to copy
+	lsr.l #1, d7
+	bcc.s .next_band_low_fast	; This band did not change
+	move.l a5, a0				; Set the screen memory address in a0
+	move.l (a4), a1
+	add.l #FRAMEBUFFER_ADDR, a1	; Set the cartridge ROM address in a1
+	moveq #((FRAMEBUFFER_BAND_SIZE / LOW_FAST_UNROLL_BYTES) - 1), d0	; Set the number of blocks to copy
+.copy_screen_low_fast:
+	rept (LOW_FAST_UNROLL_BYTES / 4)
+	copy_low_long
+	endr
+	dbf d0, .copy_screen_low_fast	; Loop until all the band is copied
+.next_band_low_fast:
+	addq.l #4, a4
+	lea SCREEN_BAND_SIZE(a5), a5
+	bra .copy_band_low_fast
+.copy_done_low_fast:
+
+; Check the different commands and the keyboard
+	check_commands
+
+	bra .print_loop_low_fast	; Continue printing the message
+
 .print_loop_high:
 	vsync_wait
+	read_dirty_bands
+	tst.l FRAMEBUFFER_HIGHRES
+	bne .print_expanded_high	; The RP2040 already expanded the rows
 
 ; We must move from the cartridge ROM to the screen memory to display the messages
-	move.l a6, a1				; Set the screen memory address in a1
-	move.l a6, a2
-	lea BYTES_ROW_HIGH(a2), a2	; Move to the next line in the screen
-	move.l #FRAMEBUFFER_ADDR, a0		; Set the cartridge ROM address in a0
 	move.l #TRANSTABLE, a3		; Set the translation table in a3
-	move.l #(ROWS_HIGH -1), d0	; Set the number of rows to copy - 1
+	move.l a6, a5				; Screen address of the first band
+	move.l #FRAMEBUFFER_BANDS, a4	; Offset of the first band in the framebuffer
+.copy_band_high:
+	tst.l d7
+	beq.s .copy_done_high		; No more bands to copy
+	lsr.l #1, d7
+	bcc.s .next_band_high		; This band did not change
+	move.l a5, a1				; Set the screen memory address in a1
+	move.l a5, a2
+	lea BYTES_ROW_HIGH(a2), a2	; Move to the next line in the screen
+	move.l (a4), a0
+	add.l #FRAMEBUFFER_ADDR, a0	; Set the cartridge ROM address in a0
+	move.l #(BAND_ROWS -1), d0	; Set the number of rows to copy - 1
 .copy_screen_row_high:
 	move.l #(COLS_HIGH -1), d1	; Set the number of columns to copy - 1 
 .copy_screen_col_high:
@@ -224,7 +467,44 @@ pre_auto:
 	lea BYTES_ROW_HIGH(a1), a1	; Move to the next line in the screen
 	lea BYTES_ROW_HIGH(a2), a2	; Move to the next line in the screen
 
-	dbf d0, .copy_screen_row_high   ; Loop until all the message is copied
+	dbf d0, .copy_screen_row_high   ; Loop until all the band is copied
+.next_band_high:
+	addq.l #4, a4
+	lea SCREEN_BAND_SIZE(a5), a5
+	bra.s .copy_band_high
+.copy_done_high:
+
+; Check the different commands and the keyboard
+	check_commands
+
+	bra .print_loop_high		; Continue printing the message
+
+; Straight copy of the rows expanded by the RP2040
+.print_expanded_high:
+	move.l d5, -(sp)			; Free D5 for the block copy
+	move.l a6, a5				; Screen address of the first band
+	move.l #FRAMEBUFFER_BANDS, d6	; Offset of the first band in the framebuffer
+.copy_band_expanded:
+	tst.l d7
+	beq .copy_done_expanded	; No more bands to copy
+	lsr.l #1, d7
+	bcc .next_band_expanded	; This band did not change
+	move.l d6, a4
+	move.l (a4), d0
+	add.l d0, d0				; The expanded rows are twice as long
+	move.l d0, a4
+	add.l #HIGHRES_ADDR, a4		; Cartridge ROM address of the band
+	rept BAND_ROWS
+	copy_expanded_row
+	endr
+	bra .next_band_copied		; A5 already points to the next band
+.next_band_expanded:
+	lea SCREEN_BAND_SIZE(a5), a5
+.next_band_copied:
+	addq.l #4, d6
+	bra .copy_band_expanded
+.copy_done_expanded:
+	move.l (sp)+, d5
 
 ; Check the different commands and the keyboard
 	check_commands
@@ -264,6 +544,128 @@ boot_gem:
 	; If we get here, continue loading GEM
     rts
 
+; Time the commands of the protocol and the copy of the framebuffer with the
+; 200 Hz timer, and send the ticks of each test to the RP2040.
+; The payload of send_sync is up to 16 bytes in D3-D6, so the largest sync
+; test sends 16 bytes instead of 20
+run_benchmark:
+	movem.l a4-a6, -(sp)
+	lea -(BENCH_TESTS * 4)(sp), sp	; Ticks of each test
+	move.l sp, a5
+
+	bench_sync 0
+	bench_sync 4
+	bench_sync 16
+	bench_write 256
+	bench_write 1024
+	bench_write 2048
+
+	move.l _hz_200.w, (a5)		; Start tick
+	move.w #(BENCH_REFRESH_ITERATIONS - 1), d7
+.bench_refresh:
+	move.l #FRAMEBUFFER_ADDR, a0
+	move.l a6, a1
+	move.w #((FRAMEBUFFER_SIZE / 4) - 1), d0
+.bench_refresh_copy:
+	move.l (a0)+, (a1)+			; Raw copy, the screen is repainted later
+	dbf d0, .bench_refresh_copy
+	dbf d7, .bench_refresh
+	bench_end
+
+	move.l sp, a5
+	sub.l a4, a4				; Index of the test
+.bench_send_result:
+	move.l a4, d3				; D3 test index
+	move.l (a5)+, d4			; D4 ticks
+	send_sync APP_TERMINAL_BENCH_RESULT, 8
+	addq.l #1, a4
+	cmp.w #BENCH_TESTS, a4
+	bne.s .bench_send_result
+
+	lea (BENCH_TESTS * 4)(sp), sp
+	movem.l (sp)+, a4-a6
+	rts
+
+; Read a known pattern from the ROM4 while the RP2040 tries each candidate
+; timing of the bus, and send the errors of each one to the RP2040.
+; The ROM4 is not reliable while a candidate is under test, so the test loop
+; runs from a copy in the stack. The RP2040 restores the default timing
+; before asking for the errors or finishing the calibration
+run_calibration:
+	movem.l a4-a6, -(sp)
+	move.w #(((.end_calib_code_in_stack - .start_calib_code_in_stack) / 2) - 1), d0
+	lea -(.end_calib_code_in_stack - .start_calib_code_in_stack)(sp), sp
+	move.l sp, a5				; Test loop in the RAM
+	move.l sp, a2
+	lea .start_calib_code_in_stack, a1
+.copy_calib_code:
+	move.w (a1)+, (a2)+
+	dbf d0, .copy_calib_code
+
+	moveq #-1, d3				; D3 round ready. The RP2040 starts the tests
+	moveq #0, d4
+	moveq #0, d5
+	send_sync APP_TERMINAL_CALIBRATE_RESULT, 12
+	move.l #-1, a4				; Last round reported
+.calib_loop:
+	jsr (a5)					; Returns the state in D0, errors in D7, passes in D6
+	cmp.l #CALIB_STATE_DONE, d0
+	beq.s .calib_done
+	move.l CALIB_ROUND_ADDR, a4	; The round tested, read with the default timing
+	move.l a4, d3				; D3 round
+	move.l d7, d4				; D4 errors
+	move.l d6, d5				; D5 passes
+	send_sync APP_TERMINAL_CALIBRATE_RESULT, 12
+	bra .calib_loop
+.calib_done:
+	lea (.end_calib_code_in_stack - .start_calib_code_in_stack)(sp), sp
+	movem.l (sp)+, a4-a6
+	rts
+
+	even
+.start_calib_code_in_stack:
+	moveq #0, d7				; Errors
+	moveq #0, d6				; Passes over the whole pattern
+.calib_wait:
+	move.l CALIB_STATE_ADDR, d0
+	cmp.l #CALIB_STATE_TEST, d0
+	beq.s .calib_test
+	cmp.l #CALIB_STATE_REPORT, d0
+	beq.s .calib_confirm
+	cmp.l #CALIB_STATE_DONE, d0
+	bne.s .calib_wait
+.calib_confirm:
+	; A read with a bad timing could look like a new state. Read it again
+	moveq #(CALIB_CONFIRM_READS - 1), d1
+.calib_confirm_read:
+	cmp.l CALIB_STATE_ADDR, d0
+	bne.s .calib_wait
+	dbf d1, .calib_confirm_read
+	cmp.l #CALIB_STATE_DONE, d0
+	beq.s .calib_exit
+	cmp.l CALIB_ROUND_ADDR, a4
+	beq.s .calib_wait			; Round already reported, wait for the next one
+.calib_exit:
+	rts
+.calib_test:
+	move.l #CALIB_PATTERN_ADDR, a0
+	move.w #(CALIB_PATTERN_LONGS - 1), d1
+.calib_test_read:
+	move.w a0, d2				; Each long is the inverted offset and the
+	not.w d2					; offset of its second word
+	swap d2
+	move.w a0, d2
+	addq.w #2, d2
+	cmp.l (a0)+, d2
+	beq.s .calib_test_ok
+	addq.l #1, d7
+.calib_test_ok:
+	dbf d1, .calib_test_read
+	addq.l #1, d6
+	bra.s .calib_wait
+	even
+.end_calib_code_in_stack:
+
 ; SidecarTridge Multidevice Real Time Clock (RTC) Emulator
 ; (C) 2023-24-25 by Diego Parrilla
 ; License: GPL v3
@@ -277,41 +679,56 @@ APP_RTCEMUL             equ $0300                           ; MSB is the app cod
 CMD_TEST_NTP            equ ($0 + APP_RTCEMUL)              ; Command code to ping to the Sidecart
 CMD_READ_DATETME        equ ($1 + APP_RTCEMUL)              ; Command code to read the date and time from the Sidecart
 CMD_SAVE_VECTORS        equ ($2 + APP_RTCEMUL)              ; Command code to save the vectors in the Sidecart
-CMD_REENTRY_LOCK        equ ($3 + APP_RTCEMUL)              ; Command code to lock the reentry to XBIOS in the Sidecart
-CMD_REENTRY_UNLOCK      equ ($4 + APP_RTCEMUL)              ; Command code to unlock the reentry to XBIOS in the Sidecart
 CMD_SET_SHARED_VAR      equ ($5 + APP_RTCEMUL)              ; Command code to set a shared variable in the Sidecart
+CMD_SET_SHARED_VARS     equ ($6 + APP_RTCEMUL)              ; Command code to set up to two shared variables in the Sidecart
 RTCEMUL_NTP_SUCCESS     equ (RANDOM_TOKEN_SEED_ADDR + 4)    ; Magic number to identify a successful NTP query
 RTCEMUL_DATETIME_BCD    equ (RTCEMUL_NTP_SUCCESS + 4)      ; ntp_success + 4 bytes
 RTCEMUL_DATETIME_MSDOS  equ (RTCEMUL_DATETIME_BCD + 8)     ; datetime_bcd + 8 bytes
 RTCEMUL_OLD_XBIOS       equ (RTCEMUL_DATETIME_MSDOS + 8)   ; datetime_msdos + 8 bytes
-RTCEMUL_REENTRY_TRAP    equ (RTCEMUL_OLD_XBIOS + 4)        ; old_bios + 4 bytes
-RTCEMUL_Y2K_PATCH       equ (RTCEMUL_REENTRY_TRAP + 4)     ; reentry_trap + 4 byte
-RTCEMUL_SHARED_VARIABLES equ (RTCEMUL_Y2K_PATCH + 8)       ; y2k_patch + 8 bytes
+RTCEMUL_OLD_GEMDOS      equ (RTCEMUL_OLD_XBIOS + 4)        ; old_bios + 4 bytes
+RTCEMUL_Y2K_PATCH       equ (RTCEMUL_OLD_GEMDOS + 4)       ; old_gemdos + 4 bytes
+RTCEMUL_DATETIME_SEQ    equ (RTCEMUL_Y2K_PATCH + 4)        ; y2k_patch + 4 bytes. Odd while the RP2040 updates the time
+RTCEMUL_DRIFT_PPB       equ (RTCEMUL_DATETIME_SEQ + 4)     ; datetime_seq + 4 bytes. Crystal drift in ppb
+RTCEMUL_SYNC_AGE        equ (RTCEMUL_DRIFT_PPB + 4)        ; drift_ppb + 4 bytes. Seconds since the last NTP sync
+RTCEMUL_SHARED_VARIABLES equ (RTCEMUL_SYNC_AGE + 4)        ; sync_age + 4 bytes
+DATETIME_SEQ_RETRIES    equ 1000                            ; Reads of a torn time before keeping the last one. About 10 ms
+SYNC_TIMEOUT_ADDR       equ (RTCEMUL_SHARED_VARIABLES + (SHARED_VARIABLE_SYNC_TIMEOUT * 4)) ; Calibrated sync timeout. 0 in the terminal
+RESIDENT_ADDR           equ (RTCEMUL_SHARED_VARIABLES + (SHARED_VARIABLE_RESIDENT_ADDR * 4)) ; Resident code in RAM. 0 in the terminal
 
 XBIOS_TRAP_ADDR         equ $b8                             ; TRAP #14 Handler (XBIOS)
+GEMDOS_TRAP_ADDR        equ $84                             ; TRAP #1 Handler (GEMDOS)
+RTC_COOKIE              equ 'SRTC'                          ; Cookie with the address of rtc_info
+RTC_INFO_VERSION        equ 1                               ; Version of the rtc_info structure
 _longframe      equ $59e    ; Address of the long frame flag. If this value is 0 then the processor uses short stack frames, otherwise it uses long stack frames.
-
-; Send a synchronous command to the Sidecart setting the reentry flag for the next XBIOS calls
-; inside our trapped XBIOS calls. Should be always paired with reentry_xbios_unlock
-reentry_xbios_lock	macro
-                    movem.l d0-d7/a0-a6,-(sp)            ; Save all registers
-                    send_sync CMD_REENTRY_LOCK,0         ; Command code to lock the reentry
-                    movem.l (sp)+,d0-d7/a0-a6            ; Restore all registers
-                	endm
-
-; Send a synchronous command to the Sidecart clearing the reentry flag for the next XBIOS calls
-; inside our trapped XBIOS calls. Should be always paired with reentry_xbios_lock
-reentry_xbios_unlock  macro
-                    movem.l d0-d7/a0-a6,-(sp)            ; Save all registers
-                    send_sync CMD_REENTRY_UNLOCK,0       ; Command code to unlock the reentry
-                    movem.l (sp)+,d0-d7/a0-a6            ; Restore all registers
-                	endm
+_nvbls          equ $454    ; Number of slots of the VBL queue
+_vblqueue       equ $456    ; Address of the slots of the VBL queue
+savptr          equ $4a2    ; Save area of the registers in the BIOS and XBIOS calls
+BIOS_SAVE_SIZE  equ 46      ; Room in the save area for a call from an interrupt
+
+; Clock discipline. Must match the values in rtc.h
+SHARED_VARIABLE_RTC_DISCIPLINE  equ (SHARED_VARIABLE_SHARED_FUNCTIONS_SIZE + 0) ; Non zero: check the clock in the VBL
+RTC_DISCIPLINE_ADDR     equ (RTCEMUL_SHARED_VARIABLES + (SHARED_VARIABLE_RTC_DISCIPLINE * 4))
+DISCIPLINE_PERIOD_MASK  equ $1FFF   ; Check every 8192 ticks of the 200 Hz timer, about 41 seconds
+DISCIPLINE_WINDOW       equ 4       ; Ticks of the 200 Hz timer in a VBL at 50 Hz
+DISCIPLINE_MAX_DRIFT    equ 1       ; Drift allowed in units of 2 seconds of the MSDOS time
+
+; GEMDOS hook. Must match the values in rtc.h
+SHARED_VARIABLE_RTC_GEMDOS_HOOK equ (SHARED_VARIABLE_SHARED_FUNCTIONS_SIZE + 1) ; Non zero: answer Tgettime and Tgetdate
+RTC_GEMDOS_HOOK_ADDR    equ (RTCEMUL_SHARED_VARIABLES + (SHARED_VARIABLE_RTC_GEMDOS_HOOK * 4))
 
 rom_function:
 ; Get information about the hardware
 	wait_sec
-    bsr detect_hw
-    bsr get_tos_version
+    bsr relocate_resident               ; The hooks and the wait loops run from RAM
+    bsr calibrate_sync_timeout          ; The next commands wait the same time in all the CPUs
+    bsr read_hw_type
+    move.l d0, -(sp)                    ; Save the hardware type
+    bsr read_tos_version
+    move.l #SHARED_VARIABLE_HARDWARE_TYPE, d3   ; First variable index
+    move.l (sp)+, d4                    ; First variable value
+    move.l #SHARED_VARIABLE_SVERSION, d5    ; Second variable index
+    move.l d0, d6                       ; Second variable value
+    send_sync CMD_SET_SHARED_VARS, 16   ; Both variables in one command
 _ntp_ready:
     send_sync CMD_READ_DATETME,0         ; Command code to read the date and time
     tst.w d0                            ; 0 if no error
@@ -319,22 +736,71 @@ _ntp_ready:
 
 _set_vectors:
     tst.l RTCEMUL_Y2K_PATCH
+    bne.s _save_vectors
+    tst.l RTC_GEMDOS_HOOK_ADDR
     beq.s _set_vectors_ignore
 
 ; We don't need to fix Y2K problem in EmuTOS
-; Save the old XBIOS vector in RTCEMUL_OLD_XBIOS and set our own vector
-    bsr save_vectors
-    tst.w d0
-    bne _exit_timemout
+; Save the old XBIOS and GEMDOS vectors in RTCEMUL_OLD_XBIOS and
+; RTCEMUL_OLD_GEMDOS while the date and time are set
+_save_vectors:
+    move.l XBIOS_TRAP_ADDR.w,d3          ; Address of the old XBIOS vector
+    move.l GEMDOS_TRAP_ADDR.w,d4         ; Address of the old GEMDOS vector
+    send_async CMD_SAVE_VECTORS,8        ; Send the command to the Sidecart
+    move.l d0, d7                       ; Ticket of the command. The traps keep D7
 
 _set_vectors_ignore:
-    pea RTCEMUL_DATETIME_BCD            ; Buffer should have a valid IKBD date and time format
+    ; The RP2040 refreshes the date and time every second. Copy them while the
+    ; sequence counter is even and has not changed, to never read a torn time.
+    ; If the RP2040 stops in the middle of an update, keep the last copy
+    lea -8(sp), sp                      ; Local copy of the IKBD date and time
+    move.w #DATETIME_SEQ_RETRIES-1, d1
+_read_datetime_retry:
+    move.l RTCEMUL_DATETIME_SEQ, d2     ; Odd while the RP2040 updates the time
+    move.l RTCEMUL_DATETIME_BCD, (sp)
+    move.l (RTCEMUL_DATETIME_BCD + 4), 4(sp)
+    move.l RTCEMUL_DATETIME_MSDOS, d6
+    btst #0, d2
+    bne.s _read_datetime_next
+    cmp.l RTCEMUL_DATETIME_SEQ, d2      ; Retry if updated while copying
+    beq.s _read_datetime_done
+_read_datetime_next:
+    dbra d1, _read_datetime_retry
+_read_datetime_done:
+
+    move.l sp, a0
+    pea (a0)                            ; Buffer should have a valid IKBD date and time format
     move.w #6, -(sp)                    ; Six bytes plus the header = 7 bytes
     move.w #25, -(sp)                   ; 
     trap #14
     addq.l #8, sp
+    lea 8(sp), sp                       ; Free the local copy
 
-    move.l RTCEMUL_DATETIME_MSDOS, d0
+    tst.l RTCEMUL_Y2K_PATCH
+    bne.s _wait_vectors
+    tst.l RTC_GEMDOS_HOOK_ADDR
+    beq.s _vectors_ready
+_wait_vectors:
+    move.l d7, d0
+    bsr wait_ticket                     ; The old vectors must be saved first
+    tst.w d0                            ; 0 if no error
+    bne _exit_timemout                   ; The RP2040 is not responding, timeout now
+
+    ; Now we have the XBIOS vector in RTCEMUL_OLD_XBIOS
+    ; Now we can safely change it to our own vector
+    tst.l RTCEMUL_Y2K_PATCH
+    beq.s _xbios_ready
+    resident_address custom_xbios, d0
+    move.l d0,XBIOS_TRAP_ADDR.w         ; Set our own vector
+_xbios_ready:
+    ; And the GEMDOS vector in RTCEMUL_OLD_GEMDOS
+    tst.l RTC_GEMDOS_HOOK_ADDR
+    beq.s _vectors_ready
+    resident_address custom_gemdos, d0
+    move.l d0,GEMDOS_TRAP_ADDR.w        ; Set our own vector
+_vectors_ready:
+
+    move.l d6, d0
     bsr set_datetime
     tst.w d0
     bne _exit_timemout
@@ -353,36 +819,73 @@ _ignore_y2k:
     trap #14
     addq.l #6, sp
 
+    tst.l RTCEMUL_Y2K_PATCH
+    bne.s _discipline_ignore            ; The XBIOS hook already returns the time of the RP2040
+    tst.l RTC_DISCIPLINE_ADDR
+    beq.s _discipline_ignore
+    bsr install_discipline              ; Keep correcting the clock of TOS
+_discipline_ignore:
+
+    bsr install_cookie                  ; Let the applications read the time directly
     rts
 
 _exit_timemout:
     asksil error_sidecart_comm_msg
     rts
 
-save_vectors:
-    move.l XBIOS_TRAP_ADDR.w,d3          ; Address of the old XBIOS vector
-    send_sync CMD_SAVE_VECTORS,4         ; Send the command to the Sidecart
-    tst.w d0                            ; 0 if no error
-    bne.s _read_timeout                 ; The RP2040 is not responding, timeout now
-
-    ; Now we have the XBIOS vector in RTCEMUL_OLD_XBIOS
-    ; Now we can safely change it to our own vector
-    move.l #custom_xbios,XBIOS_TRAP_ADDR.w    ; Set our own vector
-
+; Install the RTC_COOKIE cookie pointing to rtc_info
+; Nothing to do if there is no cookie-jar (TOS <= 1.04) or it is full
+install_cookie:
+    move.l _p_cookies.w,d0
+    beq.s _install_cookie_done
+    movea.l d0,a0
+_install_cookie_loop:
+    move.l (a0),d0                      ; Look for the end of the cookie-jar
+    beq.s _install_cookie_end
+    cmp.l #RTC_COOKIE,d0
+    beq.s _install_cookie_found         ; Already installed, update it
+    addq.l #8,a0
+    bra.s _install_cookie_loop
+_install_cookie_end:
+    move.l a0,d1
+    sub.l _p_cookies.w,d1
+    lsr.l #3,d1                         ; Cookies in the jar
+    addq.l #1,d1                        ; Plus the new one
+    move.l 4(a0),d0                     ; The last entry holds the number of slots
+    cmp.l d0,d1
+    bcc.s _install_cookie_done          ; No free slot for the end entry
+    clr.l 8(a0)                         ; Move the end of the cookie-jar
+    move.l d0,12(a0)
+    move.l #RTC_COOKIE,(a0)
+_install_cookie_found:
+    move.l #rtc_info,4(a0)
+_install_cookie_done:
     rts
 
-_read_timeout:
-    moveq #-1, d0
+; Put discipline_vbl in a free slot of the VBL queue
+; Nothing to do if the queue is full
+install_discipline:
+    move.w _nvbls.w,d0
+    subq.w #1,d0
+    bmi.s _install_discipline_done
+    movea.l _vblqueue.w,a0
+_install_discipline_loop:
+    tst.l (a0)+                         ; A free slot is zero
+    dbeq d0,_install_discipline_loop
+    bne.s _install_discipline_done      ; No free slot
+    resident_address discipline_vbl, d1
+    move.l d1,-4(a0)
+_install_discipline_done:
     rts
 
-custom_xbios:
-    btst #0, RTCEMUL_REENTRY_TRAP      ; Check if the reentry is locked
-    beq.s _custom_bios_trapped         ; If the bit is active, we are in a reentry call. We need to exec_old_handler the code
-
-    move.l RTCEMUL_OLD_XBIOS, -(sp) ; if not, continue with XBIOS call
-    rts 
+; Resident code, copied to RAM by relocate_resident. It must be position
+; independent: only branches inside the block and absolute addresses out of it
+    even
+resident_start:
 
-_custom_bios_trapped:
+; The handler never calls the XBIOS again, so there is no reentry to guard
+; against and no need to ask the RP2040 to lock or unlock it
+custom_xbios:
     btst #5, (sp)                    ; Check if called from user mode
     beq.s _user_mode                 ; if so, do correct stack pointer
 _not_user_mode:
@@ -409,15 +912,26 @@ _continue_xbios:
     move.l RTCEMUL_OLD_XBIOS, -(sp) ; if not, continue with XBIOS call
     rts 
 
-; Adjust the time when reading to compensate for the Y2K problem
+; Return the date and time directly from the cartridge memory. The RP2040
+; keeps the MSDOS date and time always fresh, without the Y2K offset, so there
+; is no need to call the old XBIOS and add the +30 years.
+; The RP2040 stores the time in the high word, and XBIOS returns the date in
+; the high word. Retry if the RP2040 was updating the time while reading, up
+; to DATETIME_SEQ_RETRIES times. Then return the last value read.
 ; We should not tap this call for EmuTOS
 _getdatetime:
-    reentry_xbios_lock
-	move.w #23,-(sp)
-	trap #14
-	addq.l #2,sp
-	add.l #$3c000000,d0 ; +30 years for all TOS except EmuTOS
-    reentry_xbios_unlock
+    move.w #DATETIME_SEQ_RETRIES-1, d2
+_getdatetime_retry:
+    move.l RTCEMUL_DATETIME_SEQ, d1     ; Odd while the RP2040 updates the time
+    move.l RTCEMUL_DATETIME_MSDOS, d0
+    btst #0, d1
+    bne.s _getdatetime_next
+    cmp.l RTCEMUL_DATETIME_SEQ, d1      ; Retry if updated while reading
+    beq.s _getdatetime_done
+_getdatetime_next:
+    dbra d2, _getdatetime_retry
+_getdatetime_done:
+    swap d0                             ; Date in the high word, time in the low
 	rte
 
 ; Adjust the time when setting to compensate for the Y2K problem
@@ -426,6 +940,133 @@ _setdatetime:
 	sub.l #$3c000000,8(a0)
     bra.s _continue_xbios
 
+; Answer Tgettime and Tgetdate from the cartridge memory, like _getdatetime,
+; and pass the other GEMDOS calls to the old vector. Tsettime and Tsetdate
+; still set the clock of TOS, but the reads always return the RP2040 time
+custom_gemdos:
+    btst #5, (sp)                    ; Check if called from user mode
+    beq.s _gemdos_user_mode          ; if so, do correct stack pointer
+_gemdos_not_user_mode:
+    move.l sp,a0                     ; Move stack pointer to a0
+    bra.s _gemdos_check_cpu
+_gemdos_user_mode:
+    move.l usp,a0                    ; if user mode, correct stack pointer
+    subq.l #6,a0
+_gemdos_check_cpu:
+    tst.w _longframe                ; Check if the CPU is a 68000 or not
+    beq.s _gemdos_notlong
+_gemdos_long:
+    addq.w #2, a0                   ; Correct the stack pointer parameters for long frames
+_gemdos_notlong:
+    cmp.w #Tgettime,6(a0)           ; is it GEMDOS Tgettime?
+    beq.s _gemdos_datetime
+    cmp.w #Tgetdate,6(a0)           ; is it GEMDOS Tgetdate?
+    beq.s _gemdos_datetime
+    move.l RTCEMUL_OLD_GEMDOS, -(sp) ; if not, continue with GEMDOS call
+    rts
+
+; The RP2040 stores the time in the high word and the date in the low word.
+; Retry up to DATETIME_SEQ_RETRIES times, then return the last value read
+_gemdos_datetime:
+    move.w #DATETIME_SEQ_RETRIES-1, d2
+_gemdos_datetime_retry:
+    move.l RTCEMUL_DATETIME_SEQ, d1     ; Odd while the RP2040 updates the time
+    move.l RTCEMUL_DATETIME_MSDOS, d0
+    btst #0, d1
+    bne.s _gemdos_datetime_next
+    cmp.l RTCEMUL_DATETIME_SEQ, d1      ; Retry if updated while reading
+    beq.s _gemdos_datetime_done
+_gemdos_datetime_next:
+    dbra d2, _gemdos_datetime_retry
+_gemdos_datetime_done:
+    cmp.w #Tgetdate,6(a0)
+    beq.s _tgetdate
+    clr.w d0
+    swap d0                             ; Time in the low word
+    rte
+_tgetdate:
+    and.l #$FFFF, d0                    ; Date in the low word
+    rte
+
+; Resident VBL routine. Once in each period of the 200 Hz timer, compare the
+; clock of TOS with the time of the RP2040 and set it again if they drifted
+; apart. The other VBLs only read the timer. TOS saves all the registers
+discipline_vbl:
+    move.w (_hz_200 + 2).w,d0           ; Low word of the 200 Hz timer
+    and.w #DISCIPLINE_PERIOD_MASK,d0
+    cmp.w #DISCIPLINE_WINDOW,d0
+    bcc.s _discipline_done
+    sub.l #BIOS_SAVE_SIZE,savptr.w      ; The VBL can interrupt a BIOS call
+
+	move.w #23,-(sp)                    ; gettime from XBIOS
+	trap #14
+	addq.l #2,sp
+    move.l d0,d2                        ; Date in the high word, time in the low
+    move.w #DATETIME_SEQ_RETRIES-1,d5   ; Then keep the last value read
+_discipline_read:
+    move.l RTCEMUL_DATETIME_SEQ,d1      ; Odd while the RP2040 updates the time
+    move.l RTCEMUL_DATETIME_MSDOS,d3
+    btst #0,d1
+    bne.s _discipline_next
+    cmp.l RTCEMUL_DATETIME_SEQ,d1       ; Retry if updated while reading
+    beq.s _discipline_compare
+_discipline_next:
+    dbra d5,_discipline_read
+_discipline_compare:
+    swap d3                             ; Date in the high word, time in the low
+    cmp.l d3,d2
+    beq.s _discipline_exit              ; Same time, the usual case
+    move.l d2,d0
+    swap d0
+    move.l d3,d1
+    swap d1
+    cmp.w d0,d1
+    bne.s _discipline_set               ; Different date
+
+    move.w d2,d4
+    bsr msdos_time_units
+    move.l d4,d6                        ; Time of TOS
+    move.w d3,d4
+    bsr msdos_time_units                ; Time of the RP2040
+    sub.l d6,d4
+    bpl.s _discipline_drift
+    neg.l d4
+_discipline_drift:
+    cmp.l #DISCIPLINE_MAX_DRIFT,d4
+    bls.s _discipline_exit
+_discipline_set:
+    move.l d3,-(sp)                     ; Date and time of the RP2040
+    move.w #22,-(sp)                    ; settime with XBIOS
+    trap #14
+    addq.l #6,sp
+_discipline_exit:
+    add.l #BIOS_SAVE_SIZE,savptr.w
+_discipline_done:
+    rts
+
+; Convert a MSDOS time to units of 2 seconds since midnight
+; d4.w : Time in MSDOS format
+; Returns the units in d4.l. Uses d5
+msdos_time_units:
+    moveq #0,d5
+    move.w d4,d5
+    lsr.w #5,d5                         ; Hours and minutes
+    and.l #$1F,d4                       ; Seconds / 2
+    move.w d5,-(sp)
+    and.w #$3F,d5                       ; Minutes
+    mulu #30,d5
+    add.l d5,d4
+    move.w (sp)+,d5
+    lsr.w #6,d5                         ; Hours
+    mulu #1800,d5
+    add.l d5,d4
+    rts
+
+; Wait loops of the sync commands of the shared functions
+    resident_sync_code
+    even
+resident_end:
+
 ; Get the date and time from the RP2040 and set the IKBD information
 ; d0.l : Date and time in MSDOS format
 set_datetime:
@@ -456,6 +1097,22 @@ _exit_set_time:
     moveq #-1, d0
     rts
 
+; Public information for the applications, found with the RTC_COOKIE cookie
+; Each field is the address in the cartridge of a long word updated by the RP2040
+; To read a consistent time, copy it while RTCEMUL_DATETIME_SEQ is even and has not changed
+        even
+rtc_info:
+        dc.l RTC_COOKIE
+        dc.w RTC_INFO_VERSION
+        dc.w rtc_info_end - rtc_info        ; Size of the structure
+        dc.l RTCEMUL_DATETIME_SEQ           ; Sequence counter. Odd while the RP2040 updates the time
+        dc.l RTCEMUL_DATETIME_BCD           ; IKBD set time command: $1B and six BCD bytes
+        dc.l RTCEMUL_DATETIME_MSDOS         ; Date and time in MS-DOS format
+        dc.l RTCEMUL_SYNC_AGE               ; Seconds since the last NTP sync. $FFFFFFFF if never
+        dc.l RTCEMUL_DRIFT_PPB              ; Drift of the crystal in ppb
+        dc.l RTCEMUL_NTP_SUCCESS            ; $FFFFFFFF if the clock is synced with NTP
+rtc_info_end:
+
         even
 error_sidecart_comm_msg:
         dc.b	$d,$a,"Communication error. Press reset.",$d,$a,0